@@ -0,0 +1,858 @@
+//-------------------------------------------------------------------------------------------------------------
+// NTBenchmark.cpp
+//
+// Times the simulation's hot paths at a range of entity counts and writes the results as JSON, so that runs
+// from before and after a change can be diffed.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include "stdafx.h"
+
+#include "game.h"
+#include "gamesnapshot.h"
+#include "gravity.h"
+#include "integrator.h"
+#include "kdtree.h"
+#include "netsnapshot.h"
+#include "objects.h"
+#include "poissondisk.h"
+
+#include <cfloat>
+#include <chrono>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------------------
+// Constants
+//-------------------------------------------------------------------------------------------------------------
+static const size_t SCALE_STEP = 4;
+static const size_t BENCHMARK_SUNS = 25;
+static const float FIELD_WIDTH = 1600.f;
+static const float FIELD_HEIGHT = 1100.f;
+static const float TICK_DELTA = 1.f / 60.f;
+
+// How far a missile at top speed travels in a 0.2 s tick, the length of path the hit test sweeps.
+static const float MISSILE_PATH_LENGTH = 100.f;
+
+// Asteroids' spacing, and how much room to give each point so that the whole count fits with some to spare.
+static const float PLACEMENT_DISTANCE = 50.f;
+static const float PLACEMENT_AREA_PER_POINT = 1.7f * PLACEMENT_DISTANCE * PLACEMENT_DISTANCE;
+
+// Points looked up per iteration of the nearest-neighbour benchmarks.
+static const size_t NEAREST_QUERIES = 256;
+
+// Missiles last ten seconds, so a game tick benchmark stops before they start to expire.
+static const long MAX_GAME_TICKS = 500;
+
+// The sun gravity benchmark puts its bodies back where they started this often, so that it goes on timing
+// bodies among the suns rather than ones that have flown off the field.
+static const long GRAVITY_RESET_TICKS = 60;
+
+// Results are folded into this so the compiler can't discard the work being timed.
+volatile float g_Sink;
+
+// Where the benchmarks' random placement comes from. Reseeded before each benchmark and scale.
+static RandomStream g_Random;
+
+//-------------------------------------------------------------------------------------------------------------
+// Options
+// Command line settings for a benchmark run.
+//-------------------------------------------------------------------------------------------------------------
+struct Options
+{
+	Options()
+	: m_Seed(1)
+	, m_MinEntities(16)
+	, m_MaxEntities(1048576)
+	, m_MinTime(0.25)
+	, m_Filter(NULL)
+	, m_JsonPath(NULL)
+	, m_ReplayPath(NULL)
+	, m_SunGravity(-1.f)
+	{
+	}
+
+	unsigned int	m_Seed;
+	size_t			m_MinEntities;
+	size_t			m_MaxEntities;
+	double			m_MinTime;
+	const char*		m_Filter;
+	const char*		m_JsonPath;
+	const char*		m_ReplayPath;
+	float			m_SunGravity;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// BenchmarkResult
+// One benchmark at one scale.
+//-------------------------------------------------------------------------------------------------------------
+struct BenchmarkResult
+{
+	const char*	m_Name;
+	size_t		m_Entities;
+	long		m_Iterations;
+	double		m_Seconds;
+
+	double GetNanosecondsPerIteration() const { return m_Seconds * 1e9 / m_Iterations; }
+	double GetNanosecondsPerEntity() const { return GetNanosecondsPerIteration() / m_Entities; }
+};
+
+//--------------------------------------------------------------------------------------------------------------
+// RandomPoint
+// A point anywhere on the playing field, with a fractional part so that nothing lines up on whole pixels.
+//--------------------------------------------------------------------------------------------------------------
+static NTPoint RandomPoint()
+{
+	return NTPoint(g_Random.NextRange(0.f, FIELD_WIDTH), g_Random.NextRange(0.f, FIELD_HEIGHT));
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SpawnSuns
+//--------------------------------------------------------------------------------------------------------------
+static void SpawnSuns(EntityArray& suns, size_t count)
+{
+	for (size_t index = 0; index < count; index++)
+	{
+		Sun::Spawn(suns, g_Random.NextRange(100, 1500), g_Random.NextRange(100, 1000));
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SpawnMissiles
+// Missiles scattered over the field, each heading for another random point.
+//--------------------------------------------------------------------------------------------------------------
+static void SpawnMissiles(EntityArray& missiles, size_t count)
+{
+	missiles.Reserve(missiles.Size() + count);
+	for (size_t index = 0; index < count; index++)
+	{
+		NTPoint from = RandomPoint();
+		NTPoint to = RandomPoint();
+		Missile::Spawn(missiles, from, to);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Time
+// Call body repeatedly until at least minTime has passed or maxIterations have been run, and record how
+// long it took. Setup is done by the caller, so only body is timed.
+//--------------------------------------------------------------------------------------------------------------
+template <typename Body>
+static BenchmarkResult Time(const char* name, size_t entities, double minTime, long maxIterations, Body body)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	BenchmarkResult result;
+	result.m_Name = name;
+	result.m_Entities = entities;
+	result.m_Iterations = 0;
+
+	Clock::time_point start = Clock::now();
+	do
+	{
+		body();
+		result.m_Iterations++;
+		result.m_Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+	while (result.m_Seconds < minTime && result.m_Iterations < maxIterations);
+
+	return result;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkNTPoint
+// The vector operations every update leans on: difference, length and normalisation.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkNTPoint(const char* name, size_t entities, const Options& options)
+{
+	std::vector<NTPoint> from(entities), to(entities);
+	for (size_t index = 0; index < entities; index++)
+	{
+		from[index] = RandomPoint();
+		to[index] = RandomPoint();
+	}
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		float sum = 0.f;
+		for (size_t index = 0; index < entities; index++)
+		{
+			NTPoint direction = to[index] - from[index];
+			float length = direction.GetLength();
+			direction.Normalise();
+			sum += (direction * length + from[index]).x;
+		}
+		g_Sink = sum;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkWithinLength
+// Counting the points within a radius of another by comparing their distances, each a square root.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkWithinLength(const char* name, size_t entities, const Options& options)
+{
+	EntityArray points(entities);
+	SpawnMissiles(points, entities);
+	NTPoint centre = RandomPoint();
+	const float radius = 200.f;
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		size_t within = 0;
+		for (size_t index = 0; index < entities; index++)
+		{
+			within += (points.GetPosition(index) - centre).GetLength() < radius ? 1 : 0;
+		}
+		g_Sink = (float)within;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkWithinSquared
+// The same count as BenchmarkWithinLength, from a batch of squared distances compared with the squared radius.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkWithinSquared(const char* name, size_t entities, const Options& options)
+{
+	EntityArray points(entities);
+	SpawnMissiles(points, entities);
+	NTPoint centre = RandomPoint();
+	const float radius = 200.f;
+	std::vector<float> distances(entities);
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		DistanceSquared(&points.m_PositionX[0], &points.m_PositionY[0], entities, centre, &distances[0]);
+		size_t within = 0;
+		for (size_t index = 0; index < entities; index++)
+		{
+			within += distances[index] < radius * radius ? 1 : 0;
+		}
+		g_Sink = (float)within;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkSunGravity
+// A tick of IntegrateBodies for every body against a full set of suns, with the game's sun gravity and
+// integrator settings, as Game::Integrate runs it for the missiles. The default gravity is the game's, so
+// this times what a default game pays; -gravity times it with the suns pulling.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkSunGravity(const char* name, size_t entities, const Options& options)
+{
+	GameSettings settings;
+	float gravity = options.m_SunGravity >= 0.f ? options.m_SunGravity : settings.m_SunGravity;
+
+	EntityArray suns;
+	EntityArray startBodies(entities);
+	SpawnSuns(suns, BENCHMARK_SUNS);
+	SpawnMissiles(startBodies, entities);
+	EntityArray bodies = startBodies;
+
+	GravityField noField;
+	GravityFieldScratch fieldScratch;
+	SunGravity sunGravity(suns, gravity, noField, fieldScratch);
+	IntegratorScratch scratch;
+	IntegratorStats stats;
+	long ticks = 0;
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		if (++ticks % GRAVITY_RESET_TICKS == 0)
+		{
+			bodies = startBodies;
+		}
+		IntegrateBodies(bodies, 0, entities, TICK_DELTA, sunGravity, settings.m_Integrator, scratch, stats);
+		g_Sink = bodies.m_VelocityX[0];
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkAsteroidHitTest
+// Asteroids::CanDestory for one missile's path against every asteroid, as a brute force collision pass would.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkAsteroidHitTest(const char* name, size_t entities, const Options& options)
+{
+	EntityArray asteroids(entities);
+	for (size_t index = 0; index < entities; index++)
+	{
+		NTPoint position = RandomPoint();
+		Asteroids::Spawn(asteroids, (int)position.x, (int)position.y);
+	}
+	NTPoint missileFrom = RandomPoint();
+	NTPoint missileTo = missileFrom + NTPoint(0.6f, 0.8f) * MISSILE_PATH_LENGTH;
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		size_t hits = 0;
+		for (size_t index = 0; index < entities; index++)
+		{
+			float time;
+			hits += Asteroids::CanDestory(asteroids, index, missileFrom, missileTo, time) ? 1 : 0;
+		}
+		g_Sink = (float)hits;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SpawnAsteroids
+//--------------------------------------------------------------------------------------------------------------
+static void SpawnAsteroids(EntityArray& asteroids, size_t count)
+{
+	asteroids.Reserve(asteroids.Size() + count);
+	for (size_t index = 0; index < count; index++)
+	{
+		NTPoint position = RandomPoint();
+		Asteroids::Spawn(asteroids, (int)position.x, (int)position.y);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkNearestScan
+// Finding the nearest asteroid to each of a set of points by looking at every asteroid, as targeting had to
+// before the asteroids were kept in a tree.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkNearestScan(const char* name, size_t entities, const Options& options)
+{
+	EntityArray asteroids;
+	SpawnAsteroids(asteroids, entities);
+	std::vector<NTPoint> points(NEAREST_QUERIES);
+	for (size_t query = 0; query < NEAREST_QUERIES; query++)
+	{
+		points[query] = RandomPoint();
+	}
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		size_t found = 0;
+		for (size_t query = 0; query < NEAREST_QUERIES; query++)
+		{
+			float nearest = FLT_MAX;
+			for (size_t index = 0; index < asteroids.Size(); index++)
+			{
+				float dx = asteroids.m_PositionX[index] - points[query].x;
+				float dy = asteroids.m_PositionY[index] - points[query].y;
+				if (dx * dx + dy * dy < nearest)
+				{
+					nearest = dx * dx + dy * dy;
+					found = index;
+				}
+			}
+		}
+		g_Sink = (float)found;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkNearestTree
+// The same lookups as BenchmarkNearestScan, through a k-d tree over the asteroids.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkNearestTree(const char* name, size_t entities, const Options& options)
+{
+	EntityArray asteroids;
+	SpawnAsteroids(asteroids, entities);
+	std::vector<NTPoint> points(NEAREST_QUERIES);
+	for (size_t query = 0; query < NEAREST_QUERIES; query++)
+	{
+		points[query] = RandomPoint();
+	}
+
+	KdTree tree;
+	tree.Build(asteroids);
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		unsigned int found = 0;
+		for (size_t query = 0; query < NEAREST_QUERIES; query++)
+		{
+			KdTreeNeighbour nearest;
+			if (tree.QueryNearest(points[query].x, points[query].y, FLT_MAX, nearest))
+			{
+				found = nearest.m_Handle.m_Slot;
+			}
+		}
+		g_Sink = (float)found;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkTreeBuild
+// Building a k-d tree over the asteroids, as the game does whenever enough have been destroyed.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkTreeBuild(const char* name, size_t entities, const Options& options)
+{
+	EntityArray asteroids;
+	SpawnAsteroids(asteroids, entities);
+	KdTree tree;
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		tree.Build(asteroids);
+		g_Sink = (float)tree.Size();
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkShipUpdate
+// Ship::Update for many ships, each checked against the suns through the sun tree.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkShipUpdate(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	SpawnSuns(game.m_Suns, BENCHMARK_SUNS);
+	game.m_SunTree.Build(game.m_Suns);
+
+	game.m_Ships.Reserve(entities);
+	for (size_t index = 0; index < entities; index++)
+	{
+		EntityHandle handle = Ship::Spawn(game.m_Ships);
+		game.m_Ships.Teleport(game.m_Ships.IndexOf(handle), RandomPoint());
+	}
+
+	std::vector<ShipCommand> commands(entities);
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		Ship::Update(game, commands, TICK_DELTA);
+		g_Sink = game.m_Ships.m_PositionX[0];
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkNetEncode
+// A server's snapshot of many thrusting ships, encoded against the one from the tick before, as sent to a
+// client that is keeping up.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkNetEncode(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	SpawnSuns(game.m_Suns, BENCHMARK_SUNS);
+	game.m_SunTree.Build(game.m_Suns);
+
+	game.m_Ships.Reserve(entities);
+	for (size_t index = 0; index < entities; index++)
+	{
+		EntityHandle handle = Ship::Spawn(game.m_Ships);
+		game.m_Ships.Teleport(game.m_Ships.IndexOf(handle), RandomPoint());
+	}
+
+	std::vector<ShipCommand> commands(entities);
+	for (size_t index = 0; index < entities; index++)
+	{
+		commands[index].Set(SHIP_THRUST);
+		commands[index].Set(index % 2 == 0 ? SHIP_TURN_LEFT : SHIP_TURN_RIGHT);
+	}
+
+	NetSnapshot baseline;
+	NetSnapshot snapshot;
+	Ship::Update(game, commands, TICK_DELTA);
+	baseline.Capture(game);
+	Ship::Update(game, commands, TICK_DELTA);
+	snapshot.Capture(game);
+
+	std::vector<unsigned char> packet;
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		packet.clear();
+		BitWriter writer(packet);
+		snapshot.Encode(&baseline, writer);
+		writer.Flush();
+		g_Sink = (float)packet.size();
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkBotControl
+// BotController deciding for many ships, each looking for the nearest sun and asteroid through the trees.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkBotControl(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	game.m_Settings.m_ThreadCount = 1;
+	game.Initialise(options.m_Seed);
+
+	game.m_Ships.Reserve(entities);
+	std::vector<unsigned int> ships;
+	for (size_t index = 0; index < entities; index++)
+	{
+		EntityHandle handle = Ship::Spawn(game.m_Ships, RandomPoint(), CONTROLLER_BOT);
+		ships.push_back((unsigned int)game.m_Ships.IndexOf(handle));
+	}
+	game.m_AsteroidTree.Build(game.m_Asteroids);
+
+	BotController bots;
+	std::vector<ShipCommand> commands(game.m_Ships.Size());
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		bots.Control(game, ships, commands);
+		g_Sink = (float)commands[ships[0]].m_Controls;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkGameTick
+// A whole game tick, on a normal playing field with the given number of missiles in flight.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkGameTick(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	game.m_Settings.m_MissileCapacity = entities;
+	game.Initialise(options.m_Seed);
+	SpawnMissiles(game.m_Missiles, entities);
+
+	return Time(name, entities, options.m_MinTime, MAX_GAME_TICKS, [&]()
+	{
+		game.Tick(TICK_DELTA);
+		g_Sink = (float)game.m_Missiles.Size();
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkStateCapture
+// Capturing the whole game, hash and all, with the given number of missiles in flight.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkStateCapture(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	game.m_Settings.m_MissileCapacity = entities;
+	game.Initialise(options.m_Seed);
+	SpawnMissiles(game.m_Missiles, entities);
+
+	GameSnapshot snapshot;
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		snapshot.Capture(game);
+		g_Sink = (float)snapshot.GetHash();
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkStateRestore
+// Restoring the game from a capture, as a rollback does before running the ticks again. The game has moved
+// on a tick since the capture, so there is something to put back.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkStateRestore(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	game.m_Settings.m_MissileCapacity = entities;
+	game.Initialise(options.m_Seed);
+	SpawnMissiles(game.m_Missiles, entities);
+
+	GameSnapshot snapshot;
+	snapshot.Capture(game);
+	game.Tick(TICK_DELTA);
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		snapshot.Restore(game);
+		g_Sink = game.m_Missiles.m_PositionX[0];
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkRender
+// Drawing a whole frame into a framebuffer, on a normal playing field with the given number of missiles.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkRender(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	game.m_Settings.m_MissileCapacity = entities;
+	game.Initialise(options.m_Seed);
+	SpawnMissiles(game.m_Missiles, entities);
+
+	Framebuffer framebuffer;
+	framebuffer.Resize((int)FIELD_WIDTH, (int)FIELD_HEIGHT);
+	FramebufferRenderBackend backend(framebuffer);
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		game.Draw(backend);
+		g_Sink = (float)framebuffer.GetPixel(0, 0);
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkRenderCommands
+// Recording and sorting a frame's commands, without drawing them.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkRenderCommands(const char* name, size_t entities, const Options& options)
+{
+	Game game;
+	game.m_Settings.m_MissileCapacity = entities;
+	game.Initialise(options.m_Seed);
+	SpawnMissiles(game.m_Missiles, entities);
+
+	RenderCommandBuffer commands;
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		game.BuildRenderCommands(commands);
+		g_Sink = (float)commands.GetBatches().size();
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkPlacement
+// Poisson-disk sampling at asteroid spacing, over a square sized to hold the given number of points.
+//--------------------------------------------------------------------------------------------------------------
+static BenchmarkResult BenchmarkPlacement(const char* name, size_t entities, const Options& options)
+{
+	float side = sqrtf((float)entities * PLACEMENT_AREA_PER_POINT);
+	PoissonDiskSampler sampler;
+	std::vector<NTPoint> points;
+
+	return Time(name, entities, options.m_MinTime, LONG_MAX, [&]()
+	{
+		sampler.Generate(g_Random, 0.f, 0.f, side, side, PLACEMENT_DISTANCE, entities, points);
+		g_Sink = (float)points.size();
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BenchmarkReplay
+// Drawing the frames of a capture saved by NTHeadless -capture, over and over. The entity count reported is
+// the average number of commands in a frame. Returns false if the capture couldn't be read.
+//--------------------------------------------------------------------------------------------------------------
+static bool BenchmarkReplay(const char* path, const Options& options, BenchmarkResult& outResult)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	std::vector<RenderCommandBuffer> frames;
+	bool valid = RenderCommandBuffer::ReadCaptureHeader(file);
+	size_t commandCount = 0;
+	while (valid)
+	{
+		RenderCommandBuffer frame;
+		if (!frame.Load(file))
+		{
+			break;
+		}
+		frame.SortByState();
+		commandCount += frame.Size();
+		frames.push_back(frame);
+	}
+	valid = valid && feof(file) != 0;
+	fclose(file);
+
+	if (!valid || frames.empty())
+	{
+		return false;
+	}
+
+	Framebuffer framebuffer;
+	framebuffer.Resize((int)FIELD_WIDTH, (int)FIELD_HEIGHT);
+	FramebufferRenderBackend backend(framebuffer);
+
+	size_t frameIndex = 0;
+	outResult = Time("replay", commandCount / frames.size(), options.m_MinTime, LONG_MAX, [&]()
+	{
+		backend.Submit(frames[frameIndex]);
+		frameIndex = (frameIndex + 1) % frames.size();
+		g_Sink = (float)framebuffer.GetPixel(0, 0);
+	});
+	return true;
+}
+
+//-------------------------------------------------------------------------------------------------------------
+// Benchmarks
+//-------------------------------------------------------------------------------------------------------------
+typedef BenchmarkResult (*BenchmarkFunction)(const char* name, size_t entities, const Options& options);
+
+struct Benchmark
+{
+	const char*			m_Name;
+	BenchmarkFunction	m_Function;
+};
+
+static const Benchmark BENCHMARKS[] =
+{
+	{ "ntpoint",		BenchmarkNTPoint },
+	{ "within_length",	BenchmarkWithinLength },
+	{ "within_squared",	BenchmarkWithinSquared },
+	{ "sun_gravity",	BenchmarkSunGravity },
+	{ "asteroid_hit",	BenchmarkAsteroidHitTest },
+	{ "ship_update",	BenchmarkShipUpdate },
+	{ "bot_control",	BenchmarkBotControl },
+	{ "net_encode",		BenchmarkNetEncode },
+	{ "game_tick",		BenchmarkGameTick },
+	{ "state_capture",	BenchmarkStateCapture },
+	{ "state_restore",	BenchmarkStateRestore },
+	{ "render",			BenchmarkRender },
+	{ "render_commands",	BenchmarkRenderCommands },
+	{ "placement",		BenchmarkPlacement },
+	{ "nearest_scan",	BenchmarkNearestScan },
+	{ "nearest_tree",	BenchmarkNearestTree },
+	{ "tree_build",		BenchmarkTreeBuild },
+};
+
+//--------------------------------------------------------------------------------------------------------------
+// PrintUsage
+//--------------------------------------------------------------------------------------------------------------
+static void PrintUsage(const char* program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("  -seed <n>       seed for every benchmark (default 1)\n");
+	printf("  -min <n>        smallest entity count (default 16)\n");
+	printf("  -max <n>        largest entity count (default 1048576)\n");
+	printf("  -time <seconds> minimum time to spend on each benchmark and scale (default 0.25)\n");
+	printf("  -filter <name>  only run benchmarks whose name contains this\n");
+	printf("  -json <file>    write the results to this file as JSON\n");
+	printf("  -replay <file>  also time drawing the frames of a capture from NTHeadless -capture\n");
+	printf("  -gravity <g>    how hard the suns pull in sun_gravity (default %g, the game's)\n", GameSettings().m_SunGravity);
+	printf("benchmarks:");
+	for (size_t index = 0; index < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); index++)
+	{
+		printf(" %s", BENCHMARKS[index].m_Name);
+	}
+	printf("\n");
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ParseOptions
+// Returns false if the command line could not be parsed.
+//--------------------------------------------------------------------------------------------------------------
+static bool ParseOptions(int argc, char** argv, Options& outOptions)
+{
+	for (int argIndex = 1; argIndex + 1 < argc; argIndex += 2)
+	{
+		const char* arg = argv[argIndex];
+		const char* value = argv[argIndex + 1];
+
+		if (strcmp(arg, "-seed") == 0)
+		{
+			outOptions.m_Seed = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-min") == 0)
+		{
+			outOptions.m_MinEntities = (size_t)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-max") == 0)
+		{
+			outOptions.m_MaxEntities = (size_t)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-time") == 0)
+		{
+			outOptions.m_MinTime = atof(value);
+		}
+		else if (strcmp(arg, "-filter") == 0)
+		{
+			outOptions.m_Filter = value;
+		}
+		else if (strcmp(arg, "-json") == 0)
+		{
+			outOptions.m_JsonPath = value;
+		}
+		else if (strcmp(arg, "-replay") == 0)
+		{
+			outOptions.m_ReplayPath = value;
+		}
+		else if (strcmp(arg, "-gravity") == 0)
+		{
+			outOptions.m_SunGravity = (float)atof(value);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return argc % 2 == 1 && outOptions.m_MinEntities > 0 && outOptions.m_MinEntities <= outOptions.m_MaxEntities;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteJson
+// Returns false if the file couldn't be written.
+//--------------------------------------------------------------------------------------------------------------
+static bool WriteJson(const char* path, const Options& options, const std::vector<BenchmarkResult>& results)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"seed\": %u,\n", options.m_Seed);
+	fprintf(file, "  \"gravity_kernel\": \"%s\",\n", GetGravityKernelName(GetBestGravityKernel()));
+	fprintf(file, "  \"results\": [\n");
+	for (size_t index = 0; index < results.size(); index++)
+	{
+		const BenchmarkResult& result = results[index];
+		fprintf(file, "    {\"name\": \"%s\", \"entities\": %u, \"iterations\": %ld, \"seconds\": %.6f, "
+			"\"ns_per_iteration\": %.3f, \"ns_per_entity\": %.3f}%s\n",
+			result.m_Name, (unsigned int)result.m_Entities, result.m_Iterations, result.m_Seconds,
+			result.GetNanosecondsPerIteration(), result.GetNanosecondsPerEntity(), index + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+
+	return fclose(file) == 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("seed %u, gravity kernel %s\n", options.m_Seed, GetGravityKernelName(GetBestGravityKernel()));
+	printf("%-16s %10s %10s %16s %14s\n", "benchmark", "entities", "iterations", "ns/iteration", "ns/entity");
+
+	std::vector<BenchmarkResult> results;
+	for (size_t benchmarkIndex = 0; benchmarkIndex < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); benchmarkIndex++)
+	{
+		const Benchmark& benchmark = BENCHMARKS[benchmarkIndex];
+		if (options.m_Filter != NULL && strstr(benchmark.m_Name, options.m_Filter) == NULL)
+		{
+			continue;
+		}
+
+		for (size_t entities = options.m_MinEntities; entities <= options.m_MaxEntities; entities *= SCALE_STEP)
+		{
+			// Every benchmark and scale starts from the same random sequence, so each can be rerun on its own.
+			g_Random.Seed(options.m_Seed, RANDOM_STREAM_TOOLS);
+
+			BenchmarkResult result = benchmark.m_Function(benchmark.m_Name, entities, options);
+			printf("%-16s %10u %10ld %16.1f %14.2f\n", result.m_Name, (unsigned int)result.m_Entities, result.m_Iterations,
+				result.GetNanosecondsPerIteration(), result.GetNanosecondsPerEntity());
+			fflush(stdout);
+			results.push_back(result);
+		}
+	}
+
+	if (options.m_ReplayPath != NULL)
+	{
+		BenchmarkResult result;
+		if (!BenchmarkReplay(options.m_ReplayPath, options, result))
+		{
+			fprintf(stderr, "Failed to read %s\n", options.m_ReplayPath);
+			return 1;
+		}
+		printf("%-16s %10u %10ld %16.1f %14.2f\n", result.m_Name, (unsigned int)result.m_Entities, result.m_Iterations,
+			result.GetNanosecondsPerIteration(), result.GetNanosecondsPerEntity());
+		results.push_back(result);
+	}
+
+	if (options.m_JsonPath != NULL && !WriteJson(options.m_JsonPath, options, results))
+	{
+		fprintf(stderr, "Failed to write %s\n", options.m_JsonPath);
+		return 1;
+	}
+
+	return 0;
+}
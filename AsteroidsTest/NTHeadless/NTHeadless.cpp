@@ -0,0 +1,1407 @@
+//-------------------------------------------------------------------------------------------------------------
+// NTHeadless.cpp
+//
+// Runs the simulation without a window, as fast as the CPU allows, and reports the tick rate. Used for
+// soak testing and profiling the simulation on machines without a display.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include "stdafx.h"
+
+#include "framepacer.h"
+#include "game.h"
+#include "gamesnapshot.h"
+#include "gravity.h"
+#include "integrator.h"
+#include "netsession.h"
+#include "objects.h"
+#include "replay.h"
+#include "simthread.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------------------
+// Constants
+//-------------------------------------------------------------------------------------------------------------
+static const int RENDER_WIDTH = 1600;
+static const int RENDER_HEIGHT = 1100;
+
+// Substreams of RANDOM_STREAM_TOOLS, one for each thing the driver does at random.
+static const unsigned int RANDOM_VERIFY_GRAVITY = 0;
+static const unsigned int RANDOM_MISSILES = 1;
+static const unsigned int RANDOM_FIRE = 2;
+static const unsigned int RANDOM_ENERGY = 3;
+static const unsigned int RANDOM_CLIENTS = 4;
+
+// The energy drift test's bodies, and the gravity it uses if none is given.
+static const size_t ENERGY_BODIES = 1000;
+static const float ENERGY_GRAVITY = 10000.f;
+
+// The size of the UDP and IPv4 headers each datagram carries as well as its payload.
+static const unsigned int UDP_HEADER_BYTES = 28;
+
+// Simulated clients change the keys they hold about once in this many ticks, as a player would, rather than
+// every tick.
+static const int CLIENT_KEY_CHANGE_ODDS = 30;
+
+//-------------------------------------------------------------------------------------------------------------
+// Options
+// Command line settings for a headless run.
+//-------------------------------------------------------------------------------------------------------------
+struct Options
+{
+	Options()
+	: m_Ticks(100000)
+	, m_TimeDelta(1.f / 60.f)
+	, m_FrameTime(0.f)
+	, m_Seed((unsigned int)time(NULL))
+	, m_FireInterval(0)
+	, m_Missiles(0)
+	, m_ThreadCount(0)
+	, m_SunCount(0)
+	, m_AsteroidCount(0)
+	, m_BotCount(0)
+	, m_SunGravity(-1.f)
+	, m_Autopilot(false)
+	, m_Cruise(false)
+	, m_StreamWorld(false)
+	, m_ChunkSize(0.f)
+	, m_VerifyGravity(false)
+	, m_MeasureEnergy(false)
+	, m_UseGravityField(false)
+	, m_Render(false)
+	, m_RealTime(false)
+	, m_RenderThread(false)
+	, m_FrameRate(0.f)
+	, m_ImagePath(NULL)
+	, m_CapturePath(NULL)
+	, m_RecordPath(NULL)
+	, m_ReplayPath(NULL)
+	, m_KeyframeInterval(DEFAULT_KEYFRAME_INTERVAL)
+	, m_SeekTick(-1)
+	, m_ServerClients(0)
+	, m_SnapshotInterval(1)
+	, m_PacketLoss(0.f)
+	, m_RollbackTicks(0)
+	, m_TracePath(NULL)
+	, m_TraceEvents(Tracer::DEFAULT_EVENTS_PER_THREAD)
+	{
+	}
+
+	long			m_Ticks;
+	float			m_TimeDelta;
+	float			m_FrameTime;
+	unsigned int	m_Seed;
+	int				m_FireInterval;
+	int				m_Missiles;
+	unsigned int	m_ThreadCount;
+	size_t			m_SunCount;
+	size_t			m_AsteroidCount;
+	size_t			m_BotCount;
+	float			m_SunGravity;
+	bool			m_Autopilot;
+	bool			m_Cruise;
+	bool			m_StreamWorld;
+	float			m_ChunkSize;
+	bool			m_VerifyGravity;
+	bool			m_MeasureEnergy;
+	bool			m_UseGravityField;
+	bool			m_Render;
+	bool			m_RealTime;
+	bool			m_RenderThread;
+	float			m_FrameRate;
+	const char*		m_ImagePath;
+	const char*		m_CapturePath;
+	const char*		m_RecordPath;
+	const char*		m_ReplayPath;
+	unsigned int	m_KeyframeInterval;
+	long long		m_SeekTick;
+	size_t			m_ServerClients;
+	unsigned int	m_SnapshotInterval;
+	float			m_PacketLoss;
+	unsigned int	m_RollbackTicks;
+	const char*		m_TracePath;
+	size_t			m_TraceEvents;
+
+	GravityFieldSettings	m_GravityField;
+};
+
+//--------------------------------------------------------------------------------------------------------------
+// AutopilotKeyState
+// Holds the ship in a thrusting, firing turn so that a run generates a steady stream of missiles.
+//--------------------------------------------------------------------------------------------------------------
+static bool AutopilotKeyState(GameKey key)
+{
+	return key == KEY_LEFT || key == KEY_UP || key == KEY_FIRE;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// CruiseKeyState
+// Holds the ship's thrust, so that it flies off in a straight line across a streamed world.
+//--------------------------------------------------------------------------------------------------------------
+static bool CruiseKeyState(GameKey key)
+{
+	return key == KEY_UP;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// PrintUsage
+//--------------------------------------------------------------------------------------------------------------
+static void PrintUsage(const char* program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("  -ticks <n>      number of ticks to simulate (default 100000)\n");
+	printf("  -dt <seconds>   simulated time per tick (default 1/60)\n");
+	printf("  -frame <secs>   time between updates, to run ticks and frames out of step (default: -dt)\n");
+	printf("  -seed <n>       seed for the playing field (default: current time)\n");
+	printf("  -fire <n>       fire at a random point every n ticks (default: never)\n");
+	printf("  -missiles <n>   launch n missiles across the field at the start\n");
+	printf("  -threads <n>    threads to run each tick on (default: one per hardware thread)\n");
+	printf("  -suns <n>       number of suns to place (default: random)\n");
+	printf("  -asteroids <n>  number of asteroids to place (default: random)\n");
+	printf("  -bots <n>       add n ships flown by the built-in bot\n");
+	printf("  -gravity <g>    how hard the suns pull (default %g)\n", GameSettings().m_SunGravity);
+	printf("  -autopilot      hold turn, thrust and fire on the local ship\n");
+	printf("  -cruise         hold thrust on the local ship, flying it in a straight line\n");
+	printf("  -stream         play on an unbounded world streamed in chunks around the ship\n");
+	printf("  -chunk <size>   with -stream, the side of a chunk (default %g)\n", WorldStreamSettings().m_ChunkSize);
+	printf("  -field <size>   sample gravity from a baked grid with cells of this size\n");
+	printf("  -fielderror <e> largest error allowed in the baked gravity (default 0.05)\n");
+	printf("  -realtime       run against the clock, sleeping between frames, and report busy and idle time\n");
+	printf("  -rate <fps>     with -realtime, wake at this rate as well as when the game needs updating\n");
+	printf("  -render         draw every frame into a framebuffer and report the raster time\n");
+	printf("  -renderthread   simulate on a thread of its own, drawing its latest snapshot on this one\n");
+	printf("                  (not with -capture, which reads the game every frame)\n");
+	printf("  -image <file>   save the last frame as .png or .ppm (implies -render)\n");
+	printf("  -capture <file> save every frame's render commands, for NTBenchmark -replay\n");
+	printf("  -record <file>  record the session's input, with keyframes, for -replay\n");
+	printf("  -keyframes <n>  ticks between keyframes when recording (default %u)\n", DEFAULT_KEYFRAME_INTERVAL);
+	printf("  -replay <file>  play a recording back as fast as possible, instead of simulating\n");
+	printf("  -seek <tick>    with -replay, jump to this tick first and report how long it took\n");
+	printf("  -server <n>     serve the game over loopback UDP to n simulated clients in this process\n");
+	printf("                  (not with -renderthread, -realtime, -capture or -record)\n");
+	printf("  -snapshots <n>  with -server, send a snapshot every n ticks (default 1)\n");
+	printf("  -loss <frac>    with -server, drop this fraction of the packets each client receives\n");
+	printf("  -rollback <n>   run every n ticks twice, restoring the game in between, and check both runs match\n");
+	printf("                  (not with -renderthread, -realtime, -capture, -record or -server)\n");
+	printf("  -trace <file>   time the hot paths and write them out as a Chrome trace, with a summary of each\n");
+	printf("                  (open the file in chrome://tracing or ui.perfetto.dev)\n");
+	printf("  -tracesize <n>  with -trace, events kept on each thread, the latest overwriting the oldest\n");
+	printf("                  (default %u)\n", (unsigned int)Tracer::DEFAULT_EVENTS_PER_THREAD);
+	printf("  -verifygravity  check every supported gravity kernel against the reference and exit\n");
+	printf("  -energy         compare how far each integrator lets bodies' energy drift over -ticks and exit\n");
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ParseOptions
+// Returns false if the command line could not be parsed.
+//--------------------------------------------------------------------------------------------------------------
+static bool ParseOptions(int argc, char** argv, Options& outOptions)
+{
+	for (int argIndex = 1; argIndex < argc; argIndex++)
+	{
+		const char* arg = argv[argIndex];
+		const char* value = argIndex + 1 < argc ? argv[argIndex + 1] : NULL;
+
+		if (strcmp(arg, "-autopilot") == 0)
+		{
+			outOptions.m_Autopilot = true;
+			continue;
+		}
+		if (strcmp(arg, "-cruise") == 0)
+		{
+			outOptions.m_Cruise = true;
+			continue;
+		}
+		if (strcmp(arg, "-stream") == 0)
+		{
+			outOptions.m_StreamWorld = true;
+			continue;
+		}
+		if (strcmp(arg, "-verifygravity") == 0)
+		{
+			outOptions.m_VerifyGravity = true;
+			continue;
+		}
+		if (strcmp(arg, "-energy") == 0)
+		{
+			outOptions.m_MeasureEnergy = true;
+			continue;
+		}
+		if (strcmp(arg, "-render") == 0)
+		{
+			outOptions.m_Render = true;
+			continue;
+		}
+		if (strcmp(arg, "-renderthread") == 0)
+		{
+			outOptions.m_RenderThread = true;
+			continue;
+		}
+		if (strcmp(arg, "-realtime") == 0)
+		{
+			outOptions.m_RealTime = true;
+			continue;
+		}
+
+		if (value == NULL)
+		{
+			return false;
+		}
+
+		if (strcmp(arg, "-ticks") == 0)
+		{
+			outOptions.m_Ticks = atol(value);
+		}
+		else if (strcmp(arg, "-dt") == 0)
+		{
+			outOptions.m_TimeDelta = (float)atof(value);
+		}
+		else if (strcmp(arg, "-frame") == 0)
+		{
+			outOptions.m_FrameTime = (float)atof(value);
+		}
+		else if (strcmp(arg, "-rate") == 0)
+		{
+			outOptions.m_FrameRate = (float)atof(value);
+		}
+		else if (strcmp(arg, "-seed") == 0)
+		{
+			outOptions.m_Seed = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-fire") == 0)
+		{
+			outOptions.m_FireInterval = atoi(value);
+		}
+		else if (strcmp(arg, "-missiles") == 0)
+		{
+			outOptions.m_Missiles = atoi(value);
+		}
+		else if (strcmp(arg, "-threads") == 0)
+		{
+			outOptions.m_ThreadCount = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-suns") == 0)
+		{
+			outOptions.m_SunCount = (size_t)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-asteroids") == 0)
+		{
+			outOptions.m_AsteroidCount = (size_t)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-bots") == 0)
+		{
+			outOptions.m_BotCount = (size_t)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-gravity") == 0)
+		{
+			outOptions.m_SunGravity = (float)atof(value);
+		}
+		else if (strcmp(arg, "-chunk") == 0)
+		{
+			outOptions.m_ChunkSize = (float)atof(value);
+		}
+		else if (strcmp(arg, "-image") == 0)
+		{
+			outOptions.m_ImagePath = value;
+			outOptions.m_Render = true;
+		}
+		else if (strcmp(arg, "-capture") == 0)
+		{
+			outOptions.m_CapturePath = value;
+		}
+		else if (strcmp(arg, "-record") == 0)
+		{
+			outOptions.m_RecordPath = value;
+		}
+		else if (strcmp(arg, "-keyframes") == 0)
+		{
+			outOptions.m_KeyframeInterval = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-replay") == 0)
+		{
+			outOptions.m_ReplayPath = value;
+		}
+		else if (strcmp(arg, "-seek") == 0)
+		{
+			outOptions.m_SeekTick = atoll(value);
+		}
+		else if (strcmp(arg, "-server") == 0)
+		{
+			outOptions.m_ServerClients = (size_t)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-snapshots") == 0)
+		{
+			outOptions.m_SnapshotInterval = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-loss") == 0)
+		{
+			outOptions.m_PacketLoss = (float)atof(value);
+		}
+		else if (strcmp(arg, "-rollback") == 0)
+		{
+			outOptions.m_RollbackTicks = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-trace") == 0)
+		{
+			outOptions.m_TracePath = value;
+		}
+		else if (strcmp(arg, "-tracesize") == 0)
+		{
+			outOptions.m_TraceEvents = (size_t)strtoul(value, NULL, 10);
+		}
+		else if (strcmp(arg, "-field") == 0)
+		{
+			outOptions.m_UseGravityField = true;
+			outOptions.m_GravityField.m_CellSize = (float)atof(value);
+		}
+		else if (strcmp(arg, "-fielderror") == 0)
+		{
+			outOptions.m_GravityField.m_MaxError = (float)atof(value);
+		}
+		else
+		{
+			return false;
+		}
+		argIndex++;
+	}
+
+	if (outOptions.m_FrameTime == 0.f)
+	{
+		outOptions.m_FrameTime = outOptions.m_TimeDelta;
+	}
+
+	return outOptions.m_Ticks > 0 && outOptions.m_TimeDelta > 0.f && outOptions.m_FrameTime > 0.f && outOptions.m_FrameRate >= 0.f
+		&& outOptions.m_GravityField.m_CellSize > 0.f && outOptions.m_KeyframeInterval > 0 && outOptions.m_ChunkSize >= 0.f
+		&& (!outOptions.m_RenderThread || outOptions.m_CapturePath == NULL) && outOptions.m_SnapshotInterval > 0
+		&& outOptions.m_PacketLoss >= 0.f && outOptions.m_PacketLoss < 1.f
+		&& (outOptions.m_ServerClients == 0 || (!outOptions.m_RenderThread && !outOptions.m_RealTime && outOptions.m_CapturePath == NULL
+			&& outOptions.m_RecordPath == NULL))
+		&& (outOptions.m_RollbackTicks == 0 || (!outOptions.m_RenderThread && !outOptions.m_RealTime && outOptions.m_CapturePath == NULL
+			&& outOptions.m_RecordPath == NULL && outOptions.m_ServerClients == 0))
+		&& outOptions.m_TraceEvents > 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// VerifyGravityKernels
+// Run every supported gravity kernel over a random batch and compare it with the reference. The error for
+// each body is measured against the sum of the magnitudes of the individual sun pulls, so that bodies where
+// the pulls cancel out aren't held to an impossible relative tolerance. Being close isn't enough between the
+// kernels, though: a game must play out the same whichever one its CPU picks, so each must also match the
+// scalar kernel bit for bit. Returns false on any mismatch.
+//--------------------------------------------------------------------------------------------------------------
+static bool VerifyGravityKernels(unsigned int seed)
+{
+	// An odd body count so that every kernel also exercises its partial last vector.
+	const size_t bodyCount = 10007;
+	const size_t sunCount = 25;
+	const float gravity = 1000.f;
+	const float tolerance = 1e-5f;
+
+	RandomStream random(seed, RANDOM_STREAM_TOOLS, RANDOM_VERIFY_GRAVITY);
+
+	std::vector<float> bodyX(bodyCount), bodyY(bodyCount), sunX(sunCount), sunY(sunCount);
+	for (size_t index = 0; index < bodyCount; index++)
+	{
+		bodyX[index] = random.NextRange(0.f, 1600.f);
+		bodyY[index] = random.NextRange(0.f, 1100.f);
+	}
+	for (size_t index = 0; index < sunCount; index++)
+	{
+		sunX[index] = (float)random.NextRange(100, 1500);
+		sunY[index] = (float)random.NextRange(100, 1000);
+	}
+
+	std::vector<float> scale(bodyCount, 0.f);
+	for (size_t bodyIndex = 0; bodyIndex < bodyCount; bodyIndex++)
+	{
+		for (size_t sunIndex = 0; sunIndex < sunCount; sunIndex++)
+		{
+			float dx = sunX[sunIndex] - bodyX[bodyIndex];
+			float dy = sunY[sunIndex] - bodyY[bodyIndex];
+			scale[bodyIndex] += gravity / sqrtf(dx * dx + dy * dy);
+		}
+	}
+
+	SunGravityBatch batch;
+	batch.m_BodyX = &bodyX[0];
+	batch.m_BodyY = &bodyY[0];
+	batch.m_BodyCount = bodyCount;
+	batch.m_SunX = &sunX[0];
+	batch.m_SunY = &sunY[0];
+	batch.m_SunCount = sunCount;
+	batch.m_Gravity = gravity;
+
+	std::vector<float> referenceX(bodyCount, 0.f), referenceY(bodyCount, 0.f);
+	batch.m_OutX = &referenceX[0];
+	batch.m_OutY = &referenceY[0];
+	AccumulateSunGravityReference(batch);
+
+	std::vector<float> scalarX(bodyCount, 0.f), scalarY(bodyCount, 0.f);
+	batch.m_OutX = &scalarX[0];
+	batch.m_OutY = &scalarY[0];
+	AccumulateSunGravity(GRAVITY_KERNEL_SCALAR, batch);
+
+	bool allMatch = true;
+	for (int kernel = 0; kernel < GRAVITY_KERNEL_COUNT; kernel++)
+	{
+		const char* name = GetGravityKernelName((GravityKernel)kernel);
+		if (!IsGravityKernelSupported((GravityKernel)kernel))
+		{
+			printf("%-8s not supported on this CPU\n", name);
+			continue;
+		}
+
+		std::vector<float> resultX(bodyCount, 0.f), resultY(bodyCount, 0.f);
+		batch.m_OutX = &resultX[0];
+		batch.m_OutY = &resultY[0];
+		AccumulateSunGravity((GravityKernel)kernel, batch);
+
+		float worstError = 0.f;
+		for (size_t index = 0; index < bodyCount; index++)
+		{
+			float errorX = fabsf(resultX[index] - referenceX[index]);
+			float errorY = fabsf(resultY[index] - referenceY[index]);
+			float error = (errorX > errorY ? errorX : errorY) / scale[index];
+			// A NaN error is a failure too, so test for the pass rather than the fail.
+			if (!(error <= worstError))
+			{
+				worstError = error;
+			}
+		}
+
+		size_t differences = 0;
+		for (size_t index = 0; index < bodyCount; index++)
+		{
+			differences += memcmp(&resultX[index], &scalarX[index], sizeof(float)) != 0 || memcmp(&resultY[index], &scalarY[index], sizeof(float)) != 0;
+		}
+
+		bool match = worstError <= tolerance && differences == 0;
+		printf("%-8s max relative error %g, %u of %u results differ from scalar %s\n", name, worstError, (unsigned int)differences,
+			(unsigned int)bodyCount, match ? "ok" : "FAILED");
+		allMatch = allMatch && match;
+	}
+
+	return allMatch;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SolidSunGravity
+// The suns' pull as the energy test applies it: the game's gravity * d / |d|^2 outside each sun, and inside
+// one the pull of a solid disc, gravity * d / R^2, which falls to nothing at the centre. A point pull has no
+// limit at the centre, so a body passing through one comes out with whatever energy the step happened to
+// give it, and there is no drift left to measure. The game destroys anything that reaches a sun, so what the
+// pull does inside one is free to choose, and this choice keeps every body in the measurement.
+//--------------------------------------------------------------------------------------------------------------
+class SolidSunGravity : public AccelerationSource
+{
+public:
+	SolidSunGravity(const EntityArray& suns, float gravity, float radius)
+	: m_Suns(suns)
+	, m_Gravity(gravity)
+	, m_Radius(radius)
+	{
+	}
+
+	virtual void Accumulate(const float* x, const float* y, size_t count, float* outX, float* outY) const
+	{
+		float radiusSquared = m_Radius * m_Radius;
+		for (size_t index = 0; index < count; index++)
+		{
+			for (size_t sunIndex = 0; sunIndex < m_Suns.Size(); sunIndex++)
+			{
+				float dx = m_Suns.m_PositionX[sunIndex] - x[index];
+				float dy = m_Suns.m_PositionY[sunIndex] - y[index];
+				float distanceSquared = dx * dx + dy * dy;
+				float scale = m_Gravity / (distanceSquared > radiusSquared ? distanceSquared : radiusSquared);
+				outX[index] += dx * scale;
+				outY[index] += dy * scale;
+			}
+		}
+	}
+
+	virtual bool HasEffect() const { return m_Gravity != 0.f && !m_Suns.IsEmpty(); }
+
+	// The energy per unit mass of the body at index, half its speed squared plus the potential the pull is
+	// the slope of: gravity * ln |d| outside each sun, and inside, the paraboloid that meets it at the edge.
+	// Summed in double, since the terms are large and mostly cancel between two nearby points.
+	double GetEnergy(const EntityArray& bodies, size_t index) const
+	{
+		double radiusSquared = (double)m_Radius * m_Radius;
+		double potential = 0.;
+		for (size_t sunIndex = 0; sunIndex < m_Suns.Size(); sunIndex++)
+		{
+			double dx = (double)m_Suns.m_PositionX[sunIndex] - bodies.m_PositionX[index];
+			double dy = (double)m_Suns.m_PositionY[sunIndex] - bodies.m_PositionY[index];
+			double distanceSquared = dx * dx + dy * dy;
+			potential += distanceSquared > radiusSquared ? 0.5 * log(distanceSquared)
+				: 0.5 * (distanceSquared / radiusSquared + log(radiusSquared) - 1.);
+		}
+
+		double velocityX = bodies.m_VelocityX[index];
+		double velocityY = bodies.m_VelocityY[index];
+		return 0.5 * (velocityX * velocityX + velocityY * velocityY) + potential * m_Gravity;
+	}
+
+private:
+	const EntityArray&	m_Suns;
+	float				m_Gravity;
+	float				m_Radius;
+};
+
+//--------------------------------------------------------------------------------------------------------------
+// EnergyDrift
+// How far the bodies' energies have moved from where they started, in units of gravity, which is the square
+// of the speed of a circular orbit. The median is given as well as the worst, since a few bodies that
+// skimmed a sun's edge can outweigh all the rest.
+//--------------------------------------------------------------------------------------------------------------
+struct EnergyDrift
+{
+	double	m_Median;
+	double	m_Worst;
+	size_t	m_Over1Percent;
+};
+
+//--------------------------------------------------------------------------------------------------------------
+// MeasureEnergyDrift
+//--------------------------------------------------------------------------------------------------------------
+static EnergyDrift MeasureEnergyDrift(const EntityArray& bodies, const std::vector<double>& startEnergies, const SolidSunGravity& gravity,
+	float strength)
+{
+	EnergyDrift drift = { 0., 0., 0 };
+	std::vector<double> errors;
+	for (size_t index = 0; index < bodies.Size(); index++)
+	{
+		double error = fabs(gravity.GetEnergy(bodies, index) - startEnergies[index]) / strength;
+		errors.push_back(error);
+		// A NaN is the worst drift of all, so test for the pass rather than the fail.
+		if (!(error <= drift.m_Worst))
+		{
+			drift.m_Worst = error;
+		}
+		drift.m_Over1Percent += error <= 0.01 ? 0 : 1;
+	}
+
+	if (!errors.empty())
+	{
+		std::nth_element(errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+		drift.m_Median = errors[errors.size() / 2];
+	}
+	return drift;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// CompareIntegrators
+// Fly the same bodies through the seed's suns with no speed limits, once with the Euler step the game used to
+// take, once with leapfrog at one step per tick, and once with leapfrog and adaptive substeps, and report
+// how well each holds the bodies' energy. The pull grows without limit with distance, so every body is bound
+// and stays among the suns, and with the suns solid, every body is measured at the end. Adaptive substeps
+// must hold energy at least as well as plain leapfrog, which only shows over long runs, so give it plenty of
+// -ticks. Returns the exit code, which is 1 if they don't.
+//--------------------------------------------------------------------------------------------------------------
+static int CompareIntegrators(const Options& options)
+{
+	float strength = options.m_SunGravity > 0.f ? options.m_SunGravity : ENERGY_GRAVITY;
+	if (!g_Game.Initialise(options.m_Seed))
+	{
+		fprintf(stderr, "Failed to initialise the game\n");
+		return 1;
+	}
+
+	SolidSunGravity gravity(g_Game.m_Suns, strength, (float)Sun::RADIUS);
+
+	// Bodies start anywhere on the field at about orbital speed, so that some pass close to suns.
+	RandomStream random(options.m_Seed, RANDOM_STREAM_TOOLS, RANDOM_ENERGY);
+	EntityArray startBodies(ENERGY_BODIES);
+	float orbitalSpeed = sqrtf(strength);
+	for (size_t index = 0; index < ENERGY_BODIES; index++)
+	{
+		float angle = random.NextRange(0.f, 6.2831853f);
+		float speed = orbitalSpeed * random.NextRange(0.5f, 1.5f);
+		startBodies.Add(NTPoint(random.NextRange(0.f, 1600.f), random.NextRange(0.f, 1100.f)),
+			NTPoint(speed * sinf(angle), speed * cosf(angle)), 0.f, 0.f);
+	}
+
+	std::vector<double> startEnergies(ENERGY_BODIES);
+	for (size_t index = 0; index < ENERGY_BODIES; index++)
+	{
+		startEnergies[index] = gravity.GetEnergy(startBodies, index);
+	}
+
+	printf("seed          %u\n", options.m_Seed);
+	printf("field         %u suns, gravity %g, %u bodies, %ld ticks of %g s\n", (unsigned int)g_Game.m_Suns.Size(), strength,
+		(unsigned int)ENERGY_BODIES, options.m_Ticks, options.m_TimeDelta);
+	printf("%-10s %12s %12s %10s %12s %10s\n", "integrator", "median drift", "worst drift", "over 1%", "steps/body", "wall ms");
+
+	typedef std::chrono::steady_clock Clock;
+	const char* names[] = { "euler", "leapfrog", "adaptive" };
+	EnergyDrift drifts[3];
+	for (int scheme = 0; scheme < 3; scheme++)
+	{
+		EntityArray bodies = startBodies;
+		IntegratorSettings settings = g_Game.m_Settings.m_Integrator;
+		settings.m_MaxSubsteps = scheme == 2 ? settings.m_MaxSubsteps : 1;
+		IntegratorScratch integratorScratch;
+		IntegratorStats stats;
+		std::vector<float> accelerationX, accelerationY;
+
+		Clock::time_point start = Clock::now();
+		for (long tick = 0; tick < options.m_Ticks; tick++)
+		{
+			if (scheme == 0)
+			{
+				accelerationX.assign(bodies.Size(), 0.f);
+				accelerationY.assign(bodies.Size(), 0.f);
+				gravity.Accumulate(&bodies.m_PositionX[0], &bodies.m_PositionY[0], bodies.Size(), &accelerationX[0], &accelerationY[0]);
+				for (size_t index = 0; index < bodies.Size(); index++)
+				{
+					bodies.m_VelocityX[index] += accelerationX[index] * options.m_TimeDelta;
+					bodies.m_VelocityY[index] += accelerationY[index] * options.m_TimeDelta;
+					bodies.m_PositionX[index] += bodies.m_VelocityX[index] * options.m_TimeDelta;
+					bodies.m_PositionY[index] += bodies.m_VelocityY[index] * options.m_TimeDelta;
+				}
+				stats.m_Substeps += bodies.Size();
+			}
+			else
+			{
+				IntegrateBodies(bodies, 0, bodies.Size(), options.m_TimeDelta, gravity, settings, integratorScratch, stats);
+			}
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		EnergyDrift& drift = drifts[scheme];
+		drift = MeasureEnergyDrift(bodies, startEnergies, gravity, strength);
+		printf("%-10s %12.3g %12.3g %10u %12.2f %10.1f\n", names[scheme], drift.m_Median, drift.m_Worst, (unsigned int)drift.m_Over1Percent,
+			(double)stats.m_Substeps / ((double)bodies.Size() * options.m_Ticks), seconds * 1000.);
+	}
+
+	// Tested for the pass, so that a NaN drift fails.
+	const EnergyDrift& leapfrog = drifts[1];
+	const EnergyDrift& adaptive = drifts[2];
+	bool holds = adaptive.m_Median <= leapfrog.m_Median && adaptive.m_Worst <= leapfrog.m_Worst;
+	printf("check         adaptive drift %.3g median, %.3g worst, against leapfrog's %.3g and %.3g %s\n", adaptive.m_Median,
+		adaptive.m_Worst, leapfrog.m_Median, leapfrog.m_Worst, holds ? "ok" : "FAILED");
+
+	return holds ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteImage
+// Save in the format the file name's extension asks for, PNG unless it is .ppm.
+//--------------------------------------------------------------------------------------------------------------
+static bool WriteImage(const Framebuffer& framebuffer, const char* path)
+{
+	size_t length = strlen(path);
+	if (length >= 4 && strcmp(path + length - 4, ".ppm") == 0)
+	{
+		return framebuffer.WritePPM(path);
+	}
+	return framebuffer.WritePNG(path);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// HashGameState
+// The hash of the whole state, for checking that two runs ended up in the same place.
+//--------------------------------------------------------------------------------------------------------------
+static unsigned long long HashGameState(const Game& game)
+{
+	GameSnapshot snapshot;
+	snapshot.Capture(game);
+	return snapshot.GetHash();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// PrintGameSummary
+// What is left on the field, and what happened to get there.
+//--------------------------------------------------------------------------------------------------------------
+static void PrintGameSummary(const Game& game)
+{
+	printf("suns          %u\n", (unsigned int)game.m_Suns.Size());
+	printf("asteroids     %u\n", (unsigned int)game.m_Asteroids.Size());
+	printf("ships         %u\n", (unsigned int)game.m_Ships.Size());
+	printf("missiles      %u\n", (unsigned int)game.m_Missiles.Size());
+	printf("collision     %llu candidate pairs, %llu hits\n", game.m_CollisionTotals.m_CandidatePairs, game.m_CollisionTotals.m_Hits);
+
+	const EntityPoolStats& missilePool = game.m_Missiles.GetStats();
+	printf("missile pool  %u live, %u peak, %u capacity, %u grows, %llu fired\n", (unsigned int)missilePool.m_LiveCount,
+		(unsigned int)missilePool.m_HighWaterMark, (unsigned int)missilePool.m_Capacity, missilePool.m_GrowCount, missilePool.m_Acquired);
+	printf("state hash    %016llx\n", HashGameState(game));
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Replay
+// Play a recording to the end, optionally seeking part way in first. Returns the exit code.
+//--------------------------------------------------------------------------------------------------------------
+static int Replay(const Options& options)
+{
+	InputPlayer player;
+	if (!player.Open(options.m_ReplayPath))
+	{
+		fprintf(stderr, "Failed to read %s\n", options.m_ReplayPath);
+		return 1;
+	}
+
+	g_Game.m_Settings.m_ThreadCount = options.m_ThreadCount;
+	if (!player.Start(g_Game))
+	{
+		fprintf(stderr, "Failed to start playing %s\n", options.m_ReplayPath);
+		return 1;
+	}
+
+	printf("seed          %u\n", player.GetSeed());
+	printf("threads       %u\n", g_Game.m_Jobs.GetThreadCount());
+	printf("recording     ticks %llu to %llu, %u keyframes\n", player.GetFirstTick(), player.GetEndTick(),
+		(unsigned int)player.GetKeyframeCount());
+
+	typedef std::chrono::steady_clock Clock;
+
+	if (options.m_SeekTick >= 0)
+	{
+		Clock::time_point seekStart = Clock::now();
+		if (!player.Seek(g_Game, (unsigned long long)options.m_SeekTick))
+		{
+			fprintf(stderr, "Failed to seek to tick %lld\n", options.m_SeekTick);
+			return 1;
+		}
+		double seekSeconds = std::chrono::duration<double>(Clock::now() - seekStart).count();
+		printf("seek          to tick %lld in %.3f ms\n", options.m_SeekTick, seekSeconds * 1000.);
+	}
+
+	unsigned long long firstTick = player.GetNextTick();
+	Clock::time_point start = Clock::now();
+	while (player.Step(g_Game))
+	{
+	}
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	if (!player.IsFinished())
+	{
+		fprintf(stderr, "The recording is corrupt at tick %llu\n", player.GetNextTick());
+		return 1;
+	}
+
+	unsigned long long ticks = player.GetNextTick() - firstTick;
+	printf("played        %llu ticks in %.3f s\n", ticks, seconds);
+	printf("ticks/sec     %.0f\n", seconds > 0. ? ticks / seconds : 0.);
+	PrintGameSummary(g_Game);
+
+	return 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ServeClients
+// Run the game as a server for clients in this same process, over loopback, each flying its ship with keys
+// that change at random. Every tick the clients send their input, the server takes it in and updates, and
+// sends out snapshots. Afterwards every client's latest snapshot is checked against the server's copy, and
+// the traffic and the server's cost per tick are reported. Returns the exit code.
+//--------------------------------------------------------------------------------------------------------------
+static int ServeClients(const Options& options)
+{
+	NetServerSettings serverSettings;
+	serverSettings.m_Address = NetAddress::Loopback(0);
+	serverSettings.m_MaxClients = options.m_ServerClients;
+	serverSettings.m_SnapshotInterval = options.m_SnapshotInterval;
+
+	NetServer server;
+	if (!server.Start(g_Game, serverSettings))
+	{
+		fprintf(stderr, "Failed to open the server's socket\n");
+		return 1;
+	}
+
+	std::vector<NetClient> clients(options.m_ServerClients);
+	for (size_t client = 0; client < clients.size(); client++)
+	{
+		NetClientSettings clientSettings;
+		clientSettings.m_SimulatedLoss = options.m_PacketLoss;
+		clientSettings.m_LossSeed = options.m_Seed + (unsigned int)client;
+		if (!clients[client].Connect(server.GetAddress(), clientSettings))
+		{
+			fprintf(stderr, "Failed to open client %u's socket\n", (unsigned int)client);
+			return 1;
+		}
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	double updateSeconds = 0.;
+	double clientSeconds = 0.;
+
+	RandomStream commandRandom(options.m_Seed, RANDOM_STREAM_TOOLS, RANDOM_CLIENTS);
+	std::vector<ShipCommand> commands(clients.size());
+	while (g_Game.GetTickCount() < (unsigned long long)options.m_Ticks)
+	{
+		Clock::time_point clientStart = Clock::now();
+		for (size_t client = 0; client < clients.size(); client++)
+		{
+			if (commandRandom.NextRange(0, CLIENT_KEY_CHANGE_ODDS) == 0)
+			{
+				commands[client].m_Controls = (unsigned char)commandRandom.NextRange(0, (int)(SHIP_FIRE << 1));
+			}
+			clients[client].SetCommand(commands[client]);
+			clients[client].Update();
+		}
+		clientSeconds += std::chrono::duration<double>(Clock::now() - clientStart).count();
+
+		server.ReceivePackets();
+
+		Clock::time_point updateStart = Clock::now();
+		bool needRedraw;
+		g_Game.Update(needRedraw);
+		updateSeconds += std::chrono::duration<double>(Clock::now() - updateStart).count();
+
+		server.SendSnapshots();
+	}
+
+	// Take in the last snapshots before checking them.
+	for (size_t client = 0; client < clients.size(); client++)
+	{
+		clients[client].Update();
+	}
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	size_t connected = 0;
+	size_t matched = 0;
+	size_t current = 0;
+	NetClientStats clientTotals;
+	for (size_t client = 0; client < clients.size(); client++)
+	{
+		connected += clients[client].GetState() == NET_CLIENT_CONNECTED ? 1 : 0;
+
+		const NetSnapshot* latest = clients[client].GetLatestSnapshot();
+		const NetSnapshot* expected = latest != NULL ? server.FindSnapshot(latest->m_Tick) : NULL;
+		matched += expected != NULL && latest->Matches(*expected) ? 1 : 0;
+		current += latest != NULL && latest->m_Tick == (unsigned int)g_Game.GetTickCount() ? 1 : 0;
+
+		const NetClientStats& stats = clients[client].GetStats();
+		clientTotals.m_PacketsLost += stats.m_PacketsLost;
+		clientTotals.m_SnapshotsDecoded += stats.m_SnapshotsDecoded;
+		clientTotals.m_SnapshotsStale += stats.m_SnapshotsStale;
+		clientTotals.m_MissingBaselines += stats.m_MissingBaselines;
+		clientTotals.m_Malformed += stats.m_Malformed;
+	}
+
+	if (options.m_ImagePath != NULL && !clients.empty() && clients[0].GetLatestSnapshot() != NULL)
+	{
+		Framebuffer framebuffer;
+		framebuffer.Resize(RENDER_WIDTH, RENDER_HEIGHT);
+		FramebufferRenderBackend backend(framebuffer);
+		RenderSnapshot view;
+		RenderCommandBuffer viewCommands;
+		clients[0].GetLatestSnapshot()->BuildRenderSnapshot(view);
+		view.BuildRenderCommands(viewCommands, 1.f);
+		backend.Submit(viewCommands);
+		if (!WriteImage(framebuffer, options.m_ImagePath))
+		{
+			fprintf(stderr, "Failed to write %s\n", options.m_ImagePath);
+			return 1;
+		}
+	}
+
+	const NetServerStats& stats = server.GetStats();
+	const NetConnectionStats& traffic = stats.m_Traffic;
+	double simSeconds = g_Game.GetTickCount() * (double)g_Game.GetTickDelta();
+	double perClient = clients.empty() || simSeconds <= 0. ? 0. : 1. / (clients.size() * simSeconds * 1024.);
+	double perTick = g_Game.GetTickCount() > 0 ? 1000. / g_Game.GetTickCount() : 0.;
+	double netSeconds = stats.m_ReceiveTime + stats.m_CaptureTime + stats.m_EncodeTime + stats.m_SendTime;
+
+	printf("seed          %u\n", options.m_Seed);
+	printf("threads       %u\n", g_Game.m_Jobs.GetThreadCount());
+	printf("ticks         %llu\n", g_Game.GetTickCount());
+	printf("sim time      %.2f s\n", simSeconds);
+	printf("wall time     %.3f s, %.3f s of it in the clients\n", seconds, clientSeconds);
+	printf("clients       %u connected of %u, %llu rejected, %llu timed out\n", (unsigned int)connected, (unsigned int)clients.size(),
+		stats.m_Rejected, stats.m_TimedOut);
+	printf("snapshots     every %u ticks, %llu full and %llu delta sent, %llu encodings shared, %llu too big to send\n",
+		options.m_SnapshotInterval, traffic.m_FullSnapshots, traffic.m_DeltaSnapshots, stats.m_SharedPackets, stats.m_OversizedPackets);
+	printf("largest       %u bytes\n", (unsigned int)traffic.m_LargestSnapshot);
+	printf("down          %.2f KB/s per client, %.2f KB/s with UDP/IP headers\n", traffic.m_BytesSent * perClient,
+		(traffic.m_BytesSent + traffic.m_PacketsSent * UDP_HEADER_BYTES) * perClient);
+	printf("up            %.2f KB/s per client, %.2f KB/s with UDP/IP headers\n", traffic.m_BytesReceived * perClient,
+		(traffic.m_BytesReceived + traffic.m_PacketsReceived * UDP_HEADER_BYTES) * perClient);
+	printf("received      %llu snapshots decoded, %llu lost, %llu stale, %llu missing their baseline, %llu malformed\n",
+		clientTotals.m_SnapshotsDecoded, clientTotals.m_PacketsLost, clientTotals.m_SnapshotsStale, clientTotals.m_MissingBaselines,
+		clientTotals.m_Malformed);
+	printf("server tick   %.3f ms updating, %.3f ms networking: receive %.3f, capture %.3f, encode %.3f, send %.3f\n",
+		updateSeconds * perTick, netSeconds * perTick, stats.m_ReceiveTime * perTick, stats.m_CaptureTime * perTick,
+		stats.m_EncodeTime * perTick, stats.m_SendTime * perTick);
+	printf("verify        %u of %u clients' latest snapshots match the server's, %u of them up to date\n", (unsigned int)matched,
+		(unsigned int)clients.size(), (unsigned int)current);
+	PrintGameSummary(g_Game);
+
+	return matched == clients.size() ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// RollBack
+// Run in windows of the given number of ticks. At the start of each window the game is captured; at the end
+// the result is captured, the game is put back to the start, and the window is run again with the same input.
+// The two results must match exactly. Reports what capturing and restoring cost. Returns the exit code.
+//--------------------------------------------------------------------------------------------------------------
+static int RollBack(const Options& options)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	GameSnapshot windowStart;
+	GameSnapshot result;
+	GameSnapshot replayed;
+	std::vector<TickInput> inputs;
+	inputs.reserve(options.m_RollbackTicks);
+
+	RandomStream fireRandom(options.m_Seed, RANDOM_STREAM_TOOLS, RANDOM_FIRE);
+	unsigned long long nextFireTick = 0;
+
+	long rollbacks = 0;
+	long mismatches = 0;
+	double captureSeconds = 0.;
+	double slowestCapture = 0.;
+	long captures = 0;
+	double restoreSeconds = 0.;
+	double slowestRestore = 0.;
+	double replaySeconds = 0.;
+	Clock::time_point start = Clock::now();
+
+	float tickDelta = g_Game.GetTickDelta();
+	while (g_Game.GetTickCount() < (unsigned long long)options.m_Ticks)
+	{
+		if (inputs.empty())
+		{
+			Clock::time_point captureStart = Clock::now();
+			windowStart.Capture(g_Game);
+			double captureTime = std::chrono::duration<double>(Clock::now() - captureStart).count();
+			captureSeconds += captureTime;
+			slowestCapture = captureTime > slowestCapture ? captureTime : slowestCapture;
+			captures++;
+		}
+
+		if (options.m_FireInterval > 0 && g_Game.GetTickCount() >= nextFireTick)
+		{
+			g_Game.Fire(fireRandom.NextRange(0, 1500), fireRandom.NextRange(0, 1000));
+			nextFireTick += options.m_FireInterval;
+		}
+		g_Game.Tick(tickDelta);
+		inputs.push_back(g_Game.GetTickInput());
+
+		if (inputs.size() < options.m_RollbackTicks && g_Game.GetTickCount() < (unsigned long long)options.m_Ticks)
+		{
+			continue;
+		}
+
+		result.Capture(g_Game);
+
+		Clock::time_point restoreStart = Clock::now();
+		if (!windowStart.Restore(g_Game))
+		{
+			fprintf(stderr, "Failed to restore tick %llu\n", windowStart.GetTick());
+			return 1;
+		}
+		double restoreTime = std::chrono::duration<double>(Clock::now() - restoreStart).count();
+		restoreSeconds += restoreTime;
+		slowestRestore = restoreTime > slowestRestore ? restoreTime : slowestRestore;
+
+		Clock::time_point replayStart = Clock::now();
+		for (size_t tick = 0; tick < inputs.size(); tick++)
+		{
+			g_Game.Tick(tickDelta, inputs[tick]);
+		}
+		replaySeconds += std::chrono::duration<double>(Clock::now() - replayStart).count();
+		rollbacks++;
+
+		replayed.Capture(g_Game);
+		if (replayed.GetHash() != result.GetHash())
+		{
+			GameStateSection section = result.FindDifference(replayed);
+			fprintf(stderr, "Ticks %llu to %llu came out differently the second time, first in the %s\n", windowStart.GetTick(),
+				result.GetTick(), GameSnapshot::GetSectionName(section));
+			mismatches++;
+		}
+		inputs.clear();
+	}
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	printf("seed          %u\n", options.m_Seed);
+	printf("threads       %u\n", g_Game.m_Jobs.GetThreadCount());
+	printf("ticks         %llu, each window of %u run twice\n", g_Game.GetTickCount(), options.m_RollbackTicks);
+	printf("wall time     %.3f s\n", seconds);
+	printf("state         %u bytes at the end\n", (unsigned int)result.GetSize());
+	printf("capture       %.1f us on average, slowest %.1f us, over %ld captures\n", captures > 0 ? captureSeconds * 1e6 / captures : 0.,
+		slowestCapture * 1e6, captures);
+	printf("restore       %.1f us on average, slowest %.1f us, over %ld rollbacks\n", rollbacks > 0 ? restoreSeconds * 1e6 / rollbacks : 0.,
+		slowestRestore * 1e6, rollbacks);
+	printf("resimulate    %.3f ms per window\n", rollbacks > 0 ? replaySeconds * 1000. / rollbacks : 0.);
+	printf("verify        %ld of %ld windows came out the same the second time\n", rollbacks - mismatches, rollbacks);
+	PrintGameSummary(g_Game);
+
+	return mismatches == 0 ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FinishTrace
+// Stop tracing, write what the buffers hold and print a line for each marker, slowest in total first. The count
+// at the worst event is how many objects that scope had when it was slowest, to tell a spike from the work
+// just growing. Returns false if the trace couldn't be written.
+//--------------------------------------------------------------------------------------------------------------
+static bool FinishTrace(const Options& options)
+{
+	if (options.m_TracePath == NULL)
+	{
+		return true;
+	}
+
+	g_Tracer.Stop();
+	if (!g_Tracer.WriteChromeTrace(options.m_TracePath))
+	{
+		fprintf(stderr, "Failed to write %s\n", options.m_TracePath);
+		return false;
+	}
+
+	std::vector<TraceSummary> summaries;
+	g_Tracer.Summarise(summaries);
+	unsigned long long events = 0;
+	for (size_t index = 0; index < summaries.size(); index++)
+	{
+		events += summaries[index].m_Events;
+	}
+
+	printf("trace         %llu events written to %s, %llu overwritten\n", events, options.m_TracePath, g_Tracer.GetOverwrittenCount());
+#if !NT_TRACE
+	printf("              the markers are compiled out of this build\n");
+#endif
+	if (!summaries.empty())
+	{
+		printf("  %-20s %10s %10s %10s %10s %10s\n", "marker", "events", "mean ms", "worst ms", "at worst", "most");
+	}
+	for (size_t index = 0; index < summaries.size(); index++)
+	{
+		const TraceSummary& summary = summaries[index];
+		printf("  %-20s %10llu %10.4f %10.4f %10llu %10llu\n", summary.m_Name, summary.m_Events,
+			summary.m_TotalTime * 1000. / summary.m_Events, summary.m_WorstTime * 1000., (unsigned long long)summary.m_WorstCount,
+			(unsigned long long)summary.m_MostCount);
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// main
+//--------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	if (options.m_VerifyGravity)
+	{
+		return VerifyGravityKernels(options.m_Seed) ? 0 : 1;
+	}
+
+	if (options.m_SunGravity >= 0.f)
+	{
+		g_Game.m_Settings.m_SunGravity = options.m_SunGravity;
+	}
+
+	if (options.m_MeasureEnergy)
+	{
+		return CompareIntegrators(options);
+	}
+
+	if (options.m_ReplayPath != NULL)
+	{
+		return Replay(options);
+	}
+
+	if (options.m_Autopilot)
+	{
+		g_Game.SetKeyStateFunction(AutopilotKeyState);
+	}
+	else if (options.m_Cruise)
+	{
+		g_Game.SetKeyStateFunction(CruiseKeyState);
+	}
+
+	g_Game.m_Settings.m_UseGravityField = options.m_UseGravityField;
+	g_Game.m_Settings.m_GravityField = options.m_GravityField;
+	g_Game.m_Settings.m_TickRate = 1.f / options.m_TimeDelta;
+	g_Game.m_Settings.m_ThreadCount = options.m_ThreadCount;
+	g_Game.m_Settings.m_SunCount = options.m_SunCount;
+	g_Game.m_Settings.m_AsteroidCount = options.m_AsteroidCount;
+	g_Game.m_Settings.m_StreamWorld = options.m_StreamWorld;
+	g_Game.m_Settings.m_BotCount = options.m_BotCount;
+	if (options.m_ChunkSize > 0.f)
+	{
+		g_Game.m_Settings.m_WorldStream.m_ChunkSize = options.m_ChunkSize;
+	}
+	g_Game.m_Settings.m_MissileCapacity = options.m_Missiles > 256 ? options.m_Missiles : 256;
+
+	if (!g_Game.Initialise(options.m_Seed))
+	{
+		fprintf(stderr, "Failed to initialise the game\n");
+		return 1;
+	}
+
+	// Against the clock the game's own timer is used, and the pacer sleeps between frames; otherwise every
+	// frame is a fixed step and the run goes as fast as it can.
+	FramePacer pacer;
+	if (options.m_RealTime)
+	{
+		FramePacerSettings pacing;
+		pacing.m_TargetRate = options.m_FrameRate;
+		pacer.SetSettings(pacing);
+	}
+	else
+	{
+		g_Game.m_Timer.SetFixedTimeDelta(options.m_FrameTime);
+	}
+
+	RandomStream missileRandom(options.m_Seed, RANDOM_STREAM_TOOLS, RANDOM_MISSILES);
+	for (int missile = 0; missile < options.m_Missiles; missile++)
+	{
+		NTPoint from((float)missileRandom.NextRange(0, 1600), (float)missileRandom.NextRange(0, 1100));
+		NTPoint to((float)missileRandom.NextRange(0, 1600), (float)missileRandom.NextRange(0, 1100));
+		Missile::Spawn(g_Game.m_Missiles, from, to);
+	}
+
+	// Tracing starts after setup, so that the buffers hold the run rather than the world being built.
+	if (options.m_TracePath != NULL)
+	{
+		NT_TRACE_THREAD_NAME("main");
+		g_Tracer.Start(options.m_TraceEvents);
+	}
+
+	if (options.m_ServerClients > 0)
+	{
+		int result = ServeClients(options);
+		return FinishTrace(options) ? result : 1;
+	}
+	if (options.m_RollbackTicks > 0)
+	{
+		int result = RollBack(options);
+		return FinishTrace(options) ? result : 1;
+	}
+
+	FILE* captureFile = NULL;
+	RenderCommandBuffer captureCommands;
+	if (options.m_CapturePath != NULL)
+	{
+		captureFile = fopen(options.m_CapturePath, "wb");
+		if (captureFile == NULL || !RenderCommandBuffer::WriteCaptureHeader(captureFile))
+		{
+			fprintf(stderr, "Failed to write %s\n", options.m_CapturePath);
+			return 1;
+		}
+	}
+
+	InputRecorder recorder;
+	if (options.m_RecordPath != NULL)
+	{
+		if (!recorder.Open(options.m_RecordPath, g_Game, options.m_KeyframeInterval))
+		{
+			fprintf(stderr, "Failed to write %s\n", options.m_RecordPath);
+			return 1;
+		}
+		g_Game.SetInputRecorder(&recorder);
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	Framebuffer framebuffer;
+	framebuffer.Resize(RENDER_WIDTH, RENDER_HEIGHT);
+	FramebufferRenderBackend backend(framebuffer);
+	double renderSeconds = 0.;
+	double slowestRender = 0.;
+
+	long frames = 0;
+	RandomStream fireRandom(options.m_Seed, RANDOM_STREAM_TOOLS, RANDOM_FIRE);
+	unsigned long long nextFireTick = 0;
+	auto beforeUpdate = [&](Game& game)
+	{
+		if (options.m_FireInterval > 0 && game.GetTickCount() >= nextFireTick)
+		{
+			game.Fire(fireRandom.NextRange(0, 1500), fireRandom.NextRange(0, 1000));
+			nextFireTick += options.m_FireInterval;
+		}
+		frames++;
+	};
+
+	// With a render thread the game belongs to the simulation thread until it has run every tick, and this
+	// one draws whichever snapshot is latest, as often as a new one turns up. Render time overlaps the
+	// simulation, so it isn't taken out of the wall time.
+	SimulationThread simThread;
+	long renderFrames = 0;
+	unsigned long long renderTicks = 0;
+	g_Game.m_Timer.Reset();
+	if (options.m_RenderThread)
+	{
+		SimulationThreadSettings simSettings;
+		simSettings.m_Pace = options.m_RealTime;
+		simSettings.m_Pacing = pacer.GetSettings();
+		simSettings.m_StopAtTick = (unsigned long long)options.m_Ticks;
+		simSettings.m_BeforeUpdate = beforeUpdate;
+		simThread.Start(g_Game, simSettings);
+
+		RenderCommandBuffer commands;
+		unsigned long long drawnCount = 0;
+		unsigned long long lastTick = 0;
+		bool finished = false;
+		while (!finished)
+		{
+			// Finishing is checked before acquiring, so the last snapshot is always drawn.
+			finished = simThread.IsFinished();
+			unsigned long long publishedCount = simThread.GetPublishedCount();
+			if (publishedCount == drawnCount)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			drawnCount = publishedCount;
+
+			Clock::time_point renderStart = Clock::now();
+			const RenderSnapshot* snapshot = simThread.AcquireSnapshot();
+			snapshot->BuildRenderCommands(commands, snapshot->GetInterpolationAt(renderStart));
+			backend.Submit(commands);
+			double renderTime = std::chrono::duration<double>(Clock::now() - renderStart).count();
+
+			renderSeconds += renderTime;
+			slowestRender = renderTime > slowestRender ? renderTime : slowestRender;
+			renderFrames++;
+			renderTicks += snapshot->m_Tick != lastTick || renderFrames == 1 ? 1 : 0;
+			lastTick = snapshot->m_Tick;
+		}
+		simThread.Stop();
+	}
+	else
+	{
+		pacer.Reset();
+		while (g_Game.GetTickCount() < (unsigned long long)options.m_Ticks)
+		{
+			beforeUpdate(g_Game);
+
+			bool needRedraw;
+			g_Game.Update(needRedraw);
+
+			if (options.m_Render)
+			{
+				Clock::time_point renderStart = Clock::now();
+				g_Game.Draw(backend);
+				double renderTime = std::chrono::duration<double>(Clock::now() - renderStart).count();
+
+				renderSeconds += renderTime;
+				slowestRender = renderTime > slowestRender ? renderTime : slowestRender;
+			}
+
+			if (captureFile != NULL)
+			{
+				g_Game.BuildRenderCommands(captureCommands);
+				captureCommands.Save(captureFile);
+			}
+
+			if (options.m_RealTime)
+			{
+				pacer.WaitForNextFrame(g_Game.GetTimeUntilUpdate());
+			}
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count() - (options.m_RenderThread ? 0. : renderSeconds);
+
+	g_Game.SetInputRecorder(NULL);
+	if (!recorder.Close())
+	{
+		fprintf(stderr, "Failed to write %s\n", options.m_RecordPath);
+		return 1;
+	}
+
+	if (captureFile != NULL && fclose(captureFile) != 0)
+	{
+		fprintf(stderr, "Failed to write %s\n", options.m_CapturePath);
+		return 1;
+	}
+
+	if (options.m_ImagePath != NULL && !WriteImage(framebuffer, options.m_ImagePath))
+	{
+		fprintf(stderr, "Failed to write %s\n", options.m_ImagePath);
+		return 1;
+	}
+
+	printf("seed          %u\n", options.m_Seed);
+	printf("gravity       %s\n", GetGravityKernelName(GetBestGravityKernel()));
+	printf("threads       %u\n", g_Game.m_Jobs.GetThreadCount());
+	if (options.m_StreamWorld)
+	{
+		const WorldStreamStats& stream = g_Game.GetWorldStreamStats();
+		printf("streaming     %u chunks resident, %llu loaded, %llu evicted, %u kept modified\n", (unsigned int)stream.m_ResidentChunks,
+			stream.m_ChunksLoaded, stream.m_ChunksEvicted, (unsigned int)stream.m_ModifiedChunks);
+	}
+	else
+	{
+		const WorldStats& world = g_Game.GetWorldStats();
+		printf("placed        %u of %u suns, %u of %u asteroids\n", (unsigned int)world.m_SunsPlaced, (unsigned int)world.m_SunsRequested,
+			(unsigned int)world.m_AsteroidsPlaced, (unsigned int)world.m_AsteroidsRequested);
+	}
+	if (g_Game.m_GravityField.IsBaked())
+	{
+		const GravityField& field = g_Game.m_GravityField;
+		printf("gravity field %dx%d cells of %g, max error %g\n", field.GetColumns(), field.GetRows(), field.GetCellSize(), field.GetMeasuredError());
+	}
+	else if (options.m_UseGravityField)
+	{
+		printf("gravity field could not meet the error bound, using the exact sum\n");
+	}
+	printf("ticks         %llu in %ld frames\n", g_Game.GetTickCount(), frames);
+	const IntegratorStats& integrator = g_Game.m_IntegratorTotals;
+	printf("integrator    %.3f steps per body, %llu bodies refined, at most %d substeps\n",
+		integrator.m_Bodies > 0 ? (double)integrator.m_Substeps / integrator.m_Bodies : 0., integrator.m_RefinedBodies, integrator.m_MostSubsteps);
+	printf("sim time      %.2f s\n", g_Game.GetTickCount() * (double)g_Game.GetTickDelta());
+	if (g_Game.GetDroppedTime() > 0.)
+	{
+		printf("dropped time  %.2f s\n", g_Game.GetDroppedTime());
+	}
+	printf("wall time     %.3f s\n", seconds);
+	if (options.m_RealTime)
+	{
+		const FramePacerStats& pacing = options.m_RenderThread ? simThread.GetPacerStats() : pacer.GetStats();
+		double paced = pacing.m_BusyTime + pacing.m_IdleTime;
+		printf("pacing        %.1f%% busy, %.1f%% idle over %llu frames, sleeps overrun by %.3f ms\n",
+			paced > 0. ? pacing.m_BusyTime * 100. / paced : 0., paced > 0. ? pacing.m_IdleTime * 100. / paced : 0., pacing.m_Frames,
+			pacing.m_SleepOverrun * 1000.);
+		printf("late frames   %llu, %.3f ms on average, worst %.3f ms\n", pacing.m_LateFrames,
+			pacing.m_LateFrames > 0 ? pacing.m_LateTime * 1000. / pacing.m_LateFrames : 0., pacing.m_WorstLateness * 1000.);
+	}
+	printf("ticks/sec     %.0f\n", seconds > 0. ? g_Game.GetTickCount() / seconds : 0.);
+	if (options.m_RenderThread)
+	{
+		printf("render thread %ld frames of %llu distinct ticks, %.3f ms per frame, slowest %.3f ms, at %dx%d\n", renderFrames,
+			renderTicks, renderFrames > 0 ? renderSeconds * 1000. / renderFrames : 0., slowestRender * 1000., framebuffer.GetWidth(),
+			framebuffer.GetHeight());
+	}
+	else if (options.m_Render)
+	{
+		printf("render        %.3f ms per frame, slowest %.3f ms, at %dx%d\n", renderSeconds * 1000. / frames,
+			slowestRender * 1000., framebuffer.GetWidth(), framebuffer.GetHeight());
+	}
+	if (options.m_RecordPath != NULL)
+	{
+		printf("recorded      %llu ticks, %u keyframes\n", recorder.GetTicksRecorded(), (unsigned int)recorder.GetKeyframesRecorded());
+	}
+	PrintGameSummary(g_Game);
+
+	return FinishTrace(options) ? 0 : 1;
+}
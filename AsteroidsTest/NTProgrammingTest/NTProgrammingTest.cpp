@@ -3,8 +3,14 @@
 
 #include "stdafx.h"
 #include "NTProgrammingTest.h"
+#include <mmsystem.h>
 
 #include "game.h"
+#include "renderbackend.h"
+#include "replay.h"
+#include "simthread.h"
+
+#pragma comment(lib, "winmm.lib")
 
 #define MAX_LOADSTRING 100
 
@@ -12,14 +18,18 @@
 HINSTANCE hInst;								// current instance
 TCHAR szTitle[MAX_LOADSTRING];					// The title bar text
 TCHAR szWindowClass[MAX_LOADSTRING];			// the main window class name
-
-Game g_Game;
+SimulationThread g_SimThread;					// runs g_Game once the window is up
+GdiRenderBackend g_GdiBackend;					// draws the simulation's snapshots
+RenderCommandBuffer g_RenderCommands;			// kept between frames so that its storage is reused
+HWND g_hWnd;									// the main window, for the simulation thread to invalidate
 
 // Forward declarations of functions included in this code module:
 ATOM				MyRegisterClass(HINSTANCE hInstance);
 BOOL				InitInstance(HINSTANCE, int);
 LRESULT CALLBACK	WndProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK	About(HWND, UINT, WPARAM, LPARAM);
+bool				GetGameKeyState(GameKey key);
+void				RequestRedraw();
 
 int APIENTRY _tWinMain(HINSTANCE hInstance,
                      HINSTANCE hPrevInstance,
@@ -27,7 +37,6 @@ int APIENTRY _tWinMain(HINSTANCE hInstance,
                      int       nCmdShow)
 {
 	UNREFERENCED_PARAMETER(hPrevInstance);
-	UNREFERENCED_PARAMETER(lpCmdLine);
 
 	MSG msg;
 	HACCEL hAccelTable;
@@ -45,44 +54,86 @@ int APIENTRY _tWinMain(HINSTANCE hInstance,
 
 	hAccelTable = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDC_NTPROGRAMMINGTEST));
 
-	HWND hWnd = FindWindowEx(NULL, NULL, szWindowClass, NULL);
+	g_hWnd = FindWindowEx(NULL, NULL, szWindowClass, NULL);
 
 	// Start the game and assert that initialisation was successful
+	g_Game.SetKeyStateFunction(GetGameKeyState);
 	bool bIsInitialize = g_Game.Initialise();
 	assert(bIsInitialize);
 
-	// Main message loop:
-	while (true)
+	// A file name on the command line records the session into it, for playing back with NTHeadless -replay.
+	InputRecorder recorder;
+	if (lpCmdLine != NULL && lpCmdLine[0] != 0)
 	{
-		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE) && !TranslateAccelerator(msg.hwnd, hAccelTable, &msg)) 
+		char recordPath[MAX_PATH];
+#ifdef UNICODE
+		WideCharToMultiByte(CP_ACP, 0, lpCmdLine, -1, recordPath, MAX_PATH, NULL, NULL);
+#else
+		strncpy_s(recordPath, MAX_PATH, lpCmdLine, _TRUNCATE);
+#endif
+		if (recorder.Open(recordPath, g_Game))
 		{
-			if (msg.message == WM_QUIT)
-			{
-				break;
-			}
-
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
+			g_Game.SetInputRecorder(&recorder);
 		}
+	}
 
-		// Update the game
-		bool needRedraw;
-		g_Game.Update(needRedraw);
-		if (needRedraw)
+	// The game runs on a thread of its own from here on, sleeping between updates; a 1 ms timer period keeps
+	// the sleeps close to what was asked for. This thread only handles messages and draws the snapshots the
+	// game publishes, so a slow paint never holds up a tick.
+	timeBeginPeriod(1);
+	SimulationThreadSettings simSettings;
+	simSettings.m_Redraw = RequestRedraw;
+	g_SimThread.Start(g_Game, simSettings);
+
+	// Main message loop:
+	while (GetMessage(&msg, NULL, 0, 0))
+	{
+		if (!TranslateAccelerator(msg.hwnd, hAccelTable, &msg))
 		{
-			RECT rect;
-			rect.top = 0;
-			rect.left = 0;
-			rect.bottom = 1000;
-			rect.right = 1500;
-			InvalidateRect(hWnd, &rect, TRUE);
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
 		}
 	}
 
+	// The game must stop before anything it uses, the recorder included, goes away.
+	g_SimThread.Stop();
+	timeEndPeriod(1);
+	g_Game.SetInputRecorder(NULL);
+	recorder.Close();
+
 	return (int)msg.wParam;
 }
 
+//
+//  FUNCTION: GetGameKeyState(GameKey)
+//
+//  PURPOSE: Maps the game's keys onto virtual keys and polls the keyboard. Called on the simulation thread,
+//           which has no message queue of its own, so the keyboard is read directly rather than through
+//           the thread's key state.
+//
+bool GetGameKeyState(GameKey key)
+{
+	static const int s_VirtualKeys[KEY_COUNT] = { VK_LEFT, VK_RIGHT, VK_UP, VK_DOWN, ' ' };
 
+	return (GetAsyncKeyState(s_VirtualKeys[key]) & 0x8000) != 0;
+}
+
+
+//
+//  FUNCTION: RequestRedraw()
+//
+//  PURPOSE: Called on the simulation thread when a new frame is wanted. Invalidating is safe from any
+//           thread; the paint happens on this one.
+//
+void RequestRedraw()
+{
+	RECT rect;
+	rect.top = 0;
+	rect.left = 0;
+	rect.bottom = 1000;
+	rect.right = 1500;
+	InvalidateRect(g_hWnd, &rect, TRUE);
+}
 
 //
 //  FUNCTION: MyRegisterClass()
@@ -184,12 +235,17 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 		break;
 
 	case WM_LBUTTONDOWN:
-		g_Game.Fire(LOWORD(lParam), HIWORD(lParam));
+		g_SimThread.Fire(LOWORD(lParam), HIWORD(lParam));
 		break;
 
 	case WM_PAINT:
 		hdc = BeginPaint(hWnd, &ps);
-		g_Game.Draw(hdc, &ps);
+		if (const RenderSnapshot* snapshot = g_SimThread.AcquireSnapshot())
+		{
+			snapshot->BuildRenderCommands(g_RenderCommands, snapshot->GetInterpolationAt(RenderSnapshot::Clock::now()));
+			g_GdiBackend.SetDeviceContext(hdc);
+			g_GdiBackend.Submit(g_RenderCommands);
+		}
 		EndPaint(hWnd, &ps);
 		break;
 	case WM_DESTROY:
@@ -0,0 +1,143 @@
+//-------------------------------------------------------------------------------------------------------------
+// bitstream.cpp
+//
+// Implementation of the bit packing.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "bitstream.h"
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteBits
+//--------------------------------------------------------------------------------------------------------------
+void BitWriter::WriteBits(unsigned int value, int count)
+{
+	assert(count >= 0 && count <= 32);
+
+	if (count < 32)
+	{
+		value &= (1u << count) - 1;
+	}
+	m_Scratch |= (unsigned long long)value << m_ScratchBits;
+	m_ScratchBits += count;
+	m_BitsWritten += count;
+
+	while (m_ScratchBits >= 8)
+	{
+		m_Data.push_back((unsigned char)m_Scratch);
+		m_Scratch >>= 8;
+		m_ScratchBits -= 8;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteUnsigned
+// 0 then 4 bits, 10 then 8 bits, 110 then 16 bits, or 111 then 32 bits.
+//--------------------------------------------------------------------------------------------------------------
+void BitWriter::WriteUnsigned(unsigned int value)
+{
+	if (value < (1u << 4))
+	{
+		WriteBits(0, 1);
+		WriteBits(value, 4);
+	}
+	else if (value < (1u << 8))
+	{
+		WriteBits(1, 2);
+		WriteBits(value, 8);
+	}
+	else if (value < (1u << 16))
+	{
+		WriteBits(3, 3);
+		WriteBits(value, 16);
+	}
+	else
+	{
+		WriteBits(7, 3);
+		WriteBits(value, 32);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteSigned
+// Zigzag encoded, so that small negative values are small too: 0, -1, 1, -2, 2 become 0, 1, 2, 3, 4.
+//--------------------------------------------------------------------------------------------------------------
+void BitWriter::WriteSigned(int value)
+{
+	WriteUnsigned(((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Flush
+//--------------------------------------------------------------------------------------------------------------
+void BitWriter::Flush()
+{
+	if (m_ScratchBits > 0)
+	{
+		m_Data.push_back((unsigned char)m_Scratch);
+		m_BitsWritten += 8 - m_ScratchBits;
+		m_Scratch = 0;
+		m_ScratchBits = 0;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReadBits
+//--------------------------------------------------------------------------------------------------------------
+unsigned int BitReader::ReadBits(int count)
+{
+	assert(count >= 0 && count <= 32);
+
+	if (m_Failed || (size_t)count > m_Size * 8 - m_BitOffset)
+	{
+		m_Failed = true;
+		return 0;
+	}
+
+	unsigned int value = 0;
+	int read = 0;
+	while (read < count)
+	{
+		size_t byte = m_BitOffset >> 3;
+		int shift = (int)(m_BitOffset & 7);
+		int take = 8 - shift < count - read ? 8 - shift : count - read;
+
+		unsigned int bits = (m_Data[byte] >> shift) & ((1u << take) - 1);
+		value |= bits << read;
+		read += take;
+		m_BitOffset += take;
+	}
+	return value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReadUnsigned
+//--------------------------------------------------------------------------------------------------------------
+unsigned int BitReader::ReadUnsigned()
+{
+	if (ReadBits(1) == 0)
+	{
+		return ReadBits(4);
+	}
+	if (ReadBits(1) == 0)
+	{
+		return ReadBits(8);
+	}
+	if (ReadBits(1) == 0)
+	{
+		return ReadBits(16);
+	}
+	return ReadBits(32);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReadSigned
+//--------------------------------------------------------------------------------------------------------------
+int BitReader::ReadSigned()
+{
+	unsigned int zigzag = ReadUnsigned();
+	return (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+}
@@ -0,0 +1,80 @@
+//-------------------------------------------------------------------------------------------------------------
+// bitstream.h
+//
+// Packing values into a byte buffer a few bits at a time, and unpacking them, for network packets where every
+// byte sent counts.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------------------
+// BitWriter
+// Appends to a buffer owned by the caller, so the buffer's storage can be reused from one packet to the next.
+// Bits fill each byte from the lowest up. Nothing reaches the buffer until it makes a whole byte, so Flush
+// must be called once everything is written.
+//
+// Integers written with WriteUnsigned and WriteSigned take fewer bits the closer they are to 0, which is what
+// makes small deltas cheap: a prefix of up to three bits picks a width of 4, 8, 16 or 32 bits.
+//-------------------------------------------------------------------------------------------------------------
+class BitWriter
+{
+public:
+	explicit BitWriter(std::vector<unsigned char>& data) : m_Data(data), m_Scratch(0), m_ScratchBits(0), m_BitsWritten(0) {}
+
+	// The low count bits of value, with count from 0 to 32.
+	void WriteBits(unsigned int value, int count);
+	void WriteBool(bool value) { WriteBits(value ? 1 : 0, 1); }
+
+	void WriteUnsigned(unsigned int value);
+	void WriteSigned(int value);
+
+	// Write out the last partial byte, padded with zeroes. Writing can carry on afterwards, from the next byte.
+	void Flush();
+
+	size_t GetBitsWritten() const { return m_BitsWritten; }
+
+private:
+	std::vector<unsigned char>&	m_Data;
+	unsigned long long			m_Scratch;
+	int							m_ScratchBits;
+	size_t						m_BitsWritten;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// BitReader
+// Reads from a buffer it doesn't own. As with StateReader, a read past the end fails, and so does every read
+// after it, returning 0, so a caller can read everything and check once at the end.
+//-------------------------------------------------------------------------------------------------------------
+class BitReader
+{
+public:
+	BitReader(const unsigned char* data, size_t size) : m_Data(data), m_Size(size), m_BitOffset(0), m_Failed(false) {}
+
+	unsigned int ReadBits(int count);
+	bool ReadBool() { return ReadBits(1) != 0; }
+
+	unsigned int ReadUnsigned();
+	int ReadSigned();
+
+	// Skip to the start of the next byte, as the writer's Flush does.
+	void Align() { m_BitOffset = (m_BitOffset + 7) & ~(size_t)7; }
+
+	bool HasFailed() const { return m_Failed; }
+
+	// Whether everything has been read, but for the padding of the last byte.
+	bool IsAtEnd() const { return (m_BitOffset + 7) / 8 == m_Size; }
+
+private:
+	const unsigned char*	m_Data;
+	size_t					m_Size;
+	size_t					m_BitOffset;
+	bool					m_Failed;
+};
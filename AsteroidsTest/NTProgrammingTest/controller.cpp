@@ -0,0 +1,220 @@
+//-------------------------------------------------------------------------------------------------------------
+// controller.cpp
+//
+// Implementation of the ship controllers.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "controller.h"
+#include "game.h"
+#include "trace.h"
+#include <cmath>
+
+static const float PI = 3.14159265f;
+
+// Bots are controlled in parallel in chunks of this many.
+static const size_t BOT_CHUNK_SIZE = 1024;
+
+// A bot closer than this to a sun flies away from it rather than doing anything else.
+static const float BOT_SUN_CAUTION = 60.f;
+
+// How far a bot looks for an asteroid to hunt.
+static const float BOT_SIGHT_RANGE = 400.f;
+
+// A bot turns until its heading is within this many radians of its target's, and fires once it is.
+static const float BOT_AIM_TOLERANCE = 0.1f;
+
+// A bot only thrusts while slower than this, and while facing within a quarter turn of where it is going.
+static const float BOT_CRUISE_SPEED = 30.f;
+
+//--------------------------------------------------------------------------------------------------------------
+// PlayerController
+//--------------------------------------------------------------------------------------------------------------
+void PlayerController::Control(Game& game, const std::vector<unsigned int>& ships, std::vector<ShipCommand>& outCommands)
+{
+	const TickInput& input = game.GetTickInput();
+
+	ShipCommand command;
+	if (input.IsKeyDown(KEY_LEFT))
+	{
+		command.Set(SHIP_TURN_LEFT);
+	}
+	if (input.IsKeyDown(KEY_RIGHT))
+	{
+		command.Set(SHIP_TURN_RIGHT);
+	}
+	if (input.IsKeyDown(KEY_UP))
+	{
+		command.Set(SHIP_THRUST);
+	}
+	if (input.IsKeyDown(KEY_DOWN))
+	{
+		command.Set(SHIP_REVERSE);
+	}
+	if (input.IsKeyDown(KEY_FIRE))
+	{
+		command.Set(SHIP_FIRE);
+	}
+
+	for (size_t ship = 0; ship < ships.size(); ship++)
+	{
+		outCommands[ships[ship]] = command;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SteerTowards
+// Turn a ship facing angle towards heading, the way it turns: left is an increasing angle.
+//--------------------------------------------------------------------------------------------------------------
+static void SteerTowards(float angle, float heading, ShipCommand& command)
+{
+	float turn = heading - angle;
+	if (turn > PI)
+	{
+		turn -= 2.f * PI;
+	}
+	else if (turn < -PI)
+	{
+		turn += 2.f * PI;
+	}
+
+	if (turn > BOT_AIM_TOLERANCE)
+	{
+		command.Set(SHIP_TURN_LEFT);
+	}
+	else if (turn < -BOT_AIM_TOLERANCE)
+	{
+		command.Set(SHIP_TURN_RIGHT);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetHeading
+// The angle a ship faces to point along direction; a ship at angle a points along (sin a, cos a).
+//--------------------------------------------------------------------------------------------------------------
+static float GetHeading(const NTPoint& direction)
+{
+	return atan2f(direction.x, direction.y);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetTurnNeeded
+// How far, either way, a ship facing angle must turn to face heading.
+//--------------------------------------------------------------------------------------------------------------
+static float GetTurnNeeded(float angle, float heading)
+{
+	float turn = fabsf(heading - angle);
+	return turn > PI ? 2.f * PI - turn : turn;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BotController
+// Only reads the game, and writes each ship's own command, so the chunks can't interfere.
+//--------------------------------------------------------------------------------------------------------------
+void BotController::Control(Game& game, const std::vector<unsigned int>& ships, std::vector<ShipCommand>& outCommands)
+{
+	const ShipArray& allShips = game.m_Ships;
+	const EntityArray& suns = game.m_Suns;
+	const EntityArray& asteroids = game.m_Asteroids;
+	EntityHandle localShip = game.GetLocalShip();
+	bool hasLocalShip = allShips.Contains(localShip);
+	NTPoint localShipPosition = hasLocalShip ? allShips.GetPosition(allShips.IndexOf(localShip)) : NTPoint();
+
+	game.m_Jobs.ParallelFor(ships.size(), BOT_CHUNK_SIZE, [&](size_t begin, size_t end)
+	{
+		NT_TRACE_SCOPE_COUNT("bot chunk", end - begin);
+		for (size_t ship = begin; ship < end; ship++)
+		{
+			unsigned int index = ships[ship];
+			NTPoint position = allShips.GetPosition(index);
+			float angle = allShips.m_Angle[index];
+			ShipCommand command;
+
+			KdTreeNeighbour nearest;
+			if (!game.m_GravityField.IsClearOfSuns(position.x, position.y, BOT_SUN_CAUTION)
+				&& game.m_SunTree.QueryNearest(position.x, position.y, BOT_SUN_CAUTION, nearest))
+			{
+				float heading = GetHeading(position - suns.GetPosition(suns.IndexOf(nearest.m_Handle)));
+				SteerTowards(angle, heading, command);
+				command.Set(SHIP_THRUST);
+				outCommands[index] = command;
+				continue;
+			}
+
+			NTPoint target;
+			bool hasTarget = false;
+			if (game.m_AsteroidTree.QueryNearest(position.x, position.y, BOT_SIGHT_RANGE, nearest))
+			{
+				target = asteroids.GetPosition(asteroids.IndexOf(nearest.m_Handle));
+				hasTarget = true;
+			}
+			else if (hasLocalShip && allShips.HandleAt(index) != localShip)
+			{
+				target = localShipPosition;
+				hasTarget = true;
+			}
+
+			if (hasTarget && target != position)
+			{
+				float heading = GetHeading(target - position);
+				SteerTowards(angle, heading, command);
+
+				float turnNeeded = GetTurnNeeded(angle, heading);
+				if (turnNeeded <= BOT_AIM_TOLERANCE)
+				{
+					command.Set(SHIP_FIRE);
+				}
+				if (turnNeeded < 0.5f * PI && allShips.GetVelocity(index).LengthSquared() < BOT_CRUISE_SPEED * BOT_CRUISE_SPEED)
+				{
+					command.Set(SHIP_THRUST);
+				}
+			}
+
+			outCommands[index] = command;
+		}
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SetCommand
+//--------------------------------------------------------------------------------------------------------------
+void RemoteController::SetCommand(EntityHandle ship, const ShipCommand& command)
+{
+	assert(!ship.IsNull());
+
+	if (ship.m_Slot >= m_Commands.size())
+	{
+		m_Commands.resize(ship.m_Slot + 1);
+	}
+	m_Commands[ship.m_Slot].m_Ship = ship;
+	m_Commands[ship.m_Slot].m_Command = command;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ClearCommand
+//--------------------------------------------------------------------------------------------------------------
+void RemoteController::ClearCommand(EntityHandle ship)
+{
+	if (ship.m_Slot < m_Commands.size() && m_Commands[ship.m_Slot].m_Ship == ship)
+	{
+		m_Commands[ship.m_Slot] = SlotCommand();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// RemoteController
+//--------------------------------------------------------------------------------------------------------------
+void RemoteController::Control(Game& game, const std::vector<unsigned int>& ships, std::vector<ShipCommand>& outCommands)
+{
+	for (size_t ship = 0; ship < ships.size(); ship++)
+	{
+		EntityHandle handle = game.m_Ships.HandleAt(ships[ship]);
+		if (handle.m_Slot < m_Commands.size() && m_Commands[handle.m_Slot].m_Ship == handle)
+		{
+			outCommands[ships[ship]] = m_Commands[handle.m_Slot].m_Command;
+		}
+	}
+}
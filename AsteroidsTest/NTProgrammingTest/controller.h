@@ -0,0 +1,129 @@
+//-------------------------------------------------------------------------------------------------------------
+// controller.h
+//
+// What drives the ships. Each tick, every ship's controller decides what the ship does, and the ships then
+// act on those commands; a ship never looks at where its orders come from.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "entitystore.h"
+
+// Externally defined classes.
+class Game;
+
+//-------------------------------------------------------------------------------------------------------------
+// ShipControl
+// The things a ship can be told to do in a tick, as bits of a ShipCommand.
+//-------------------------------------------------------------------------------------------------------------
+enum ShipControl
+{
+	SHIP_TURN_LEFT	= 1 << 0,
+	SHIP_TURN_RIGHT	= 1 << 1,
+	SHIP_THRUST		= 1 << 2,
+	SHIP_REVERSE	= 1 << 3,
+	SHIP_FIRE		= 1 << 4
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// ShipCommand
+// One ship's orders for one tick. Firing is only acted on once the ship's weapon has cooled down.
+//-------------------------------------------------------------------------------------------------------------
+struct ShipCommand
+{
+	ShipCommand() : m_Controls(0) {}
+
+	bool IsSet(ShipControl control) const { return (m_Controls & control) != 0; }
+	void Set(ShipControl control) { m_Controls |= (unsigned char)control; }
+
+	unsigned char	m_Controls;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// ShipControllerId
+// Which controller drives a ship. Stored with the ship, so saved and replayed along with it.
+//-------------------------------------------------------------------------------------------------------------
+enum ShipControllerId
+{
+	// Driven by the tick's input: the keys, live or from a recording.
+	CONTROLLER_PLAYER,
+
+	// Driven by BotController.
+	CONTROLLER_BOT,
+
+	// Driven by commands from outside the game, through RemoteController: a server's clients' ships. The
+	// commands aren't part of the tick's input, so a recording of a game with remote ships won't replay.
+	CONTROLLER_REMOTE,
+
+	CONTROLLER_COUNT
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// ShipController
+// Decides the commands for every ship it drives, all at once, before anything moves. It sees the state as it
+// was at the start of the tick and must decide from that alone, so that a tick's result doesn't depend on the
+// order ships are controlled in or on how the work is split between threads.
+//-------------------------------------------------------------------------------------------------------------
+class ShipController
+{
+public:
+	virtual ~ShipController() {}
+
+	// Fill in outCommands[ships[i]] for each of the ship indices given, which are in increasing order.
+	virtual void Control(Game& game, const std::vector<unsigned int>& ships, std::vector<ShipCommand>& outCommands) = 0;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// PlayerController
+// Turns the keys held for the tick into commands. Recordings store the keys, so a replayed session comes
+// back through here too.
+//-------------------------------------------------------------------------------------------------------------
+class PlayerController : public ShipController
+{
+public:
+	virtual void Control(Game& game, const std::vector<unsigned int>& ships, std::vector<ShipCommand>& outCommands);
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// BotController
+// Flies ships on its own, for filling the field with opponents and for load testing. A bot keeps clear of
+// the suns, otherwise hunts the nearest asteroid in sight, or the local ship if there is none, and fires
+// whenever it is pointing at its target. Each bot decides from the shared state alone, so bots are
+// controlled in parallel and need nothing recorded to be replayed.
+//-------------------------------------------------------------------------------------------------------------
+class BotController : public ShipController
+{
+public:
+	virtual void Control(Game& game, const std::vector<unsigned int>& ships, std::vector<ShipCommand>& outCommands);
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// RemoteController
+// Gives each ship the command last set for it, tick after tick until it is changed, the way a held key
+// keeps acting. A ship with no command set does nothing.
+//-------------------------------------------------------------------------------------------------------------
+class RemoteController : public ShipController
+{
+public:
+	void SetCommand(EntityHandle ship, const ShipCommand& command);
+	void ClearCommand(EntityHandle ship);
+
+	virtual void Control(Game& game, const std::vector<unsigned int>& ships, std::vector<ShipCommand>& outCommands);
+
+private:
+	// By the ship's slot, with the handle it was set for, so that a command never passes to a new ship that
+	// reuses the slot.
+	struct SlotCommand
+	{
+		EntityHandle	m_Ship;
+		ShipCommand		m_Command;
+	};
+
+	std::vector<SlotCommand>	m_Commands;
+};
@@ -0,0 +1,453 @@
+//-------------------------------------------------------------------------------------------------------------
+// entitystore.cpp
+//
+// Implementation of the structure-of-arrays entity storage.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "entitystore.h"
+
+// The capacity an array grows to when it is first added to without having been reserved.
+static const size_t MIN_GROWN_CAPACITY = 16;
+
+//--------------------------------------------------------------------------------------------------------------
+// EntityArray
+//--------------------------------------------------------------------------------------------------------------
+EntityArray::EntityArray(size_t initialCapacity)
+{
+	Reserve(initialCapacity);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Reserve
+// Allocate room for at least capacity entities, so that adding up to that many never allocates.
+//--------------------------------------------------------------------------------------------------------------
+void EntityArray::Reserve(size_t capacity)
+{
+	if (capacity <= m_Stats.m_Capacity)
+	{
+		return;
+	}
+
+	m_PositionX.reserve(capacity);
+	m_PositionY.reserve(capacity);
+	m_VelocityX.reserve(capacity);
+	m_VelocityY.reserve(capacity);
+	m_Lifetime.reserve(capacity);
+	m_Radius.reserve(capacity);
+	m_PreviousX.reserve(capacity);
+	m_PreviousY.reserve(capacity);
+	m_SlotOfIndex.reserve(capacity);
+	m_IndexOfSlot.reserve(capacity);
+	m_SlotGeneration.reserve(capacity);
+	m_FreeSlots.reserve(capacity);
+	ReserveExtra(capacity);
+
+	m_Stats.m_Capacity = capacity;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Add
+// Append an entity and return a handle to it. Freed slots are reused before new ones are made, and the
+// storage doubles if the pool is full.
+//--------------------------------------------------------------------------------------------------------------
+EntityHandle EntityArray::Add(const NTPoint& position, const NTPoint& velocity, float lifetime, float radius)
+{
+	unsigned int index = (unsigned int)m_PositionX.size();
+	unsigned int slot;
+
+	if (index == m_Stats.m_Capacity)
+	{
+		Reserve(m_Stats.m_Capacity * 2 > MIN_GROWN_CAPACITY ? m_Stats.m_Capacity * 2 : MIN_GROWN_CAPACITY);
+		m_Stats.m_GrowCount++;
+	}
+
+	if (m_FreeSlots.empty())
+	{
+		slot = (unsigned int)m_IndexOfSlot.size();
+		m_IndexOfSlot.push_back(index);
+		m_SlotGeneration.push_back(0);
+	}
+	else
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+		m_IndexOfSlot[slot] = index;
+	}
+
+	m_PositionX.push_back(position.x);
+	m_PositionY.push_back(position.y);
+	m_VelocityX.push_back(velocity.x);
+	m_VelocityY.push_back(velocity.y);
+	m_Lifetime.push_back(lifetime);
+	m_Radius.push_back(radius);
+	m_PreviousX.push_back(position.x);
+	m_PreviousY.push_back(position.y);
+	m_SlotOfIndex.push_back(slot);
+	PushExtra();
+
+	m_Stats.m_Acquired++;
+	m_Stats.m_LiveCount = m_PositionX.size();
+	if (m_Stats.m_LiveCount > m_Stats.m_HighWaterMark)
+	{
+		m_Stats.m_HighWaterMark = m_Stats.m_LiveCount;
+	}
+
+	return EntityHandle(slot, m_SlotGeneration[slot]);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Remove
+// Remove the entity the handle refers to. Does nothing if it has already gone.
+//--------------------------------------------------------------------------------------------------------------
+void EntityArray::Remove(EntityHandle handle)
+{
+	if (Contains(handle))
+	{
+		RemoveAt(m_IndexOfSlot[handle.m_Slot]);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// RemoveAt
+// Remove the entity at index by moving the last entity into its place. Anything iterating by index must
+// revisit index afterwards.
+//--------------------------------------------------------------------------------------------------------------
+void EntityArray::RemoveAt(size_t index)
+{
+	assert(index < Size());
+
+	size_t last = Size() - 1;
+	unsigned int removedSlot = m_SlotOfIndex[index];
+
+	if (index != last)
+	{
+		m_PositionX[index] = m_PositionX[last];
+		m_PositionY[index] = m_PositionY[last];
+		m_VelocityX[index] = m_VelocityX[last];
+		m_VelocityY[index] = m_VelocityY[last];
+		m_Lifetime[index] = m_Lifetime[last];
+		m_Radius[index] = m_Radius[last];
+		m_PreviousX[index] = m_PreviousX[last];
+		m_PreviousY[index] = m_PreviousY[last];
+		m_SlotOfIndex[index] = m_SlotOfIndex[last];
+		m_IndexOfSlot[m_SlotOfIndex[index]] = (unsigned int)index;
+		MoveExtra(index, last);
+	}
+
+	m_PositionX.pop_back();
+	m_PositionY.pop_back();
+	m_VelocityX.pop_back();
+	m_VelocityY.pop_back();
+	m_Lifetime.pop_back();
+	m_Radius.pop_back();
+	m_PreviousX.pop_back();
+	m_PreviousY.pop_back();
+	m_SlotOfIndex.pop_back();
+	PopExtra();
+
+	m_IndexOfSlot[removedSlot] = EntityHandle::INVALID_SLOT;
+	m_SlotGeneration[removedSlot]++;
+	m_FreeSlots.push_back(removedSlot);
+
+	m_Stats.m_Released++;
+	m_Stats.m_LiveCount = m_PositionX.size();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+// Remove every entity. The slots are released rather than forgotten, so outstanding handles stay detectably
+// invalid, and the storage is kept for reuse.
+//--------------------------------------------------------------------------------------------------------------
+void EntityArray::Clear()
+{
+	for (size_t index = 0; index < m_SlotOfIndex.size(); index++)
+	{
+		unsigned int slot = m_SlotOfIndex[index];
+		m_IndexOfSlot[slot] = EntityHandle::INVALID_SLOT;
+		m_SlotGeneration[slot]++;
+		m_FreeSlots.push_back(slot);
+	}
+	m_Stats.m_Released += m_SlotOfIndex.size();
+	m_Stats.m_LiveCount = 0;
+
+	m_PositionX.clear();
+	m_PositionY.clear();
+	m_VelocityX.clear();
+	m_VelocityY.clear();
+	m_Lifetime.clear();
+	m_Radius.clear();
+	m_PreviousX.clear();
+	m_PreviousY.clear();
+	m_SlotOfIndex.clear();
+	ClearExtra();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Contains
+// Returns true if the handle refers to a live entity.
+//--------------------------------------------------------------------------------------------------------------
+bool EntityArray::Contains(EntityHandle handle) const
+{
+	return handle.m_Slot < m_IndexOfSlot.size()
+		&& m_SlotGeneration[handle.m_Slot] == handle.m_Generation
+		&& m_IndexOfSlot[handle.m_Slot] != EntityHandle::INVALID_SLOT;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// IndexOf
+// Returns the current index of a live entity.
+//--------------------------------------------------------------------------------------------------------------
+size_t EntityArray::IndexOf(EntityHandle handle) const
+{
+	assert(Contains(handle));
+	return m_IndexOfSlot[handle.m_Slot];
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SavePreviousPositions
+// Called at the start of each tick, before anything moves.
+//--------------------------------------------------------------------------------------------------------------
+void EntityArray::SavePreviousPositions()
+{
+	m_PreviousX = m_PositionX;
+	m_PreviousY = m_PositionY;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetInterpolatedPosition
+// Blend from the previous position to the current one; an interpolation of 0 gives the previous position.
+//--------------------------------------------------------------------------------------------------------------
+NTPoint EntityArray::GetInterpolatedPosition(size_t index, float interpolation) const
+{
+	return NTPoint(m_PreviousX[index] + (m_PositionX[index] - m_PreviousX[index]) * interpolation,
+		m_PreviousY[index] + (m_PositionY[index] - m_PreviousY[index]) * interpolation);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Teleport
+//--------------------------------------------------------------------------------------------------------------
+void EntityArray::Teleport(size_t index, const NTPoint& position)
+{
+	SetPosition(index, position);
+	m_PreviousX[index] = position.x;
+	m_PreviousY[index] = position.y;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SaveState
+//--------------------------------------------------------------------------------------------------------------
+void EntityArray::SaveState(StateWriter& writer) const
+{
+	writer.WriteVector(m_PositionX);
+	writer.WriteVector(m_PositionY);
+	writer.WriteVector(m_VelocityX);
+	writer.WriteVector(m_VelocityY);
+	writer.WriteVector(m_Lifetime);
+	writer.WriteVector(m_Radius);
+	writer.WriteVector(m_PreviousX);
+	writer.WriteVector(m_PreviousY);
+	writer.WriteVector(m_SlotOfIndex);
+	writer.WriteVector(m_IndexOfSlot);
+	writer.WriteVector(m_SlotGeneration);
+	writer.WriteVector(m_FreeSlots);
+
+	// Field by field, so that no padding ends up in the state.
+	writer.WriteValue((unsigned long long)m_Stats.m_HighWaterMark);
+	writer.WriteValue((unsigned long long)m_Stats.m_Capacity);
+	writer.WriteValue(m_Stats.m_GrowCount);
+	writer.WriteValue(m_Stats.m_Acquired);
+	writer.WriteValue(m_Stats.m_Released);
+
+	SaveExtra(writer);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// LoadState
+// The storage already reserved is kept, so loading into an array that has held as many entities before
+// doesn't allocate. What a failed load leaves can't be trusted even to be cleared, so every slot is
+// forgotten; handles from before it are no longer told apart, but the array must be cleared or loaded
+// again before use anyway.
+//--------------------------------------------------------------------------------------------------------------
+bool EntityArray::LoadState(StateReader& reader)
+{
+	if (ReadState(reader))
+	{
+		return true;
+	}
+
+	m_PositionX.clear();
+	m_PositionY.clear();
+	m_VelocityX.clear();
+	m_VelocityY.clear();
+	m_Lifetime.clear();
+	m_Radius.clear();
+	m_PreviousX.clear();
+	m_PreviousY.clear();
+	m_SlotOfIndex.clear();
+	m_IndexOfSlot.clear();
+	m_SlotGeneration.clear();
+	m_FreeSlots.clear();
+	ClearExtra();
+	m_Stats.m_LiveCount = 0;
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReadState
+// Read and check the state, which may be left half read if it is malformed.
+//--------------------------------------------------------------------------------------------------------------
+bool EntityArray::ReadState(StateReader& reader)
+{
+	reader.ReadVector(m_PositionX);
+	reader.ReadVector(m_PositionY);
+	reader.ReadVector(m_VelocityX);
+	reader.ReadVector(m_VelocityY);
+	reader.ReadVector(m_Lifetime);
+	reader.ReadVector(m_Radius);
+	reader.ReadVector(m_PreviousX);
+	reader.ReadVector(m_PreviousY);
+	reader.ReadVector(m_SlotOfIndex);
+	reader.ReadVector(m_IndexOfSlot);
+	reader.ReadVector(m_SlotGeneration);
+	reader.ReadVector(m_FreeSlots);
+
+	unsigned long long highWaterMark = 0;
+	unsigned long long capacity = 0;
+	reader.ReadValue(highWaterMark);
+	reader.ReadValue(capacity);
+	reader.ReadValue(m_Stats.m_GrowCount);
+	reader.ReadValue(m_Stats.m_Acquired);
+	reader.ReadValue(m_Stats.m_Released);
+
+	if (!LoadExtra(reader) || reader.HasFailed())
+	{
+		return false;
+	}
+
+	size_t count = m_PositionX.size();
+	if (m_PositionY.size() != count || m_VelocityX.size() != count || m_VelocityY.size() != count
+		|| m_Lifetime.size() != count || m_Radius.size() != count || m_PreviousX.size() != count
+		|| m_PreviousY.size() != count || m_SlotOfIndex.size() != count || m_SlotGeneration.size() != m_IndexOfSlot.size()
+		|| capacity < count)
+	{
+		return false;
+	}
+	for (size_t index = 0; index < count; index++)
+	{
+		if (m_SlotOfIndex[index] >= m_IndexOfSlot.size() || m_IndexOfSlot[m_SlotOfIndex[index]] != index)
+		{
+			return false;
+		}
+	}
+
+	// Every slot must be either live or free, never both and never twice, or the next Add would write past
+	// the end or hand out a live entity's slot. Free slots are marked as they are checked, to catch repeats
+	// without allocating, and then put back.
+	size_t slotCount = m_IndexOfSlot.size();
+	if (m_FreeSlots.size() + count != slotCount)
+	{
+		return false;
+	}
+	const unsigned int checkedSlot = EntityHandle::INVALID_SLOT - 1;
+	for (size_t free = 0; free < m_FreeSlots.size(); free++)
+	{
+		unsigned int slot = m_FreeSlots[free];
+		if (slot >= slotCount || m_IndexOfSlot[slot] != EntityHandle::INVALID_SLOT)
+		{
+			return false;
+		}
+		m_IndexOfSlot[slot] = checkedSlot;
+	}
+	for (size_t free = 0; free < m_FreeSlots.size(); free++)
+	{
+		m_IndexOfSlot[m_FreeSlots[free]] = EntityHandle::INVALID_SLOT;
+	}
+
+	// The pool only grows when it is full, to double what it was, so it can't have grown past twice the slots
+	// it has handed out; anything bigger than that, or than it was reserved for here, is corrupt, and would
+	// otherwise be allocated.
+	size_t largestCapacity = slotCount * 2 > MIN_GROWN_CAPACITY ? slotCount * 2 : MIN_GROWN_CAPACITY;
+	largestCapacity = m_Stats.m_Capacity > largestCapacity ? m_Stats.m_Capacity : largestCapacity;
+	if (capacity > largestCapacity)
+	{
+		return false;
+	}
+
+	m_Stats.m_LiveCount = count;
+	m_Stats.m_HighWaterMark = (size_t)highWaterMark;
+
+	// The pool carries on from the capacity it was saved with, so that it grows at the same points as it
+	// would have without the load.
+	Reserve((size_t)capacity);
+	m_Stats.m_Capacity = (size_t)capacity;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ShipArray
+// The base constructor can't reach ReserveExtra, so the ship-only attributes are reserved here.
+//--------------------------------------------------------------------------------------------------------------
+ShipArray::ShipArray(size_t initialCapacity)
+: EntityArray(initialCapacity)
+{
+	ReserveExtra(initialCapacity);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ShipArray
+// Keep the ship-only attributes in step with the shared ones.
+//--------------------------------------------------------------------------------------------------------------
+void ShipArray::ReserveExtra(size_t capacity)
+{
+	m_Angle.reserve(capacity);
+	m_TimeSinceLastShot.reserve(capacity);
+	m_Controller.reserve(capacity);
+}
+
+void ShipArray::PushExtra()
+{
+	m_Angle.push_back(0.f);
+	m_TimeSinceLastShot.push_back(0.f);
+	m_Controller.push_back(0);
+}
+
+void ShipArray::MoveExtra(size_t toIndex, size_t fromIndex)
+{
+	m_Angle[toIndex] = m_Angle[fromIndex];
+	m_TimeSinceLastShot[toIndex] = m_TimeSinceLastShot[fromIndex];
+	m_Controller[toIndex] = m_Controller[fromIndex];
+}
+
+void ShipArray::PopExtra()
+{
+	m_Angle.pop_back();
+	m_TimeSinceLastShot.pop_back();
+	m_Controller.pop_back();
+}
+
+void ShipArray::ClearExtra()
+{
+	m_Angle.clear();
+	m_TimeSinceLastShot.clear();
+	m_Controller.clear();
+}
+
+void ShipArray::SaveExtra(StateWriter& writer) const
+{
+	writer.WriteVector(m_Angle);
+	writer.WriteVector(m_TimeSinceLastShot);
+	writer.WriteVector(m_Controller);
+}
+
+bool ShipArray::LoadExtra(StateReader& reader)
+{
+	reader.ReadVector(m_Angle);
+	reader.ReadVector(m_TimeSinceLastShot);
+	reader.ReadVector(m_Controller);
+	return !reader.HasFailed() && m_Angle.size() == m_PositionX.size() && m_TimeSinceLastShot.size() == m_PositionX.size()
+		&& m_Controller.size() == m_PositionX.size();
+}
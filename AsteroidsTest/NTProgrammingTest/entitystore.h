@@ -0,0 +1,165 @@
+//-------------------------------------------------------------------------------------------------------------
+// entitystore.h
+//
+// Structure-of-arrays storage for game objects.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+#include <vector>
+#include "ntpoint.h"
+#include "statestream.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// EntityHandle
+// A stable reference to an entity. Indices into an EntityArray change as entities are removed; handles don't.
+// Each slot counts how many times it has been released, and a handle records the count it was issued with,
+// so a handle to an entity that has gone is detected even after its slot has been reused.
+//-------------------------------------------------------------------------------------------------------------
+struct EntityHandle
+{
+	EntityHandle() : m_Slot(INVALID_SLOT), m_Generation(0) {}
+	EntityHandle(unsigned int slot, unsigned int generation) : m_Slot(slot), m_Generation(generation) {}
+
+	bool IsNull() const { return m_Slot == INVALID_SLOT; }
+
+	bool operator==(const EntityHandle& other) const { return m_Slot == other.m_Slot && m_Generation == other.m_Generation; }
+	bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+
+	static const unsigned int INVALID_SLOT = 0xffffffffu;
+
+	unsigned int m_Slot;
+	unsigned int m_Generation;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// EntityPoolStats
+// Allocation counters for an EntityArray.
+//-------------------------------------------------------------------------------------------------------------
+struct EntityPoolStats
+{
+	EntityPoolStats()
+	: m_LiveCount(0)
+	, m_HighWaterMark(0)
+	, m_Capacity(0)
+	, m_GrowCount(0)
+	, m_Acquired(0)
+	, m_Released(0)
+	{
+	}
+
+	size_t				m_LiveCount;
+	size_t				m_HighWaterMark;
+	size_t				m_Capacity;
+	unsigned int		m_GrowCount;
+	unsigned long long	m_Acquired;
+	unsigned long long	m_Released;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// EntityArray
+// All entities of one kind, with each attribute held in its own contiguous array so that update passes are
+// linear sweeps. Removal swaps the last entity into the hole, so entities don't keep their index; use a
+// handle to refer to an entity across removals.
+//
+// The array is a pool: storage for Capacity() entities is allocated up front, Add and Remove are O(1) and
+// never allocate until the capacity is exceeded, at which point it doubles.
+//-------------------------------------------------------------------------------------------------------------
+class EntityArray
+{
+public:
+	explicit EntityArray(size_t initialCapacity = 0);
+	virtual ~EntityArray() {}
+
+	void Reserve(size_t capacity);
+	size_t Capacity() const { return m_Stats.m_Capacity; }
+	const EntityPoolStats& GetStats() const { return m_Stats; }
+
+	EntityHandle Add(const NTPoint& position, const NTPoint& velocity, float lifetime, float radius);
+	void Remove(EntityHandle handle);
+	void RemoveAt(size_t index);
+	void Clear();
+
+	size_t Size() const { return m_PositionX.size(); }
+	bool IsEmpty() const { return m_PositionX.empty(); }
+
+	bool Contains(EntityHandle handle) const;
+	size_t IndexOf(EntityHandle handle) const;
+	EntityHandle HandleAt(size_t index) const { return EntityHandle(m_SlotOfIndex[index], m_SlotGeneration[m_SlotOfIndex[index]]); }
+
+	NTPoint GetPosition(size_t index) const { return NTPoint(m_PositionX[index], m_PositionY[index]); }
+	NTPoint GetVelocity(size_t index) const { return NTPoint(m_VelocityX[index], m_VelocityY[index]); }
+	void SetPosition(size_t index, const NTPoint& position) { m_PositionX[index] = position.x; m_PositionY[index] = position.y; }
+	void SetVelocity(size_t index, const NTPoint& velocity) { m_VelocityX[index] = velocity.x; m_VelocityY[index] = velocity.y; }
+
+	// Positions as they were at the start of the current tick, for drawing between ticks.
+	void SavePreviousPositions();
+	NTPoint GetInterpolatedPosition(size_t index, float interpolation) const;
+
+	// Move an entity without it being drawn as travelling there.
+	void Teleport(size_t index, const NTPoint& position);
+
+	// Every entity, its slot and the slots' generations, so that handles held across a save and load stay
+	// valid. LoadState replaces the contents, and returns false if the state is malformed, in which case the
+	// array must be cleared or loaded again before use.
+	void SaveState(StateWriter& writer) const;
+	bool LoadState(StateReader& reader);
+
+public:
+	std::vector<float>	m_PositionX;
+	std::vector<float>	m_PositionY;
+	std::vector<float>	m_VelocityX;
+	std::vector<float>	m_VelocityY;
+	std::vector<float>	m_Lifetime;
+	std::vector<float>	m_Radius;
+	std::vector<float>	m_PreviousX;
+	std::vector<float>	m_PreviousY;
+
+protected:
+	// Kinds with extra attributes keep them in step with the shared ones through these.
+	virtual void ReserveExtra(size_t capacity) {}
+	virtual void PushExtra() {}
+	virtual void MoveExtra(size_t toIndex, size_t fromIndex) {}
+	virtual void PopExtra() {}
+	virtual void ClearExtra() {}
+	virtual void SaveExtra(StateWriter& writer) const {}
+	virtual bool LoadExtra(StateReader& reader) { return true; }
+
+private:
+	bool ReadState(StateReader& reader);
+
+	std::vector<unsigned int>	m_SlotOfIndex;
+	std::vector<unsigned int>	m_IndexOfSlot;
+	std::vector<unsigned int>	m_SlotGeneration;
+	std::vector<unsigned int>	m_FreeSlots;
+	EntityPoolStats				m_Stats;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// ShipArray
+// Ships, which also carry a heading, a weapon cooldown and the ShipControllerId of what drives them.
+//-------------------------------------------------------------------------------------------------------------
+class ShipArray : public EntityArray
+{
+public:
+	explicit ShipArray(size_t initialCapacity = 0);
+
+	std::vector<float>			m_Angle;
+	std::vector<float>			m_TimeSinceLastShot;
+	std::vector<unsigned char>	m_Controller;
+
+protected:
+	virtual void ReserveExtra(size_t capacity);
+	virtual void PushExtra();
+	virtual void MoveExtra(size_t toIndex, size_t fromIndex);
+	virtual void PopExtra();
+	virtual void ClearExtra();
+	virtual void SaveExtra(StateWriter& writer) const;
+	virtual bool LoadExtra(StateReader& reader);
+};
@@ -0,0 +1,354 @@
+//-------------------------------------------------------------------------------------------------------------
+// framebuffer.cpp
+//
+// Implementation of the software framebuffer.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "framebuffer.h"
+#include <math.h>
+#include <stdio.h>
+
+// Largest block an uncompressed deflate stream can hold.
+static const size_t MAX_STORED_BLOCK = 65535;
+
+//--------------------------------------------------------------------------------------------------------------
+// Framebuffer
+//--------------------------------------------------------------------------------------------------------------
+Framebuffer::Framebuffer()
+: m_Width(0)
+, m_Height(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Resize
+// The contents are undefined afterwards; Clear before drawing.
+//--------------------------------------------------------------------------------------------------------------
+void Framebuffer::Resize(int width, int height)
+{
+	assert(width >= 0 && height >= 0);
+
+	m_Width = width;
+	m_Height = height;
+	m_Pixels.resize((size_t)width * height);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+//--------------------------------------------------------------------------------------------------------------
+void Framebuffer::Clear(Colour colour)
+{
+	m_Pixels.assign(m_Pixels.size(), colour);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FillSpan
+// Fill the pixels from fromX to toX inclusive on row y, clipped to the image.
+//--------------------------------------------------------------------------------------------------------------
+void Framebuffer::FillSpan(int y, int fromX, int toX, Colour colour)
+{
+	if (y < 0 || y >= m_Height)
+	{
+		return;
+	}
+
+	if (fromX < 0)
+	{
+		fromX = 0;
+	}
+	if (toX >= m_Width)
+	{
+		toX = m_Width - 1;
+	}
+
+	Colour* row = &m_Pixels[(size_t)y * m_Width];
+	for (int x = fromX; x <= toX; x++)
+	{
+		row[x] = colour;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetCircleSpan
+// The pixels on row y whose centres are inside the circle. The circle covers the same box as GDI's
+// Ellipse(centreX - radius, centreY - radius, centreX + radius, centreY + radius). Returns false if the row
+// misses the circle.
+//--------------------------------------------------------------------------------------------------------------
+bool Framebuffer::GetCircleSpan(int centreX, int centreY, int radius, int y, int& outFromX, int& outToX) const
+{
+	float dy = (float)y + 0.5f - (float)centreY;
+	float squared = (float)radius * (float)radius - dy * dy;
+	if (radius <= 0 || squared < 0.f)
+	{
+		return false;
+	}
+
+	float halfWidth = sqrtf(squared);
+	outFromX = (int)ceilf((float)centreX - halfWidth - 0.5f);
+	outToX = (int)floorf((float)centreX + halfWidth - 0.5f);
+	return outFromX <= outToX;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// DrawCircle
+// Each row is the span of the outer circle, with the span of a circle one pixel smaller filled inside it.
+//--------------------------------------------------------------------------------------------------------------
+void Framebuffer::DrawCircle(int centreX, int centreY, int radius, Colour outline, Colour fill)
+{
+	int fromY = centreY - radius;
+	int toY = centreY + radius - 1;
+	if (fromY < 0)
+	{
+		fromY = 0;
+	}
+	if (toY >= m_Height)
+	{
+		toY = m_Height - 1;
+	}
+
+	for (int y = fromY; y <= toY; y++)
+	{
+		int outerFrom, outerTo;
+		if (!GetCircleSpan(centreX, centreY, radius, y, outerFrom, outerTo))
+		{
+			continue;
+		}
+		if (outerTo < 0 || outerFrom >= m_Width)
+		{
+			continue;
+		}
+
+		int innerFrom, innerTo;
+		if (GetCircleSpan(centreX, centreY, radius - 1, y, innerFrom, innerTo))
+		{
+			FillSpan(y, outerFrom, innerFrom - 1, outline);
+			FillSpan(y, innerFrom, innerTo, fill);
+			FillSpan(y, innerTo + 1, outerTo, outline);
+		}
+		else
+		{
+			FillSpan(y, outerFrom, outerTo, outline);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// DrawLine
+// Bresenham, including both end points.
+//--------------------------------------------------------------------------------------------------------------
+void Framebuffer::DrawLine(int fromX, int fromY, int toX, int toY, Colour colour)
+{
+	int dx = abs(toX - fromX);
+	int dy = -abs(toY - fromY);
+	int stepX = fromX < toX ? 1 : -1;
+	int stepY = fromY < toY ? 1 : -1;
+	int error = dx + dy;
+
+	int x = fromX;
+	int y = fromY;
+	for (;;)
+	{
+		if (x >= 0 && x < m_Width && y >= 0 && y < m_Height)
+		{
+			m_Pixels[(size_t)y * m_Width + x] = colour;
+		}
+
+		if (x == toX && y == toY)
+		{
+			break;
+		}
+
+		int doubled = 2 * error;
+		if (doubled >= dy)
+		{
+			error += dy;
+			x += stepX;
+		}
+		if (doubled <= dx)
+		{
+			error += dx;
+			y += stepY;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// DrawPolygon
+//--------------------------------------------------------------------------------------------------------------
+void Framebuffer::DrawPolygon(const int* points, int pointCount, Colour colour)
+{
+	for (int point = 0; point < pointCount; point++)
+	{
+		int next = (point + 1) % pointCount;
+		DrawLine(points[2 * point], points[2 * point + 1], points[2 * next], points[2 * next + 1], colour);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WritePPM
+// Binary PPM, which has no alpha channel.
+//--------------------------------------------------------------------------------------------------------------
+bool Framebuffer::WritePPM(const char* path) const
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", m_Width, m_Height);
+
+	std::vector<unsigned char> row((size_t)m_Width * 3);
+	for (int y = 0; y < m_Height; y++)
+	{
+		for (int x = 0; x < m_Width; x++)
+		{
+			Colour colour = GetPixel(x, y);
+			row[x * 3 + 0] = (unsigned char)GetRed(colour);
+			row[x * 3 + 1] = (unsigned char)GetGreen(colour);
+			row[x * 3 + 2] = (unsigned char)GetBlue(colour);
+		}
+		if (!row.empty())
+		{
+			fwrite(&row[0], 1, row.size(), file);
+		}
+	}
+
+	return fclose(file) == 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// PNG helpers
+//--------------------------------------------------------------------------------------------------------------
+static unsigned int UpdateCrc(unsigned int crc, const unsigned char* data, size_t length)
+{
+	static unsigned int table[256];
+	static bool tableBuilt = false;
+	if (!tableBuilt)
+	{
+		for (unsigned int entry = 0; entry < 256; entry++)
+		{
+			unsigned int value = entry;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+			}
+			table[entry] = value;
+		}
+		tableBuilt = true;
+	}
+
+	for (size_t index = 0; index < length; index++)
+	{
+		crc = table[(crc ^ data[index]) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void AppendBigEndian(std::vector<unsigned char>& out, unsigned int value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+static void WriteChunk(FILE* file, const char* type, const std::vector<unsigned char>& data)
+{
+	std::vector<unsigned char> header;
+	AppendBigEndian(header, (unsigned int)data.size());
+	header.insert(header.end(), type, type + 4);
+	fwrite(&header[0], 1, header.size(), file);
+
+	unsigned int crc = UpdateCrc(0xffffffffu, (const unsigned char*)type, 4);
+	if (!data.empty())
+	{
+		fwrite(&data[0], 1, data.size(), file);
+		crc = UpdateCrc(crc, &data[0], data.size());
+	}
+
+	std::vector<unsigned char> footer;
+	AppendBigEndian(footer, crc ^ 0xffffffffu);
+	fwrite(&footer[0], 1, footer.size(), file);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WritePNG
+// 8 bit RGBA, with every row unfiltered and the image data in stored (uncompressed) deflate blocks.
+//--------------------------------------------------------------------------------------------------------------
+bool Framebuffer::WritePNG(const char* path) const
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	fwrite(signature, 1, sizeof(signature), file);
+
+	std::vector<unsigned char> header;
+	AppendBigEndian(header, (unsigned int)m_Width);
+	AppendBigEndian(header, (unsigned int)m_Height);
+	header.push_back(8);	// Bit depth
+	header.push_back(6);	// Colour type: RGBA
+	header.push_back(0);	// Compression
+	header.push_back(0);	// Filter
+	header.push_back(0);	// Interlace
+	WriteChunk(file, "IHDR", header);
+
+	// The raw scanlines, each led by its filter type.
+	std::vector<unsigned char> raw;
+	raw.reserve((size_t)m_Height * (m_Width * 4 + 1));
+	for (int y = 0; y < m_Height; y++)
+	{
+		raw.push_back(0);
+		for (int x = 0; x < m_Width; x++)
+		{
+			Colour colour = GetPixel(x, y);
+			raw.push_back((unsigned char)GetRed(colour));
+			raw.push_back((unsigned char)GetGreen(colour));
+			raw.push_back((unsigned char)GetBlue(colour));
+			raw.push_back((unsigned char)GetAlpha(colour));
+		}
+	}
+
+	// Wrap them in a zlib stream of stored blocks.
+	std::vector<unsigned char> data;
+	data.push_back(0x78);
+	data.push_back(0x01);
+
+	size_t offset = 0;
+	do
+	{
+		size_t length = raw.size() - offset < MAX_STORED_BLOCK ? raw.size() - offset : MAX_STORED_BLOCK;
+		bool last = offset + length == raw.size();
+
+		data.push_back(last ? 1 : 0);
+		data.push_back((unsigned char)length);
+		data.push_back((unsigned char)(length >> 8));
+		data.push_back((unsigned char)~length);
+		data.push_back((unsigned char)(~length >> 8));
+		data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+		offset += length;
+	}
+	while (offset < raw.size());
+
+	unsigned int sumA = 1;
+	unsigned int sumB = 0;
+	for (size_t index = 0; index < raw.size(); index++)
+	{
+		sumA = (sumA + raw[index]) % 65521;
+		sumB = (sumB + sumA) % 65521;
+	}
+	AppendBigEndian(data, (sumB << 16) | sumA);
+
+	WriteChunk(file, "IDAT", data);
+	WriteChunk(file, "IEND", std::vector<unsigned char>());
+
+	return fclose(file) == 0;
+}
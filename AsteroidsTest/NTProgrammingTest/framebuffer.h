@@ -0,0 +1,71 @@
+//-------------------------------------------------------------------------------------------------------------
+// framebuffer.h
+//
+// An in-memory RGBA image and the few shapes the game draws, so that frames can be rendered and saved without
+// a window.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------------------
+// Colour
+// Packed with red in the lowest byte and alpha in the highest.
+//-------------------------------------------------------------------------------------------------------------
+typedef unsigned int Colour;
+
+inline Colour MakeColour(unsigned int red, unsigned int green, unsigned int blue, unsigned int alpha = 255)
+{
+	return (red & 0xff) | ((green & 0xff) << 8) | ((blue & 0xff) << 16) | ((alpha & 0xff) << 24);
+}
+
+inline unsigned int GetRed(Colour colour)   { return colour & 0xff; }
+inline unsigned int GetGreen(Colour colour) { return (colour >> 8) & 0xff; }
+inline unsigned int GetBlue(Colour colour)  { return (colour >> 16) & 0xff; }
+inline unsigned int GetAlpha(Colour colour) { return colour >> 24; }
+
+//-------------------------------------------------------------------------------------------------------------
+// Framebuffer
+// Shapes are clipped to the image and drawn a row span at a time, so the inner loops are plain fills of
+// contiguous pixels. Coordinates are in pixels with the origin at the top left, as with GDI.
+//-------------------------------------------------------------------------------------------------------------
+class Framebuffer
+{
+public:
+	Framebuffer();
+
+	void Resize(int width, int height);
+	void Clear(Colour colour);
+
+	int GetWidth() const { return m_Width; }
+	int GetHeight() const { return m_Height; }
+	const Colour* GetPixels() const { return m_Pixels.empty() ? NULL : &m_Pixels[0]; }
+	Colour GetPixel(int x, int y) const { return m_Pixels[(size_t)y * m_Width + x]; }
+
+	// A circle with a one pixel outline and a filled interior, like GDI's Ellipse with a pen and brush.
+	void DrawCircle(int centreX, int centreY, int radius, Colour outline, Colour fill);
+
+	void DrawLine(int fromX, int fromY, int toX, int toY, Colour colour);
+
+	// A closed outline through the points, with points[2 * i] and points[2 * i + 1] the x and y of each.
+	void DrawPolygon(const int* points, int pointCount, Colour colour);
+
+	// Save the image. Returns false if the file couldn't be written. PNGs are stored uncompressed, which
+	// keeps the writer small at the expense of file size.
+	bool WritePPM(const char* path) const;
+	bool WritePNG(const char* path) const;
+
+private:
+	void FillSpan(int y, int fromX, int toX, Colour colour);
+	bool GetCircleSpan(int centreX, int centreY, int radius, int y, int& outFromX, int& outToX) const;
+
+	int					m_Width;
+	int					m_Height;
+	std::vector<Colour>	m_Pixels;
+};
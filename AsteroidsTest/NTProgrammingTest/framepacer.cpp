@@ -0,0 +1,143 @@
+//-------------------------------------------------------------------------------------------------------------
+// framepacer.cpp
+//
+// Implementation of the frame pacer.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "framepacer.h"
+#include "trace.h"
+#include <thread>
+
+// How much each sleep moves the overrun estimate towards what it measured. It rises quickly and falls
+// slowly, so that it follows the longer overruns rather than the typical one: waking a little early only
+// costs some yielding, where waking late costs a late frame.
+static const double OVERRUN_RISE = 0.5;
+static const double OVERRUN_FALL = 1. / 32.;
+
+// A frame starting less than this long after it was due counts as on time; reading the clock and yielding
+// can't be relied on to be any finer.
+static const double LATE_TOLERANCE = 0.0005;
+
+//--------------------------------------------------------------------------------------------------------------
+// FramePacer
+//--------------------------------------------------------------------------------------------------------------
+FramePacer::FramePacer()
+: m_Wait(NULL)
+{
+	Reset();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Reset
+// The overrun estimate is kept, since it describes the system rather than the run.
+//--------------------------------------------------------------------------------------------------------------
+void FramePacer::Reset()
+{
+	double sleepOverrun = m_Stats.m_SleepOverrun;
+	m_Stats = FramePacerStats();
+	m_Stats.m_SleepOverrun = sleepOverrun;
+
+	m_FrameStart = Clock::now();
+	m_NextFrame = m_FrameStart;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WaitForNextFrame
+// Sleep until the overrun estimate short of the deadline, then yield the rest of the way. The yielding is
+// capped by m_MaxSpin, so a system whose sleeps overrun badly costs late frames rather than a spinning core.
+//--------------------------------------------------------------------------------------------------------------
+void FramePacer::WaitForNextFrame(double gameDeadline)
+{
+	NT_TRACE_SCOPE("wait");
+	Clock::time_point waitStart = Clock::now();
+	m_Stats.m_BusyTime += std::chrono::duration<double>(waitStart - m_FrameStart).count();
+	m_Stats.m_Frames++;
+
+	Clock::time_point due = waitStart;
+	bool hasDeadline = false;
+	if (gameDeadline >= 0.)
+	{
+		due = waitStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gameDeadline));
+		hasDeadline = true;
+	}
+
+	if (m_Settings.m_TargetRate > 0.f)
+	{
+		Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1. / m_Settings.m_TargetRate));
+		if (m_NextFrame <= waitStart)
+		{
+			m_NextFrame += period;
+			if (m_NextFrame + period <= waitStart)
+			{
+				m_NextFrame = waitStart;
+			}
+		}
+		if (!hasDeadline || m_NextFrame < due)
+		{
+			due = m_NextFrame;
+		}
+	}
+
+	Clock::time_point now = waitStart;
+	while (now < due)
+	{
+		double remaining = std::chrono::duration<double>(due - now).count();
+		double spin = m_Stats.m_SleepOverrun < m_Settings.m_MaxSpin ? m_Stats.m_SleepOverrun : m_Settings.m_MaxSpin;
+
+		if (remaining > spin)
+		{
+			if (Sleep(remaining - spin))
+			{
+				now = Clock::now();
+				break;
+			}
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+		now = Clock::now();
+	}
+
+	double lateness = std::chrono::duration<double>(now - due).count();
+	if (lateness > LATE_TOLERANCE)
+	{
+		m_Stats.m_LateFrames++;
+		m_Stats.m_LateTime += lateness;
+		m_Stats.m_WorstLateness = lateness > m_Stats.m_WorstLateness ? lateness : m_Stats.m_WorstLateness;
+	}
+
+	m_Stats.m_IdleTime += std::chrono::duration<double>(now - waitStart).count();
+	m_FrameStart = now;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Sleep
+// Only sleeps that ran their course are measured; one cut short by the wait function says nothing about
+// overrun.
+//--------------------------------------------------------------------------------------------------------------
+bool FramePacer::Sleep(double seconds)
+{
+	Clock::time_point start = Clock::now();
+	if (m_Wait != NULL)
+	{
+		if (m_Wait(seconds))
+		{
+			return true;
+		}
+	}
+	else
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	}
+
+	double overrun = std::chrono::duration<double>(Clock::now() - start).count() - seconds;
+	overrun = overrun > 0. ? overrun : 0.;
+	double smoothing = overrun > m_Stats.m_SleepOverrun ? OVERRUN_RISE : OVERRUN_FALL;
+	m_Stats.m_SleepOverrun += (overrun - m_Stats.m_SleepOverrun) * smoothing;
+	return false;
+}
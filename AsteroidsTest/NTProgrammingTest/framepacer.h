@@ -0,0 +1,110 @@
+//-------------------------------------------------------------------------------------------------------------
+// framepacer.h
+//
+// Keeps a main loop from spinning. Between frames it sleeps until the next one is due, and it keeps track of
+// how much of the time was spent working and how much waiting.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <chrono>
+
+// Block for up to the given number of seconds. Returns true if woken early by something the loop should deal
+// with straight away, such as window messages arriving.
+typedef bool (*PacerWaitFunction)(double seconds);
+
+//-------------------------------------------------------------------------------------------------------------
+// FramePacerSettings
+//-------------------------------------------------------------------------------------------------------------
+struct FramePacerSettings
+{
+	FramePacerSettings()
+	: m_TargetRate(0.f)
+	, m_MaxSpin(0.001)
+	{
+	}
+
+	// Frames per second to aim for, on a steady cadence. With 0, the loop only wakes when the game next
+	// needs updating.
+	float	m_TargetRate;
+
+	// A sleep usually overruns by a little. The pacer learns by how much and wakes that much early, then
+	// yields until the deadline; this is the most time, in seconds, it will spend yielding per frame.
+	double	m_MaxSpin;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// FramePacerStats
+// Times in seconds, since the last Reset.
+//-------------------------------------------------------------------------------------------------------------
+struct FramePacerStats
+{
+	FramePacerStats()
+	: m_Frames(0)
+	, m_BusyTime(0.)
+	, m_IdleTime(0.)
+	, m_LateFrames(0)
+	, m_LateTime(0.)
+	, m_WorstLateness(0.)
+	, m_SleepOverrun(0.)
+	{
+	}
+
+	// Time between waits, doing the frame's work, and time spent in them.
+	unsigned long long	m_Frames;
+	double				m_BusyTime;
+	double				m_IdleTime;
+
+	// Frames that started noticeably after they were due, and by how much.
+	unsigned long long	m_LateFrames;
+	double				m_LateTime;
+	double				m_WorstLateness;
+
+	// The current estimate of how far a sleep overruns.
+	double				m_SleepOverrun;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// FramePacer
+// Call WaitForNextFrame at the end of each frame's work. It returns when the next frame is due: the next
+// step of the target rate's cadence, or sooner if the game needs updating sooner. A cadence that falls more
+// than a frame behind starts again from now, rather than running frames back to back to catch up.
+//-------------------------------------------------------------------------------------------------------------
+class FramePacer
+{
+public:
+	FramePacer();
+
+	void SetSettings(const FramePacerSettings& settings) { m_Settings = settings; }
+	const FramePacerSettings& GetSettings() const { return m_Settings; }
+
+	// Waits are made through this function; with none set the thread sleeps.
+	void SetWaitFunction(PacerWaitFunction wait) { m_Wait = wait; }
+
+	// Start timing from now, with the stats cleared.
+	void Reset();
+
+	// gameDeadline is how long, in seconds, until the game next needs updating, or negative if it doesn't
+	// care. Returns early if the wait function says it was woken for something.
+	void WaitForNextFrame(double gameDeadline);
+
+	const FramePacerStats& GetStats() const { return m_Stats; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// Sleep through the wait function, learning how far sleeps overrun. Returns true if woken early.
+	bool Sleep(double seconds);
+
+	FramePacerSettings	m_Settings;
+	PacerWaitFunction	m_Wait;
+	FramePacerStats		m_Stats;
+
+	Clock::time_point	m_FrameStart;
+	Clock::time_point	m_NextFrame;
+};
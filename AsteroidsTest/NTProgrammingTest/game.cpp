@@ -15,8 +15,13 @@
 
 #include "game.h"
 #include "objects.h"
+#include "replay.h"
 #include "timer.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
 #include <ctime>
+#include <thread>
 
 //-------------------------------------------------------------------------------------------------------------
 // Constants
@@ -29,43 +34,60 @@ static const int X_SAFEREGION_MIN = 100;
 static const int X_SAFEREGION_MAX = 1500;
 static const int Y_SAFEREGION_MIN = 100;
 static const int Y_SAFEREGION_MAX = 1000;
-static const int PLACE_ATTEMPTS_PER_SUN = 20;
-static const int PLACE_ATTEMPTS_PER_ASTEROIDS = 10;
-static const float MINIMUM_DISTANCE_BETWEEN_SUNS = 150.0f;
-static const float MINIMUM_DISTANCE_BETWEEN_ASTEROIDS= 50.0f;
 static const float DRAW_TIME = 0.05f;
+static const double TICK_TOLERANCE = 1e-4;
+static const float SHIP_GRID_CELL_SIZE = 32.f;
+
+// Destroyed asteroids are marked in the asteroid tree rather than taken out, until more than this fraction
+// of its entries are marked and it is rebuilt.
+static const float MAX_REMOVED_FRACTION = 0.25f;
+
+// Missiles are updated in parallel in chunks of this many. A multiple of the widest gravity kernel, so that
+// chunking doesn't change which missiles share a vector.
+static const size_t MISSILE_CHUNK_SIZE = 1024;
+
+Game g_Game;
+
+//--------------------------------------------------------------------------------------------------------------
+// Constructor
+//--------------------------------------------------------------------------------------------------------------
+Game::Game()
+: m_KeyState(NULL)
+, m_AsteroidTreeDirty(true)
+, m_Seed(0)
+, m_Recorder(NULL)
+, m_TickAccumulator(0.)
+, m_DroppedTime(0.)
+, m_TickCount(0)
+, m_Interpolation(0.f)
+, m_TimeUntilDraw(0.f)
+, m_TickTimeDelta(0.f)
+{
+	m_Controllers[CONTROLLER_PLAYER] = &m_PlayerController;
+	m_Controllers[CONTROLLER_BOT] = &m_BotController;
+	m_Controllers[CONTROLLER_REMOTE] = &m_RemoteController;
+
+	BuildTickGraph();
+}
 
 //--------------------------------------------------------------------------------------------------------------
-// Destructor
-// Clean up any remaining objects being held in our lists.
+// BuildTickGraph
+// The ships' controllers decide what every ship does while the missiles integrate, since neither touches
+// what the other reads. Then the missiles are swept against everything they can hit, the hits are resolved,
+// and the ships act on their commands last.
 //--------------------------------------------------------------------------------------------------------------
-Game::~Game()
+void Game::BuildTickGraph()
 {
-       m_LocalShip = NULL;
-
-       for ( std::list< Sun * >::iterator itSun = m_Suns.begin(); itSun != m_Suns.end(); itSun++ )
-       {
-              delete *itSun;
-       }
-       m_Suns.clear();
-
-       for ( std::list< Ship * >::iterator itShip = m_Ships.begin(); itShip != m_Ships.end(); itShip++ )
-       {
-              delete *itShip;
-       }
-       m_Ships.clear();
-
-       for ( std::list< Missile * >::iterator itMissile = m_Missiles.begin(); itMissile != m_Missiles.end(); itMissile++ )
-       {
-              delete *itMissile;
-       }
-       m_Missiles.clear();
-
-	   for (std::list< Asteroids* >::iterator itAsteroids = m_Asteroids.begin(); itAsteroids != m_Asteroids.end(); itAsteroids++)
-	   {
-		   delete* itAsteroids;
-	   }
-	   m_Asteroids.clear();
+	int control = m_TickGraph.AddPhase("control", [this]() { ControlShips(); });
+	int integrate = m_TickGraph.AddPhase("integrate", [this]() { IntegrateMissiles(); });
+	int collide = m_TickGraph.AddPhase("collide", [this]() { CollideMissiles(); });
+	int resolve = m_TickGraph.AddPhase("resolve", [this]() { ResolveCollisions(); });
+	int ships = m_TickGraph.AddPhase("ships", [this]() { UpdateShips(); });
+
+	m_TickGraph.AddDependency(collide, control);
+	m_TickGraph.AddDependency(collide, integrate);
+	m_TickGraph.AddDependency(resolve, collide);
+	m_TickGraph.AddDependency(ships, resolve);
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -74,191 +96,717 @@ Game::~Game()
 //--------------------------------------------------------------------------------------------------------------
 bool Game::Initialise()
 {
-	srand(time(NULL));
-	// Generate a random number of suns
-	int numberOfSuns = RandomRange(MIN_SUNS, MAX_SUNS);
+	return Initialise((unsigned int)time(NULL));
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Initialise
+// As above, but with an explicit seed so that headless runs can reproduce the same playing field.
+//--------------------------------------------------------------------------------------------------------------
+bool Game::Initialise(unsigned int seed)
+{
+	m_Seed = seed;
+
+	unsigned int threadCount = m_Settings.m_ThreadCount;
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+	if (threadCount != m_Jobs.GetThreadCount())
+	{
+		m_Jobs.Start(threadCount - 1);
+	}
+	m_GravityScratch.resize(threadCount);
+	m_IntegratorScratch.resize(threadCount);
+	m_IntegratorThreadStats.resize(threadCount);
+
+	// Start from an empty field, with the pools sized so that normal play never has to grow them.
+	m_Missiles.Clear();
+	m_Suns.Clear();
+	m_Ships.Clear();
+	m_Asteroids.Clear();
+	m_Missiles.Reserve(m_Settings.m_MissileCapacity);
+
+	if (m_Settings.m_StreamWorld)
+	{
+		m_WorldStats = WorldStats();
+		m_GravityField.Clear();
+		m_World.Reset(seed, m_Settings.m_WorldStream);
+	}
+	else
+	{
+		PlaceFixedWorld(seed);
+	}
+	m_SunTree.Build(m_Suns);
+	m_AsteroidTreeDirty = true;
+
+	// Launch the player ship, and the bots, each from its own stream so that adding bots doesn't move the
+	// others.
+	m_LocalShip = Ship::Spawn(m_Ships);
+	for (size_t bot = 0; bot < m_Settings.m_BotCount; bot++)
+	{
+		RandomStream botRandom(seed, RANDOM_STREAM_BOTS, bot);
+		float x = botRandom.NextRange((float)X_SAFEREGION_MIN, (float)X_SAFEREGION_MAX);
+		float y = botRandom.NextRange((float)Y_SAFEREGION_MIN, (float)Y_SAFEREGION_MAX);
+		Ship::Spawn(m_Ships, NTPoint(x, y), CONTROLLER_BOT);
+	}
+
+	// The first chunks load around where the ship starts.
+	StreamWorld();
+
+	// Start the clock from here, so that the time spent setting up isn't treated as a frame to catch up on.
+	m_Timer.Reset();
+	m_TickAccumulator = 0.;
+	m_DroppedTime = 0.;
+	m_TickCount = 0;
+	m_CollisionTotals.Reset();
+	m_IntegratorTotals.Reset();
+	m_Interpolation = 0.f;
+	m_TimeUntilDraw = 0.f;
+	m_TickInput = TickInput();
+	m_PolledInput = TickInput();
+
+	return true;
+}
 
-	for (int sunIndex = 0; sunIndex < numberOfSuns; sunIndex++)
+//--------------------------------------------------------------------------------------------------------------
+// PlaceFixedWorld
+// Scatter suns and asteroids over the fixed field, and bake the suns' gravity if asked to.
+//--------------------------------------------------------------------------------------------------------------
+void Game::PlaceFixedWorld(unsigned int seed)
+{
+	// The counts come from their own stream, and each kind of object is placed from another, so that
+	// changing how one is placed doesn't move the others.
+	RandomStream worldRandom(seed, RANDOM_STREAM_WORLD);
+	m_WorldStats.m_SunsRequested = m_Settings.m_SunCount > 0 ? m_Settings.m_SunCount : worldRandom.NextRange(MIN_SUNS, MAX_SUNS + 1);
+	m_WorldStats.m_AsteroidsRequested = m_Settings.m_AsteroidCount > 0 ? m_Settings.m_AsteroidCount : worldRandom.NextRange(MIN_ASTEROIDS, MAX_ASTEROIDS + 1);
+
+	RandomStream sunRandom(seed, RANDOM_STREAM_SUNS);
+	m_WorldStats.m_SunsPlaced = ScatterObjects(m_PlacementSampler, sunRandom, (float)X_SAFEREGION_MIN, (float)Y_SAFEREGION_MIN,
+		(float)X_SAFEREGION_MAX, (float)Y_SAFEREGION_MAX, Sun::MINIMUM_SPACING, m_WorldStats.m_SunsRequested, m_Suns, Sun::Spawn, NULL);
+
+	// Suns never move, so their gravity can be baked once they are all placed. A field that can't be brought
+	// within the error bound is dropped in favour of the exact sum.
+	m_GravityField.Clear();
+	if (m_Settings.m_UseGravityField)
 	{
-		// Try to place each sun a limited number of times, to ensure the function doesn't get stuck in an infinite loop
-		for (int attemptNumber = 0; attemptNumber < PLACE_ATTEMPTS_PER_SUN; attemptNumber++)
+		if (!m_GravityField.Bake(m_Suns, m_Settings.m_SunGravity, (float)X_SAFEREGION_MIN, (float)Y_SAFEREGION_MIN,
+			(float)X_SAFEREGION_MAX, (float)Y_SAFEREGION_MAX, m_Settings.m_GravityField))
 		{
-			// Generate a random position
-			int sunX = RandomRange(X_SAFEREGION_MIN, X_SAFEREGION_MAX);
-			int sunY = RandomRange(Y_SAFEREGION_MIN, Y_SAFEREGION_MAX);
-	
-			// Check the position is safe
-			bool positionIsSafe = true;
-			for (std::list<Sun*>::iterator itSun = m_Suns.begin(); itSun != m_Suns.end(); itSun++)
-			{
-				if (NTPoint(NTPoint((float)sunX, (float)sunY) - (*itSun)->GetPosition()).GetLength() < MINIMUM_DISTANCE_BETWEEN_SUNS)
-				{
-					positionIsSafe = false;
-					break;
-				}
-			}
+			m_GravityField.Clear();
+		}
+	}
 
-			if (positionIsSafe)
-			{
-				// Found a safe position, so create the sun and break out of the attempt loop
-				m_Suns.push_back(new Sun(sunX, sunY));
-				break;
-			}
+	RandomStream asteroidRandom(seed, RANDOM_STREAM_ASTEROIDS);
+	m_WorldStats.m_AsteroidsPlaced = ScatterObjects(m_PlacementSampler, asteroidRandom, (float)X_SAFEREGION_MIN, (float)Y_SAFEREGION_MIN,
+		(float)X_SAFEREGION_MAX, (float)Y_SAFEREGION_MAX, Asteroids::MINIMUM_SPACING, m_WorldStats.m_AsteroidsRequested, m_Asteroids,
+		Asteroids::Spawn, NULL);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// StreamWorld
+// Bring the streamed chunks up to date with where the ships are. The suns' tree is rebuilt here rather than
+// every tick, since this is the only place suns come and go.
+//--------------------------------------------------------------------------------------------------------------
+void Game::StreamWorld()
+{
+	if (!m_Settings.m_StreamWorld)
+	{
+		return;
+	}
+
+	NT_TRACE_SCOPE_COUNT("stream world", m_Ships.Size());
+	if (m_World.Update(m_Suns, m_Asteroids, m_Ships))
+	{
+		m_SunTree.Build(m_Suns);
+		m_AsteroidTreeDirty = true;
+	}
+}
+
+#ifdef _WIN32
+//--------------------------------------------------------------------------------------------------------------
+// Draw
+// Draw the game into the window.
+//--------------------------------------------------------------------------------------------------------------
+void Game::Draw(HDC hdc, PAINTSTRUCT* ps)
+{
+	m_GdiBackend.SetDeviceContext(hdc);
+	Draw(m_GdiBackend);
+}
+#endif // _WIN32
+
+//--------------------------------------------------------------------------------------------------------------
+// Draw
+// Draw the game through a backend. The command buffer is kept between frames so that its storage is reused.
+//--------------------------------------------------------------------------------------------------------------
+void Game::Draw(RenderBackend& backend)
+{
+	NT_TRACE_SCOPE("draw");
+	BuildRenderCommands(m_RenderCommands);
+
+	NT_TRACE_SCOPE_COUNT("submit", m_RenderCommands.Size());
+	backend.Submit(m_RenderCommands);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BuildRenderCommands
+// Drawn through a snapshot, the same way the render thread draws, with the snapshot kept between frames so
+// that its storage is reused.
+//--------------------------------------------------------------------------------------------------------------
+void Game::BuildRenderCommands(RenderCommandBuffer& commands)
+{
+	CaptureSnapshot(m_RenderSnapshot);
+	m_RenderSnapshot.BuildRenderCommands(commands, m_Interpolation);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// CaptureSnapshot
+// Suns and asteroids don't move, so only the missiles and ships need their previous positions.
+//--------------------------------------------------------------------------------------------------------------
+void Game::CaptureSnapshot(RenderSnapshot& snapshot) const
+{
+	NT_TRACE_SCOPE_COUNT("capture snapshot", m_Suns.Size() + m_Asteroids.Size() + m_Missiles.Size() + m_Ships.Size());
+	snapshot.m_Tick = m_TickCount;
+	snapshot.m_TickDelta = GetTickDelta();
+	snapshot.m_Interpolation = m_Interpolation;
+	snapshot.m_CaptureTime = RenderSnapshot::Clock::now();
+
+	snapshot.m_Suns.Capture(m_Suns, false);
+	snapshot.m_Asteroids.Capture(m_Asteroids, false);
+	snapshot.m_Missiles.Capture(m_Missiles, true);
+	snapshot.m_Ships.Capture(m_Ships, true);
+	snapshot.m_Ships.m_Angle.assign(m_Ships.m_Angle.begin(), m_Ships.m_Angle.end());
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+// Update
+// Run as many fixed ticks as the time since the last update calls for, and decide whether to redraw.
+//--------------------------------------------------------------------------------------------------------------
+void Game::Update(bool& outNeedRedraw)
+{
+	NT_TRACE_SCOPE("update");
+
+	// Update the timer before doing anything else.
+	{
+		NT_TRACE_SCOPE("timer");
+		m_Timer.Update();
+	}
+
+	double tickDelta = 1. / m_Settings.m_TickRate;
+	m_TickAccumulator += m_Timer.GetTimeDelta();
+
+	// The tolerance stops rounding in the frame time from skipping a tick when frames and ticks are the same
+	// length.
+	int ticks = 0;
+	while (m_TickAccumulator >= tickDelta * (1. - TICK_TOLERANCE))
+	{
+		if (ticks == m_Settings.m_MaxTicksPerUpdate)
+		{
+			double dropped = floor(m_TickAccumulator / tickDelta) * tickDelta;
+			m_DroppedTime += dropped;
+			m_TickAccumulator -= dropped;
+			break;
 		}
+
+		Tick((float)tickDelta);
+		m_TickAccumulator -= tickDelta;
+		ticks++;
 	}
 
-	// Generate a random number of Asteroids
-	int numberOfAsteroids = RandomRange(MIN_ASTEROIDS, MAX_ASTEROIDS);
+	if (m_TickAccumulator < 0.)
+	{
+		m_TickAccumulator = 0.;
+	}
+	m_Interpolation = (float)(m_TickAccumulator / tickDelta);
+	if (m_Interpolation > 1.f)
+	{
+		m_Interpolation = 1.f;
+	}
 
-	for (int AsteroidsIndex = 0; AsteroidsIndex < numberOfAsteroids; AsteroidsIndex++)
+	// Check if we need a redraw
+	m_TimeUntilDraw -= m_Timer.GetTimeDelta();
+	if (m_TimeUntilDraw < 0.f)
 	{
-		// Try to place each Asteroids a limited number of times, to ensure the function doesn't get stuck in an infinite loop
-		for (int attemptNumber = 0; attemptNumber < PLACE_ATTEMPTS_PER_ASTEROIDS; attemptNumber++)
+		m_TimeUntilDraw = DRAW_TIME;
+		outNeedRedraw = true;
+	}
+	else
+	{
+		outNeedRedraw = false;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetTimeUntilUpdate
+// The same tests as Update makes, turned round to say when they will next pass.
+//--------------------------------------------------------------------------------------------------------------
+double Game::GetTimeUntilUpdate() const
+{
+	double tickDelta = 1. / m_Settings.m_TickRate;
+	double untilTick = tickDelta * (1. - TICK_TOLERANCE) - m_TickAccumulator;
+	double untilDraw = m_TimeUntilDraw;
+
+	double until = untilTick < untilDraw ? untilTick : untilDraw;
+	return until > 0. ? until : 0.;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Tick
+// Poll the keys, and hand the input to the recorder before running the tick with it.
+//--------------------------------------------------------------------------------------------------------------
+void Game::Tick(float timeDelta)
+{
+	m_PolledInput.m_Keys = 0;
+	for (int key = 0; key < KEY_COUNT; key++)
+	{
+		if (m_KeyState != NULL && m_KeyState((GameKey)key))
 		{
-			// Generate a random position
-			int AsteroidsX = RandomRange(X_SAFEREGION_MIN, X_SAFEREGION_MAX);
-			int AsteroidsY = RandomRange(Y_SAFEREGION_MIN, Y_SAFEREGION_MAX);
+			m_PolledInput.m_Keys |= 1u << key;
+		}
+	}
 
-			// Check the position is safe
-			bool positionIsSafe = true;
-			for (std::list<Asteroids*>::iterator itAsteroids = m_Asteroids.begin(); itAsteroids != m_Asteroids.end(); itAsteroids++)
-			{
-				if (NTPoint(NTPoint((float)AsteroidsX, (float)AsteroidsY) - (*itAsteroids)->GetPosition()).GetLength() < MINIMUM_DISTANCE_BETWEEN_ASTEROIDS)
-				{
-					positionIsSafe = false;
-					break;
-				}
-			}
+	if (m_Recorder != NULL)
+	{
+		m_Recorder->RecordTick(*this, m_PolledInput);
+	}
 
-			if (positionIsSafe)
-			{
-				// Found a safe position, so create the sun and break out of the attempt loop
-				m_Asteroids.push_back(new Asteroids(AsteroidsX, AsteroidsY));
-				break;
-			}
+	Tick(timeDelta, m_PolledInput);
+	m_PolledInput.m_Fires.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Tick
+// Advance the simulation by one step. The shots are fired first, so that they take part in the whole tick.
+//--------------------------------------------------------------------------------------------------------------
+void Game::Tick(float timeDelta, const TickInput& input)
+{
+	NT_TRACE_SCOPE_COUNT("tick", m_Suns.Size() + m_Asteroids.Size() + m_Missiles.Size() + m_Ships.Size());
+
+	m_TickInput = input;
+	m_TickTimeDelta = timeDelta;
+	m_CollisionStats.Reset();
+	for (size_t thread = 0; thread < m_IntegratorThreadStats.size(); thread++)
+	{
+		m_IntegratorThreadStats[thread].Reset();
+	}
+
+	if (!input.m_Fires.empty() && m_Ships.Contains(m_LocalShip))
+	{
+		NTPoint shipPosition = m_Ships.GetPosition(m_Ships.IndexOf(m_LocalShip));
+		for (size_t fire = 0; fire < input.m_Fires.size(); fire++)
+		{
+			Missile::Spawn(m_Missiles, shipPosition, NTPoint((float)input.m_Fires[fire].m_X, (float)input.m_Fires[fire].m_Y));
 		}
 	}
 
-	// Launch the player ship
-	m_LocalShip = new Ship();
-	m_Ships.push_back(m_LocalShip);
+	StreamWorld();
 
-	return true;
+	m_TickGraph.Run(m_Jobs);
+
+	m_IntegratorStats.Reset();
+	for (size_t thread = 0; thread < m_IntegratorThreadStats.size(); thread++)
+	{
+		m_IntegratorStats.Add(m_IntegratorThreadStats[thread]);
+	}
+	m_IntegratorTotals.Add(m_IntegratorStats);
+	m_CollisionTotals.Add(m_CollisionStats);
+	m_TickCount++;
 }
 
 //--------------------------------------------------------------------------------------------------------------
-// Draw
-// Draw the game.
+// IntegrateMissiles
+// Move the missiles through the suns' gravity, a chunk at a time.
 //--------------------------------------------------------------------------------------------------------------
-void Game::Draw(HDC hdc, PAINTSTRUCT* ps)
+void Game::IntegrateMissiles()
 {
-	// Make some pens
-	HPEN penBlue = CreatePen(PS_SOLID, 1, RGB(0,0,255));
-	HPEN penGreen = CreatePen(PS_SOLID, 1, RGB(0,255,0));
-	HPEN penRed  = CreatePen(PS_SOLID, 1, RGB(255,0,0));
+	NT_TRACE_SCOPE_COUNT("integrate", m_Missiles.Size());
+	m_Missiles.SavePreviousPositions();
 
-	// Draw suns
-	SelectObject(hdc, penRed);
-	for (std::list<Sun*>::iterator itSun = m_Suns.begin(); itSun != m_Suns.end(); itSun++)
+	m_Jobs.ParallelFor(m_Missiles.Size(), MISSILE_CHUNK_SIZE, [this](size_t begin, size_t end)
 	{
-		(*itSun)->Draw(hdc);
+		{
+			NT_TRACE_SCOPE_COUNT("missile gravity", end - begin);
+			Integrate(m_Missiles, begin, end);
+		}
+		NT_TRACE_SCOPE_COUNT("missile update", end - begin);
+		Missile::Update(m_Missiles, m_TickTimeDelta, begin, end);
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ControlShips
+// Sort the ships by controller and have each controller decide for all of its ships at once. The asteroid
+// tree is brought up to date first, since bots look for asteroids through it.
+//--------------------------------------------------------------------------------------------------------------
+void Game::ControlShips()
+{
+	NT_TRACE_SCOPE_COUNT("control", m_Ships.Size());
+
+	if (m_AsteroidTreeDirty || (float)m_AsteroidTree.GetRemovedCount() > (float)m_AsteroidTree.Size() * MAX_REMOVED_FRACTION)
+	{
+		NT_TRACE_SCOPE_COUNT("asteroid tree", m_Asteroids.Size());
+		m_AsteroidTree.Build(m_Asteroids);
+		m_AsteroidTreeDirty = false;
 	}
 
-	// Draw missiles
-	SelectObject(hdc, penBlue);
-	for (std::list<Missile*>::iterator itMissile = m_Missiles.begin(); itMissile != m_Missiles.end(); itMissile++)
+	for (int controller = 0; controller < CONTROLLER_COUNT; controller++)
+	{
+		m_ControlledShips[controller].clear();
+	}
+	for (size_t index = 0; index < m_Ships.Size(); index++)
 	{
-		(*itMissile)->Draw(hdc);
+		assert(m_Ships.m_Controller[index] < CONTROLLER_COUNT);
+		m_ControlledShips[m_Ships.m_Controller[index]].push_back((unsigned int)index);
 	}
 
-	// Draw ships
-	SelectObject(hdc, penBlue);
-	for (std::list<Ship*>::iterator itShip = m_Ships.begin(); itShip != m_Ships.end(); itShip++)
+	m_ShipCommands.assign(m_Ships.Size(), ShipCommand());
+	for (int controller = 0; controller < CONTROLLER_COUNT; controller++)
 	{
-		(*itShip)->Draw(hdc);
+		if (!m_ControlledShips[controller].empty())
+		{
+			m_Controllers[controller]->Control(*this, m_ControlledShips[controller], m_ShipCommands);
+		}
 	}
+}
 
-	// Draw Asteroids
-	SelectObject(hdc, penBlue);
-	for (std::list<Asteroids*>::iterator itAsteroids = m_Asteroids.begin(); itAsteroids != m_Asteroids.end(); itAsteroids++)
+//--------------------------------------------------------------------------------------------------------------
+// SetController
+//--------------------------------------------------------------------------------------------------------------
+void Game::SetController(ShipControllerId id, ShipController* controller)
+{
+	assert(id >= 0 && id < CONTROLLER_COUNT);
+
+	if (controller == NULL)
 	{
-		(*itAsteroids)->Draw(hdc);
+		switch (id)
+		{
+		case CONTROLLER_PLAYER:
+			controller = &m_PlayerController;
+			break;
+		case CONTROLLER_BOT:
+			controller = &m_BotController;
+			break;
+		default:
+			controller = &m_RemoteController;
+			break;
+		}
 	}
+	m_Controllers[id] = controller;
+}
 
-	// Delete our pens
-	DeleteObject(penRed);
-	DeleteObject(penGreen);
-	DeleteObject(penBlue);
+//--------------------------------------------------------------------------------------------------------------
+// UpdateShips
+// Steer, fire and collide the ships where they are, then move them.
+//--------------------------------------------------------------------------------------------------------------
+void Game::UpdateShips()
+{
+	NT_TRACE_SCOPE_COUNT("ships", m_Ships.Size());
+	m_Ships.SavePreviousPositions();
+	Ship::Update(*this, m_ShipCommands, m_TickTimeDelta);
+	Integrate(m_Ships, 0, m_Ships.Size());
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GatherCandidates
+// The indices of the entities in the tree within radius of the point.
+//--------------------------------------------------------------------------------------------------------------
+static void GatherCandidates(const KdTree& tree, const EntityArray& entities, const NTPoint& point, float radius,
+	std::vector<EntityHandle>& handles, std::vector<unsigned int>& outCandidates)
+{
+	handles.clear();
+	tree.QueryRadius(point.x, point.y, radius, handles);
 
+	outCandidates.clear();
+	for (size_t handle = 0; handle < handles.size(); handle++)
+	{
+		outCandidates.push_back((unsigned int)entities.IndexOf(handles[handle]));
+	}
 }
 
+//--------------------------------------------------------------------------------------------------------------
+// SweepMissile
+// Test a missile's path over the tick against the candidate targets, keeping the earliest hit. Returns true if
+// it found one earlier than outTime, which must start at more than 1.
+//--------------------------------------------------------------------------------------------------------------
+typedef bool (*MissileHitTest)(const EntityArray& targets, size_t index, const NTPoint& missileFrom, const NTPoint& missileTo,
+	float& outTime);
+
+static bool SweepMissile(const EntityArray& targets, MissileHitTest hitTest, const NTPoint& from, const NTPoint& to,
+	std::vector<unsigned int>& candidates, CollisionStats& stats, float& outTime, unsigned int& outTarget)
+{
+	// Ties go to the lowest index, whatever order the broadphase found the candidates in.
+	std::sort(candidates.begin(), candidates.end());
+	stats.m_CandidatePairs += candidates.size();
+
+	bool found = false;
+	for (size_t candidate = 0; candidate < candidates.size(); candidate++)
+	{
+		float time;
+		if (hitTest(targets, candidates[candidate], from, to, time) && time < outTime)
+		{
+			outTime = time;
+			outTarget = candidates[candidate];
+			found = true;
+		}
+	}
+	return found;
+}
 
 //--------------------------------------------------------------------------------------------------------------
-// Update
-// Update the game.
+// CollideMissiles
+// Sweep each missile along the path it took this tick against the asteroids, ships and suns, recording the
+// first thing it hit in its chunk's own results. Everything but the missiles is still where it was at the
+// start of the tick, so only the missiles' movement needs sweeping.
 //--------------------------------------------------------------------------------------------------------------
-void Game::Update(bool& outNeedRedraw)
+void Game::CollideMissiles()
 {
-	// Update the timer before doing anything else.
-	m_Timer.Update();
+	NT_TRACE_SCOPE_COUNT("collide", m_Missiles.Size());
+	{
+		NT_TRACE_SCOPE_COUNT("ship grid", m_Ships.Size());
+		m_ShipGrid.Build(m_Ships, SHIP_GRID_CELL_SIZE);
+	}
 
-	// Update missiles
-	for (std::list<Missile*>::iterator itMissile = m_Missiles.begin(); itMissile != m_Missiles.end(); )
+	size_t chunkCount = (m_Missiles.Size() + MISSILE_CHUNK_SIZE - 1) / MISSILE_CHUNK_SIZE;
+	if (m_CollisionChunks.size() < chunkCount)
 	{
-		(*itMissile)->ApplyTheGravityFromSuns(m_Suns);
-		(*itMissile)->Update();
+		m_CollisionChunks.resize(chunkCount);
+	}
+
+	m_Jobs.ParallelFor(m_Missiles.Size(), MISSILE_CHUNK_SIZE, [this](size_t begin, size_t end)
+	{
+		NT_TRACE_SCOPE_COUNT("collide chunk", end - begin);
+		CollisionChunk& chunk = m_CollisionChunks[begin / MISSILE_CHUNK_SIZE];
+		chunk.m_Hits.clear();
+		chunk.m_Stats.Reset();
+
+		const float asteroidReach = (float)(Asteroids::RADIUS + Missile::RADIUS);
+		const float shipReach = (float)(Ship::RADIUS + Missile::RADIUS);
+		const float sunReach = (float)(Sun::RADIUS + Missile::RADIUS);
 
-		for (std::list<Asteroids*>::iterator itAsteroids = m_Asteroids.begin(); itAsteroids != m_Asteroids.end(); )
+		for (size_t missileIndex = begin; missileIndex < end; missileIndex++)
 		{
-			if ((*itAsteroids)->CanDestory(*itMissile))
+			NTPoint from(m_Missiles.m_PreviousX[missileIndex], m_Missiles.m_PreviousY[missileIndex]);
+			NTPoint to = m_Missiles.GetPosition(missileIndex);
+
+			// Anything the path touches is within half its length, plus the reach, of its middle.
+			NTPoint middle = (from + to) * 0.5f;
+			float halfLength = (to - from).GetLength() * 0.5f;
+
+			MissileHit hit;
+			hit.m_Missile = (unsigned int)missileIndex;
+			float hitTime = 2.f;
+			bool anyHit = false;
+
+			GatherCandidates(m_AsteroidTree, m_Asteroids, middle, halfLength + asteroidReach, chunk.m_Handles, chunk.m_Candidates);
+			if (SweepMissile(m_Asteroids, Asteroids::CanDestory, from, to, chunk.m_Candidates, chunk.m_Stats, hitTime,
+				hit.m_TargetIndex))
+			{
+				hit.m_Target = TARGET_ASTEROID;
+				anyHit = true;
+			}
+
+			chunk.m_Candidates.clear();
+			m_ShipGrid.Query(middle.x, middle.y, halfLength + shipReach, chunk.m_Candidates);
+			if (SweepMissile(m_Ships, Ship::IsHitBy, from, to, chunk.m_Candidates, chunk.m_Stats, hitTime, hit.m_TargetIndex))
 			{
-				itAsteroids = m_Asteroids.erase(itAsteroids);
+				hit.m_Target = TARGET_SHIP;
+				anyHit = true;
 			}
-			else
+
+			// The baked field can rule out every sun at once; otherwise ask the tree.
+			chunk.m_Candidates.clear();
+			if (!m_GravityField.IsClearOfSuns(middle.x, middle.y, halfLength + sunReach))
 			{
-				++itAsteroids;
+				GatherCandidates(m_SunTree, m_Suns, middle, halfLength + sunReach, chunk.m_Handles, chunk.m_Candidates);
+			}
+			if (SweepMissile(m_Suns, Sun::IsHitBy, from, to, chunk.m_Candidates, chunk.m_Stats, hitTime, hit.m_TargetIndex))
+			{
+				hit.m_Target = TARGET_SUN;
+				anyHit = true;
 			}
-		}
 
-		// Remove old missiles
-		if ((*itMissile)->IsOutOfFuel())
-		{
-			itMissile = m_Missiles.erase(itMissile);
+			if (anyHit)
+			{
+				chunk.m_Stats.m_Hits++;
+				chunk.m_Hits.push_back(hit);
+			}
 		}
-		else
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ResolveCollisions
+// Merge the chunks' results in order. Every missile that hit something is spent, every asteroid it hit is
+// destroyed and every ship it hit explodes. Then the spent missiles and those that have run out are removed.
+// Removal is done highest index first, so that the entry swapped into each hole has already been dealt with.
+//--------------------------------------------------------------------------------------------------------------
+void Game::ResolveCollisions()
+{
+	NT_TRACE_SCOPE_COUNT("resolve", m_Missiles.Size());
+	m_AsteroidHit.assign(m_Asteroids.Size(), 0);
+	m_ShipHit.assign(m_Ships.Size(), 0);
+	m_MissileHit.assign(m_Missiles.Size(), 0);
+	bool anyAsteroidHit = false;
+
+	size_t chunkCount = (m_Missiles.Size() + MISSILE_CHUNK_SIZE - 1) / MISSILE_CHUNK_SIZE;
+	for (size_t chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+	{
+		const CollisionChunk& chunk = m_CollisionChunks[chunkIndex];
+		m_CollisionStats.Add(chunk.m_Stats);
+
+		for (size_t hitIndex = 0; hitIndex < chunk.m_Hits.size(); hitIndex++)
 		{
-			++itMissile;
+			const MissileHit& hit = chunk.m_Hits[hitIndex];
+			m_MissileHit[hit.m_Missile] = 1;
+			if (hit.m_Target == TARGET_ASTEROID)
+			{
+				m_AsteroidHit[hit.m_TargetIndex] = 1;
+				anyAsteroidHit = true;
+			}
+			else if (hit.m_Target == TARGET_SHIP)
+			{
+				m_ShipHit[hit.m_TargetIndex] = 1;
+			}
 		}
-
 	}
 
-	// Update player ships
-	for (std::list<Ship*>::iterator itShip = m_Ships.begin(); itShip != m_Ships.end(); itShip++)
+	// The tree only marks destroyed asteroids, and is rebuilt once enough are gone.
+	if (anyAsteroidHit)
 	{
-		(*itShip)->ApplyTheGravityFromSuns(m_Suns);
-		(*itShip)->Update();
+		for (size_t asteroidIndex = m_Asteroids.Size(); asteroidIndex-- > 0; )
+		{
+			if (m_AsteroidHit[asteroidIndex])
+			{
+				m_AsteroidTree.Remove(m_Asteroids.HandleAt(asteroidIndex));
+				m_Asteroids.RemoveAt(asteroidIndex);
+			}
+		}
 	}
 
-	// Check if we need a redraw
-	static float fNextDraw = 0.f;
-	fNextDraw -= m_Timer.GetTimeDelta();
-	if (fNextDraw < 0.f)
+	for (size_t shipIndex = 0; shipIndex < m_Ships.Size(); shipIndex++)
 	{
-		fNextDraw = DRAW_TIME;
-		outNeedRedraw = true;
+		if (m_ShipHit[shipIndex])
+		{
+			Ship::Explode(*this, shipIndex);
+		}
 	}
-	else
+
+	for (size_t missileIndex = m_Missiles.Size(); missileIndex-- > 0; )
 	{
-		outNeedRedraw = false;
+		if (m_MissileHit[missileIndex] || Missile::IsOutOfFuel(m_Missiles, missileIndex))
+		{
+			m_Missiles.RemoveAt(missileIndex);
+		}
 	}
 }
 
 
+
+//--------------------------------------------------------------------------------------------------------------
+// Integrate
+// Move the bodies in [begin, end) through the suns' gravity for the tick, from the baked field if there is
+// one. Safe to call from several threads at once on separate ranges.
+//--------------------------------------------------------------------------------------------------------------
+void Game::Integrate(EntityArray& bodies, size_t begin, size_t end)
+{
+	unsigned int threadIndex = m_Jobs.GetThreadIndex();
+	SunGravity gravity(m_Suns, m_Settings.m_SunGravity, m_GravityField, m_GravityScratch[threadIndex]);
+	IntegrateBodies(bodies, begin, end, m_TickTimeDelta, gravity, m_Settings.m_Integrator, m_IntegratorScratch[threadIndex],
+		m_IntegratorThreadStats[threadIndex]);
+}
+
 //--------------------------------------------------------------------------------------------------------------
 // Fire
 // Fire weapons
 //--------------------------------------------------------------------------------------------------------------
 void Game::Fire(int x, int y)
 {
-	m_Missiles.push_back(new Missile(m_LocalShip->GetPosition(), NTPoint((float)x, (float)y)));
+	FireCommand fire;
+	fire.m_X = x;
+	fire.m_Y = y;
+	m_PolledInput.m_Fires.push_back(fire);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SaveState
+//--------------------------------------------------------------------------------------------------------------
+void Game::SaveState(StateWriter& writer, size_t* outSectionEnds) const
+{
+	size_t sectionEnds[GAME_STATE_SECTION_COUNT];
+
+	writer.WriteValue(m_TickCount);
+	writer.WriteValue(m_LocalShip.m_Slot);
+	writer.WriteValue(m_LocalShip.m_Generation);
+	writer.WriteValue(m_CollisionTotals.m_CandidatePairs);
+	writer.WriteValue(m_CollisionTotals.m_Hits);
+	writer.WriteValue(m_IntegratorTotals.m_Bodies);
+	writer.WriteValue(m_IntegratorTotals.m_Substeps);
+	writer.WriteValue(m_IntegratorTotals.m_RefinedBodies);
+	writer.WriteValue(m_IntegratorTotals.m_MostSubsteps);
+	sectionEnds[GAME_STATE_COUNTERS] = writer.GetSize();
+
+	m_Suns.SaveState(writer);
+	sectionEnds[GAME_STATE_SUNS] = writer.GetSize();
+	m_Asteroids.SaveState(writer);
+	sectionEnds[GAME_STATE_ASTEROIDS] = writer.GetSize();
+	m_Missiles.SaveState(writer);
+	sectionEnds[GAME_STATE_MISSILES] = writer.GetSize();
+	m_Ships.SaveState(writer);
+	sectionEnds[GAME_STATE_SHIPS] = writer.GetSize();
+
+	if (m_Settings.m_StreamWorld)
+	{
+		m_World.SaveState(writer);
+	}
+	sectionEnds[GAME_STATE_WORLD] = writer.GetSize();
+
+	if (outSectionEnds != NULL)
+	{
+		memcpy(outSectionEnds, sectionEnds, sizeof(sectionEnds));
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// LoadState
+// The trees are rebuilt from the loaded entities, and the game carries on from the start of the saved tick.
+//--------------------------------------------------------------------------------------------------------------
+bool Game::LoadState(StateReader& reader)
+{
+	reader.ReadValue(m_TickCount);
+	reader.ReadValue(m_LocalShip.m_Slot);
+	reader.ReadValue(m_LocalShip.m_Generation);
+	reader.ReadValue(m_CollisionTotals.m_CandidatePairs);
+	reader.ReadValue(m_CollisionTotals.m_Hits);
+	reader.ReadValue(m_IntegratorTotals.m_Bodies);
+	reader.ReadValue(m_IntegratorTotals.m_Substeps);
+	reader.ReadValue(m_IntegratorTotals.m_RefinedBodies);
+	reader.ReadValue(m_IntegratorTotals.m_MostSubsteps);
+
+	if (reader.HasFailed() || !m_Suns.LoadState(reader) || !m_Asteroids.LoadState(reader)
+		|| !m_Missiles.LoadState(reader) || !m_Ships.LoadState(reader)
+		|| (m_Settings.m_StreamWorld && !m_World.LoadState(reader)))
+	{
+		return false;
+	}
+
+	for (size_t index = 0; index < m_Ships.Size(); index++)
+	{
+		if (m_Ships.m_Controller[index] >= CONTROLLER_COUNT)
+		{
+			return false;
+		}
+	}
+
+	m_SunTree.Build(m_Suns);
+	m_AsteroidTreeDirty = true;
+
+	m_TickAccumulator = 0.;
+	m_Interpolation = 0.f;
+	m_PolledInput.m_Fires.clear();
+	return true;
 }
@@ -13,23 +13,164 @@
 //-------------------------------------------------------------------------------------------------------------
 // Includes
 //-------------------------------------------------------------------------------------------------------------
-#include <list>
+#include <stdlib.h>
+#include "controller.h"
+#include "entitystore.h"
+#include "gravityfield.h"
+#include "integrator.h"
+#include "jobsystem.h"
+#include "kdtree.h"
+#include "objects.h"
+#include "poissondisk.h"
+#include "random.h"
+#include "renderbackend.h"
+#include "rendercommands.h"
+#include "rendersnapshot.h"
+#include "spatialgrid.h"
+#include "statestream.h"
 #include "timer.h"
+#include "worldstream.h"
 
-// Externally defined classes.
-class Sun;
-class Missile;
-class Ship;
-class Asteroids;
-
-//--------------------------------------------------------------------------------------------------------------
-// Random
-// Generate a random number in a specified range.
-//--------------------------------------------------------------------------------------------------------------
-static int RandomRange(int min, int max)
+class InputRecorder;
+
+//-------------------------------------------------------------------------------------------------------------
+// GameKey
+// The keys polled for the local ship. The platform layer maps these onto its own key codes.
+//-------------------------------------------------------------------------------------------------------------
+enum GameKey
+{
+	KEY_LEFT,
+	KEY_RIGHT,
+	KEY_UP,
+	KEY_DOWN,
+	KEY_FIRE,
+
+	KEY_COUNT
+};
+
+typedef bool (*KeyStateFunction)(GameKey key);
+
+//-------------------------------------------------------------------------------------------------------------
+// FireCommand
+// A click on the playing field, firing the local ship's weapon at that point.
+//-------------------------------------------------------------------------------------------------------------
+struct FireCommand
+{
+	int	m_X;
+	int	m_Y;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// TickInput
+// Everything from outside the simulation that a tick acts on. Given the same starting state and the same
+// input, a tick always produces the same result, which is what lets a session be recorded and replayed.
+//-------------------------------------------------------------------------------------------------------------
+struct TickInput
+{
+	TickInput() : m_Keys(0) {}
+
+	bool IsKeyDown(GameKey key) const { return (m_Keys & (1u << key)) != 0; }
+
+	// One bit per GameKey.
+	unsigned int				m_Keys;
+	std::vector<FireCommand>	m_Fires;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// GameSettings
+// Options for how the simulation runs. Set before calling Initialise.
+//-------------------------------------------------------------------------------------------------------------
+struct GameSettings
+{
+	GameSettings()
+	: m_SunGravity((float)Sun::GRAVITY)
+	, m_UseGravityField(false)
+	, m_MissileCapacity(256)
+	, m_TickRate(60.f)
+	, m_MaxTicksPerUpdate(5)
+	, m_ThreadCount(0)
+	, m_SunCount(0)
+	, m_AsteroidCount(0)
+	, m_StreamWorld(false)
+	, m_BotCount(0)
+	{
+	}
+
+	// How hard the suns pull: the acceleration a body feels at unit distance from a sun, falling off with the
+	// distance.
+	float					m_SunGravity;
+
+	// How bodies are stepped through the suns' gravity.
+	IntegratorSettings		m_Integrator;
+
+	// Bake the sun gravity into a grid at startup and sample it, rather than summing over every sun. Only for
+	// the fixed field; a streamed world's suns come and go.
+	bool					m_UseGravityField;
+	GravityFieldSettings	m_GravityField;
+
+	// Missiles reserved up front, so that firing doesn't allocate until more than this many are in flight.
+	size_t					m_MissileCapacity;
+
+	// The simulation always advances in ticks of 1 / m_TickRate seconds, however often Update is called. If
+	// Update falls so far behind that it would need more than m_MaxTicksPerUpdate ticks, the excess is dropped
+	// and the game runs slow rather than spending ever longer catching up.
+	float					m_TickRate;
+	int						m_MaxTicksPerUpdate;
+
+	// Threads to run each tick across, counting the one calling Update. 0 uses one per hardware thread. The
+	// results of a tick are the same whatever this is set to.
+	unsigned int			m_ThreadCount;
+
+	// How many suns and asteroids to place, or 0 for a random number each. Objects are kept a minimum
+	// distance apart, so fewer are placed if the field can't hold the number asked for.
+	size_t					m_SunCount;
+	size_t					m_AsteroidCount;
+
+	// Play on an unbounded field generated a chunk at a time around the ships, instead of the fixed field.
+	// The counts above apply only to the fixed field.
+	bool					m_StreamWorld;
+	WorldStreamSettings		m_WorldStream;
+
+	// Ships flown by BotController, placed at random alongside the local ship.
+	size_t					m_BotCount;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// WorldStats
+// How many objects Initialise was asked to place on the fixed field, and how many fitted.
+//-------------------------------------------------------------------------------------------------------------
+struct WorldStats
 {
-	return (int)(((double)rand() / RAND_MAX) * (max - min) + min);
-}
+	WorldStats()
+	: m_SunsRequested(0)
+	, m_SunsPlaced(0)
+	, m_AsteroidsRequested(0)
+	, m_AsteroidsPlaced(0)
+	{
+	}
+
+	size_t	m_SunsRequested;
+	size_t	m_SunsPlaced;
+	size_t	m_AsteroidsRequested;
+	size_t	m_AsteroidsPlaced;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// GameStateSection
+// The parts of the saved state, in the order they are saved. Streamed worlds add the chunks; the fixed field
+// saves nothing for them.
+//-------------------------------------------------------------------------------------------------------------
+enum GameStateSection
+{
+	GAME_STATE_COUNTERS,
+	GAME_STATE_SUNS,
+	GAME_STATE_ASTEROIDS,
+	GAME_STATE_MISSILES,
+	GAME_STATE_SHIPS,
+	GAME_STATE_WORLD,
+
+	GAME_STATE_SECTION_COUNT
+};
 
 //-------------------------------------------------------------------------------------------------------------
 // Game
@@ -38,23 +179,179 @@ static int RandomRange(int min, int max)
 class Game
 {
 public:
+	Game();
+
 	bool Initialise();
+	bool Initialise(unsigned int seed);
 	void Update(bool& outNeedRedraw);
+
+	// Advance by one tick, with the keys as they are now and the fires queued since the last tick.
+	void Tick(float timeDelta);
+
+	// Advance by one tick with the given input, as when replaying a recording.
+	void Tick(float timeDelta, const TickInput& input);
+#ifdef _WIN32
 	void Draw(HDC hdc, PAINTSTRUCT* ps);
+#endif
+	void Draw(RenderBackend& backend);
+
+	// Record the current frame's drawing, sorted and ready to submit.
+	void BuildRenderCommands(RenderCommandBuffer& commands);
 
+	// Copy what drawing needs from the current state, to draw later or on another thread.
+	void CaptureSnapshot(RenderSnapshot& snapshot) const;
+
+	// Queue a shot for the next tick.
 	void Fire(int x, int y);
 
-	~Game();
+	EntityHandle GetLocalShip() const { return m_LocalShip; }
+	unsigned int GetSeed() const { return m_Seed; }
+	const WorldStats& GetWorldStats() const { return m_WorldStats; }
+	const WorldStreamStats& GetWorldStreamStats() const { return m_World.GetStats(); }
+
+	// Rounded the same way as the step Update ticks with, so that replayed ticks match recorded ones exactly.
+	float GetTickDelta() const { return (float)(1. / m_Settings.m_TickRate); }
+	unsigned long long GetTickCount() const { return m_TickCount; }
+	double GetDroppedTime() const { return m_DroppedTime; }
+
+	// How long, in seconds, until Update will next have a tick to run or a redraw to ask for. A main loop
+	// can sleep this long without falling behind.
+	double GetTimeUntilUpdate() const;
+
+	// How far between the last two ticks the current frame is, from 0 to 1. Drawing blends the previous and
+	// current positions by this, so motion stays smooth when frames and ticks don't line up.
+	float GetInterpolation() const { return m_Interpolation; }
+
+	// Input is polled through this function; with none set every key reads as released.
+	void SetKeyStateFunction(KeyStateFunction keyState) { m_KeyState = keyState; }
+
+	// The input for the tick being run.
+	const TickInput& GetTickInput() const { return m_TickInput; }
+
+	// Replace the controller that drives every ship set to id, for the ticks that follow. The game keeps
+	// only the pointer. Passing NULL puts the game's own controller back.
+	void SetController(ShipControllerId id, ShipController* controller);
+
+	// What each ship, by index, was told to do this tick.
+	const std::vector<ShipCommand>& GetShipCommands() const { return m_ShipCommands; }
+
+	// Every tick run through Tick(timeDelta) is passed to the recorder, if there is one, before it runs.
+	void SetInputRecorder(InputRecorder* recorder) { m_Recorder = recorder; }
+
+	// Everything that changes from tick to tick. Settings, and what Initialise derives from the suns, aren't
+	// saved, so state must be loaded into a game initialised with the same seed and settings. LoadState returns
+	// false if the state is malformed, in which case the game must be initialised again before use.
+	//
+	// If outSectionEnds is given, it receives the writer's size after each GameStateSection, so that two saves
+	// can be compared a section at a time.
+	void SaveState(StateWriter& writer, size_t* outSectionEnds = NULL) const;
+	bool LoadState(StateReader& reader);
 
 public:
+	GameSettings		m_Settings;
 	Timer				m_Timer;
-	std::list<Missile*> m_Missiles;
-	std::list<Sun*>     m_Suns;
-	std::list<Ship*>    m_Ships;
-	std::list<Asteroids*>     m_Asteroids;
+	EntityArray			m_Missiles;
+	EntityArray			m_Suns;
+	ShipArray			m_Ships;
+	EntityArray			m_Asteroids;
+	GravityField		m_GravityField;
+
+	// Broadphase. The suns and asteroids don't move, so they are kept in trees, built when they come or go;
+	// the ships are gridded afresh every tick.
+	KdTree				m_SunTree;
+	KdTree				m_AsteroidTree;
+	SpatialGrid			m_ShipGrid;
+
+	// Collision tests made and hits found, over the last tick and since startup.
+	CollisionStats		m_CollisionStats;
+	CollisionStats		m_CollisionTotals;
+
+	// Integration steps taken over the last tick and since startup.
+	IntegratorStats		m_IntegratorStats;
+	IntegratorStats		m_IntegratorTotals;
+
+	JobSystem			m_Jobs;
 
 protected:
-	Ship*				m_LocalShip;
+	enum MissileTarget
+	{
+		TARGET_ASTEROID,
+		TARGET_SHIP,
+		TARGET_SUN
+	};
+
+	// The first thing a missile hit during the tick.
+	struct MissileHit
+	{
+		unsigned int	m_Missile;
+		MissileTarget	m_Target;
+		unsigned int	m_TargetIndex;
+	};
+
+	// The missile results for one chunk of missiles, kept apart so that chunks can be tested in parallel and
+	// merged in order.
+	struct CollisionChunk
+	{
+		std::vector<unsigned int>	m_Candidates;
+		std::vector<EntityHandle>	m_Handles;
+		std::vector<MissileHit>		m_Hits;
+		CollisionStats				m_Stats;
+	};
+
+	void BuildTickGraph();
+	void PlaceFixedWorld(unsigned int seed);
+	void StreamWorld();
+	void ControlShips();
+	void Integrate(EntityArray& bodies, size_t begin, size_t end);
+	void IntegrateMissiles();
+	void CollideMissiles();
+	void ResolveCollisions();
+	void UpdateShips();
+
+	EntityHandle		m_LocalShip;
+	KeyStateFunction	m_KeyState;
+	bool				m_AsteroidTreeDirty;
+	unsigned int		m_Seed;
+	WorldStats			m_WorldStats;
+	PoissonDiskSampler	m_PlacementSampler;
+	WorldStreamer		m_World;
+
+	// Input for the tick being run, and the shots queued for the next one.
+	TickInput			m_TickInput;
+	TickInput			m_PolledInput;
+	InputRecorder*		m_Recorder;
+
+	// The controllers, the ships each one drives this tick, and the commands they gave.
+	PlayerController			m_PlayerController;
+	BotController				m_BotController;
+	RemoteController			m_RemoteController;
+	ShipController*				m_Controllers[CONTROLLER_COUNT];
+	std::vector<unsigned int>	m_ControlledShips[CONTROLLER_COUNT];
+	std::vector<ShipCommand>	m_ShipCommands;
+
+	double				m_TickAccumulator;
+	double				m_DroppedTime;
+	unsigned long long	m_TickCount;
+	float				m_Interpolation;
+	float				m_TimeUntilDraw;
+
+	// The phases of a tick, and the time step they are running with.
+	PhaseGraph			m_TickGraph;
+	float				m_TickTimeDelta;
+
+	std::vector<GravityFieldScratch>	m_GravityScratch;
+	std::vector<IntegratorScratch>		m_IntegratorScratch;
+	std::vector<IntegratorStats>		m_IntegratorThreadStats;
+	std::vector<CollisionChunk>			m_CollisionChunks;
+	std::vector<unsigned char>			m_AsteroidHit;
+	std::vector<unsigned char>			m_ShipHit;
+	std::vector<unsigned char>			m_MissileHit;
+
+	RenderSnapshot		m_RenderSnapshot;
+	RenderCommandBuffer	m_RenderCommands;
+#ifdef _WIN32
+	GdiRenderBackend	m_GdiBackend;
+#endif
 };
 
 extern Game g_Game;
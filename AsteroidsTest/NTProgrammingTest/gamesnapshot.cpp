@@ -0,0 +1,183 @@
+//-------------------------------------------------------------------------------------------------------------
+// gamesnapshot.cpp
+//
+// Implementation of the whole-game snapshot.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "gamesnapshot.h"
+#include "trace.h"
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------
+// Constants
+//-------------------------------------------------------------------------------------------------------------
+
+// Odd constants with well spread bits, from xxHash, whose round the hash below uses.
+static const unsigned long long HASH_PRIME_1 = 0x9e3779b185ebca87ull;
+static const unsigned long long HASH_PRIME_2 = 0xc2b2ae3d27d4eb4full;
+static const unsigned long long HASH_PRIME_3 = 0x165667b19e3779f9ull;
+
+// Words hashed side by side, so that each multiply doesn't have to wait for the one before.
+static const size_t HASH_LANES = 4;
+
+static const char* SECTION_NAMES[GAME_STATE_SECTION_COUNT] =
+{
+	"counters",
+	"suns",
+	"asteroids",
+	"missiles",
+	"ships",
+	"world"
+};
+
+//--------------------------------------------------------------------------------------------------------------
+// RotateLeft
+//--------------------------------------------------------------------------------------------------------------
+static unsigned long long RotateLeft(unsigned long long value, int shift)
+{
+	return (value << shift) | (value >> (64 - shift));
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// HashRound
+//--------------------------------------------------------------------------------------------------------------
+static unsigned long long HashRound(unsigned long long hash, unsigned long long word)
+{
+	return RotateLeft(hash + word * HASH_PRIME_2, 31) * HASH_PRIME_1;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// HashState
+// Eight bytes at a time across the lanes, then what is left over, then the lanes folded together and mixed so
+// that every bit of the result depends on every byte. The state is tens of kilobytes at most, and this gets
+// through it at memory speed; hashing a byte at a time would take several times as long as copying it.
+//--------------------------------------------------------------------------------------------------------------
+static unsigned long long HashState(const unsigned char* data, size_t size)
+{
+	unsigned long long lanes[HASH_LANES] = { HASH_PRIME_1, HASH_PRIME_2, HASH_PRIME_3, 0 };
+
+	const size_t blockSize = HASH_LANES * sizeof(unsigned long long);
+	size_t offset = 0;
+	for (; offset + blockSize <= size; offset += blockSize)
+	{
+		unsigned long long words[HASH_LANES];
+		memcpy(words, data + offset, blockSize);
+		for (size_t lane = 0; lane < HASH_LANES; lane++)
+		{
+			lanes[lane] = HashRound(lanes[lane], words[lane]);
+		}
+	}
+
+	unsigned long long hash = (unsigned long long)size * HASH_PRIME_3;
+	for (size_t lane = 0; lane < HASH_LANES; lane++)
+	{
+		hash = HashRound(hash, lanes[lane]);
+	}
+	for (; offset + sizeof(unsigned long long) <= size; offset += sizeof(unsigned long long))
+	{
+		unsigned long long word;
+		memcpy(&word, data + offset, sizeof(word));
+		hash = HashRound(hash, word);
+	}
+	for (; offset < size; offset++)
+	{
+		hash = HashRound(hash, data[offset]);
+	}
+
+	hash ^= hash >> 33;
+	hash *= HASH_PRIME_2;
+	hash ^= hash >> 29;
+	hash *= HASH_PRIME_3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GameSnapshot
+//--------------------------------------------------------------------------------------------------------------
+GameSnapshot::GameSnapshot()
+: m_Tick(0)
+, m_Hash(0)
+{
+	Clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Capture
+//--------------------------------------------------------------------------------------------------------------
+void GameSnapshot::Capture(const Game& game)
+{
+	NT_TRACE_SCOPE("state capture");
+
+	m_Data.clear();
+	StateWriter writer(m_Data);
+	game.SaveState(writer, m_SectionEnds);
+
+	m_Tick = game.GetTickCount();
+	m_Hash = HashState(&m_Data[0], m_Data.size());
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Restore
+//--------------------------------------------------------------------------------------------------------------
+bool GameSnapshot::Restore(Game& game) const
+{
+	if (m_Data.empty())
+	{
+		return false;
+	}
+
+	NT_TRACE_SCOPE_COUNT("state restore", m_Data.size());
+	StateReader reader(&m_Data[0], m_Data.size());
+	return game.LoadState(reader) && reader.IsAtEnd();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+//--------------------------------------------------------------------------------------------------------------
+void GameSnapshot::Clear()
+{
+	m_Data.clear();
+	for (size_t section = 0; section < GAME_STATE_SECTION_COUNT; section++)
+	{
+		m_SectionEnds[section] = 0;
+	}
+	m_Tick = 0;
+	m_Hash = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FindDifference
+// A section that has changed size differs, whatever its bytes; otherwise the bytes are compared.
+//--------------------------------------------------------------------------------------------------------------
+GameStateSection GameSnapshot::FindDifference(const GameSnapshot& other) const
+{
+	assert(!IsEmpty() && !other.IsEmpty());
+
+	size_t begin = 0;
+	size_t otherBegin = 0;
+	for (int section = 0; section < GAME_STATE_SECTION_COUNT; section++)
+	{
+		size_t size = m_SectionEnds[section] - begin;
+		size_t otherSize = other.m_SectionEnds[section] - otherBegin;
+		if (size != otherSize || memcmp(&m_Data[0] + begin, &other.m_Data[0] + otherBegin, size) != 0)
+		{
+			return (GameStateSection)section;
+		}
+		begin = m_SectionEnds[section];
+		otherBegin = other.m_SectionEnds[section];
+	}
+	return GAME_STATE_SECTION_COUNT;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetSectionName
+//--------------------------------------------------------------------------------------------------------------
+const char* GameSnapshot::GetSectionName(GameStateSection section)
+{
+	return section < GAME_STATE_SECTION_COUNT ? SECTION_NAMES[section] : "none";
+}
@@ -0,0 +1,62 @@
+//-------------------------------------------------------------------------------------------------------------
+// gamesnapshot.h
+//
+// The whole game state held in one flat buffer, for rolling the game back and for trying out what-ifs: capture
+// it, run on, and restore it to carry on from where it was.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "game.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// GameSnapshot
+// What Game::SaveState writes, with the tick it was taken at and a hash of it. The buffer is reused from one
+// capture to the next, and restoring reads straight into the game's entity arrays, which keep their storage;
+// once both have grown to fit, neither allocates. Streamed worlds are the exception, as their chunks are
+// rebuilt on restore.
+//
+// Nothing random needs saving: every random choice the game makes comes from a stream seeded by the game's
+// seed and what is being chosen, not from a generator that moves on as it is used.
+//-------------------------------------------------------------------------------------------------------------
+class GameSnapshot
+{
+public:
+	GameSnapshot();
+
+	void Capture(const Game& game);
+
+	// Put the game back as it was at the start of the captured tick. The game must have been initialised with
+	// the same seed and settings as the one captured. Returns false if nothing has been captured, or if the
+	// game couldn't take the state, in which case it must be initialised again before use.
+	bool Restore(Game& game) const;
+
+	// Forget the contents, keeping the storage.
+	void Clear();
+
+	bool IsEmpty() const { return m_Data.empty(); }
+	unsigned long long GetTick() const { return m_Tick; }
+	size_t GetSize() const { return m_Data.size(); }
+
+	// A hash of the whole state, made on capture. Equal states always have equal hashes, so runs that have
+	// drifted apart can be caught by comparing hashes, without keeping either state.
+	unsigned long long GetHash() const { return m_Hash; }
+
+	// The first section whose contents differ between the two, or GAME_STATE_SECTION_COUNT if they are the
+	// same. Both must have been captured.
+	GameStateSection FindDifference(const GameSnapshot& other) const;
+
+	static const char* GetSectionName(GameStateSection section);
+
+private:
+	std::vector<unsigned char>	m_Data;
+	size_t						m_SectionEnds[GAME_STATE_SECTION_COUNT];
+	unsigned long long			m_Tick;
+	unsigned long long			m_Hash;
+};
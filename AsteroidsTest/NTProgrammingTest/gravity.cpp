@@ -0,0 +1,206 @@
+//-------------------------------------------------------------------------------------------------------------
+// gravity.cpp
+//
+// Kernel selection and the scalar paths of the batched sun gravity.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "gravity.h"
+#include "objects.h"
+
+#if defined(NT_GRAVITY_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+//--------------------------------------------------------------------------------------------------------------
+// CPU features
+// Query which instruction sets the CPU, and the OS, can run.
+//--------------------------------------------------------------------------------------------------------------
+#if defined(NT_GRAVITY_X86) && defined(_MSC_VER)
+static bool CpuSupports(GravityKernel kernel)
+{
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+
+	// The OS must save the AVX (and for AVX-512, the opmask and upper ZMM) register state.
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	bool osAvx = (xcr0 & 0x6) == 0x6;
+	bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+
+	bool avx2 = false;
+	bool avx512 = false;
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+		avx512 = (info[1] & (1 << 16)) != 0;
+	}
+
+	switch (kernel)
+	{
+	case GRAVITY_KERNEL_SSE2:	return sse2;
+	case GRAVITY_KERNEL_AVX2:	return avx2 && osAvx;
+	case GRAVITY_KERNEL_AVX512:	return avx512 && osAvx512;
+	default:					return false;
+	}
+}
+#elif defined(NT_GRAVITY_X86)
+static bool CpuSupports(GravityKernel kernel)
+{
+	__builtin_cpu_init();
+
+	switch (kernel)
+	{
+	case GRAVITY_KERNEL_SSE2:	return __builtin_cpu_supports("sse2");
+	case GRAVITY_KERNEL_AVX2:	return __builtin_cpu_supports("avx2");
+	case GRAVITY_KERNEL_AVX512:	return __builtin_cpu_supports("avx512f");
+	default:					return false;
+	}
+}
+#else
+static bool CpuSupports(GravityKernel kernel)
+{
+	return false;
+}
+#endif
+
+//--------------------------------------------------------------------------------------------------------------
+// IsGravityKernelSupported
+//--------------------------------------------------------------------------------------------------------------
+bool IsGravityKernelSupported(GravityKernel kernel)
+{
+	return kernel == GRAVITY_KERNEL_SCALAR || CpuSupports(kernel);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FindBestGravityKernel
+// The widest supported kernel.
+//--------------------------------------------------------------------------------------------------------------
+static GravityKernel FindBestGravityKernel()
+{
+	for (int kernel = GRAVITY_KERNEL_COUNT - 1; kernel > GRAVITY_KERNEL_SCALAR; kernel--)
+	{
+		if (IsGravityKernelSupported((GravityKernel)kernel))
+		{
+			return (GravityKernel)kernel;
+		}
+	}
+	return GRAVITY_KERNEL_SCALAR;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetBestGravityKernel
+// As above, worked out once on first use.
+//--------------------------------------------------------------------------------------------------------------
+GravityKernel GetBestGravityKernel()
+{
+	static const GravityKernel s_BestKernel = FindBestGravityKernel();
+	return s_BestKernel;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetGravityKernelName
+//--------------------------------------------------------------------------------------------------------------
+const char* GetGravityKernelName(GravityKernel kernel)
+{
+	static const char* s_Names[GRAVITY_KERNEL_COUNT] = { "scalar", "sse2", "avx2", "avx512" };
+
+	return kernel < GRAVITY_KERNEL_COUNT ? s_Names[kernel] : "unknown";
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateSunGravity
+// Run the batch with the best kernel this CPU supports.
+//--------------------------------------------------------------------------------------------------------------
+void AccumulateSunGravity(const SunGravityBatch& batch)
+{
+	AccumulateSunGravity(GetBestGravityKernel(), batch);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateSunGravity
+// Run the batch with a particular kernel.
+//--------------------------------------------------------------------------------------------------------------
+void AccumulateSunGravity(GravityKernel kernel, const SunGravityBatch& batch)
+{
+	assert(IsGravityKernelSupported(kernel));
+
+	switch (kernel)
+	{
+#ifdef NT_GRAVITY_X86
+	case GRAVITY_KERNEL_SSE2:
+		AccumulateSunGravitySSE2(batch);
+		break;
+	case GRAVITY_KERNEL_AVX2:
+		AccumulateSunGravityAVX2(batch);
+		break;
+	case GRAVITY_KERNEL_AVX512:
+		AccumulateSunGravityAVX512(batch);
+		break;
+#endif
+	default:
+		AccumulateSunGravityScalar(batch, 0);
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateSunGravityScalar
+// One body at a time, with the same arithmetic as the vector kernels: gravity * d / |d|^2 needs no square
+// root, where normalising d and then dividing by its length needs two. Every kernel does these operations in
+// this order, with no fused multiply-adds, so that each gives bit for bit the same sums and the game plays
+// out the same whichever kernel the CPU picks.
+//--------------------------------------------------------------------------------------------------------------
+void AccumulateSunGravityScalar(const SunGravityBatch& batch, size_t firstBody)
+{
+	for (size_t bodyIndex = firstBody; bodyIndex < batch.m_BodyCount; bodyIndex++)
+	{
+		float bodyX = batch.m_BodyX[bodyIndex];
+		float bodyY = batch.m_BodyY[bodyIndex];
+		float sumX = 0.f;
+		float sumY = 0.f;
+
+		for (size_t sunIndex = 0; sunIndex < batch.m_SunCount; sunIndex++)
+		{
+			float dx = batch.m_SunX[sunIndex] - bodyX;
+			float dy = batch.m_SunY[sunIndex] - bodyY;
+			float scale = batch.m_Gravity / (dx * dx + dy * dy);
+			sumX += dx * scale;
+			sumY += dy * scale;
+		}
+
+		batch.m_OutX[bodyIndex] += sumX;
+		batch.m_OutY[bodyIndex] += sumY;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateSunGravityReference
+// The original per-sun calculation, kept as the yardstick for the kernels.
+//--------------------------------------------------------------------------------------------------------------
+void AccumulateSunGravityReference(const SunGravityBatch& batch)
+{
+	for (size_t bodyIndex = 0; bodyIndex < batch.m_BodyCount; bodyIndex++)
+	{
+		NTPoint position(batch.m_BodyX[bodyIndex], batch.m_BodyY[bodyIndex]);
+		NTPoint resultGravity(0.f, 0.f);
+
+		for (size_t sunIndex = 0; sunIndex < batch.m_SunCount; sunIndex++)
+		{
+			NTPoint sunPosition(batch.m_SunX[sunIndex], batch.m_SunY[sunIndex]);
+			resultGravity = resultGravity + Sun::GetGravityOfOutsidePoint(sunPosition, position, batch.m_Gravity);
+		}
+
+		batch.m_OutX[bodyIndex] += resultGravity.x;
+		batch.m_OutY[bodyIndex] += resultGravity.y;
+	}
+}
@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------------------------------------------
+// gravity.h
+//
+// Batched sun gravity. Sums the pull of every sun on a whole array of bodies at once, using the widest
+// vector instructions the CPU supports. Every kernel gives exactly the same results as the scalar one.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+
+// The vector kernels are only built for x86; everywhere else the scalar kernel is used.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define NT_GRAVITY_X86 1
+#endif
+
+//-------------------------------------------------------------------------------------------------------------
+// GravityKernel
+// The implementations of the batched gravity sum, narrowest first.
+//-------------------------------------------------------------------------------------------------------------
+enum GravityKernel
+{
+	GRAVITY_KERNEL_SCALAR,
+	GRAVITY_KERNEL_SSE2,
+	GRAVITY_KERNEL_AVX2,
+	GRAVITY_KERNEL_AVX512,
+
+	GRAVITY_KERNEL_COUNT
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// SunGravityBatch
+// The inputs to one gravity sum. The kernel adds the summed pull of all suns on body i, gravity * d / |d|^2
+// where d points from the body to the sun, onto outX[i] and outY[i]. Passing a velocity array as the output
+// applies the gravity directly.
+//-------------------------------------------------------------------------------------------------------------
+struct SunGravityBatch
+{
+	const float*	m_BodyX;
+	const float*	m_BodyY;
+	size_t			m_BodyCount;
+	const float*	m_SunX;
+	const float*	m_SunY;
+	size_t			m_SunCount;
+	float			m_Gravity;
+	float*			m_OutX;
+	float*			m_OutY;
+};
+
+// Run the batch with the best kernel this CPU supports.
+void AccumulateSunGravity(const SunGravityBatch& batch);
+
+// Run the batch with a particular kernel, which must be supported.
+void AccumulateSunGravity(GravityKernel kernel, const SunGravityBatch& batch);
+
+// The reference implementation, one sun at a time through Sun::GetGravityOfOutsidePoint.
+void AccumulateSunGravityReference(const SunGravityBatch& batch);
+
+bool IsGravityKernelSupported(GravityKernel kernel);
+GravityKernel GetBestGravityKernel();
+const char* GetGravityKernelName(GravityKernel kernel);
+
+// Per-instruction-set entry points. Each vector kernel lives in its own translation unit so that it can be
+// compiled with the matching target flags. The scalar kernel starts at firstBody so that the vector kernels
+// can hand it the bodies left over after their last full vector.
+void AccumulateSunGravityScalar(const SunGravityBatch& batch, size_t firstBody);
+void AccumulateSunGravitySSE2(const SunGravityBatch& batch);
+void AccumulateSunGravityAVX2(const SunGravityBatch& batch);
+void AccumulateSunGravityAVX512(const SunGravityBatch& batch);
@@ -0,0 +1,50 @@
+//-------------------------------------------------------------------------------------------------------------
+// gravity_avx2.cpp
+//
+// The AVX2 batched sun gravity kernel, eight bodies at a time. Needs AVX2; compiled with the matching target
+// flags and only called once the CPU has been checked for it.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "gravity.h"
+
+#ifdef NT_GRAVITY_X86
+
+#include <immintrin.h>
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateSunGravityAVX2
+//--------------------------------------------------------------------------------------------------------------
+void AccumulateSunGravityAVX2(const SunGravityBatch& batch)
+{
+	const __m256 gravity = _mm256_set1_ps(batch.m_Gravity);
+
+	size_t bodyIndex = 0;
+	for (; bodyIndex + 8 <= batch.m_BodyCount; bodyIndex += 8)
+	{
+		__m256 bodyX = _mm256_loadu_ps(batch.m_BodyX + bodyIndex);
+		__m256 bodyY = _mm256_loadu_ps(batch.m_BodyY + bodyIndex);
+		__m256 sumX = _mm256_setzero_ps();
+		__m256 sumY = _mm256_setzero_ps();
+
+		for (size_t sunIndex = 0; sunIndex < batch.m_SunCount; sunIndex++)
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_set1_ps(batch.m_SunX[sunIndex]), bodyX);
+			__m256 dy = _mm256_sub_ps(_mm256_set1_ps(batch.m_SunY[sunIndex]), bodyY);
+			__m256 distanceSquared = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+			__m256 scale = _mm256_div_ps(gravity, distanceSquared);
+			sumX = _mm256_add_ps(sumX, _mm256_mul_ps(dx, scale));
+			sumY = _mm256_add_ps(sumY, _mm256_mul_ps(dy, scale));
+		}
+
+		_mm256_storeu_ps(batch.m_OutX + bodyIndex, _mm256_add_ps(_mm256_loadu_ps(batch.m_OutX + bodyIndex), sumX));
+		_mm256_storeu_ps(batch.m_OutY + bodyIndex, _mm256_add_ps(_mm256_loadu_ps(batch.m_OutY + bodyIndex), sumY));
+	}
+
+	AccumulateSunGravityScalar(batch, bodyIndex);
+}
+
+#endif // NT_GRAVITY_X86
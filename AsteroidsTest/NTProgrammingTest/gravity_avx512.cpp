@@ -0,0 +1,51 @@
+//-------------------------------------------------------------------------------------------------------------
+// gravity_avx512.cpp
+//
+// The AVX-512 batched sun gravity kernel, sixteen bodies at a time. Needs AVX-512F; compiled with the
+// matching target flags and only called once the CPU has been checked for it.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "gravity.h"
+
+#ifdef NT_GRAVITY_X86
+
+#include <immintrin.h>
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateSunGravityAVX512
+// The last partial vector is handled with masked loads and stores rather than by the scalar kernel.
+//--------------------------------------------------------------------------------------------------------------
+void AccumulateSunGravityAVX512(const SunGravityBatch& batch)
+{
+	const __m512 gravity = _mm512_set1_ps(batch.m_Gravity);
+
+	for (size_t bodyIndex = 0; bodyIndex < batch.m_BodyCount; bodyIndex += 16)
+	{
+		size_t remaining = batch.m_BodyCount - bodyIndex;
+		__mmask16 mask = remaining >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << remaining) - 1);
+
+		__m512 bodyX = _mm512_maskz_loadu_ps(mask, batch.m_BodyX + bodyIndex);
+		__m512 bodyY = _mm512_maskz_loadu_ps(mask, batch.m_BodyY + bodyIndex);
+		__m512 sumX = _mm512_setzero_ps();
+		__m512 sumY = _mm512_setzero_ps();
+
+		for (size_t sunIndex = 0; sunIndex < batch.m_SunCount; sunIndex++)
+		{
+			__m512 dx = _mm512_sub_ps(_mm512_set1_ps(batch.m_SunX[sunIndex]), bodyX);
+			__m512 dy = _mm512_sub_ps(_mm512_set1_ps(batch.m_SunY[sunIndex]), bodyY);
+			__m512 distanceSquared = _mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy));
+			__m512 scale = _mm512_div_ps(gravity, distanceSquared);
+			sumX = _mm512_add_ps(sumX, _mm512_mul_ps(dx, scale));
+			sumY = _mm512_add_ps(sumY, _mm512_mul_ps(dy, scale));
+		}
+
+		_mm512_mask_storeu_ps(batch.m_OutX + bodyIndex, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, batch.m_OutX + bodyIndex), sumX));
+		_mm512_mask_storeu_ps(batch.m_OutY + bodyIndex, mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, batch.m_OutY + bodyIndex), sumY));
+	}
+}
+
+#endif // NT_GRAVITY_X86
@@ -0,0 +1,49 @@
+//-------------------------------------------------------------------------------------------------------------
+// gravity_sse2.cpp
+//
+// The SSE2 batched sun gravity kernel, four bodies at a time.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "gravity.h"
+
+#ifdef NT_GRAVITY_X86
+
+#include <emmintrin.h>
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateSunGravitySSE2
+//--------------------------------------------------------------------------------------------------------------
+void AccumulateSunGravitySSE2(const SunGravityBatch& batch)
+{
+	const __m128 gravity = _mm_set1_ps(batch.m_Gravity);
+
+	size_t bodyIndex = 0;
+	for (; bodyIndex + 4 <= batch.m_BodyCount; bodyIndex += 4)
+	{
+		__m128 bodyX = _mm_loadu_ps(batch.m_BodyX + bodyIndex);
+		__m128 bodyY = _mm_loadu_ps(batch.m_BodyY + bodyIndex);
+		__m128 sumX = _mm_setzero_ps();
+		__m128 sumY = _mm_setzero_ps();
+
+		for (size_t sunIndex = 0; sunIndex < batch.m_SunCount; sunIndex++)
+		{
+			__m128 dx = _mm_sub_ps(_mm_set1_ps(batch.m_SunX[sunIndex]), bodyX);
+			__m128 dy = _mm_sub_ps(_mm_set1_ps(batch.m_SunY[sunIndex]), bodyY);
+			__m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			__m128 scale = _mm_div_ps(gravity, distanceSquared);
+			sumX = _mm_add_ps(sumX, _mm_mul_ps(dx, scale));
+			sumY = _mm_add_ps(sumY, _mm_mul_ps(dy, scale));
+		}
+
+		_mm_storeu_ps(batch.m_OutX + bodyIndex, _mm_add_ps(_mm_loadu_ps(batch.m_OutX + bodyIndex), sumX));
+		_mm_storeu_ps(batch.m_OutY + bodyIndex, _mm_add_ps(_mm_loadu_ps(batch.m_OutY + bodyIndex), sumY));
+	}
+
+	AccumulateSunGravityScalar(batch, bodyIndex);
+}
+
+#endif // NT_GRAVITY_X86
@@ -0,0 +1,369 @@
+//-------------------------------------------------------------------------------------------------------------
+// gravityfield.cpp
+//
+// Implementation of the precomputed gravity field.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "gravity.h"
+#include "gravityfield.h"
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------------------
+// GravityField
+//--------------------------------------------------------------------------------------------------------------
+GravityField::GravityField()
+: m_MinX(0.f)
+, m_MinY(0.f)
+, m_CellSize(0.f)
+, m_InvCellSize(0.f)
+, m_CellDiagonal(0.f)
+, m_ExactRadius(0.f)
+, m_Gravity(0.f)
+, m_MeasuredError(0.f)
+, m_Columns(0)
+, m_Rows(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Bake
+// Bake at the requested cell size, then keep halving it until the measured error is within bounds.
+//--------------------------------------------------------------------------------------------------------------
+bool GravityField::Bake(const EntityArray& suns, float gravity, float minX, float minY, float maxX, float maxY, const GravityFieldSettings& settings)
+{
+	assert(settings.m_CellSize > 0.f);
+
+	Clear();
+
+	minX -= settings.m_Margin;
+	minY -= settings.m_Margin;
+	maxX += settings.m_Margin;
+	maxY += settings.m_Margin;
+
+	m_MinX = minX;
+	m_MinY = minY;
+	m_ExactRadius = settings.m_ExactRadius;
+	m_Gravity = gravity;
+
+	float cellSize = settings.m_CellSize;
+	for (;;)
+	{
+		int columns = (int)ceilf((maxX - minX) / cellSize);
+		int rows = (int)ceilf((maxY - minY) / cellSize);
+
+		if ((double)(columns + 1) * (double)(rows + 1) > (double)settings.m_MaxNodes)
+		{
+			// Even the first bake is too big; there's nothing to fall back on.
+			if (!IsBaked())
+			{
+				return false;
+			}
+			break;
+		}
+
+		m_Columns = columns;
+		m_Rows = rows;
+		m_CellSize = cellSize;
+		m_InvCellSize = 1.f / cellSize;
+		m_CellDiagonal = cellSize * 1.41421356f;
+
+		BakeNodes(suns);
+		m_MeasuredError = MeasureError(suns);
+
+		if (m_MeasuredError <= settings.m_MaxError)
+		{
+			return true;
+		}
+
+		cellSize *= 0.5f;
+	}
+
+	return false;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+//--------------------------------------------------------------------------------------------------------------
+void GravityField::Clear()
+{
+	m_Nodes.clear();
+	m_Columns = 0;
+	m_Rows = 0;
+	m_MeasuredError = 0.f;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BakeNodes
+// Work out the exact gravity and nearest sun distance at every grid node.
+//--------------------------------------------------------------------------------------------------------------
+void GravityField::BakeNodes(const EntityArray& suns)
+{
+	size_t nodeCount = (size_t)(m_Columns + 1) * (size_t)(m_Rows + 1);
+
+	std::vector<float> nodeX(nodeCount), nodeY(nodeCount);
+	std::vector<float> gravityX(nodeCount, 0.f), gravityY(nodeCount, 0.f);
+
+	for (int row = 0; row <= m_Rows; row++)
+	{
+		for (int column = 0; column <= m_Columns; column++)
+		{
+			size_t node = (size_t)row * (m_Columns + 1) + column;
+			nodeX[node] = m_MinX + column * m_CellSize;
+			nodeY[node] = m_MinY + row * m_CellSize;
+		}
+	}
+
+	if (!suns.IsEmpty())
+	{
+		SunGravityBatch batch;
+		batch.m_BodyX = &nodeX[0];
+		batch.m_BodyY = &nodeY[0];
+		batch.m_BodyCount = nodeCount;
+		batch.m_SunX = &suns.m_PositionX[0];
+		batch.m_SunY = &suns.m_PositionY[0];
+		batch.m_SunCount = suns.Size();
+		batch.m_Gravity = m_Gravity;
+		batch.m_OutX = &gravityX[0];
+		batch.m_OutY = &gravityY[0];
+		AccumulateSunGravity(batch);
+	}
+
+	m_Nodes.resize(nodeCount);
+	for (size_t node = 0; node < nodeCount; node++)
+	{
+		float nearestSquared = 1e30f;
+		for (size_t sunIndex = 0; sunIndex < suns.Size(); sunIndex++)
+		{
+			float dx = suns.m_PositionX[sunIndex] - nodeX[node];
+			float dy = suns.m_PositionY[sunIndex] - nodeY[node];
+			float distanceSquared = dx * dx + dy * dy;
+			if (distanceSquared < nearestSquared)
+			{
+				nearestSquared = distanceSquared;
+			}
+		}
+
+		m_Nodes[node].m_GravityX = gravityX[node];
+		m_Nodes[node].m_GravityY = gravityY[node];
+		m_Nodes[node].m_SunDistance = sqrtf(nearestSquared);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// MeasureError
+// Compare the field with the exact sum at the centre and edge midpoints of every cell, which is where
+// bilinear interpolation is furthest from the nodes. Points the field won't be sampled at are skipped.
+//--------------------------------------------------------------------------------------------------------------
+float GravityField::MeasureError(const EntityArray& suns) const
+{
+	if (suns.IsEmpty())
+	{
+		return 0.f;
+	}
+
+	static const float s_TestOffsets[3][2] = { { 0.5f, 0.5f }, { 0.5f, 0.f }, { 0.f, 0.5f } };
+
+	std::vector<float> testX, testY, sampledX, sampledY;
+	for (int row = 0; row < m_Rows; row++)
+	{
+		for (int column = 0; column < m_Columns; column++)
+		{
+			for (int offset = 0; offset < 3; offset++)
+			{
+				float x = m_MinX + (column + s_TestOffsets[offset][0]) * m_CellSize;
+				float y = m_MinY + (row + s_TestOffsets[offset][1]) * m_CellSize;
+				float gravityX, gravityY;
+				if (Sample(x, y, gravityX, gravityY))
+				{
+					testX.push_back(x);
+					testY.push_back(y);
+					sampledX.push_back(gravityX);
+					sampledY.push_back(gravityY);
+				}
+			}
+		}
+	}
+
+	if (testX.empty())
+	{
+		return 0.f;
+	}
+
+	std::vector<float> exactX(testX.size(), 0.f), exactY(testX.size(), 0.f);
+
+	SunGravityBatch batch;
+	batch.m_BodyX = &testX[0];
+	batch.m_BodyY = &testY[0];
+	batch.m_BodyCount = testX.size();
+	batch.m_SunX = &suns.m_PositionX[0];
+	batch.m_SunY = &suns.m_PositionY[0];
+	batch.m_SunCount = suns.Size();
+	batch.m_Gravity = m_Gravity;
+	batch.m_OutX = &exactX[0];
+	batch.m_OutY = &exactY[0];
+	AccumulateSunGravity(batch);
+
+	float worstError = 0.f;
+	for (size_t index = 0; index < testX.size(); index++)
+	{
+		float dx = sampledX[index] - exactX[index];
+		float dy = sampledY[index] - exactY[index];
+		float error = sqrtf(dx * dx + dy * dy);
+		if (error > worstError)
+		{
+			worstError = error;
+		}
+	}
+
+	return worstError;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Locate
+// Find the cell containing a point and how far across it the point lies. Returns false outside the field.
+//--------------------------------------------------------------------------------------------------------------
+bool GravityField::Locate(float x, float y, int& outNode, float& outFractionX, float& outFractionY) const
+{
+	float gridX = (x - m_MinX) * m_InvCellSize;
+	float gridY = (y - m_MinY) * m_InvCellSize;
+
+	// Written so that NaN positions fail too.
+	if (!(gridX >= 0.f && gridY >= 0.f && gridX < (float)m_Columns && gridY < (float)m_Rows))
+	{
+		return false;
+	}
+
+	int column = (int)gridX;
+	int row = (int)gridY;
+
+	outNode = row * (m_Columns + 1) + column;
+	outFractionX = gridX - column;
+	outFractionY = gridY - row;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SampleSunDistance
+// Interpolate the nearest sun distance within a cell.
+//--------------------------------------------------------------------------------------------------------------
+float GravityField::SampleSunDistance(int node, float fractionX, float fractionY) const
+{
+	const Node& n00 = m_Nodes[node];
+	const Node& n10 = m_Nodes[node + 1];
+	const Node& n01 = m_Nodes[node + m_Columns + 1];
+	const Node& n11 = m_Nodes[node + m_Columns + 2];
+
+	float top = n00.m_SunDistance + (n10.m_SunDistance - n00.m_SunDistance) * fractionX;
+	float bottom = n01.m_SunDistance + (n11.m_SunDistance - n01.m_SunDistance) * fractionX;
+	return top + (bottom - top) * fractionY;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Sample
+// Bilinear interpolation of the gravity at a point. The nearest sun distance is interpolated too; distance
+// changes by at most one unit per unit moved, so the interpolated value is within a cell diagonal of the
+// truth, and that is allowed for when deciding whether the point is too near a sun.
+//--------------------------------------------------------------------------------------------------------------
+bool GravityField::Sample(float x, float y, float& outGravityX, float& outGravityY) const
+{
+	int node;
+	float fractionX, fractionY;
+	if (!Locate(x, y, node, fractionX, fractionY))
+	{
+		return false;
+	}
+
+	if (SampleSunDistance(node, fractionX, fractionY) < m_ExactRadius + m_CellDiagonal)
+	{
+		return false;
+	}
+
+	const Node& n00 = m_Nodes[node];
+	const Node& n10 = m_Nodes[node + 1];
+	const Node& n01 = m_Nodes[node + m_Columns + 1];
+	const Node& n11 = m_Nodes[node + m_Columns + 2];
+
+	float topX = n00.m_GravityX + (n10.m_GravityX - n00.m_GravityX) * fractionX;
+	float topY = n00.m_GravityY + (n10.m_GravityY - n00.m_GravityY) * fractionX;
+	float bottomX = n01.m_GravityX + (n11.m_GravityX - n01.m_GravityX) * fractionX;
+	float bottomY = n01.m_GravityY + (n11.m_GravityY - n01.m_GravityY) * fractionX;
+
+	outGravityX = topX + (bottomX - topX) * fractionY;
+	outGravityY = topY + (bottomY - topY) * fractionY;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// IsClearOfSuns
+//--------------------------------------------------------------------------------------------------------------
+bool GravityField::IsClearOfSuns(float x, float y, float distance) const
+{
+	int node;
+	float fractionX, fractionY;
+	if (!Locate(x, y, node, fractionX, fractionY))
+	{
+		return false;
+	}
+
+	return SampleSunDistance(node, fractionX, fractionY) - m_CellDiagonal >= distance;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AccumulateGravity
+// Sample the field for every point it covers, and gather the rest into one exact batch.
+//--------------------------------------------------------------------------------------------------------------
+void GravityField::AccumulateGravity(const float* x, const float* y, size_t count, const EntityArray& suns,
+	float* outX, float* outY, GravityFieldScratch& scratch) const
+{
+	std::vector<unsigned int>& exactIndices = scratch.m_ExactIndices;
+	exactIndices.clear();
+	scratch.m_ExactX.clear();
+	scratch.m_ExactY.clear();
+
+	for (size_t index = 0; index < count; index++)
+	{
+		float gravityX, gravityY;
+		if (Sample(x[index], y[index], gravityX, gravityY))
+		{
+			outX[index] += gravityX;
+			outY[index] += gravityY;
+		}
+		else
+		{
+			exactIndices.push_back((unsigned int)index);
+			scratch.m_ExactX.push_back(x[index]);
+			scratch.m_ExactY.push_back(y[index]);
+		}
+	}
+
+	if (exactIndices.empty() || suns.IsEmpty())
+	{
+		return;
+	}
+
+	scratch.m_ExactGravityX.assign(exactIndices.size(), 0.f);
+	scratch.m_ExactGravityY.assign(exactIndices.size(), 0.f);
+
+	SunGravityBatch batch;
+	batch.m_BodyX = &scratch.m_ExactX[0];
+	batch.m_BodyY = &scratch.m_ExactY[0];
+	batch.m_BodyCount = exactIndices.size();
+	batch.m_SunX = &suns.m_PositionX[0];
+	batch.m_SunY = &suns.m_PositionY[0];
+	batch.m_SunCount = suns.Size();
+	batch.m_Gravity = m_Gravity;
+	batch.m_OutX = &scratch.m_ExactGravityX[0];
+	batch.m_OutY = &scratch.m_ExactGravityY[0];
+	AccumulateSunGravity(batch);
+
+	for (size_t exactIndex = 0; exactIndex < exactIndices.size(); exactIndex++)
+	{
+		unsigned int index = exactIndices[exactIndex];
+		outX[index] += scratch.m_ExactGravityX[exactIndex];
+		outY[index] += scratch.m_ExactGravityY[exactIndex];
+	}
+}
@@ -0,0 +1,119 @@
+//-------------------------------------------------------------------------------------------------------------
+// gravityfield.h
+//
+// A precomputed grid of the summed sun gravity and the distance to the nearest sun. Suns never move, so the
+// field can be baked once and sampled for O(1) per body instead of summing over every sun.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "entitystore.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// GravityFieldSettings
+// How finely to bake the field and how accurate it has to be.
+//-------------------------------------------------------------------------------------------------------------
+struct GravityFieldSettings
+{
+	GravityFieldSettings()
+	: m_CellSize(8.f)
+	, m_MaxError(0.05f)
+	, m_ExactRadius(30.f)
+	, m_Margin(100.f)
+	, m_MaxNodes(4 * 1024 * 1024)
+	{
+	}
+
+	// Distance between grid nodes. Halved until the field is within m_MaxError, as far as m_MaxNodes allows.
+	float	m_CellSize;
+
+	// Largest allowed difference between the sampled and the exact summed gravity.
+	float	m_MaxError;
+
+	// Gravity goes to infinity at a sun's centre, where no grid can follow it. Closer than this to a sun the
+	// field isn't sampled and the exact sum is used instead.
+	float	m_ExactRadius;
+
+	// How far beyond the given area the grid extends.
+	float	m_Margin;
+
+	int		m_MaxNodes;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// GravityFieldScratch
+// Working space for the bodies that fall back to the exact sum. Callers applying gravity from several
+// threads at once give each thread its own.
+//-------------------------------------------------------------------------------------------------------------
+struct GravityFieldScratch
+{
+	std::vector<unsigned int>	m_ExactIndices;
+	std::vector<float>			m_ExactX;
+	std::vector<float>			m_ExactY;
+	std::vector<float>			m_ExactGravityX;
+	std::vector<float>			m_ExactGravityY;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// GravityField
+//-------------------------------------------------------------------------------------------------------------
+class GravityField
+{
+public:
+	GravityField();
+
+	// Bake the field over the given area. Returns false if it could not be brought within the error bound, in
+	// which case the finest field allowed is still baked and usable.
+	bool Bake(const EntityArray& suns, float gravity, float minX, float minY, float maxX, float maxY, const GravityFieldSettings& settings);
+	void Clear();
+
+	bool IsBaked() const { return !m_Nodes.empty(); }
+
+	// Interpolate the summed gravity at a point. Returns false if the point is outside the field or too near
+	// a sun, in which case the exact sum should be used.
+	bool Sample(float x, float y, float& outGravityX, float& outGravityY) const;
+
+	// Returns true if the field guarantees there is no sun centre within distance of the point. False means
+	// there might be, and the suns should be checked.
+	bool IsClearOfSuns(float x, float y, float distance) const;
+
+	// Add the gravity of the suns at each of count points onto outX and outY.
+	void AccumulateGravity(const float* x, const float* y, size_t count, const EntityArray& suns, float* outX, float* outY,
+		GravityFieldScratch& scratch) const;
+
+	float GetCellSize() const { return m_CellSize; }
+	float GetMeasuredError() const { return m_MeasuredError; }
+	int GetColumns() const { return m_Columns; }
+	int GetRows() const { return m_Rows; }
+
+private:
+	struct Node
+	{
+		float	m_GravityX;
+		float	m_GravityY;
+		float	m_SunDistance;
+	};
+
+	bool Locate(float x, float y, int& outNode, float& outFractionX, float& outFractionY) const;
+	float SampleSunDistance(int node, float fractionX, float fractionY) const;
+	void BakeNodes(const EntityArray& suns);
+	float MeasureError(const EntityArray& suns) const;
+
+	std::vector<Node>	m_Nodes;
+	float				m_MinX;
+	float				m_MinY;
+	float				m_CellSize;
+	float				m_InvCellSize;
+	float				m_CellDiagonal;
+	float				m_ExactRadius;
+	float				m_Gravity;
+	float				m_MeasuredError;
+	int					m_Columns;
+	int					m_Rows;
+};
@@ -0,0 +1,263 @@
+//-------------------------------------------------------------------------------------------------------------
+// integrator.cpp
+//
+// Implementation of the leapfrog integrator.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "integrator.h"
+#include "gravity.h"
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------------------------------
+
+// The most times a substepped body's count is chosen again before the last choice is taken.
+static const int SYMMETRY_PASSES = 4;
+
+//--------------------------------------------------------------------------------------------------------------
+// Accumulate
+//--------------------------------------------------------------------------------------------------------------
+void SunGravity::Accumulate(const float* x, const float* y, size_t count, float* outX, float* outY) const
+{
+	if (count == 0 || !HasEffect())
+	{
+		return;
+	}
+
+	if (m_Field.IsBaked())
+	{
+		m_Field.AccumulateGravity(x, y, count, m_Suns, outX, outY, m_Scratch);
+		return;
+	}
+
+	SunGravityBatch batch;
+	batch.m_BodyX = x;
+	batch.m_BodyY = y;
+	batch.m_BodyCount = count;
+	batch.m_SunX = &m_Suns.m_PositionX[0];
+	batch.m_SunY = &m_Suns.m_PositionY[0];
+	batch.m_SunCount = m_Suns.Size();
+	batch.m_Gravity = m_Gravity;
+	batch.m_OutX = outX;
+	batch.m_OutY = outY;
+	AccumulateSunGravity(batch);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SubstepGroup
+// Step the gathered bodies through the tick in equal drift-kick-drift substeps, measuring their accelerations
+// together at each.
+//--------------------------------------------------------------------------------------------------------------
+static void SubstepGroup(IntegratorScratch& scratch, float timeDelta, int substeps, const AccelerationSource& acceleration)
+{
+	size_t count = scratch.m_GroupX.size();
+	float step = timeDelta / (float)substeps;
+	float halfStep = step * 0.5f;
+
+	float* x = &scratch.m_GroupX[0];
+	float* y = &scratch.m_GroupY[0];
+	float* velocityX = &scratch.m_GroupVelocityX[0];
+	float* velocityY = &scratch.m_GroupVelocityY[0];
+
+	for (int substep = 0; substep < substeps; substep++)
+	{
+		MultiplyAdd(x, velocityX, halfStep, count);
+		MultiplyAdd(y, velocityY, halfStep, count);
+
+		scratch.m_AccelerationX.assign(count, 0.f);
+		scratch.m_AccelerationY.assign(count, 0.f);
+		acceleration.Accumulate(x, y, count, &scratch.m_AccelerationX[0], &scratch.m_AccelerationY[0]);
+
+		for (size_t index = 0; index < count; index++)
+		{
+			velocityX[index] += scratch.m_AccelerationX[index] * step;
+			velocityY[index] += scratch.m_AccelerationY[index] * step;
+			x[index] += velocityX[index] * halfStep;
+			y[index] += velocityY[index] * halfStep;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// CountSubsteps
+// The power of two at or above needed, up to the first at or above the most allowed.
+//--------------------------------------------------------------------------------------------------------------
+static int CountSubsteps(float needed, int maxSubsteps)
+{
+	int substeps = 1;
+	while (substeps < needed && substeps < maxSubsteps)
+	{
+		substeps *= 2;
+	}
+	return substeps;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// IntegrateBodies
+// Drift-kick-drift leapfrog, which needs the acceleration only once per step, at the midpoint. Every body
+// first drifts half a tick and has its acceleration there measured in one batch. That is also what decides
+// its substeps: a body that needs only one finishes the step from the batch, and the rest are started again
+// from the beginning of the tick, grouped by how many substeps they need.
+//
+// Leapfrog only keeps its energy over long runs if stepping backwards undoes a step exactly, so the substep
+// count must come out the same whichever end of the tick it is chosen from. A single step's midpoint is the
+// same from either end. A substepped body's isn't, so once it has been stepped its count is chosen again
+// from the need at both ends' midpoints, averaged, and if that differs it is stepped again from the start.
+// The last of SYMMETRY_PASSES takes whatever it has, so a body on the edge between two counts costs a few
+// extra steps at worst.
+//--------------------------------------------------------------------------------------------------------------
+void IntegrateBodies(EntityArray& bodies, size_t begin, size_t end, float timeDelta, const AccelerationSource& acceleration,
+	const IntegratorSettings& settings, IntegratorScratch& scratch, IntegratorStats& stats)
+{
+	assert(begin <= end && end <= bodies.Size());
+
+	size_t count = end - begin;
+	stats.m_Bodies += count;
+	stats.m_Substeps += count;
+	if (count == 0)
+	{
+		return;
+	}
+	stats.m_MostSubsteps = stats.m_MostSubsteps > 1 ? stats.m_MostSubsteps : 1;
+
+	// With nothing to kick them, the drifts add up to a plain move.
+	if (!acceleration.HasEffect())
+	{
+		MultiplyAdd(&bodies.m_PositionX[begin], &bodies.m_VelocityX[begin], timeDelta, count);
+		MultiplyAdd(&bodies.m_PositionY[begin], &bodies.m_VelocityY[begin], timeDelta, count);
+		return;
+	}
+
+	float halfDelta = timeDelta * 0.5f;
+	scratch.m_HalfX.resize(count);
+	scratch.m_HalfY.resize(count);
+	for (size_t index = 0; index < count; index++)
+	{
+		scratch.m_HalfX[index] = bodies.m_PositionX[begin + index] + bodies.m_VelocityX[begin + index] * halfDelta;
+		scratch.m_HalfY[index] = bodies.m_PositionY[begin + index] + bodies.m_VelocityY[begin + index] * halfDelta;
+	}
+
+	scratch.m_AccelerationX.assign(count, 0.f);
+	scratch.m_AccelerationY.assign(count, 0.f);
+	acceleration.Accumulate(&scratch.m_HalfX[0], &scratch.m_HalfY[0], count, &scratch.m_AccelerationX[0], &scratch.m_AccelerationY[0]);
+
+	// The substep length the settings allow is accuracy * sqrt(length / |a|), so the number needed is this
+	// times sqrt(|a|).
+	float substepsPerRootAcceleration = timeDelta / (settings.m_Accuracy * sqrtf(settings.m_LengthScale));
+
+	// A body's substeps stay in m_Substeps until it has been stepped, and are then set to 0.
+	scratch.m_Substeps.resize(count);
+	scratch.m_Needed.resize(count);
+	int largestSubsteps = 1;
+	for (size_t index = 0; index < count; index++)
+	{
+		float accelerationX = scratch.m_AccelerationX[index];
+		float accelerationY = scratch.m_AccelerationY[index];
+		float needed = substepsPerRootAcceleration * sqrtf(sqrtf(accelerationX * accelerationX + accelerationY * accelerationY));
+
+		int substeps = CountSubsteps(needed, settings.m_MaxSubsteps);
+		scratch.m_Substeps[index] = substeps;
+		scratch.m_Needed[index] = needed;
+		largestSubsteps = substeps > largestSubsteps ? substeps : largestSubsteps;
+
+		if (substeps == 1)
+		{
+			size_t bodyIndex = begin + index;
+			float velocityX = bodies.m_VelocityX[bodyIndex] + accelerationX * timeDelta;
+			float velocityY = bodies.m_VelocityY[bodyIndex] + accelerationY * timeDelta;
+			bodies.m_VelocityX[bodyIndex] = velocityX;
+			bodies.m_VelocityY[bodyIndex] = velocityY;
+			bodies.m_PositionX[bodyIndex] = scratch.m_HalfX[index] + velocityX * halfDelta;
+			bodies.m_PositionY[bodyIndex] = scratch.m_HalfY[index] + velocityY * halfDelta;
+			scratch.m_Substeps[index] = 0;
+		}
+	}
+	if (largestSubsteps == 1)
+	{
+		return;
+	}
+	largestSubsteps = CountSubsteps((float)settings.m_MaxSubsteps, settings.m_MaxSubsteps);
+
+	int mostSubsteps = 1;
+	for (int pass = 0; pass < SYMMETRY_PASSES; pass++)
+	{
+		bool lastPass = pass + 1 == SYMMETRY_PASSES;
+		bool anyLeft = false;
+		for (int substeps = 1; substeps <= largestSubsteps; substeps *= 2)
+		{
+			scratch.m_GroupIndices.clear();
+			scratch.m_GroupX.clear();
+			scratch.m_GroupY.clear();
+			scratch.m_GroupVelocityX.clear();
+			scratch.m_GroupVelocityY.clear();
+			for (size_t index = 0; index < count; index++)
+			{
+				if (scratch.m_Substeps[index] == substeps)
+				{
+					size_t bodyIndex = begin + index;
+					scratch.m_GroupIndices.push_back((unsigned int)index);
+					scratch.m_GroupX.push_back(bodies.m_PositionX[bodyIndex]);
+					scratch.m_GroupY.push_back(bodies.m_PositionY[bodyIndex]);
+					scratch.m_GroupVelocityX.push_back(bodies.m_VelocityX[bodyIndex]);
+					scratch.m_GroupVelocityY.push_back(bodies.m_VelocityY[bodyIndex]);
+				}
+			}
+			size_t groupSize = scratch.m_GroupIndices.size();
+			if (groupSize == 0)
+			{
+				continue;
+			}
+
+			SubstepGroup(scratch, timeDelta, substeps, acceleration);
+
+			// The midpoint a single step back from where the group ended up.
+			scratch.m_BackX.resize(groupSize);
+			scratch.m_BackY.resize(groupSize);
+			for (size_t group = 0; group < groupSize; group++)
+			{
+				scratch.m_BackX[group] = scratch.m_GroupX[group] - scratch.m_GroupVelocityX[group] * halfDelta;
+				scratch.m_BackY[group] = scratch.m_GroupY[group] - scratch.m_GroupVelocityY[group] * halfDelta;
+			}
+			scratch.m_AccelerationX.assign(groupSize, 0.f);
+			scratch.m_AccelerationY.assign(groupSize, 0.f);
+			acceleration.Accumulate(&scratch.m_BackX[0], &scratch.m_BackY[0], groupSize, &scratch.m_AccelerationX[0],
+				&scratch.m_AccelerationY[0]);
+			stats.m_Substeps += groupSize * (substeps + 1);
+
+			for (size_t group = 0; group < groupSize; group++)
+			{
+				unsigned int index = scratch.m_GroupIndices[group];
+				float accelerationX = scratch.m_AccelerationX[group];
+				float accelerationY = scratch.m_AccelerationY[group];
+				float backNeeded = substepsPerRootAcceleration * sqrtf(sqrtf(accelerationX * accelerationX + accelerationY * accelerationY));
+				int symmetricSubsteps = CountSubsteps((scratch.m_Needed[index] + backNeeded) * 0.5f, settings.m_MaxSubsteps);
+				if (symmetricSubsteps != substeps && !lastPass)
+				{
+					scratch.m_Substeps[index] = symmetricSubsteps;
+					anyLeft = true;
+					continue;
+				}
+
+				size_t bodyIndex = begin + index;
+				bodies.m_PositionX[bodyIndex] = scratch.m_GroupX[group];
+				bodies.m_PositionY[bodyIndex] = scratch.m_GroupY[group];
+				bodies.m_VelocityX[bodyIndex] = scratch.m_GroupVelocityX[group];
+				bodies.m_VelocityY[bodyIndex] = scratch.m_GroupVelocityY[group];
+				scratch.m_Substeps[index] = 0;
+
+				stats.m_RefinedBodies += substeps > 1 ? 1 : 0;
+				mostSubsteps = substeps > mostSubsteps ? substeps : mostSubsteps;
+			}
+		}
+		if (!anyLeft)
+		{
+			break;
+		}
+	}
+	stats.m_MostSubsteps = mostSubsteps > stats.m_MostSubsteps ? mostSubsteps : stats.m_MostSubsteps;
+}
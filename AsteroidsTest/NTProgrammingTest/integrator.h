@@ -0,0 +1,141 @@
+//-------------------------------------------------------------------------------------------------------------
+// integrator.h
+//
+// Moving bodies through the suns' gravity. Bodies are stepped with leapfrog, which unlike Euler doesn't feed
+// energy into orbits, and a body whose acceleration is high is given several smaller steps within the tick,
+// so that the few bodies passing close to a sun stay accurate without shrinking the step for everything.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "entitystore.h"
+#include "gravityfield.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// AccelerationSource
+// Whatever the bodies are accelerated by.
+//-------------------------------------------------------------------------------------------------------------
+class AccelerationSource
+{
+public:
+	virtual ~AccelerationSource() {}
+
+	// Add the acceleration at each of count points onto outX and outY.
+	virtual void Accumulate(const float* x, const float* y, size_t count, float* outX, float* outY) const = 0;
+
+	// False if the acceleration is zero everywhere, in which case bodies just drift.
+	virtual bool HasEffect() const = 0;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// SunGravity
+// The pull of the suns, gravity * d / |d|^2 towards each, from a baked field where there is one. The scratch
+// is used for the bodies the field doesn't cover, so each thread needs its own.
+//-------------------------------------------------------------------------------------------------------------
+class SunGravity : public AccelerationSource
+{
+public:
+	SunGravity(const EntityArray& suns, float gravity, const GravityField& field, GravityFieldScratch& scratch)
+	: m_Suns(suns)
+	, m_Gravity(gravity)
+	, m_Field(field)
+	, m_Scratch(scratch)
+	{
+	}
+
+	virtual void Accumulate(const float* x, const float* y, size_t count, float* outX, float* outY) const;
+	virtual bool HasEffect() const { return m_Gravity != 0.f && !m_Suns.IsEmpty(); }
+
+private:
+	const EntityArray&		m_Suns;
+	float					m_Gravity;
+	const GravityField&		m_Field;
+	GravityFieldScratch&	m_Scratch;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// IntegratorSettings
+//-------------------------------------------------------------------------------------------------------------
+struct IntegratorSettings
+{
+	IntegratorSettings()
+	: m_Accuracy(0.05f)
+	, m_LengthScale(15.f)
+	, m_MaxSubsteps(64)
+	{
+	}
+
+	// A body is stepped in substeps no longer than m_Accuracy * sqrt(m_LengthScale / |a|), where a is its
+	// acceleration: the time it takes the acceleration to move a body from rest by m_Accuracy^2 / 2 of
+	// m_LengthScale. The substep count is rounded up to a power of two, at most m_MaxSubsteps.
+	float	m_Accuracy;
+	float	m_LengthScale;
+	int		m_MaxSubsteps;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// IntegratorStats
+//-------------------------------------------------------------------------------------------------------------
+struct IntegratorStats
+{
+	IntegratorStats() { Reset(); }
+
+	void Reset()
+	{
+		m_Bodies = 0;
+		m_Substeps = 0;
+		m_RefinedBodies = 0;
+		m_MostSubsteps = 0;
+	}
+
+	void Add(const IntegratorStats& other)
+	{
+		m_Bodies += other.m_Bodies;
+		m_Substeps += other.m_Substeps;
+		m_RefinedBodies += other.m_RefinedBodies;
+		m_MostSubsteps = other.m_MostSubsteps > m_MostSubsteps ? other.m_MostSubsteps : m_MostSubsteps;
+	}
+
+	// Bodies stepped, and how many times their accelerations were measured doing it, which counts the batch
+	// every body starts with and the substeps of any that were stepped again.
+	unsigned long long	m_Bodies;
+	unsigned long long	m_Substeps;
+
+	// Bodies that needed more than one substep, and the most substeps any body needed.
+	unsigned long long	m_RefinedBodies;
+	int					m_MostSubsteps;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// IntegratorScratch
+// Working space for IntegrateBodies. Callers integrating from several threads at once give each its own.
+//-------------------------------------------------------------------------------------------------------------
+struct IntegratorScratch
+{
+	std::vector<float>			m_HalfX;
+	std::vector<float>			m_HalfY;
+	std::vector<float>			m_AccelerationX;
+	std::vector<float>			m_AccelerationY;
+	std::vector<int>			m_Substeps;
+	std::vector<float>			m_Needed;
+
+	// The bodies being substepped together.
+	std::vector<unsigned int>	m_GroupIndices;
+	std::vector<float>			m_GroupX;
+	std::vector<float>			m_GroupY;
+	std::vector<float>			m_GroupVelocityX;
+	std::vector<float>			m_GroupVelocityY;
+	std::vector<float>			m_BackX;
+	std::vector<float>			m_BackY;
+};
+
+// Advance the positions and velocities of the bodies in [begin, end) by timeDelta, and add what it took to
+// stats.
+void IntegrateBodies(EntityArray& bodies, size_t begin, size_t end, float timeDelta, const AccelerationSource& acceleration,
+	const IntegratorSettings& settings, IntegratorScratch& scratch, IntegratorStats& stats);
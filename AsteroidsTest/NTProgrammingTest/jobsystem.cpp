@@ -0,0 +1,370 @@
+//-------------------------------------------------------------------------------------------------------------
+// jobsystem.cpp
+//
+// Implementation of the work-stealing thread pool and the phase graph.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "jobsystem.h"
+#include "trace.h"
+#include <stdio.h>
+
+// How many times an idle worker looks for work before going to sleep. Ticks come close together, so a short
+// spin saves a wake up between phases.
+static const int IDLE_SPINS = 64;
+
+// The pool and index of the current thread, if it is a worker.
+static thread_local const JobSystem* t_JobSystem = NULL;
+static thread_local unsigned int t_ThreadIndex = 0;
+
+//--------------------------------------------------------------------------------------------------------------
+// JobSystem
+//--------------------------------------------------------------------------------------------------------------
+JobSystem::JobSystem()
+: m_QueuedJobs(0)
+, m_Stopping(false)
+{
+	m_Queues.push_back(new Queue);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~JobSystem
+//--------------------------------------------------------------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	Stop();
+
+	for (size_t index = 0; index < m_Queues.size(); index++)
+	{
+		delete m_Queues[index];
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Start
+//--------------------------------------------------------------------------------------------------------------
+void JobSystem::Start(unsigned int workerCount)
+{
+	Stop();
+
+	m_Stopping = false;
+	for (unsigned int worker = 0; worker < workerCount; worker++)
+	{
+		m_Queues.push_back(new Queue);
+	}
+	for (unsigned int worker = 0; worker < workerCount; worker++)
+	{
+		m_Workers.push_back(std::thread(&JobSystem::WorkerMain, this, worker + 1));
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Stop
+// Let the workers finish whatever is queued, then join them.
+//--------------------------------------------------------------------------------------------------------------
+void JobSystem::Stop()
+{
+	if (m_Workers.empty())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Stopping = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (size_t index = 0; index < m_Workers.size(); index++)
+	{
+		m_Workers[index].join();
+	}
+	m_Workers.clear();
+
+	for (size_t index = 1; index < m_Queues.size(); index++)
+	{
+		delete m_Queues[index];
+	}
+	m_Queues.resize(1);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetThreadIndex
+//--------------------------------------------------------------------------------------------------------------
+unsigned int JobSystem::GetThreadIndex() const
+{
+	return t_JobSystem == this ? t_ThreadIndex : 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Run
+// Queue a job on the calling thread's queue and wake a worker to take it.
+//--------------------------------------------------------------------------------------------------------------
+void JobSystem::Run(JobCounter& counter, const Job& job)
+{
+	counter.m_Remaining++;
+
+	QueuedJob queued;
+	queued.m_Job = job;
+	queued.m_Counter = &counter;
+
+	Queue& queue = *m_Queues[GetThreadIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.m_Mutex);
+		queue.m_Jobs.push_back(queued);
+	}
+
+	// The count is raised before the sleep mutex is taken, so a worker either sees it when it checks
+	// whether to sleep or is already asleep and gets this notification.
+	m_QueuedJobs++;
+	if (!m_Workers.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_WakeCondition.notify_one();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Wait
+// Run queued jobs until every job in the counter's group has finished.
+//--------------------------------------------------------------------------------------------------------------
+void JobSystem::Wait(JobCounter& counter)
+{
+	unsigned int threadIndex = GetThreadIndex();
+
+	while (counter.m_Remaining.load() > 0)
+	{
+		if (!TryRunJob(threadIndex))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ParallelFor
+// The calling thread runs the first chunk itself rather than waiting idle for a worker to pick it up.
+//--------------------------------------------------------------------------------------------------------------
+void JobSystem::ParallelFor(size_t count, size_t grainSize, const RangeJob& job)
+{
+	assert(grainSize > 0);
+
+	if (count <= grainSize)
+	{
+		if (count > 0)
+		{
+			job(0, count);
+		}
+		return;
+	}
+
+	JobCounter counter;
+	for (size_t begin = grainSize; begin < count; begin += grainSize)
+	{
+		size_t end = begin + grainSize < count ? begin + grainSize : count;
+		Run(counter, [&job, begin, end]() { job(begin, end); });
+	}
+
+	job(0, grainSize);
+	Wait(counter);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// TryRunJob
+// Take the newest job from this thread's own queue, or failing that the oldest from another thread's, and
+// run it. Returns false if there was nothing to run.
+//--------------------------------------------------------------------------------------------------------------
+bool JobSystem::TryRunJob(unsigned int threadIndex)
+{
+	QueuedJob queued;
+	bool found = false;
+
+	size_t queueCount = m_Queues.size();
+	for (size_t offset = 0; offset < queueCount && !found; offset++)
+	{
+		Queue& queue = *m_Queues[(threadIndex + offset) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.m_Mutex);
+
+		if (queue.m_Jobs.empty())
+		{
+			continue;
+		}
+
+		if (offset == 0)
+		{
+			queued = queue.m_Jobs.back();
+			queue.m_Jobs.pop_back();
+		}
+		else
+		{
+			queued = queue.m_Jobs.front();
+			queue.m_Jobs.pop_front();
+		}
+		found = true;
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	m_QueuedJobs--;
+	queued.m_Job();
+	queued.m_Counter->m_Remaining--;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WorkerMain
+//--------------------------------------------------------------------------------------------------------------
+void JobSystem::WorkerMain(unsigned int threadIndex)
+{
+	t_JobSystem = this;
+	t_ThreadIndex = threadIndex;
+
+#if NT_TRACE
+	char name[32];
+	snprintf(name, sizeof(name), "job worker %u", threadIndex);
+	NT_TRACE_THREAD_NAME(name);
+#endif
+
+	for (;;)
+	{
+		bool ranJob = false;
+		for (int spin = 0; spin < IDLE_SPINS && !ranJob; spin++)
+		{
+			ranJob = TryRunJob(threadIndex);
+			if (!ranJob)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		if (ranJob)
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_WakeCondition.wait(lock, [this]() { return m_Stopping || m_QueuedJobs.load() > 0; });
+		if (m_Stopping && m_QueuedJobs.load() == 0)
+		{
+			return;
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AddPhase
+// Returns the phase's id, for use with AddDependency.
+//--------------------------------------------------------------------------------------------------------------
+int PhaseGraph::AddPhase(const char* name, const PhaseFunction& function)
+{
+	Phase phase;
+	phase.m_Name = name;
+	phase.m_Function = function;
+	m_Phases.push_back(phase);
+	m_Waves.clear();
+
+	return (int)m_Phases.size() - 1;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AddDependency
+// phase won't start until dependsOn has finished.
+//--------------------------------------------------------------------------------------------------------------
+void PhaseGraph::AddDependency(int phase, int dependsOn)
+{
+	assert(phase >= 0 && phase < (int)m_Phases.size());
+	assert(dependsOn >= 0 && dependsOn < (int)m_Phases.size() && dependsOn != phase);
+
+	m_Phases[phase].m_DependsOn.push_back(dependsOn);
+	m_Waves.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+//--------------------------------------------------------------------------------------------------------------
+void PhaseGraph::Clear()
+{
+	m_Phases.clear();
+	m_Waves.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BuildWaves
+// Sort the phases into waves, each holding the phases whose dependencies are all in earlier waves.
+//--------------------------------------------------------------------------------------------------------------
+void PhaseGraph::BuildWaves()
+{
+	std::vector<int> waveOf(m_Phases.size(), -1);
+	size_t placed = 0;
+
+	while (placed < m_Phases.size())
+	{
+		std::vector<int> wave;
+		for (size_t phase = 0; phase < m_Phases.size(); phase++)
+		{
+			if (waveOf[phase] >= 0)
+			{
+				continue;
+			}
+
+			bool ready = true;
+			const std::vector<int>& dependsOn = m_Phases[phase].m_DependsOn;
+			for (size_t dependency = 0; dependency < dependsOn.size() && ready; dependency++)
+			{
+				int dependencyWave = waveOf[dependsOn[dependency]];
+				ready = dependencyWave >= 0 && dependencyWave < (int)m_Waves.size();
+			}
+
+			if (ready)
+			{
+				wave.push_back((int)phase);
+			}
+		}
+
+		// Nothing ready with phases left over means the dependencies form a cycle.
+		assert(!wave.empty());
+		if (wave.empty())
+		{
+			break;
+		}
+
+		for (size_t index = 0; index < wave.size(); index++)
+		{
+			waveOf[wave[index]] = (int)m_Waves.size();
+		}
+		placed += wave.size();
+		m_Waves.push_back(wave);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Run
+// Run every phase once. The calling thread runs the last phase of each wave itself.
+//--------------------------------------------------------------------------------------------------------------
+void PhaseGraph::Run(JobSystem& jobs)
+{
+	if (m_Waves.empty())
+	{
+		BuildWaves();
+	}
+
+	for (size_t waveIndex = 0; waveIndex < m_Waves.size(); waveIndex++)
+	{
+		const std::vector<int>& wave = m_Waves[waveIndex];
+
+		JobCounter counter;
+		for (size_t index = 0; index + 1 < wave.size(); index++)
+		{
+			jobs.Run(counter, m_Phases[wave[index]].m_Function);
+		}
+
+		m_Phases[wave.back()].m_Function();
+		jobs.Wait(counter);
+	}
+}
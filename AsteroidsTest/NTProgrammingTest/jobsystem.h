@@ -0,0 +1,127 @@
+//-------------------------------------------------------------------------------------------------------------
+// jobsystem.h
+//
+// A small work-stealing thread pool, and a graph of update phases that runs on it.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------------------------------------------------
+// JobCounter
+// Counts the jobs in a group that haven't finished yet. Wait on it to block until they all have.
+//-------------------------------------------------------------------------------------------------------------
+struct JobCounter
+{
+	JobCounter() : m_Remaining(0) {}
+
+	std::atomic<int>	m_Remaining;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// JobSystem
+// Every thread, including the one that started the pool, owns a queue. A thread pushes and pops its own jobs
+// at the back of its queue, and steals from the front of the others' when it runs out. A thread waiting on
+// a counter runs jobs while it waits instead of blocking, so jobs may themselves start and wait on jobs.
+//
+// Nothing is promised about which thread runs a job or in what order. Work is split into chunks by
+// ParallelFor's grain size alone, never by the thread count, so that callers who write each chunk's results
+// to its own place get the same answer on any number of threads.
+//-------------------------------------------------------------------------------------------------------------
+class JobSystem
+{
+public:
+	typedef std::function<void()> Job;
+	typedef std::function<void(size_t begin, size_t end)> RangeJob;
+
+	JobSystem();
+	~JobSystem();
+
+	// Start workerCount threads to help the calling thread. With none, every job runs on the calling thread
+	// when it is waited for.
+	void Start(unsigned int workerCount);
+	void Stop();
+
+	// The calling thread and the workers.
+	unsigned int GetThreadCount() const { return (unsigned int)m_Queues.size(); }
+
+	// 0 for the thread that started the pool, and 1 to GetThreadCount() - 1 for the workers. Threads that
+	// don't belong to this pool are treated as the starting thread.
+	unsigned int GetThreadIndex() const;
+
+	void Run(JobCounter& counter, const Job& job);
+	void Wait(JobCounter& counter);
+
+	// Call job for each chunk of [0, count), in chunks of grainSize, and return once all are done.
+	void ParallelFor(size_t count, size_t grainSize, const RangeJob& job);
+
+private:
+	struct QueuedJob
+	{
+		Job			m_Job;
+		JobCounter*	m_Counter;
+	};
+
+	struct Queue
+	{
+		std::mutex				m_Mutex;
+		std::deque<QueuedJob>	m_Jobs;
+	};
+
+	void WorkerMain(unsigned int threadIndex);
+	bool TryRunJob(unsigned int threadIndex);
+
+	std::vector<Queue*>			m_Queues;
+	std::vector<std::thread>	m_Workers;
+
+	std::mutex					m_SleepMutex;
+	std::condition_variable		m_WakeCondition;
+	std::atomic<int>			m_QueuedJobs;
+	bool						m_Stopping;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// PhaseGraph
+// The stages of an update and the order they must run in. Phases whose dependencies have all run go
+// together as a wave, with the phases in a wave running in parallel; a phase may also split its own work with
+// ParallelFor. Waves are fixed by the graph, not by timing, so a phase always sees the same state.
+//-------------------------------------------------------------------------------------------------------------
+class PhaseGraph
+{
+public:
+	typedef std::function<void()> PhaseFunction;
+
+	int AddPhase(const char* name, const PhaseFunction& function);
+	void AddDependency(int phase, int dependsOn);
+	void Clear();
+
+	void Run(JobSystem& jobs);
+
+	size_t GetPhaseCount() const { return m_Phases.size(); }
+	const char* GetPhaseName(int phase) const { return m_Phases[phase].m_Name; }
+
+private:
+	struct Phase
+	{
+		const char*			m_Name;
+		PhaseFunction		m_Function;
+		std::vector<int>	m_DependsOn;
+	};
+
+	void BuildWaves();
+
+	std::vector<Phase>				m_Phases;
+	std::vector<std::vector<int> >	m_Waves;
+};
@@ -0,0 +1,309 @@
+//-------------------------------------------------------------------------------------------------------------
+// kdtree.cpp
+//
+// Implementation of the k-d tree.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "kdtree.h"
+#include <algorithm>
+#include <cfloat>
+
+static const unsigned int NO_ENTRY = 0xffffffffu;
+
+//--------------------------------------------------------------------------------------------------------------
+// IsCloser
+// Orders neighbours nearest first, which makes a heap of them keep the farthest on top.
+//--------------------------------------------------------------------------------------------------------------
+static bool IsCloser(const KdTreeNeighbour& lhs, const KdTreeNeighbour& rhs)
+{
+	return lhs.m_DistanceSquared < rhs.m_DistanceSquared;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// KdTree
+//--------------------------------------------------------------------------------------------------------------
+KdTree::KdTree()
+: m_RemovedCount(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Build
+// Sort the entities into tree order through m_Order, then copy them out in that order.
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::Build(const EntityArray& entities)
+{
+	size_t count = entities.Size();
+
+	m_Order.resize(count);
+	for (size_t index = 0; index < count; index++)
+	{
+		m_Order[index] = (unsigned int)index;
+	}
+
+	// The split axes are worked out against the entities' own arrays, and stored by tree position.
+	m_X.assign(entities.m_PositionX.begin(), entities.m_PositionX.end());
+	m_Y.assign(entities.m_PositionY.begin(), entities.m_PositionY.end());
+	m_SplitAxis.assign(count, 0);
+	BuildRange(0, count);
+
+	std::vector<float> x(count), y(count);
+	m_Handles.resize(count);
+	for (size_t entry = 0; entry < count; entry++)
+	{
+		unsigned int index = m_Order[entry];
+		x[entry] = entities.m_PositionX[index];
+		y[entry] = entities.m_PositionY[index];
+		m_Handles[entry] = entities.HandleAt(index);
+	}
+	m_X.swap(x);
+	m_Y.swap(y);
+
+	m_Removed.assign(count, 0);
+	m_RemovedCount = 0;
+
+	m_EntryOfSlot.clear();
+	for (size_t entry = 0; entry < count; entry++)
+	{
+		unsigned int slot = m_Handles[entry].m_Slot;
+		if (slot >= m_EntryOfSlot.size())
+		{
+			m_EntryOfSlot.resize(slot + 1, NO_ENTRY);
+		}
+		m_EntryOfSlot[slot] = (unsigned int)entry;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BuildRange
+// Split the range at its median across its wider axis, and the halves either side of it in turn. Ties are
+// broken by index, so the same entities always build the same tree.
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::BuildRange(size_t begin, size_t end)
+{
+	if (end - begin < 2)
+	{
+		return;
+	}
+
+	float minX = FLT_MAX, minY = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	for (size_t entry = begin; entry < end; entry++)
+	{
+		unsigned int index = m_Order[entry];
+		minX = m_X[index] < minX ? m_X[index] : minX;
+		maxX = m_X[index] > maxX ? m_X[index] : maxX;
+		minY = m_Y[index] < minY ? m_Y[index] : minY;
+		maxY = m_Y[index] > maxY ? m_Y[index] : maxY;
+	}
+
+	unsigned char axis = maxY - minY > maxX - minX ? 1 : 0;
+	const std::vector<float>& coordinate = axis == 0 ? m_X : m_Y;
+
+	size_t middle = begin + (end - begin) / 2;
+	std::nth_element(m_Order.begin() + begin, m_Order.begin() + middle, m_Order.begin() + end,
+		[&coordinate](unsigned int lhs, unsigned int rhs)
+		{
+			return coordinate[lhs] < coordinate[rhs] || (coordinate[lhs] == coordinate[rhs] && lhs < rhs);
+		});
+	m_SplitAxis[middle] = axis;
+
+	BuildRange(begin, middle);
+	BuildRange(middle + 1, end);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::Clear()
+{
+	m_X.clear();
+	m_Y.clear();
+	m_Handles.clear();
+	m_SplitAxis.clear();
+	m_Removed.clear();
+	m_RemovedCount = 0;
+	m_EntryOfSlot.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Remove
+//--------------------------------------------------------------------------------------------------------------
+bool KdTree::Remove(EntityHandle handle)
+{
+	if (handle.m_Slot >= m_EntryOfSlot.size())
+	{
+		return false;
+	}
+
+	unsigned int entry = m_EntryOfSlot[handle.m_Slot];
+	if (entry == NO_ENTRY || m_Handles[entry] != handle || m_Removed[entry])
+	{
+		return false;
+	}
+
+	m_Removed[entry] = 1;
+	m_RemovedCount++;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// QueryNearest
+//--------------------------------------------------------------------------------------------------------------
+bool KdTree::QueryNearest(float x, float y, float maxDistance, KdTreeNeighbour& outNeighbour) const
+{
+	KdTreeNeighbour best;
+	best.m_DistanceSquared = maxDistance * maxDistance;
+	QueryNearestRange(0, Size(), x, y, best);
+
+	if (best.m_Handle.IsNull())
+	{
+		return false;
+	}
+	outNeighbour = best;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// QueryNearestRange
+// Look in the half of the range the point is in first, so that the best found so far is close by the time
+// the other half is considered, and skip that half if the splitting line is further away than the best.
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::QueryNearestRange(size_t begin, size_t end, float x, float y, KdTreeNeighbour& best) const
+{
+	if (begin >= end)
+	{
+		return;
+	}
+
+	size_t middle = begin + (end - begin) / 2;
+	float dx = x - m_X[middle];
+	float dy = y - m_Y[middle];
+	float distanceSquared = dx * dx + dy * dy;
+	if (distanceSquared < best.m_DistanceSquared && !m_Removed[middle])
+	{
+		best.m_Handle = m_Handles[middle];
+		best.m_DistanceSquared = distanceSquared;
+	}
+
+	float side = m_SplitAxis[middle] == 0 ? dx : dy;
+	if (side < 0.f)
+	{
+		QueryNearestRange(begin, middle, x, y, best);
+		if (side * side < best.m_DistanceSquared)
+		{
+			QueryNearestRange(middle + 1, end, x, y, best);
+		}
+	}
+	else
+	{
+		QueryNearestRange(middle + 1, end, x, y, best);
+		if (side * side < best.m_DistanceSquared)
+		{
+			QueryNearestRange(begin, middle, x, y, best);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// QueryNearest
+// The closest found so far are kept in a heap with the farthest of them on top, which is the one to beat.
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::QueryNearest(float x, float y, size_t count, std::vector<KdTreeNeighbour>& outNeighbours) const
+{
+	outNeighbours.clear();
+	if (count == 0)
+	{
+		return;
+	}
+
+	QueryNearestRange(0, Size(), x, y, count, outNeighbours);
+	std::sort_heap(outNeighbours.begin(), outNeighbours.end(), IsCloser);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// QueryNearestRange
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::QueryNearestRange(size_t begin, size_t end, float x, float y, size_t count, std::vector<KdTreeNeighbour>& heap) const
+{
+	if (begin >= end)
+	{
+		return;
+	}
+
+	size_t middle = begin + (end - begin) / 2;
+	float dx = x - m_X[middle];
+	float dy = y - m_Y[middle];
+	float distanceSquared = dx * dx + dy * dy;
+	if (!m_Removed[middle])
+	{
+		if (heap.size() < count)
+		{
+			KdTreeNeighbour neighbour;
+			neighbour.m_Handle = m_Handles[middle];
+			neighbour.m_DistanceSquared = distanceSquared;
+			heap.push_back(neighbour);
+			std::push_heap(heap.begin(), heap.end(), IsCloser);
+		}
+		else if (distanceSquared < heap.front().m_DistanceSquared)
+		{
+			std::pop_heap(heap.begin(), heap.end(), IsCloser);
+			heap.back().m_Handle = m_Handles[middle];
+			heap.back().m_DistanceSquared = distanceSquared;
+			std::push_heap(heap.begin(), heap.end(), IsCloser);
+		}
+	}
+
+	float side = m_SplitAxis[middle] == 0 ? dx : dy;
+	size_t nearBegin = side < 0.f ? begin : middle + 1;
+	size_t nearEnd = side < 0.f ? middle : end;
+	size_t farBegin = side < 0.f ? middle + 1 : begin;
+	size_t farEnd = side < 0.f ? end : middle;
+
+	QueryNearestRange(nearBegin, nearEnd, x, y, count, heap);
+	if (heap.size() < count || side * side < heap.front().m_DistanceSquared)
+	{
+		QueryNearestRange(farBegin, farEnd, x, y, count, heap);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// QueryRadius
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::QueryRadius(float x, float y, float radius, std::vector<EntityHandle>& outHandles) const
+{
+	QueryRadiusRange(0, Size(), x, y, radius * radius, outHandles);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// QueryRadiusRange
+//--------------------------------------------------------------------------------------------------------------
+void KdTree::QueryRadiusRange(size_t begin, size_t end, float x, float y, float radiusSquared, std::vector<EntityHandle>& outHandles) const
+{
+	if (begin >= end)
+	{
+		return;
+	}
+
+	size_t middle = begin + (end - begin) / 2;
+	float dx = x - m_X[middle];
+	float dy = y - m_Y[middle];
+	if (dx * dx + dy * dy < radiusSquared && !m_Removed[middle])
+	{
+		outHandles.push_back(m_Handles[middle]);
+	}
+
+	float side = m_SplitAxis[middle] == 0 ? dx : dy;
+	if (side < 0.f || side * side < radiusSquared)
+	{
+		QueryRadiusRange(begin, middle, x, y, radiusSquared, outHandles);
+	}
+	if (side >= 0.f || side * side < radiusSquared)
+	{
+		QueryRadiusRange(middle + 1, end, x, y, radiusSquared, outHandles);
+	}
+}
@@ -0,0 +1,82 @@
+//-------------------------------------------------------------------------------------------------------------
+// kdtree.h
+//
+// A k-d tree over objects that don't move, such as suns and asteroids, for finding the nearest ones to a
+// point. Built once and then only read, so it is laid out for lookups rather than for change.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "entitystore.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// KdTreeNeighbour
+// An object found by a query, and its squared distance from the query point.
+//-------------------------------------------------------------------------------------------------------------
+struct KdTreeNeighbour
+{
+	EntityHandle	m_Handle;
+	float			m_DistanceSquared;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// KdTree
+// The tree has no nodes as such: entries are sorted so that each range's median splits it, with the lower
+// half before it and the upper half after, so the tree is implicit in a flat array and a query walks it
+// without following pointers. Each range is split across whichever axis it is wider in.
+//
+// Entries are entity handles, since removing an entity moves others to new indices. An object destroyed after
+// the build can be marked removed, which hides it from queries but leaves the tree's shape, and so the cost
+// of a query, as it was; rebuild once enough have gone.
+//-------------------------------------------------------------------------------------------------------------
+class KdTree
+{
+public:
+	KdTree();
+
+	void Build(const EntityArray& entities);
+	void Clear();
+
+	// Entries in the tree, including those marked removed.
+	size_t Size() const { return m_X.size(); }
+	size_t GetRemovedCount() const { return m_RemovedCount; }
+
+	// Hide an entity from queries. Returns false if it isn't in the tree or is already removed.
+	bool Remove(EntityHandle handle);
+
+	// Find the entity closest to the point that is less than maxDistance away. Returns false if there isn't one.
+	bool QueryNearest(float x, float y, float maxDistance, KdTreeNeighbour& outNeighbour) const;
+
+	// Find the count entities closest to the point, or all of them if there are fewer, nearest first.
+	void QueryNearest(float x, float y, size_t count, std::vector<KdTreeNeighbour>& outNeighbours) const;
+
+	// Append every entity less than radius from the point, in no particular order.
+	void QueryRadius(float x, float y, float radius, std::vector<EntityHandle>& outHandles) const;
+
+private:
+	void BuildRange(size_t begin, size_t end);
+	void QueryNearestRange(size_t begin, size_t end, float x, float y, KdTreeNeighbour& best) const;
+	void QueryNearestRange(size_t begin, size_t end, float x, float y, size_t count, std::vector<KdTreeNeighbour>& heap) const;
+	void QueryRadiusRange(size_t begin, size_t end, float x, float y, float radiusSquared, std::vector<EntityHandle>& outHandles) const;
+
+	// The entries, in tree order. m_SplitAxis is 0 if the range an entry is the median of is split across x,
+	// and 1 if across y.
+	std::vector<float>			m_X;
+	std::vector<float>			m_Y;
+	std::vector<EntityHandle>	m_Handles;
+	std::vector<unsigned char>	m_SplitAxis;
+	std::vector<unsigned char>	m_Removed;
+	size_t						m_RemovedCount;
+
+	// Where each entity slot's entry is, so removal doesn't have to search.
+	std::vector<unsigned int>	m_EntryOfSlot;
+
+	// Working order for the build.
+	std::vector<unsigned int>	m_Order;
+};
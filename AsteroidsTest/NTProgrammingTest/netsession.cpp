@@ -0,0 +1,748 @@
+//-------------------------------------------------------------------------------------------------------------
+// netsession.cpp
+//
+// Implementation of the multiplayer server and client.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "netsession.h"
+#include "game.h"
+#include "trace.h"
+#include <chrono>
+
+//-------------------------------------------------------------------------------------------------------------
+// Constants
+//-------------------------------------------------------------------------------------------------------------
+
+// Starts every packet, so that stray datagrams, and packets from another version, are ignored.
+static const unsigned int PROTOCOL_ID = 0x4e544101;
+
+// The most a UDP datagram over IPv4 can carry.
+static const size_t MAX_PACKET_SIZE = 65507;
+
+// Clients' ships start somewhere in the middle of the field, as the bots do.
+static const float SPAWN_MIN_X = 100.f;
+static const float SPAWN_MAX_X = 1500.f;
+static const float SPAWN_MIN_Y = 100.f;
+static const float SPAWN_MAX_Y = 1000.f;
+
+//-------------------------------------------------------------------------------------------------------------
+// PacketType
+//
+// CONNECT		client to server, until answered
+// ACCEPT		server to client: the ship's slot and generation
+// REJECT		server to client, when full
+// INPUT		client to server, every tick: a sequence number, the ship's controls, and the latest snapshot
+//				decoded, if any
+// SNAPSHOT		server to client: the tick, the baseline's tick, if any, and the snapshot encoded against it
+// DISCONNECT	either way
+//-------------------------------------------------------------------------------------------------------------
+enum PacketType
+{
+	PACKET_CONNECT,
+	PACKET_ACCEPT,
+	PACKET_REJECT,
+	PACKET_INPUT,
+	PACKET_SNAPSHOT,
+	PACKET_DISCONNECT
+};
+
+typedef std::chrono::steady_clock Clock;
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteHeader
+//--------------------------------------------------------------------------------------------------------------
+static void WriteHeader(BitWriter& writer, PacketType type)
+{
+	writer.WriteBits(PROTOCOL_ID, 32);
+	writer.WriteBits(type, 8);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReadHeader
+// Returns false for a packet that isn't ours.
+//--------------------------------------------------------------------------------------------------------------
+static bool ReadHeader(BitReader& reader, PacketType& outType)
+{
+	if (reader.ReadBits(32) != PROTOCOL_ID)
+	{
+		return false;
+	}
+	outType = (PacketType)reader.ReadBits(8);
+	return !reader.HasFailed();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Seconds
+//--------------------------------------------------------------------------------------------------------------
+static double Seconds(Clock::time_point from, Clock::time_point to)
+{
+	return std::chrono::duration<double>(to - from).count();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// NetServer
+//--------------------------------------------------------------------------------------------------------------
+NetServer::NetServer()
+: m_Game(NULL)
+, m_LastSnapshotTick(0)
+, m_PacketCount(0)
+{
+	for (unsigned int index = 0; index < NET_SNAPSHOT_HISTORY; index++)
+	{
+		m_HistoryValid[index] = false;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~NetServer
+//--------------------------------------------------------------------------------------------------------------
+NetServer::~NetServer()
+{
+	Stop();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Start
+//--------------------------------------------------------------------------------------------------------------
+bool NetServer::Start(Game& game, const NetServerSettings& settings)
+{
+	Stop();
+	assert(settings.m_SnapshotInterval > 0);
+
+	if (!m_Socket.Open(settings.m_Address))
+	{
+		return false;
+	}
+
+	m_Game = &game;
+	m_Settings = settings;
+	m_Stats = NetServerStats();
+	for (unsigned int index = 0; index < NET_SNAPSHOT_HISTORY; index++)
+	{
+		m_HistoryValid[index] = false;
+	}
+	m_LastSnapshotTick = ~0ull;
+	m_ReceiveBuffer.resize(MAX_PACKET_SIZE + 1);
+
+	game.SetController(CONTROLLER_REMOTE, &m_Controller);
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Stop
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::Stop()
+{
+	if (!m_Socket.IsOpen())
+	{
+		return;
+	}
+
+	while (!m_Clients.empty())
+	{
+		SendControl(m_Clients.back(), PACKET_DISCONNECT);
+		RemoveClient(m_Clients.size() - 1);
+	}
+	m_Game->SetController(CONTROLLER_REMOTE, NULL);
+	m_Socket.Close();
+	m_Game = NULL;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReceivePackets
+// Everything waiting is handled, then clients that have gone quiet are dropped.
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::ReceivePackets()
+{
+	NT_TRACE_SCOPE_COUNT("net receive", m_Clients.size());
+	assert(m_Socket.IsOpen());
+	Clock::time_point start = Clock::now();
+
+	NetAddress from;
+	size_t size;
+	while ((size = m_Socket.Receive(&m_ReceiveBuffer[0], m_ReceiveBuffer.size(), from)) > 0)
+	{
+		HandlePacket(from, &m_ReceiveBuffer[0], size);
+	}
+
+	unsigned long long tick = m_Game->GetTickCount();
+	for (size_t client = m_Clients.size(); client-- > 0;)
+	{
+		if (tick - m_Clients[client].m_LastHeardTick > m_Settings.m_TimeoutTicks)
+		{
+			SendControl(m_Clients[client], PACKET_DISCONNECT);
+			RemoveClient(client);
+			m_Stats.m_TimedOut++;
+		}
+	}
+
+	m_Stats.m_ReceiveTime += Seconds(start, Clock::now());
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// HandlePacket
+// Input is acted on only if it is newer than what the client last sent, since datagrams can arrive out of
+// order; the same goes for acknowledgements.
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::HandlePacket(const NetAddress& from, const unsigned char* data, size_t size)
+{
+	BitReader reader(data, size);
+	PacketType type;
+	if (!ReadHeader(reader, type))
+	{
+		return;
+	}
+
+	size_t clientIndex = FindClient(from);
+	if (clientIndex == m_Clients.size())
+	{
+		if (type == PACKET_CONNECT)
+		{
+			m_Stats.m_Traffic.m_PacketsReceived++;
+			m_Stats.m_Traffic.m_BytesReceived += size;
+			AddClient(from);
+		}
+		return;
+	}
+
+	Client& client = m_Clients[clientIndex];
+	client.m_Stats.m_PacketsReceived++;
+	client.m_Stats.m_BytesReceived += size;
+	m_Stats.m_Traffic.m_PacketsReceived++;
+	m_Stats.m_Traffic.m_BytesReceived += size;
+	client.m_LastHeardTick = m_Game->GetTickCount();
+
+	switch (type)
+	{
+	case PACKET_CONNECT:
+		// The accept was lost.
+		SendControl(client, PACKET_ACCEPT);
+		break;
+
+	case PACKET_INPUT:
+		{
+			unsigned int sequence = reader.ReadBits(32);
+			ShipCommand command;
+			command.m_Controls = (unsigned char)reader.ReadBits(8);
+			bool hasAck = reader.ReadBool();
+			unsigned int ackedTick = hasAck ? reader.ReadBits(32) : 0;
+			if (reader.HasFailed())
+			{
+				break;
+			}
+
+			if ((int)(sequence - client.m_InputSequence) > 0)
+			{
+				client.m_InputSequence = sequence;
+				m_Controller.SetCommand(client.m_Ship, command);
+			}
+			if (hasAck && (!client.m_HasAck || (int)(ackedTick - client.m_AckedTick) > 0))
+			{
+				client.m_HasAck = true;
+				client.m_AckedTick = ackedTick;
+			}
+		}
+		break;
+
+	case PACKET_DISCONNECT:
+		RemoveClient(clientIndex);
+		m_Stats.m_Disconnected++;
+		break;
+
+	default:
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AddClient
+// Each connection's ship starts from its own stream, so where one starts doesn't depend on who else joined.
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::AddClient(const NetAddress& address)
+{
+	Client client;
+	client.m_Address = address;
+	client.m_InputSequence = 0;
+	client.m_HasAck = false;
+	client.m_AckedTick = 0;
+	client.m_LastHeardTick = m_Game->GetTickCount();
+
+	if (m_Clients.size() >= m_Settings.m_MaxClients)
+	{
+		SendControl(client, PACKET_REJECT);
+		m_Stats.m_Rejected++;
+		return;
+	}
+
+	RandomStream spawnRandom(m_Game->GetSeed(), RANDOM_STREAM_NETWORK, m_Stats.m_Connected);
+	float x = spawnRandom.NextRange(SPAWN_MIN_X, SPAWN_MAX_X);
+	float y = spawnRandom.NextRange(SPAWN_MIN_Y, SPAWN_MAX_Y);
+	client.m_Ship = Ship::Spawn(m_Game->m_Ships, NTPoint(x, y), CONTROLLER_REMOTE);
+	m_Stats.m_Connected++;
+
+	m_Clients.push_back(client);
+	SendControl(m_Clients.back(), PACKET_ACCEPT);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// RemoveClient
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::RemoveClient(size_t client)
+{
+	EntityHandle ship = m_Clients[client].m_Ship;
+	m_Controller.ClearCommand(ship);
+	if (m_Game->m_Ships.Contains(ship))
+	{
+		m_Game->m_Ships.Remove(ship);
+	}
+	m_Clients.erase(m_Clients.begin() + client);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FindClient
+// The client's index, or the client count if there is none from that address.
+//--------------------------------------------------------------------------------------------------------------
+size_t NetServer::FindClient(const NetAddress& address) const
+{
+	size_t client = 0;
+	while (client < m_Clients.size() && m_Clients[client].m_Address != address)
+	{
+		client++;
+	}
+	return client;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SendControl
+// A packet with nothing but the header, or with the ship for an accept.
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::SendControl(Client& client, int type)
+{
+	m_SendBuffer.clear();
+	BitWriter writer(m_SendBuffer);
+	WriteHeader(writer, (PacketType)type);
+	if (type == PACKET_ACCEPT)
+	{
+		writer.WriteBits(client.m_Ship.m_Slot, 32);
+		writer.WriteBits(client.m_Ship.m_Generation, 32);
+	}
+	writer.Flush();
+	Send(client, m_SendBuffer);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SendSnapshots
+// Nothing is sent unless a tick has run since the last call, and then only on the snapshot interval, and only
+// to clients that have sent input.
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::SendSnapshots()
+{
+	assert(m_Socket.IsOpen());
+
+	unsigned long long tick = m_Game->GetTickCount();
+	if (tick == m_LastSnapshotTick || tick % m_Settings.m_SnapshotInterval != 0)
+	{
+		return;
+	}
+	m_LastSnapshotTick = tick;
+	NT_TRACE_SCOPE_COUNT("net send", m_Clients.size());
+
+	Clock::time_point start = Clock::now();
+	unsigned int slot = (unsigned int)(tick % NET_SNAPSHOT_HISTORY);
+	NetSnapshot& snapshot = m_History[slot];
+	snapshot.Capture(*m_Game);
+	m_HistoryValid[slot] = true;
+	m_Stats.m_Snapshots++;
+
+	Clock::time_point captured = Clock::now();
+	m_Stats.m_CaptureTime += Seconds(start, captured);
+
+	double encodeTime = m_Stats.m_EncodeTime;
+	m_PacketCount = 0;
+	for (size_t clientIndex = 0; clientIndex < m_Clients.size(); clientIndex++)
+	{
+		Client& client = m_Clients[clientIndex];
+		if (client.m_InputSequence == 0)
+		{
+			// Not heard from since being accepted, so the accept may have been lost, and the client would
+			// ignore the snapshot.
+			continue;
+		}
+
+		const NetSnapshot* baseline = client.m_HasAck ? FindSnapshot(client.m_AckedTick) : NULL;
+		const EncodedPacket& packet = GetSnapshotPacket(snapshot, baseline);
+		if (packet.m_Data.size() > MAX_PACKET_SIZE)
+		{
+			m_Stats.m_OversizedPackets++;
+			continue;
+		}
+
+		Send(client, packet.m_Data);
+		if (baseline != NULL)
+		{
+			client.m_Stats.m_DeltaSnapshots++;
+			m_Stats.m_Traffic.m_DeltaSnapshots++;
+		}
+		else
+		{
+			client.m_Stats.m_FullSnapshots++;
+			m_Stats.m_Traffic.m_FullSnapshots++;
+		}
+		if (packet.m_Data.size() > client.m_Stats.m_LargestSnapshot)
+		{
+			client.m_Stats.m_LargestSnapshot = packet.m_Data.size();
+		}
+		if (packet.m_Data.size() > m_Stats.m_Traffic.m_LargestSnapshot)
+		{
+			m_Stats.m_Traffic.m_LargestSnapshot = packet.m_Data.size();
+		}
+	}
+
+	m_Stats.m_SendTime += Seconds(captured, Clock::now()) - (m_Stats.m_EncodeTime - encodeTime);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FindSnapshot
+//--------------------------------------------------------------------------------------------------------------
+const NetSnapshot* NetServer::FindSnapshot(unsigned int tick) const
+{
+	unsigned int slot = tick % NET_SNAPSHOT_HISTORY;
+	return m_HistoryValid[slot] && m_History[slot].m_Tick == tick ? &m_History[slot] : NULL;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetSnapshotPacket
+// This tick's packet for the baseline, encoding it if no other client has needed it yet.
+//--------------------------------------------------------------------------------------------------------------
+const NetServer::EncodedPacket& NetServer::GetSnapshotPacket(const NetSnapshot& snapshot, const NetSnapshot* baseline)
+{
+	for (size_t index = 0; index < m_PacketCount; index++)
+	{
+		const EncodedPacket& packet = m_Packets[index];
+		if (packet.m_HasBaseline == (baseline != NULL) && (baseline == NULL || packet.m_BaselineTick == baseline->m_Tick))
+		{
+			m_Stats.m_SharedPackets++;
+			return packet;
+		}
+	}
+
+	Clock::time_point start = Clock::now();
+	if (m_PacketCount == m_Packets.size())
+	{
+		m_Packets.push_back(EncodedPacket());
+	}
+	EncodedPacket& packet = m_Packets[m_PacketCount++];
+	packet.m_HasBaseline = baseline != NULL;
+	packet.m_BaselineTick = baseline != NULL ? baseline->m_Tick : 0;
+	packet.m_Data.clear();
+
+	BitWriter writer(packet.m_Data);
+	WriteHeader(writer, PACKET_SNAPSHOT);
+	writer.WriteBits(snapshot.m_Tick, 32);
+	writer.WriteBool(baseline != NULL);
+	if (baseline != NULL)
+	{
+		writer.WriteBits(baseline->m_Tick, 32);
+	}
+	snapshot.Encode(baseline, writer);
+	writer.Flush();
+
+	m_Stats.m_EncodedPackets++;
+	m_Stats.m_EncodeTime += Seconds(start, Clock::now());
+	return packet;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Send
+//--------------------------------------------------------------------------------------------------------------
+void NetServer::Send(Client& client, const std::vector<unsigned char>& packet)
+{
+	m_Socket.Send(client.m_Address, &packet[0], packet.size());
+	client.m_Stats.m_PacketsSent++;
+	client.m_Stats.m_BytesSent += packet.size();
+	m_Stats.m_Traffic.m_PacketsSent++;
+	m_Stats.m_Traffic.m_BytesSent += packet.size();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// NetClient
+//--------------------------------------------------------------------------------------------------------------
+NetClient::NetClient()
+: m_State(NET_CLIENT_DISCONNECTED)
+, m_UpdatesSinceConnect(0)
+, m_InputSequence(0)
+, m_HasSnapshot(false)
+, m_LatestTick(0)
+{
+	for (unsigned int index = 0; index < NET_SNAPSHOT_HISTORY; index++)
+	{
+		m_HistoryValid[index] = false;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~NetClient
+//--------------------------------------------------------------------------------------------------------------
+NetClient::~NetClient()
+{
+	Disconnect();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Connect
+//--------------------------------------------------------------------------------------------------------------
+bool NetClient::Connect(const NetAddress& server, const NetClientSettings& settings)
+{
+	Disconnect();
+
+	if (!m_Socket.Open(NetAddress()))
+	{
+		return false;
+	}
+
+	m_Settings = settings;
+	m_Server = server;
+	m_LossRandom.Seed(settings.m_LossSeed, RANDOM_STREAM_NETWORK);
+	m_State = NET_CLIENT_CONNECTING;
+	m_Ship = EntityHandle();
+	m_Command = ShipCommand();
+	m_InputSequence = 0;
+	m_HasSnapshot = false;
+	m_LatestTick = 0;
+	m_Stats = NetClientStats();
+	for (unsigned int index = 0; index < NET_SNAPSHOT_HISTORY; index++)
+	{
+		m_HistoryValid[index] = false;
+	}
+	m_ReceiveBuffer.resize(MAX_PACKET_SIZE + 1);
+
+	SendConnect();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Disconnect
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::Disconnect()
+{
+	if (m_Socket.IsOpen() && (m_State == NET_CLIENT_CONNECTING || m_State == NET_CLIENT_CONNECTED))
+	{
+		SendDisconnect();
+	}
+	m_Socket.Close();
+	m_State = NET_CLIENT_DISCONNECTED;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Update
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::Update()
+{
+	if (!m_Socket.IsOpen())
+	{
+		return;
+	}
+
+	NetAddress from;
+	size_t size;
+	while ((size = m_Socket.Receive(&m_ReceiveBuffer[0], m_ReceiveBuffer.size(), from)) > 0)
+	{
+		if (from != m_Server)
+		{
+			continue;
+		}
+		if (m_Settings.m_SimulatedLoss > 0.f && m_LossRandom.NextUnit() < m_Settings.m_SimulatedLoss)
+		{
+			m_Stats.m_PacketsLost++;
+			continue;
+		}
+
+		m_Stats.m_PacketsReceived++;
+		m_Stats.m_BytesReceived += size;
+		HandlePacket(&m_ReceiveBuffer[0], size);
+		if (!m_Socket.IsOpen())
+		{
+			return;
+		}
+	}
+
+	if (m_State == NET_CLIENT_CONNECTING)
+	{
+		if (++m_UpdatesSinceConnect >= m_Settings.m_ConnectInterval)
+		{
+			SendConnect();
+		}
+	}
+	else if (m_State == NET_CLIENT_CONNECTED)
+	{
+		SendInput();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetLatestSnapshot
+//--------------------------------------------------------------------------------------------------------------
+const NetSnapshot* NetClient::GetLatestSnapshot() const
+{
+	return m_HasSnapshot ? &m_History[m_LatestTick % NET_SNAPSHOT_HISTORY] : NULL;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// HandlePacket
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::HandlePacket(const unsigned char* data, size_t size)
+{
+	BitReader reader(data, size);
+	PacketType type;
+	if (!ReadHeader(reader, type))
+	{
+		return;
+	}
+
+	switch (type)
+	{
+	case PACKET_ACCEPT:
+		if (m_State == NET_CLIENT_CONNECTING)
+		{
+			unsigned int slot = reader.ReadBits(32);
+			unsigned int generation = reader.ReadBits(32);
+			if (!reader.HasFailed())
+			{
+				m_Ship = EntityHandle(slot, generation);
+				m_State = NET_CLIENT_CONNECTED;
+			}
+		}
+		break;
+
+	case PACKET_REJECT:
+		if (m_State == NET_CLIENT_CONNECTING)
+		{
+			m_Socket.Close();
+			m_State = NET_CLIENT_REJECTED;
+		}
+		break;
+
+	case PACKET_SNAPSHOT:
+		if (m_State == NET_CLIENT_CONNECTED)
+		{
+			HandleSnapshot(reader);
+		}
+		break;
+
+	case PACKET_DISCONNECT:
+		m_Socket.Close();
+		m_State = NET_CLIENT_DISCONNECTED;
+		break;
+
+	default:
+		break;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// HandleSnapshot
+// A snapshot is decoded into the history slot for its tick. The server never encodes against a snapshot as
+// old as the history, so the slot never holds the baseline.
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::HandleSnapshot(BitReader& reader)
+{
+	unsigned int tick = reader.ReadBits(32);
+	bool hasBaseline = reader.ReadBool();
+	unsigned int baselineTick = hasBaseline ? reader.ReadBits(32) : 0;
+	if (reader.HasFailed())
+	{
+		m_Stats.m_Malformed++;
+		return;
+	}
+
+	if (m_HasSnapshot && (int)(tick - m_LatestTick) <= 0)
+	{
+		m_Stats.m_SnapshotsStale++;
+		return;
+	}
+
+	unsigned int slot = tick % NET_SNAPSHOT_HISTORY;
+	const NetSnapshot* baseline = NULL;
+	if (hasBaseline)
+	{
+		unsigned int baselineSlot = baselineTick % NET_SNAPSHOT_HISTORY;
+		if (!m_HistoryValid[baselineSlot] || m_History[baselineSlot].m_Tick != baselineTick || baselineSlot == slot)
+		{
+			m_Stats.m_MissingBaselines++;
+			return;
+		}
+		baseline = &m_History[baselineSlot];
+	}
+
+	NetSnapshot& snapshot = m_History[slot];
+	m_HistoryValid[slot] = false;
+	if (!snapshot.Decode(reader, baseline))
+	{
+		m_Stats.m_Malformed++;
+		return;
+	}
+
+	snapshot.m_Tick = tick;
+	m_HistoryValid[slot] = true;
+	m_HasSnapshot = true;
+	m_LatestTick = tick;
+	m_Stats.m_SnapshotsDecoded++;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Send
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::Send(const std::vector<unsigned char>& packet)
+{
+	m_Socket.Send(m_Server, &packet[0], packet.size());
+	m_Stats.m_PacketsSent++;
+	m_Stats.m_BytesSent += packet.size();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SendConnect
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::SendConnect()
+{
+	m_SendBuffer.clear();
+	BitWriter writer(m_SendBuffer);
+	WriteHeader(writer, PACKET_CONNECT);
+	writer.Flush();
+	Send(m_SendBuffer);
+	m_UpdatesSinceConnect = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SendInput
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::SendInput()
+{
+	m_SendBuffer.clear();
+	BitWriter writer(m_SendBuffer);
+	WriteHeader(writer, PACKET_INPUT);
+	writer.WriteBits(++m_InputSequence, 32);
+	writer.WriteBits(m_Command.m_Controls, 8);
+	writer.WriteBool(m_HasSnapshot);
+	if (m_HasSnapshot)
+	{
+		writer.WriteBits(m_LatestTick, 32);
+	}
+	writer.Flush();
+	Send(m_SendBuffer);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SendDisconnect
+//--------------------------------------------------------------------------------------------------------------
+void NetClient::SendDisconnect()
+{
+	m_SendBuffer.clear();
+	BitWriter writer(m_SendBuffer);
+	WriteHeader(writer, PACKET_DISCONNECT);
+	writer.Flush();
+	Send(m_SendBuffer);
+}
@@ -0,0 +1,327 @@
+//-------------------------------------------------------------------------------------------------------------
+// netsession.h
+//
+// Server-authoritative multiplayer over UDP. The server runs the game; each client flies one ship, sending the
+// server its ship's command every tick and drawing the snapshots the server sends back. Clients never
+// simulate, so they can't disagree with the server.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "controller.h"
+#include "entitystore.h"
+#include "netsnapshot.h"
+#include "netsocket.h"
+#include "random.h"
+
+// Externally defined classes.
+class Game;
+
+// Snapshots kept by both ends to encode against and decode against. A client that hasn't acknowledged a
+// snapshot for this many ticks is sent the next one in full.
+static const unsigned int NET_SNAPSHOT_HISTORY = 64;
+
+//-------------------------------------------------------------------------------------------------------------
+// NetConnectionStats
+// Traffic with one client, as the server sees it.
+//-------------------------------------------------------------------------------------------------------------
+struct NetConnectionStats
+{
+	NetConnectionStats()
+	: m_PacketsSent(0)
+	, m_BytesSent(0)
+	, m_PacketsReceived(0)
+	, m_BytesReceived(0)
+	, m_FullSnapshots(0)
+	, m_DeltaSnapshots(0)
+	, m_LargestSnapshot(0)
+	{
+	}
+
+	unsigned long long	m_PacketsSent;
+	unsigned long long	m_BytesSent;
+	unsigned long long	m_PacketsReceived;
+	unsigned long long	m_BytesReceived;
+	unsigned long long	m_FullSnapshots;
+	unsigned long long	m_DeltaSnapshots;
+	size_t				m_LargestSnapshot;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetServerStats
+// Totals since the server started. Times are in seconds.
+//-------------------------------------------------------------------------------------------------------------
+struct NetServerStats
+{
+	NetServerStats()
+	: m_Snapshots(0)
+	, m_Connected(0)
+	, m_Disconnected(0)
+	, m_TimedOut(0)
+	, m_Rejected(0)
+	, m_EncodedPackets(0)
+	, m_SharedPackets(0)
+	, m_OversizedPackets(0)
+	, m_ReceiveTime(0.)
+	, m_CaptureTime(0.)
+	, m_EncodeTime(0.)
+	, m_SendTime(0.)
+	{
+	}
+
+	// Snapshots captured, and clients that came and went.
+	unsigned long long	m_Snapshots;
+	unsigned long long	m_Connected;
+	unsigned long long	m_Disconnected;
+	unsigned long long	m_TimedOut;
+	unsigned long long	m_Rejected;
+
+	// Snapshot packets encoded, and sent to a client as already encoded for another with the same baseline.
+	// Oversized packets were too big for a datagram and weren't sent.
+	unsigned long long	m_EncodedPackets;
+	unsigned long long	m_SharedPackets;
+	unsigned long long	m_OversizedPackets;
+
+	// Every client's traffic added up, including clients that have since gone.
+	NetConnectionStats	m_Traffic;
+
+	double				m_ReceiveTime;
+	double				m_CaptureTime;
+	double				m_EncodeTime;
+	double				m_SendTime;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetServerSettings
+//-------------------------------------------------------------------------------------------------------------
+struct NetServerSettings
+{
+	NetServerSettings()
+	: m_Address(0, 0)
+	, m_MaxClients(256)
+	, m_SnapshotInterval(1)
+	, m_TimeoutTicks(300)
+	{
+	}
+
+	// Where to listen. Host 0 listens on every interface, and port 0 picks a free port.
+	NetAddress		m_Address;
+
+	size_t			m_MaxClients;
+
+	// Send a snapshot every this many ticks.
+	unsigned int	m_SnapshotInterval;
+
+	// Drop a client that hasn't been heard from for this many ticks.
+	unsigned int	m_TimeoutTicks;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetServer
+// Drives the game's remote ships from its clients. Call ReceivePackets before each update and SendSnapshots
+// after it. A client's ship is spawned when it connects and removed when it leaves or times out.
+//
+// Each snapshot is encoded against the latest one its client has acknowledged, so a lost packet only makes
+// the next ones bigger, never wrong. Clients that acknowledged the same snapshot are sent the same packet,
+// encoded once.
+//-------------------------------------------------------------------------------------------------------------
+class NetServer
+{
+public:
+	NetServer();
+	~NetServer();
+
+	// Open the socket and take over the game's remote ships. Returns false if the socket couldn't be opened.
+	bool Start(Game& game, const NetServerSettings& settings);
+
+	// Tell every client, and give the remote ships back to the game.
+	void Stop();
+
+	void ReceivePackets();
+	void SendSnapshots();
+
+	NetAddress GetAddress() const { return m_Socket.GetAddress(); }
+	size_t GetClientCount() const { return m_Clients.size(); }
+	const NetConnectionStats& GetClientStats(size_t client) const { return m_Clients[client].m_Stats; }
+	const NetServerStats& GetStats() const { return m_Stats; }
+
+	// A snapshot sent in the last NET_SNAPSHOT_HISTORY ticks, or NULL.
+	const NetSnapshot* FindSnapshot(unsigned int tick) const;
+
+private:
+	struct Client
+	{
+		NetAddress			m_Address;
+		EntityHandle		m_Ship;
+		unsigned int		m_InputSequence;
+		bool				m_HasAck;
+		unsigned int		m_AckedTick;
+		unsigned long long	m_LastHeardTick;
+		NetConnectionStats	m_Stats;
+	};
+
+	// A snapshot packet for the current tick, encoded against one baseline, or none.
+	struct EncodedPacket
+	{
+		bool						m_HasBaseline;
+		unsigned int				m_BaselineTick;
+		std::vector<unsigned char>	m_Data;
+	};
+
+	void HandlePacket(const NetAddress& from, const unsigned char* data, size_t size);
+	void AddClient(const NetAddress& address);
+	void RemoveClient(size_t client);
+	size_t FindClient(const NetAddress& address) const;
+	void SendControl(Client& client, int type);
+	const EncodedPacket& GetSnapshotPacket(const NetSnapshot& snapshot, const NetSnapshot* baseline);
+	void Send(Client& client, const std::vector<unsigned char>& packet);
+
+	Game*						m_Game;
+	NetServerSettings			m_Settings;
+	UdpSocket					m_Socket;
+	RemoteController			m_Controller;
+	std::vector<Client>			m_Clients;
+	NetServerStats				m_Stats;
+
+	NetSnapshot					m_History[NET_SNAPSHOT_HISTORY];
+	bool						m_HistoryValid[NET_SNAPSHOT_HISTORY];
+	unsigned long long			m_LastSnapshotTick;
+
+	// This tick's encoded packets, and how many are in use; the rest keep their storage for later ticks.
+	std::vector<EncodedPacket>	m_Packets;
+	size_t						m_PacketCount;
+
+	std::vector<unsigned char>	m_ReceiveBuffer;
+	std::vector<unsigned char>	m_SendBuffer;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetClientStats
+//-------------------------------------------------------------------------------------------------------------
+struct NetClientStats
+{
+	NetClientStats()
+	: m_PacketsSent(0)
+	, m_BytesSent(0)
+	, m_PacketsReceived(0)
+	, m_BytesReceived(0)
+	, m_PacketsLost(0)
+	, m_SnapshotsDecoded(0)
+	, m_SnapshotsStale(0)
+	, m_MissingBaselines(0)
+	, m_Malformed(0)
+	{
+	}
+
+	unsigned long long	m_PacketsSent;
+	unsigned long long	m_BytesSent;
+	unsigned long long	m_PacketsReceived;
+	unsigned long long	m_BytesReceived;
+
+	// Packets dropped by the simulated loss, which aren't counted as received.
+	unsigned long long	m_PacketsLost;
+
+	// Snapshots decoded; arriving after a newer one; encoded against a snapshot this client no longer has;
+	// and failing to decode.
+	unsigned long long	m_SnapshotsDecoded;
+	unsigned long long	m_SnapshotsStale;
+	unsigned long long	m_MissingBaselines;
+	unsigned long long	m_Malformed;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetClientSettings
+//-------------------------------------------------------------------------------------------------------------
+struct NetClientSettings
+{
+	NetClientSettings()
+	: m_SimulatedLoss(0.f)
+	, m_LossSeed(0)
+	, m_ConnectInterval(30)
+	{
+	}
+
+	// The fraction of incoming packets to drop, as if lost on the way, chosen at random from the seed.
+	float			m_SimulatedLoss;
+	unsigned int	m_LossSeed;
+
+	// Updates between attempts to connect, until the server answers.
+	unsigned int	m_ConnectInterval;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetClientState
+//-------------------------------------------------------------------------------------------------------------
+enum NetClientState
+{
+	NET_CLIENT_DISCONNECTED,
+	NET_CLIENT_CONNECTING,
+	NET_CLIENT_CONNECTED,
+
+	// The server was full.
+	NET_CLIENT_REJECTED
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetClient
+// Call Update once per tick: it takes in whatever the server has sent, then sends the server the command set
+// for the ship, along with the latest snapshot decoded as the acknowledgement.
+//-------------------------------------------------------------------------------------------------------------
+class NetClient
+{
+public:
+	NetClient();
+	~NetClient();
+
+	bool Connect(const NetAddress& server, const NetClientSettings& settings = NetClientSettings());
+
+	// Tell the server, if connected, and close the socket.
+	void Disconnect();
+
+	void SetCommand(const ShipCommand& command) { m_Command = command; }
+	void Update();
+
+	NetClientState GetState() const { return m_State; }
+
+	// The client's ship, once connected. Its entry in the snapshots' ship layer has the same slot.
+	EntityHandle GetShip() const { return m_Ship; }
+
+	// The latest snapshot decoded, or NULL before the first.
+	const NetSnapshot* GetLatestSnapshot() const;
+
+	const NetClientStats& GetStats() const { return m_Stats; }
+
+private:
+	void HandlePacket(const unsigned char* data, size_t size);
+	void HandleSnapshot(BitReader& reader);
+	void Send(const std::vector<unsigned char>& packet);
+	void SendConnect();
+	void SendInput();
+	void SendDisconnect();
+
+	NetClientSettings			m_Settings;
+	NetClientState				m_State;
+	UdpSocket					m_Socket;
+	NetAddress					m_Server;
+	RandomStream				m_LossRandom;
+	unsigned int				m_UpdatesSinceConnect;
+
+	EntityHandle				m_Ship;
+	ShipCommand					m_Command;
+	unsigned int				m_InputSequence;
+
+	NetSnapshot					m_History[NET_SNAPSHOT_HISTORY];
+	bool						m_HistoryValid[NET_SNAPSHOT_HISTORY];
+	bool						m_HasSnapshot;
+	unsigned int				m_LatestTick;
+
+	NetClientStats				m_Stats;
+	std::vector<unsigned char>	m_ReceiveBuffer;
+	std::vector<unsigned char>	m_SendBuffer;
+};
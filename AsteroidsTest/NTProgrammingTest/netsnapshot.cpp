@@ -0,0 +1,397 @@
+//-------------------------------------------------------------------------------------------------------------
+// netsnapshot.cpp
+//
+// Implementation of network snapshots and their encoding.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "netsnapshot.h"
+#include "game.h"
+#include <algorithm>
+#include <cmath>
+
+static const float PI = 3.14159265f;
+
+// Positions are clamped to this, in quantized units, so that a body flung far out can't overflow.
+static const int MAX_POSITION = 1 << 28;
+
+//--------------------------------------------------------------------------------------------------------------
+// QuantizePosition
+//--------------------------------------------------------------------------------------------------------------
+int NetSnapshot::QuantizePosition(float position)
+{
+	float scaled = floorf(position * (float)POSITION_SCALE + 0.5f);
+	if (!(scaled > (float)-MAX_POSITION))
+	{
+		return -MAX_POSITION;
+	}
+	return scaled < (float)MAX_POSITION ? (int)scaled : MAX_POSITION;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// DequantizePosition
+//--------------------------------------------------------------------------------------------------------------
+float NetSnapshot::DequantizePosition(int position)
+{
+	return (float)position * (1.f / (float)POSITION_SCALE);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// QuantizeAngle
+// Angles are kept as they are turned, so they can be any number of turns either way; only the remainder is sent.
+//--------------------------------------------------------------------------------------------------------------
+unsigned int NetSnapshot::QuantizeAngle(float angle)
+{
+	float steps = floorf(angle * ((float)ANGLE_STEPS / (2.f * PI)) + 0.5f);
+	float wrapped = steps - floorf(steps / (float)ANGLE_STEPS) * (float)ANGLE_STEPS;
+	return (unsigned int)wrapped & (ANGLE_STEPS - 1);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// DequantizeAngle
+//--------------------------------------------------------------------------------------------------------------
+float NetSnapshot::DequantizeAngle(unsigned int angle)
+{
+	return (float)angle * (2.f * PI / (float)ANGLE_STEPS);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// CaptureLayer
+//--------------------------------------------------------------------------------------------------------------
+static void CaptureLayer(const EntityArray& entities, const std::vector<float>* angles, std::vector<NetEntity>& outLayer)
+{
+	outLayer.resize(entities.Size());
+	for (size_t index = 0; index < entities.Size(); index++)
+	{
+		EntityHandle handle = entities.HandleAt(index);
+		NetEntity& entity = outLayer[index];
+		entity.m_Slot = handle.m_Slot;
+		entity.m_Generation = handle.m_Generation;
+		entity.m_X = NetSnapshot::QuantizePosition(entities.m_PositionX[index]);
+		entity.m_Y = NetSnapshot::QuantizePosition(entities.m_PositionY[index]);
+		entity.m_Angle = angles != NULL ? NetSnapshot::QuantizeAngle((*angles)[index]) : 0;
+	}
+
+	std::sort(outLayer.begin(), outLayer.end(), [](const NetEntity& a, const NetEntity& b) { return a.m_Slot < b.m_Slot; });
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Capture
+//--------------------------------------------------------------------------------------------------------------
+void NetSnapshot::Capture(const Game& game)
+{
+	m_Tick = (unsigned int)game.GetTickCount();
+	CaptureLayer(game.m_Suns, NULL, m_Layers[NET_LAYER_SUNS]);
+	CaptureLayer(game.m_Asteroids, NULL, m_Layers[NET_LAYER_ASTEROIDS]);
+	CaptureLayer(game.m_Missiles, NULL, m_Layers[NET_LAYER_MISSILES]);
+	CaptureLayer(game.m_Ships, &game.m_Ships.m_Angle, m_Layers[NET_LAYER_SHIPS]);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// EncodeLayer
+// Both lists are written as a run of entries, each flagged with a 1 and the run ended with a 0, and slots are
+// written as the gap from the slot after the one before.
+//--------------------------------------------------------------------------------------------------------------
+static void EncodeLayer(const std::vector<NetEntity>& layer, const std::vector<NetEntity>& baseline, bool hasAngle, BitWriter& writer)
+{
+	size_t current = 0;
+	unsigned int nextSlot = 0;
+	for (size_t previous = 0; previous < baseline.size(); previous++)
+	{
+		unsigned int slot = baseline[previous].m_Slot;
+		while (current < layer.size() && layer[current].m_Slot < slot)
+		{
+			current++;
+		}
+		if (current == layer.size() || layer[current].m_Slot != slot)
+		{
+			writer.WriteBool(true);
+			writer.WriteUnsigned(slot - nextSlot);
+			nextSlot = slot + 1;
+		}
+	}
+	writer.WriteBool(false);
+
+	size_t previous = 0;
+	nextSlot = 0;
+	for (current = 0; current < layer.size(); current++)
+	{
+		const NetEntity& entity = layer[current];
+		while (previous < baseline.size() && baseline[previous].m_Slot < entity.m_Slot)
+		{
+			previous++;
+		}
+		const NetEntity* before = NULL;
+		if (previous < baseline.size() && baseline[previous].m_Slot == entity.m_Slot && baseline[previous].m_Generation == entity.m_Generation)
+		{
+			before = &baseline[previous];
+			if (entity.HasSameState(*before))
+			{
+				continue;
+			}
+		}
+
+		writer.WriteBool(true);
+		writer.WriteUnsigned(entity.m_Slot - nextSlot);
+		nextSlot = entity.m_Slot + 1;
+
+		writer.WriteBool(before == NULL);
+		if (before == NULL)
+		{
+			writer.WriteUnsigned(entity.m_Generation);
+			writer.WriteSigned(entity.m_X);
+			writer.WriteSigned(entity.m_Y);
+			if (hasAngle)
+			{
+				writer.WriteBits(entity.m_Angle, NetSnapshot::ANGLE_BITS);
+			}
+			continue;
+		}
+
+		writer.WriteBool(entity.m_X != before->m_X);
+		if (entity.m_X != before->m_X)
+		{
+			writer.WriteSigned(entity.m_X - before->m_X);
+		}
+		writer.WriteBool(entity.m_Y != before->m_Y);
+		if (entity.m_Y != before->m_Y)
+		{
+			writer.WriteSigned(entity.m_Y - before->m_Y);
+		}
+		if (hasAngle)
+		{
+			// The shorter way round, so that turning through zero is a small change.
+			writer.WriteBool(entity.m_Angle != before->m_Angle);
+			if (entity.m_Angle != before->m_Angle)
+			{
+				int turn = (int)((entity.m_Angle - before->m_Angle) & (NetSnapshot::ANGLE_STEPS - 1));
+				writer.WriteSigned(turn >= (int)NetSnapshot::ANGLE_STEPS / 2 ? turn - (int)NetSnapshot::ANGLE_STEPS : turn);
+			}
+		}
+	}
+	writer.WriteBool(false);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Encode
+//--------------------------------------------------------------------------------------------------------------
+void NetSnapshot::Encode(const NetSnapshot* baseline, BitWriter& writer) const
+{
+	static const std::vector<NetEntity> s_Empty;
+
+	for (int layer = 0; layer < NET_LAYER_COUNT; layer++)
+	{
+		EncodeLayer(m_Layers[layer], baseline != NULL ? baseline->m_Layers[layer] : s_Empty, layer == NET_LAYER_SHIPS, writer);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReadSlot
+// The next slot of a run, or false at the end of the run. Slots must increase, which also bounds how long a
+// corrupt run can go on; a run that would pass the last slot ends it and sets outMalformed.
+//--------------------------------------------------------------------------------------------------------------
+static bool ReadSlot(BitReader& reader, unsigned int& nextSlot, unsigned int& outSlot, bool& outMalformed)
+{
+	if (!reader.ReadBool())
+	{
+		return false;
+	}
+
+	unsigned int gap = reader.ReadUnsigned();
+	if (gap >= EntityHandle::INVALID_SLOT - nextSlot)
+	{
+		outMalformed = true;
+		return false;
+	}
+	outSlot = nextSlot + gap;
+	nextSlot = outSlot + 1;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Decode
+// The layer is rebuilt by merging the baseline with the changes, both in slot order, leaving out the slots
+// that have gone.
+//--------------------------------------------------------------------------------------------------------------
+bool NetSnapshot::Decode(BitReader& reader, const NetSnapshot* baseline)
+{
+	static const std::vector<NetEntity> s_Empty;
+	assert(baseline != this);
+
+	for (int layerIndex = 0; layerIndex < NET_LAYER_COUNT; layerIndex++)
+	{
+		std::vector<NetEntity>& layer = m_Layers[layerIndex];
+		const std::vector<NetEntity>& previous = baseline != NULL ? baseline->m_Layers[layerIndex] : s_Empty;
+		bool hasAngle = layerIndex == NET_LAYER_SHIPS;
+		layer.clear();
+
+		m_Removed.clear();
+		unsigned int nextSlot = 0;
+		unsigned int slot;
+		bool malformed = false;
+		while (ReadSlot(reader, nextSlot, slot, malformed))
+		{
+			m_Removed.push_back(slot);
+		}
+
+		// Copy the baseline's entries before a slot, other than those removed.
+		size_t copied = 0;
+		size_t removed = 0;
+		auto copyUpTo = [&](unsigned long long endSlot)
+		{
+			while (copied < previous.size() && previous[copied].m_Slot < endSlot)
+			{
+				while (removed < m_Removed.size() && m_Removed[removed] < previous[copied].m_Slot)
+				{
+					removed++;
+				}
+				if (removed == m_Removed.size() || m_Removed[removed] != previous[copied].m_Slot)
+				{
+					layer.push_back(previous[copied]);
+				}
+				copied++;
+			}
+		};
+
+		nextSlot = 0;
+		while (ReadSlot(reader, nextSlot, slot, malformed))
+		{
+			copyUpTo(slot);
+			const NetEntity* before = NULL;
+			if (copied < previous.size() && previous[copied].m_Slot == slot)
+			{
+				before = &previous[copied];
+				copied++;
+			}
+
+			NetEntity entity;
+			if (reader.ReadBool())
+			{
+				entity.m_Slot = slot;
+				entity.m_Generation = reader.ReadUnsigned();
+				entity.m_X = reader.ReadSigned();
+				entity.m_Y = reader.ReadSigned();
+				entity.m_Angle = hasAngle ? reader.ReadBits(ANGLE_BITS) : 0;
+			}
+			else
+			{
+				if (before == NULL)
+				{
+					return false;
+				}
+				entity = *before;
+				if (reader.ReadBool())
+				{
+					entity.m_X = (int)((unsigned int)entity.m_X + (unsigned int)reader.ReadSigned());
+				}
+				if (reader.ReadBool())
+				{
+					entity.m_Y = (int)((unsigned int)entity.m_Y + (unsigned int)reader.ReadSigned());
+				}
+				if (hasAngle && reader.ReadBool())
+				{
+					entity.m_Angle = (entity.m_Angle + (unsigned int)reader.ReadSigned()) & (ANGLE_STEPS - 1);
+				}
+			}
+			layer.push_back(entity);
+		}
+		copyUpTo(~0ull);
+
+		if (malformed || reader.HasFailed())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Matches
+//--------------------------------------------------------------------------------------------------------------
+bool NetSnapshot::Matches(const NetSnapshot& other) const
+{
+	if (m_Tick != other.m_Tick)
+	{
+		return false;
+	}
+	for (int layer = 0; layer < NET_LAYER_COUNT; layer++)
+	{
+		const std::vector<NetEntity>& mine = m_Layers[layer];
+		const std::vector<NetEntity>& theirs = other.m_Layers[layer];
+		if (mine.size() != theirs.size())
+		{
+			return false;
+		}
+		for (size_t index = 0; index < mine.size(); index++)
+		{
+			if (mine[index].m_Slot != theirs[index].m_Slot || mine[index].m_Generation != theirs[index].m_Generation
+				|| !mine[index].HasSameState(theirs[index]))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetEntityCount
+//--------------------------------------------------------------------------------------------------------------
+size_t NetSnapshot::GetEntityCount() const
+{
+	size_t count = 0;
+	for (int layer = 0; layer < NET_LAYER_COUNT; layer++)
+	{
+		count += m_Layers[layer].size();
+	}
+	return count;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BuildRenderLayer
+//--------------------------------------------------------------------------------------------------------------
+static void BuildRenderLayer(const std::vector<NetEntity>& layer, bool withPrevious, bool withAngle, RenderSnapshotLayer& outLayer)
+{
+	outLayer.m_X.resize(layer.size());
+	outLayer.m_Y.resize(layer.size());
+	outLayer.m_Angle.resize(withAngle ? layer.size() : 0);
+	for (size_t index = 0; index < layer.size(); index++)
+	{
+		outLayer.m_X[index] = NetSnapshot::DequantizePosition(layer[index].m_X);
+		outLayer.m_Y[index] = NetSnapshot::DequantizePosition(layer[index].m_Y);
+		if (withAngle)
+		{
+			outLayer.m_Angle[index] = NetSnapshot::DequantizeAngle(layer[index].m_Angle);
+		}
+	}
+
+	if (withPrevious)
+	{
+		outLayer.m_PreviousX = outLayer.m_X;
+		outLayer.m_PreviousY = outLayer.m_Y;
+	}
+	else
+	{
+		outLayer.m_PreviousX.clear();
+		outLayer.m_PreviousY.clear();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BuildRenderSnapshot
+//--------------------------------------------------------------------------------------------------------------
+void NetSnapshot::BuildRenderSnapshot(RenderSnapshot& outSnapshot) const
+{
+	outSnapshot.m_Tick = m_Tick;
+	outSnapshot.m_TickDelta = 0.f;
+	outSnapshot.m_Interpolation = 1.f;
+	outSnapshot.m_CaptureTime = RenderSnapshot::Clock::now();
+
+	BuildRenderLayer(m_Layers[NET_LAYER_SUNS], false, false, outSnapshot.m_Suns);
+	BuildRenderLayer(m_Layers[NET_LAYER_ASTEROIDS], false, false, outSnapshot.m_Asteroids);
+	BuildRenderLayer(m_Layers[NET_LAYER_MISSILES], true, false, outSnapshot.m_Missiles);
+	BuildRenderLayer(m_Layers[NET_LAYER_SHIPS], true, true, outSnapshot.m_Ships);
+}
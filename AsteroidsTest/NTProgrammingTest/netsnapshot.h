@@ -0,0 +1,102 @@
+//-------------------------------------------------------------------------------------------------------------
+// netsnapshot.h
+//
+// The game state a server sends its clients each tick: every object's position, rounded to a fixed grid, and
+// packed as the changes from a snapshot the client is known to have.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "bitstream.h"
+
+// Externally defined classes.
+class Game;
+struct RenderSnapshot;
+
+//-------------------------------------------------------------------------------------------------------------
+// NetLayer
+// The kinds of object a snapshot carries, each in a list of its own.
+//-------------------------------------------------------------------------------------------------------------
+enum NetLayer
+{
+	NET_LAYER_SUNS,
+	NET_LAYER_ASTEROIDS,
+	NET_LAYER_MISSILES,
+	NET_LAYER_SHIPS,
+
+	NET_LAYER_COUNT
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetEntity
+// One object, identified by its handle's slot and generation. Positions are in 1 / POSITION_SCALE units and
+// angles in 1 / ANGLE_STEPS turns; only ships have an angle.
+//-------------------------------------------------------------------------------------------------------------
+struct NetEntity
+{
+	bool HasSameState(const NetEntity& other) const
+	{
+		return m_X == other.m_X && m_Y == other.m_Y && m_Angle == other.m_Angle;
+	}
+
+	unsigned int	m_Slot;
+	unsigned int	m_Generation;
+	int				m_X;
+	int				m_Y;
+	unsigned int	m_Angle;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// NetSnapshot
+// Each layer is sorted by slot, so that two snapshots are compared in one pass over both.
+//
+// Encoded against a baseline, a layer lists the slots that have gone, then the objects that are new or have
+// moved: a new object, or a slot reused by another, is sent in full, and a moved one sends only the fields
+// that changed, as differences. Objects that haven't changed cost nothing, so the suns and asteroids are
+// sent once and then only when one goes. Encoded without a baseline every object is new.
+//-------------------------------------------------------------------------------------------------------------
+class NetSnapshot
+{
+public:
+	static const int POSITION_SCALE = 8;
+	static const int ANGLE_BITS = 10;
+	static const unsigned int ANGLE_STEPS = 1u << ANGLE_BITS;
+
+	NetSnapshot() : m_Tick(0) {}
+
+	void Capture(const Game& game);
+
+	// The snapshot's objects as changes from baseline, or in full if baseline is NULL. The tick isn't written.
+	void Encode(const NetSnapshot* baseline, BitWriter& writer) const;
+
+	// Read what Encode wrote, with the same baseline, which must not be this snapshot. Returns false if the data
+	// is malformed, in which case the snapshot's contents are undefined.
+	bool Decode(BitReader& reader, const NetSnapshot* baseline);
+
+	// Whether the two hold exactly the same objects in exactly the same state.
+	bool Matches(const NetSnapshot& other) const;
+
+	size_t GetEntityCount() const;
+
+	// The objects where they are, for drawing. Snapshots have no previous positions, so nothing is drawn as
+	// moving between ticks.
+	void BuildRenderSnapshot(RenderSnapshot& outSnapshot) const;
+
+	static int QuantizePosition(float position);
+	static float DequantizePosition(int position);
+	static unsigned int QuantizeAngle(float angle);
+	static float DequantizeAngle(unsigned int angle);
+
+	unsigned int			m_Tick;
+	std::vector<NetEntity>	m_Layers[NET_LAYER_COUNT];
+
+private:
+	// The slots a layer being decoded has lost, kept so that the storage is reused.
+	std::vector<unsigned int>	m_Removed;
+};
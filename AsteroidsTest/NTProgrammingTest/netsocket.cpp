@@ -0,0 +1,212 @@
+//-------------------------------------------------------------------------------------------------------------
+// netsocket.cpp
+//
+// Implementation of the UDP socket.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "netsocket.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SOCKET;
+static const SOCKET INVALID_SOCKET = -1;
+#endif
+
+// Big enough for a burst of full snapshots, or a tick's input from every client, to queue without loss.
+static const int SOCKET_BUFFER_SIZE = 1 << 20;
+
+static const size_t CLOSED = (size_t)INVALID_SOCKET;
+
+//--------------------------------------------------------------------------------------------------------------
+// ToSockAddr
+//--------------------------------------------------------------------------------------------------------------
+static sockaddr_in ToSockAddr(const NetAddress& address)
+{
+	sockaddr_in result;
+	memset(&result, 0, sizeof(result));
+	result.sin_family = AF_INET;
+	result.sin_addr.s_addr = htonl(address.m_Host);
+	result.sin_port = htons(address.m_Port);
+	return result;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FromSockAddr
+//--------------------------------------------------------------------------------------------------------------
+static NetAddress FromSockAddr(const sockaddr_in& address)
+{
+	return NetAddress(ntohl(address.sin_addr.s_addr), ntohs(address.sin_port));
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// UdpSocket
+//--------------------------------------------------------------------------------------------------------------
+UdpSocket::UdpSocket()
+: m_Socket(CLOSED)
+, m_Started(false)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~UdpSocket
+//--------------------------------------------------------------------------------------------------------------
+UdpSocket::~UdpSocket()
+{
+	Close();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// IsOpen
+//--------------------------------------------------------------------------------------------------------------
+bool UdpSocket::IsOpen() const
+{
+	return m_Socket != CLOSED;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Open
+//--------------------------------------------------------------------------------------------------------------
+bool UdpSocket::Open(const NetAddress& address)
+{
+	Close();
+
+#ifdef _WIN32
+	// Winsock counts its starts, so every socket can start it and stop it for itself.
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		return false;
+	}
+	m_Started = true;
+#endif
+
+	SOCKET handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	m_Socket = (size_t)handle;
+	if (handle == INVALID_SOCKET)
+	{
+		Close();
+		return false;
+	}
+
+	sockaddr_in bindAddress = ToSockAddr(address);
+	if (bind(handle, (const sockaddr*)&bindAddress, sizeof(bindAddress)) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	sockaddr_in boundAddress;
+	socklen_t boundSize = sizeof(boundAddress);
+	if (getsockname(handle, (sockaddr*)&boundAddress, &boundSize) != 0)
+	{
+		Close();
+		return false;
+	}
+	m_Address = FromSockAddr(boundAddress);
+
+	// The buffer sizes are only a request; a smaller buffer just drops more under load.
+	int bufferSize = SOCKET_BUFFER_SIZE;
+	setsockopt(handle, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferSize, sizeof(bufferSize));
+	setsockopt(handle, SOL_SOCKET, SO_SNDBUF, (const char*)&bufferSize, sizeof(bufferSize));
+
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	bool setNonBlocking = ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+	bool setNonBlocking = fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+	if (!setNonBlocking)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Close
+//--------------------------------------------------------------------------------------------------------------
+void UdpSocket::Close()
+{
+	if (m_Socket != CLOSED)
+	{
+#ifdef _WIN32
+		closesocket((SOCKET)m_Socket);
+#else
+		close((SOCKET)m_Socket);
+#endif
+	}
+#ifdef _WIN32
+	if (m_Started)
+	{
+		WSACleanup();
+	}
+#endif
+	m_Socket = CLOSED;
+	m_Started = false;
+	m_Address = NetAddress();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Send
+//--------------------------------------------------------------------------------------------------------------
+bool UdpSocket::Send(const NetAddress& to, const void* data, size_t size)
+{
+	assert(IsOpen());
+
+	sockaddr_in toAddress = ToSockAddr(to);
+	int sent = sendto((SOCKET)m_Socket, (const char*)data, (int)size, 0, (const sockaddr*)&toAddress, sizeof(toAddress));
+	return sent == (int)size;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Receive
+// Some errors are skipped over rather than ending the read: on some systems a datagram that couldn't be
+// delivered earlier shows up as an error on the next receive.
+//--------------------------------------------------------------------------------------------------------------
+size_t UdpSocket::Receive(void* data, size_t capacity, NetAddress& outFrom)
+{
+	assert(IsOpen());
+
+	for (;;)
+	{
+		sockaddr_in fromAddress;
+		socklen_t fromSize = sizeof(fromAddress);
+		int received = recvfrom((SOCKET)m_Socket, (char*)data, (int)capacity, 0, (sockaddr*)&fromAddress, &fromSize);
+		if (received >= 0)
+		{
+			if (received > 0 && (size_t)received < capacity)
+			{
+				outFrom = FromSockAddr(fromAddress);
+				return (size_t)received;
+			}
+			continue;
+		}
+
+#ifdef _WIN32
+		int error = WSAGetLastError();
+		bool skip = error == WSAECONNRESET || error == WSAEMSGSIZE;
+#else
+		int error = errno;
+		bool skip = error == ECONNREFUSED || error == EINTR;
+#endif
+		if (!skip)
+		{
+			return 0;
+		}
+	}
+}
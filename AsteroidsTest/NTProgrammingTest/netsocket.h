@@ -0,0 +1,70 @@
+//-------------------------------------------------------------------------------------------------------------
+// netsocket.h
+//
+// A thin non-blocking UDP socket, over Winsock or BSD sockets.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <stddef.h>
+
+//-------------------------------------------------------------------------------------------------------------
+// NetAddress
+// An IPv4 address and port, both in host byte order.
+//-------------------------------------------------------------------------------------------------------------
+struct NetAddress
+{
+	NetAddress() : m_Host(0), m_Port(0) {}
+	NetAddress(unsigned int host, unsigned short port) : m_Host(host), m_Port(port) {}
+
+	static NetAddress Loopback(unsigned short port) { return NetAddress(0x7f000001u, port); }
+
+	bool operator==(const NetAddress& other) const { return m_Host == other.m_Host && m_Port == other.m_Port; }
+	bool operator!=(const NetAddress& other) const { return !(*this == other); }
+
+	unsigned int	m_Host;
+	unsigned short	m_Port;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// UdpSocket
+// Sends and receives whole datagrams without ever blocking. Errors that only mean a datagram was lost, such as
+// a peer's port having closed, are not reported; to the caller UDP is simply unreliable.
+//-------------------------------------------------------------------------------------------------------------
+class UdpSocket
+{
+public:
+	UdpSocket();
+	~UdpSocket();
+
+	// Bind to the address given. A port of 0 lets the system pick one; GetAddress says which.
+	bool Open(const NetAddress& address);
+	void Close();
+	bool IsOpen() const;
+
+	NetAddress GetAddress() const { return m_Address; }
+
+	// Returns false if the datagram couldn't be handed to the system.
+	bool Send(const NetAddress& to, const void* data, size_t size);
+
+	// The size of the next datagram, copied into data, or 0 if none is waiting. A datagram that fills the
+	// capacity may have been cut short, so it is dropped; give one byte more than the largest expected.
+	size_t Receive(void* data, size_t capacity, NetAddress& outFrom);
+
+private:
+	// Not copyable.
+	UdpSocket(const UdpSocket&);
+	UdpSocket& operator=(const UdpSocket&);
+
+	// A SOCKET on Windows, a file descriptor elsewhere.
+	size_t		m_Socket;
+	NetAddress	m_Address;
+
+	// Whether Open started Winsock, which Close must then stop.
+	bool		m_Started;
+};
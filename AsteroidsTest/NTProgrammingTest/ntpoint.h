@@ -3,63 +3,129 @@
 //
 // Created: JohnL
 //
-// A 2D point class.
+// A 2D point class, and the same operations over arrays of coordinates.
 //
 // Copyright(c) Ninja Theory 2010. All Rights Reserved.
 //-------------------------------------------------------------------------------------------------------------
 
+#pragma once
+
 #include <math.h>
+#include <stddef.h>
 
+//-------------------------------------------------------------------------------------------------------------
+// NTPoint
+// Everything that doesn't need a square root is constexpr. Comparing a distance against a radius is done on
+// the squares, which needs no root at all.
+//-------------------------------------------------------------------------------------------------------------
 class NTPoint
 {
 public:
-	NTPoint()
+	constexpr NTPoint()
+	: x(0.f)
+	, y(0.f)
 	{
 	}
 
-	NTPoint(float _x, float _y)
+	constexpr NTPoint(float _x, float _y)
 	: x(_x)
 	, y(_y)
 	{
 	}
 
-	NTPoint& operator=(const NTPoint& pt)      
+	constexpr NTPoint operator+(const NTPoint& pt) const
 	{
-		x = pt.x;
-		y = pt.y;
-		return *this;
+		return NTPoint(x + pt.x, y + pt.y);
 	}
 
-	NTPoint operator+(const NTPoint& pt) const
+	constexpr NTPoint operator-(const NTPoint& pt) const
 	{
-		return NTPoint(x + pt.x, y + pt.y);
+		return NTPoint(x - pt.x, y - pt.y);
 	}
 
-	NTPoint operator-(const NTPoint& pt) const
+	constexpr NTPoint operator-() const
 	{
-		return NTPoint(x - pt.x, y - pt.y);
+		return NTPoint(-x, -y);
 	}
 
-	NTPoint operator*(float f) const
+	constexpr NTPoint operator*(float f) const
 	{
 		return NTPoint(x * f, y * f);
 	}
 
-	NTPoint operator/(float f) const
+	constexpr NTPoint operator/(float f) const
 	{
 		return NTPoint(x / f, y / f);
 	}
 
+	constexpr NTPoint& operator+=(const NTPoint& pt)
+	{
+		x += pt.x;
+		y += pt.y;
+		return *this;
+	}
+
+	constexpr NTPoint& operator-=(const NTPoint& pt)
+	{
+		x -= pt.x;
+		y -= pt.y;
+		return *this;
+	}
+
+	constexpr NTPoint& operator*=(float f)
+	{
+		x *= f;
+		y *= f;
+		return *this;
+	}
+
+	constexpr float Dot(const NTPoint& pt) const
+	{
+		return x * pt.x + y * pt.y;
+	}
+
+	// The z of the 3D cross product: positive if pt is anticlockwise of this.
+	constexpr float Cross(const NTPoint& pt) const
+	{
+		return x * pt.y - y * pt.x;
+	}
+
+	constexpr float LengthSquared() const
+	{
+		return x * x + y * y;
+	}
+
+	constexpr float DistanceSquared(const NTPoint& pt) const
+	{
+		return (pt - *this).LengthSquared();
+	}
+
+	// Whether pt is closer than distance.
+	constexpr bool IsWithin(const NTPoint& pt, float distance) const
+	{
+		return DistanceSquared(pt) < distance * distance;
+	}
+
 	float GetLength() const
 	{
-		return sqrt((float)(x * x + y * y));
+		return sqrtf(LengthSquared());
+	}
+
+	// This at unit length, or zero if it is zero: one root and one divide, where dividing each component by
+	// the length takes two.
+	NTPoint GetNormalisedOrZero() const
+	{
+		float lengthSquared = LengthSquared();
+		if (lengthSquared == 0.f)
+		{
+			return NTPoint();
+		}
+		return *this * (1.f / sqrtf(lengthSquared));
 	}
 
 	void Normalise()
 	{
-		float f = GetLength();
-		x /= f;
-		y /= f;
+		*this = GetNormalisedOrZero();
 	}
 
 public:
@@ -71,7 +137,65 @@ public:
 // operator==
 // Comparison operator for two point objects.
 //--------------------------------------------------------------------------------------------------------------
-static bool operator==(const NTPoint& lhs, const NTPoint& rhs) 
+constexpr bool operator==(const NTPoint& lhs, const NTPoint& rhs)
 {
 	return lhs.x == rhs.x && lhs.y == rhs.y;
 }
+
+constexpr bool operator!=(const NTPoint& lhs, const NTPoint& rhs)
+{
+	return !(lhs == rhs);
+}
+
+constexpr NTPoint operator*(float f, const NTPoint& pt)
+{
+	return pt * f;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// MultiplyAdd
+// point + direction * scale, the step every integration and thrust takes.
+//--------------------------------------------------------------------------------------------------------------
+constexpr NTPoint MultiplyAdd(const NTPoint& point, const NTPoint& direction, float scale)
+{
+	return NTPoint(point.x + direction.x * scale, point.y + direction.y * scale);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// MultiplyAdd
+// The same over arrays: values[i] += deltas[i] * scale, for one coordinate of many points at once. These batch
+// versions are plain loops over separate coordinate arrays, which the compiler vectorises.
+//--------------------------------------------------------------------------------------------------------------
+inline void MultiplyAdd(float* values, const float* deltas, float scale, size_t count)
+{
+	for (size_t index = 0; index < count; index++)
+	{
+		values[index] += deltas[index] * scale;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// LengthSquared
+// outLengths[i] = |(x[i], y[i])|^2.
+//--------------------------------------------------------------------------------------------------------------
+inline void LengthSquared(const float* x, const float* y, size_t count, float* outLengths)
+{
+	for (size_t index = 0; index < count; index++)
+	{
+		outLengths[index] = x[index] * x[index] + y[index] * y[index];
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// DistanceSquared
+// outDistances[i] = |(x[i], y[i]) - point|^2.
+//--------------------------------------------------------------------------------------------------------------
+inline void DistanceSquared(const float* x, const float* y, size_t count, const NTPoint& point, float* outDistances)
+{
+	for (size_t index = 0; index < count; index++)
+	{
+		float dx = x[index] - point.x;
+		float dy = y[index] - point.y;
+		outDistances[index] = dx * dx + dy * dy;
+	}
+}
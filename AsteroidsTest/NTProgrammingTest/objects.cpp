@@ -12,236 +12,246 @@
 
 #include "game.h"
 #include "objects.h"
+#include "sweep.h"
 #include "timer.h"
 #include <cmath>
 
-//--------------------------------------------------------------------------------------------------------------
-// CelestialBody
-//--------------------------------------------------------------------------------------------------------------
-CelestialBody::CelestialBody(const NTPoint& position)
-: m_Position(position)
-{
-}
-
-//--------------------------------------------------------------------------------------------------------------
-// CelestialBody
-// calculate the gravity of all suns and apply it to velocity
-//--------------------------------------------------------------------------------------------------------------
-void CelestialBody::ApplyTheGravityFromSuns(const std::list<Sun*>& AllSuns)
-{
-	NTPoint resultGravity(0.f, 0.f);
-
-	for (auto OneSun : AllSuns)
-	{
-		NTPoint OneSunGravity = OneSun->GetGravityOfOutsidePoint(m_Position);
-		resultGravity = resultGravity + OneSunGravity;
-	}
-
-	m_Velocity = m_Velocity + resultGravity;
-}
+// Speeds in units per second, and the ships' acceleration in units per second squared.
+static const float MISSILE_SPEED = 300.f;
+static const float MISSILE_MIN_SPEED = 50.f;
+static const float MISSILE_MAX_SPEED = 500.f;
+static const float SHIP_ACCELERATION = 40.f;
+static const float SHIP_MAX_SPEED = 50.f;
 
 const int Sun::RADIUS = 15;
+// The default for GameSettings::m_SunGravity.
 const int Sun::GRAVITY = 0;
+const float Sun::MINIMUM_SPACING = 150.f;
 
 //--------------------------------------------------------------------------------------------------------------
 // Sun
 // Construct a sun.  Let there be light.
 //--------------------------------------------------------------------------------------------------------------
-Sun::Sun(int x, int y)
-: CelestialBody(NTPoint((float)x,(float)y))
+EntityHandle Sun::Spawn(EntityArray& suns, int x, int y)
 {
+	return suns.Add(NTPoint((float)x, (float)y), NTPoint(0.f, 0.f), 0.f, (float)RADIUS);
 }
 
 //--------------------------------------------------------------------------------------------------------------
 // Draw
-// Draw the sun.
+// Draw the suns.
 //--------------------------------------------------------------------------------------------------------------
-void Sun::Draw(HDC hdc)
+void Sun::Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& suns)
 {
-	Ellipse(hdc, (int)m_Position.x - RADIUS, (int)m_Position.y - RADIUS, (int)m_Position.x + RADIUS, (int)m_Position.y + RADIUS);
+	for (size_t index = 0; index < suns.Size(); index++)
+	{
+		commands.AddCircle(PEN_RED, suns.m_X[index], suns.m_Y[index], RADIUS);
+	}
 }
 
 //--------------------------------------------------------------------------------------------------------------
 // Gravity
 // calculate the gravity for the point outside the sun
 //--------------------------------------------------------------------------------------------------------------
-NTPoint Sun::GetGravityOfOutsidePoint(const NTPoint& point)
+NTPoint Sun::GetGravityOfOutsidePoint(const NTPoint& sunPosition, const NTPoint& point)
+{
+	return GetGravityOfOutsidePoint(sunPosition, point, (float)GRAVITY);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Gravity
+// As above, for a sun of the given strength.
+//--------------------------------------------------------------------------------------------------------------
+NTPoint Sun::GetGravityOfOutsidePoint(const NTPoint& sunPosition, const NTPoint& point, float gravity)
 {
-	NTPoint targetVector = m_Position - point;
+	NTPoint targetVector = sunPosition - point;
 	float distance = targetVector.GetLength();
 	targetVector.Normalise();
 	// the distance if bigger , the gravity is smaller
-	return targetVector * GRAVITY / distance;
+	return targetVector * gravity / distance;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// IsHitBy
+//--------------------------------------------------------------------------------------------------------------
+bool Sun::IsHitBy(const EntityArray& suns, size_t index, const NTPoint& missileFrom, const NTPoint& missileTo, float& outTime)
+{
+	return SweepCircle(missileFrom, missileTo, suns.GetPosition(index), (float)(RADIUS + Missile::RADIUS), outTime);
 }
 
 
+const int Missile::RADIUS = 2;
 
 //--------------------------------------------------------------------------------------------------------------
 // Missile
 // Constructs a missile. Fired from FromPosition at ToPosition.
 //--------------------------------------------------------------------------------------------------------------
-Missile::Missile(NTPoint& FromPosition, NTPoint& ToPosition)
+EntityHandle Missile::Spawn(EntityArray& missiles, const NTPoint& FromPosition, const NTPoint& ToPosition)
 {
-	m_Position = FromPosition;
-	m_Velocity = ToPosition - FromPosition;
-	m_Velocity.Normalise();
-	m_Velocity = m_Velocity * 300.f;
-	m_ShotTime = 10.f;
+	// A shot at the ship's own position has no direction, and goes nowhere.
+	NTPoint velocity = (ToPosition - FromPosition).GetNormalisedOrZero() * MISSILE_SPEED;
+
+	return missiles.Add(FromPosition, velocity, 10.f, (float)RADIUS);
 }
 
 //--------------------------------------------------------------------------------------------------------------
 // Update
-// Updates the position & velocity.
+// Burns the fuel of the missiles in [begin, end) and keeps their speed in range. Missiles are moved by the
+// game's integrator beforehand.
 //--------------------------------------------------------------------------------------------------------------
-void Missile::Update()
+void Missile::Update(EntityArray& missiles, float timeDelta, size_t begin, size_t end)
 {
-	float timeDelta = g_Game.m_Timer.GetTimeDelta();
+	assert(begin <= end && end <= missiles.Size());
 
-	m_ShotTime -= timeDelta;
-
-	float speed = m_Velocity.GetLength();
-	if (speed > 500.f)
+	for (size_t index = begin; index < end; index++)
 	{
-		m_Velocity.Normalise();
-		m_Velocity = m_Velocity * 500.f;
-	}
-	else if (speed < 50.f && speed != 0.f)
-	{
-		m_Velocity.Normalise();
-		m_Velocity = m_Velocity * 50.f;
-	}
+		missiles.m_Lifetime[index] -= timeDelta;
 
-	m_Position = m_Position + m_Velocity * timeDelta;
+		// Only a missile whose speed is out of range needs a root taken.
+		NTPoint velocity = missiles.GetVelocity(index);
+		float speedSquared = velocity.LengthSquared();
+		if (speedSquared > MISSILE_MAX_SPEED * MISSILE_MAX_SPEED)
+		{
+			missiles.SetVelocity(index, velocity * (MISSILE_MAX_SPEED / sqrtf(speedSquared)));
+		}
+		else if (speedSquared < MISSILE_MIN_SPEED * MISSILE_MIN_SPEED && speedSquared != 0.f)
+		{
+			missiles.SetVelocity(index, velocity * (MISSILE_MIN_SPEED / sqrtf(speedSquared)));
+		}
+	}
 }
 
 //--------------------------------------------------------------------------------------------------------------
 // Draw
-// Draws a missile.
+// Draws the missiles, part way between their last two positions.
 //--------------------------------------------------------------------------------------------------------------
-void Missile::Draw(HDC hdc)
+void Missile::Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& missiles, float interpolation)
 {
-	Ellipse(hdc, (int)m_Position.x - 2, (int)m_Position.y - 2, (int)m_Position.x + 2, (int)m_Position.y + 2);
+	for (size_t index = 0; index < missiles.Size(); index++)
+	{
+		NTPoint position = missiles.GetInterpolatedPosition(index, interpolation);
+		commands.AddCircle(PEN_BLUE, position.x, position.y, RADIUS);
+	}
 }
 
+const int Ship::RADIUS = 3;
+
 //--------------------------------------------------------------------------------------------------------------
 // Ship
 // Constructs a player ship.
 //--------------------------------------------------------------------------------------------------------------
-Ship::Ship()
-: CelestialBody(NTPoint(250.f, 250.f))
-, m_Angle(0.f)
-, m_TimeSinceLastShot(10.f)
+EntityHandle Ship::Spawn(ShipArray& ships)
 {
-	m_Velocity.x = 0.f;
-	m_Velocity.y = 0.f;
+	return Spawn(ships, NTPoint(250.f, 250.f), CONTROLLER_PLAYER);
 }
 
 //--------------------------------------------------------------------------------------------------------------
-// Update
-// Update for a player ship.
+// Ship
+// Constructs a ship at the given position, driven by the given controller.
 //--------------------------------------------------------------------------------------------------------------
-void Ship::Update()
+EntityHandle Ship::Spawn(ShipArray& ships, const NTPoint& position, ShipControllerId controller)
 {
-	float timeDelta = g_Game.m_Timer.GetTimeDelta();
+	EntityHandle handle = ships.Add(position, NTPoint(0.f, 0.f), 0.f, (float)RADIUS);
 
-	bool bCollision = false;
+	size_t index = ships.IndexOf(handle);
+	ships.m_Angle[index] = 0.f;
+	ships.m_TimeSinceLastShot[index] = 10.f;
+	ships.m_Controller[index] = (unsigned char)controller;
 
-	if (GetKeyState(VK_LEFT) & 0x800)
-	{
-		m_Angle += timeDelta * 3.14f;
-		if (m_Angle > 3.14f) m_Angle -= 3.14f * 2.f;
-	}
-	if (GetKeyState(VK_RIGHT) & 0x800)
-	{
-		m_Angle -= timeDelta * 3.14f;
-		if (m_Angle < -3.14f) m_Angle += 3.14f * 2.f;
-	}
-	
-	if (GetKeyState(VK_UP) & 0x800)
-	{
-		NTPoint pt(1.f * sinf(m_Angle), 1.f * cosf(m_Angle));
-		m_Velocity = m_Velocity + pt * 40.f * timeDelta;
-	}
-	if (GetKeyState(VK_DOWN) & 0x800)
-	{
-		NTPoint pt(-1.f * sinf(m_Angle), -1.f * cosf(m_Angle));
-		m_Velocity = m_Velocity + pt * 40.f * timeDelta;
-	}
+	return handle;
+}
 
-	if (m_TimeSinceLastShot < 0.5f)
-	{
-		m_TimeSinceLastShot += timeDelta;
-	}
-	else if (GetKeyState(' ') & 0x800)
-	{
-		NTPoint pt(1.f * sinf(m_Angle), 1.f * cosf(m_Angle));
-		g_Game.m_Missiles.push_back(new Missile(m_Position + pt * 10.f, m_Position + pt * 20.f));
-		m_TimeSinceLastShot = 0.f;
-	}
+//--------------------------------------------------------------------------------------------------------------
+// Update
+// Update for the ships. Suns are found through the game's sun tree; missiles have already been swept
+// against the ships this tick. The ships are moved by the game's integrator afterwards.
+//--------------------------------------------------------------------------------------------------------------
+void Ship::Update(Game& game, const std::vector<ShipCommand>& commands, float timeDelta)
+{
+	ShipArray& ships = game.m_Ships;
+	EntityArray& missiles = game.m_Missiles;
+	assert(commands.size() >= ships.Size());
 
-	for (std::list<Missile*>::iterator itMissile = g_Game.m_Missiles.begin(); 
-		itMissile != g_Game.m_Missiles.end(); itMissile++)
+	for (size_t index = 0; index < ships.Size(); index++)
 	{
-		NTPoint pt = (*itMissile)->GetPosition();
-		NTPoint dir = pt - m_Position;
-		float dist = dir.GetLength();
-		if (dist < 3.f)
+		const ShipCommand& command = commands[index];
+		NTPoint position = ships.GetPosition(index);
+		NTPoint velocity = ships.GetVelocity(index);
+		float& angle = ships.m_Angle[index];
+		float& timeSinceLastShot = ships.m_TimeSinceLastShot[index];
+
+		bool bCollision = false;
+
+		if (command.IsSet(SHIP_TURN_LEFT))
 		{
-			bCollision = true;
+			angle += timeDelta * 3.14f;
+			if (angle > 3.14f) angle -= 3.14f * 2.f;
+		}
+		if (command.IsSet(SHIP_TURN_RIGHT))
+		{
+			angle -= timeDelta * 3.14f;
+			if (angle < -3.14f) angle += 3.14f * 2.f;
 		}
-	}
 
-	for (std::list<Sun*>::iterator itSun = g_Game.m_Suns.begin(); 
-		itSun != g_Game.m_Suns.end(); itSun++)
-	{
-		NTPoint pt = (*itSun)->GetPosition();
-		NTPoint dir = pt - m_Position;
-		float dist = dir.GetLength();
-		if (dist < 15.f)
+		if (command.IsSet(SHIP_THRUST))
+		{
+			NTPoint pt(1.f * sinf(angle), 1.f * cosf(angle));
+			velocity = MultiplyAdd(velocity, pt, SHIP_ACCELERATION * timeDelta);
+		}
+		if (command.IsSet(SHIP_REVERSE))
+		{
+			NTPoint pt(-1.f * sinf(angle), -1.f * cosf(angle));
+			velocity = MultiplyAdd(velocity, pt, SHIP_ACCELERATION * timeDelta);
+		}
+
+		if (timeSinceLastShot < 0.5f)
+		{
+			timeSinceLastShot += timeDelta;
+		}
+		else if (command.IsSet(SHIP_FIRE))
+		{
+			NTPoint pt(1.f * sinf(angle), 1.f * cosf(angle));
+			Missile::Spawn(missiles, position + pt * 10.f, position + pt * 20.f);
+			timeSinceLastShot = 0.f;
+		}
+
+		// The baked field can rule out every sun at once; otherwise only the nearest sun can matter.
+		KdTreeNeighbour nearestSun;
+		if (!game.m_GravityField.IsClearOfSuns(position.x, position.y, (float)Sun::RADIUS)
+			&& game.m_SunTree.QueryNearest(position.x, position.y, (float)Sun::RADIUS, nearestSun))
 		{
+			game.m_CollisionStats.m_Hits++;
 			bCollision = true;
 		}
-	}
 
-	if (bCollision)
-	{
-		Explode();
-	}
+		if (bCollision)
+		{
+			Explode(game, index);
+			velocity = ships.GetVelocity(index);
+		}
 
-	float speed = m_Velocity.GetLength();
-	if (fabsf(speed) > 50.f)
-	{
-		m_Velocity.Normalise();
-		m_Velocity = m_Velocity * 50.f;
-	}
+		float speedSquared = velocity.LengthSquared();
+		if (speedSquared > SHIP_MAX_SPEED * SHIP_MAX_SPEED)
+		{
+			velocity *= SHIP_MAX_SPEED / sqrtf(speedSquared);
+		}
 
-	m_Position = m_Position + m_Velocity * timeDelta;
+		ships.SetVelocity(index, velocity);
+	}
 }
 
 
 //--------------------------------------------------------------------------------------------------------------
 // Draw
-// Draw a player ship.
+// Draw the player ships, part way between their last two positions.
 //--------------------------------------------------------------------------------------------------------------
-void Ship::Draw(HDC hdc)
+void Ship::Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& ships, float interpolation)
 {
-	const int iLong = 12;
-	const int iShort = 4;
-
-	int aiPoints[4][2] =
+	for (size_t index = 0; index < ships.Size(); index++)
 	{
-		{(int)(m_Position.x),									(int)(m_Position.y)},
-		{(int)(m_Position.x+sinf(m_Angle-3.14f/2.f)*iShort),	(int)(m_Position.y+cosf(m_Angle-3.14f/2.f)*iShort)},
-		{(int)(m_Position.x+sinf(m_Angle)*iLong),				(int)(m_Position.y+cosf(m_Angle)*iLong)},
-		{(int)(m_Position.x+sinf(m_Angle+3.14f/2.f)*iShort),	(int)(m_Position.y+cosf(m_Angle+3.14f/2.f)*iShort)}
-	};
-	
-	MoveToEx(hdc, aiPoints[0][0], aiPoints[0][1], 0);
-	LineTo(hdc, aiPoints[1][0], aiPoints[1][1]);
-	LineTo(hdc, aiPoints[2][0], aiPoints[2][1]);
-	LineTo(hdc, aiPoints[3][0], aiPoints[3][1]);
-	LineTo(hdc, aiPoints[0][0], aiPoints[0][1]);
-
+		NTPoint position = ships.GetInterpolatedPosition(index, interpolation);
+		commands.AddShip(PEN_BLUE, position.x, position.y, ships.m_Angle[index]);
+	}
 }
 
 
@@ -249,45 +259,60 @@ void Ship::Draw(HDC hdc)
 // Explode
 // Destroy the players ship.
 //--------------------------------------------------------------------------------------------------------------
-void Ship::Explode()
+void Ship::Explode(Game& game, size_t index)
+{
+	ShipArray& ships = game.m_Ships;
+
+	// Keyed on the tick and the ship rather than drawn from a shared generator, so the result doesn't depend
+	// on the order ships are updated in, and nothing needs saving to reproduce it.
+	unsigned long long key = (game.GetTickCount() << 32) | ships.HandleAt(index).m_Slot;
+	RandomStream random(game.GetSeed(), RANDOM_STREAM_RESPAWN, key);
+
+	float x = random.NextRange(100.f, 700.f);
+	float y = random.NextRange(100.f, 500.f);
+	ships.Teleport(index, NTPoint(x, y));
+	ships.SetVelocity(index, NTPoint(0, 0));
+	ships.m_Angle[index] = 0.f;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// IsHitBy
+//--------------------------------------------------------------------------------------------------------------
+bool Ship::IsHitBy(const EntityArray& ships, size_t index, const NTPoint& missileFrom, const NTPoint& missileTo, float& outTime)
 {
-	m_Position = NTPoint(float(((double)rand() / RAND_MAX) * 600 + 100), float(((double)rand() / RAND_MAX) * 400 + 100));
-	m_Velocity = NTPoint(0, 0);
-	m_Angle = 0.f;
+	return SweepCircle(missileFrom, missileTo, ships.GetPosition(index), (float)(RADIUS + Missile::RADIUS), outTime);
 }
 
 const int Asteroids::RADIUS = 10;
+const float Asteroids::MINIMUM_SPACING = 50.f;
 
 //--------------------------------------------------------------------------------------------------------------
 // Asteroids
 // Construct a Asteroids.  Let there be light.
 //--------------------------------------------------------------------------------------------------------------
-Asteroids::Asteroids(int x, int y)
-	: CelestialBody(NTPoint((float)x, (float)y))
+EntityHandle Asteroids::Spawn(EntityArray& asteroids, int x, int y)
 {
+	return asteroids.Add(NTPoint((float)x, (float)y), NTPoint(0.f, 0.f), 0.f, (float)RADIUS);
 }
 
 //--------------------------------------------------------------------------------------------------------------
 // Draw
 // Draw the Asteroids.
 //--------------------------------------------------------------------------------------------------------------
-void Asteroids::Draw(HDC hdc)
+void Asteroids::Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& asteroids)
 {
-	Ellipse(hdc, (int)m_Position.x - RADIUS, (int)m_Position.y - RADIUS, (int)m_Position.x + RADIUS, (int)m_Position.y + RADIUS);
+	for (size_t index = 0; index < asteroids.Size(); index++)
+	{
+		commands.AddCircle(PEN_BLUE, asteroids.m_X[index], asteroids.m_Y[index], RADIUS);
+	}
 }
 
 //--------------------------------------------------------------------------------------------------------------
 // destory
-// destory the Asteroids.
+// destory the Asteroids. Tested along the missile's path, so a fast missile can't pass through between ticks.
 //--------------------------------------------------------------------------------------------------------------
-bool Asteroids::CanDestory(const Missile* OneMissile)
+bool Asteroids::CanDestory(const EntityArray& asteroids, size_t index, const NTPoint& missileFrom, const NTPoint& missileTo,
+	float& outTime)
 {
-	float distance = (OneMissile->m_Position - m_Position).GetLength();
-
-	if ((int)distance > RADIUS)
-	{
-		return false;
-	}
-
-	return true;
+	return SweepCircle(missileFrom, missileTo, asteroids.GetPosition(index), (float)(RADIUS + Missile::RADIUS), outTime);
 }
@@ -3,51 +3,46 @@
 //
 // Created: JohnL
 //
-// Game objects.
+// Game objects. Each kind of object is stored in an EntityArray owned by the game; the classes here hold the
+// behaviour for a kind and operate on the whole array at once.
 //
 // Copyright(c) Ninja Theory 2010. All Rights Reserved.
 //-------------------------------------------------------------------------------------------------------------
 
+#pragma once
+
 //-------------------------------------------------------------------------------------------------------------
 // Includes
 //-------------------------------------------------------------------------------------------------------------
 #include "ntpoint.h"
+#include "controller.h"
+#include "entitystore.h"
+#include "rendercommands.h"
+#include "rendersnapshot.h"
 
-//-------------------------------------------------------------------------------------------------------------
-// CelestialBody
-// The base class for all game objects.
-//-------------------------------------------------------------------------------------------------------------
-class CelestialBody
-{
-public:
-	CelestialBody() {}
-	CelestialBody(const NTPoint& position);
-
-	virtual void Update() = 0;
-	virtual void Draw(HDC hdc) = 0;
-
-	NTPoint GetPosition() { return m_Position; }
-	void ApplyTheGravityFromSuns(const std::list<Sun*>& AllSuns);
-
-	NTPoint m_Position;
-	NTPoint m_Velocity;
-};
-
+// Externally defined classes.
+class Game;
 
 //-------------------------------------------------------------------------------------------------------------
 // Sun
 // A star, a simple unmoving object.
 //-------------------------------------------------------------------------------------------------------------
-class Sun : public CelestialBody
+class Sun
 {
 public:
-	Sun(int x, int y);
-	virtual void Update() {}
-	virtual void Draw(HDC hdc);
-	NTPoint GetGravityOfOutsidePoint(const NTPoint& point);
+	static EntityHandle Spawn(EntityArray& suns, int x, int y);
+	static void Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& suns);
+	static NTPoint GetGravityOfOutsidePoint(const NTPoint& sunPosition, const NTPoint& point);
+	static NTPoint GetGravityOfOutsidePoint(const NTPoint& sunPosition, const NTPoint& point, float gravity);
+
+	// Whether a missile moving from missileFrom to missileTo flies into the sun, and if so how far along.
+	static bool IsHitBy(const EntityArray& suns, size_t index, const NTPoint& missileFrom, const NTPoint& missileTo, float& outTime);
 
 	static const int RADIUS;
 	static const int GRAVITY;
+
+	// The closest two suns are placed to each other.
+	static const float MINIMUM_SPACING;
 };
 
 
@@ -55,54 +50,61 @@ public:
 // Missile
 // Fired by a player ship.
 //-------------------------------------------------------------------------------------------------------------
-class Missile : public CelestialBody
+class Missile
 {
 public:
-	Missile(NTPoint& FromPosition, NTPoint& ToPosition);
+	static EntityHandle Spawn(EntityArray& missiles, const NTPoint& FromPosition, const NTPoint& ToPosition);
 
-	virtual void Update();
-	virtual void Draw(HDC hdc);
+	static void Update(EntityArray& missiles, float timeDelta, size_t begin, size_t end);
+	static void Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& missiles, float interpolation);
 
-	bool IsOutOfFuel()
+	static bool IsOutOfFuel(const EntityArray& missiles, size_t index)
 	{
-		return m_ShotTime < 0.f;
+		return missiles.m_Lifetime[index] < 0.f;
 	}
 
-private:
-	float m_ShotTime;
+	static const int RADIUS;
 };
 
 //-------------------------------------------------------------------------------------------------------------
 // Ship
-// Controlled by the player.
+// Flown by whichever controller is set for it.
 //-------------------------------------------------------------------------------------------------------------
-class Ship : public CelestialBody
+class Ship
 {
 public:
-	Ship();
+	static EntityHandle Spawn(ShipArray& ships);
+	static EntityHandle Spawn(ShipArray& ships, const NTPoint& position, ShipControllerId controller);
+
+	// Act on each ship's command, commands[index].
+	static void Update(Game& game, const std::vector<ShipCommand>& commands, float timeDelta);
+	static void Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& ships, float interpolation);
 
-	virtual void Update();
-	virtual void Draw(HDC hdc);
 
-	void Explode();
+	static void Explode(Game& game, size_t index);
 
-	float m_Angle;
-	float m_TimeSinceLastShot;
+	// Whether a missile moving from missileFrom to missileTo hits the ship, and if so how far along.
+	static bool IsHitBy(const EntityArray& ships, size_t index, const NTPoint& missileFrom, const NTPoint& missileTo, float& outTime);
 
+	static const int RADIUS;
 };
 
 //-------------------------------------------------------------------------------------------------------------
-// Asteroids 
+// Asteroids
 // spawn asteroids which the player can destroy by shooting them once.
 //-------------------------------------------------------------------------------------------------------------
-class Asteroids : public CelestialBody
+class Asteroids
 {
 public:
-	Asteroids(int x, int y);
-	virtual void Update() {}
-	virtual void Draw(HDC hdc);
+	static EntityHandle Spawn(EntityArray& asteroids, int x, int y);
+	static void Draw(RenderCommandBuffer& commands, const RenderSnapshotLayer& asteroids);
 
 	static const int RADIUS;
 
-	bool CanDestory(const Missile* OneMissile);
+	// The closest two asteroids are placed to each other.
+	static const float MINIMUM_SPACING;
+
+	// Whether a missile moving from missileFrom to missileTo hits the asteroid, and if so how far along.
+	static bool CanDestory(const EntityArray& asteroids, size_t index, const NTPoint& missileFrom, const NTPoint& missileTo,
+		float& outTime);
 };
@@ -0,0 +1,154 @@
+//-------------------------------------------------------------------------------------------------------------
+// poissondisk.cpp
+//
+// Implementation of Poisson-disk sampling.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "poissondisk.h"
+
+// Candidates tried around an active point before it is retired. Bridson's suggested value.
+static const int CANDIDATES_PER_POINT = 30;
+
+static const float TWO_PI = 6.2831853f;
+
+//--------------------------------------------------------------------------------------------------------------
+// Generate
+// Start from one random point. Repeatedly pick an active point and try candidates in the ring between one and
+// two minimum distances around it; a candidate clear of every point so far is kept and made active, and a
+// point with no room left around it is retired. Each point is made active once and retired once, and each
+// candidate test looks at a fixed number of cells, so the whole fill is linear in the points it makes.
+//--------------------------------------------------------------------------------------------------------------
+size_t PoissonDiskSampler::Generate(RandomStream& random, float minX, float minY, float maxX, float maxY,
+	float minDistance, size_t maxPoints, std::vector<NTPoint>& outPoints)
+{
+	assert(minDistance > 0.f);
+
+	outPoints.clear();
+	if (maxPoints == 0 || !(maxX > minX) || !(maxY > minY))
+	{
+		return 0;
+	}
+
+	m_MinX = minX;
+	m_MinY = minY;
+	m_MaxX = maxX;
+	m_MaxY = maxY;
+	m_MinDistance = minDistance;
+	m_CellSize = minDistance / sqrtf(2.f);
+	m_Columns = (int)ceilf((maxX - minX) / m_CellSize);
+	m_Rows = (int)ceilf((maxY - minY) / m_CellSize);
+
+	m_Grid.assign((size_t)m_Columns * m_Rows, -1);
+	m_Points.clear();
+	m_Active.clear();
+
+	AddPoint(NTPoint(random.NextRange(minX, maxX), random.NextRange(minY, maxY)));
+
+	while (!m_Active.empty())
+	{
+		size_t activeIndex = (size_t)random.NextRange(0, (int)m_Active.size());
+		NTPoint centre = m_Points[m_Active[activeIndex]];
+
+		bool placed = false;
+		for (int attempt = 0; attempt < CANDIDATES_PER_POINT && !placed; attempt++)
+		{
+			// Uniform over the ring's area rather than its radius.
+			float radius = minDistance * sqrtf(1.f + 3.f * random.NextUnit());
+			float angle = random.NextUnit() * TWO_PI;
+			NTPoint candidate(centre.x + radius * cosf(angle), centre.y + radius * sinf(angle));
+
+			if (candidate.x < minX || candidate.x >= maxX || candidate.y < minY || candidate.y >= maxY
+				|| !IsFarEnough(candidate))
+			{
+				continue;
+			}
+
+			AddPoint(candidate);
+			placed = true;
+		}
+
+		if (!placed)
+		{
+			m_Active[activeIndex] = m_Active.back();
+			m_Active.pop_back();
+		}
+	}
+
+	// A partial shuffle leaves a uniform random choice of the points at the front.
+	size_t count = m_Points.size() < maxPoints ? m_Points.size() : maxPoints;
+	for (size_t index = 0; index < count; index++)
+	{
+		size_t other = index + (size_t)random.NextRange(0, (int)(m_Points.size() - index));
+		NTPoint swapped = m_Points[index];
+		m_Points[index] = m_Points[other];
+		m_Points[other] = swapped;
+	}
+
+	outPoints.assign(m_Points.begin(), m_Points.begin() + count);
+	return count;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetCell
+// Clamped, in case rounding puts a point on the far edge of the rectangle just outside the last cell.
+//--------------------------------------------------------------------------------------------------------------
+void PoissonDiskSampler::GetCell(const NTPoint& point, int& outColumn, int& outRow) const
+{
+	outColumn = (int)((point.x - m_MinX) / m_CellSize);
+	outRow = (int)((point.y - m_MinY) / m_CellSize);
+	outColumn = outColumn < m_Columns - 1 ? outColumn : m_Columns - 1;
+	outRow = outRow < m_Rows - 1 ? outRow : m_Rows - 1;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AddPoint
+// Keep the point, make it active, and enter it in the grid.
+//--------------------------------------------------------------------------------------------------------------
+void PoissonDiskSampler::AddPoint(const NTPoint& point)
+{
+	int column, row;
+	GetCell(point, column, row);
+
+	int index = (int)m_Points.size();
+	m_Points.push_back(point);
+	m_Active.push_back(index);
+	m_Grid[(size_t)row * m_Columns + column] = index;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// IsFarEnough
+// A point within the minimum distance can only be in the 5x5 block of cells around the candidate's.
+//--------------------------------------------------------------------------------------------------------------
+bool PoissonDiskSampler::IsFarEnough(const NTPoint& candidate) const
+{
+	int column, row;
+	GetCell(candidate, column, row);
+
+	int fromColumn = column - 2 > 0 ? column - 2 : 0;
+	int toColumn = column + 2 < m_Columns - 1 ? column + 2 : m_Columns - 1;
+	int fromRow = row - 2 > 0 ? row - 2 : 0;
+	int toRow = row + 2 < m_Rows - 1 ? row + 2 : m_Rows - 1;
+
+	float minDistanceSquared = m_MinDistance * m_MinDistance;
+	for (int y = fromRow; y <= toRow; y++)
+	{
+		for (int x = fromColumn; x <= toColumn; x++)
+		{
+			int index = m_Grid[(size_t)y * m_Columns + x];
+			if (index >= 0)
+			{
+				float dx = m_Points[index].x - candidate.x;
+				float dy = m_Points[index].y - candidate.y;
+				if (dx * dx + dy * dy < minDistanceSquared)
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,52 @@
+//-------------------------------------------------------------------------------------------------------------
+// poissondisk.h
+//
+// Scattering points over a rectangle with a guaranteed minimum distance between them, in time linear in the
+// number of points, using Bridson's algorithm.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "ntpoint.h"
+#include "random.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// PoissonDiskSampler
+// Keeps its working storage between calls, so generating again at a similar size doesn't allocate.
+//-------------------------------------------------------------------------------------------------------------
+class PoissonDiskSampler
+{
+public:
+	// Fill the rectangle until no more points fit, then keep a random choice of maxPoints of them, so that a
+	// few points are spread over the whole rectangle rather than clustered where filling started. Every
+	// point is at least minDistance from every other. Returns the number of points generated, which is less
+	// than maxPoints only if the rectangle can't hold that many.
+	size_t Generate(RandomStream& random, float minX, float minY, float maxX, float maxY, float minDistance,
+		size_t maxPoints, std::vector<NTPoint>& outPoints);
+
+private:
+	void GetCell(const NTPoint& point, int& outColumn, int& outRow) const;
+	void AddPoint(const NTPoint& point);
+	bool IsFarEnough(const NTPoint& candidate) const;
+
+	// The grid's cells are small enough that each holds at most one point. Entries are indices into
+	// m_Points, or -1 for an empty cell.
+	std::vector<int>		m_Grid;
+	std::vector<NTPoint>	m_Points;
+	std::vector<int>		m_Active;
+
+	float					m_MinX;
+	float					m_MinY;
+	float					m_MaxX;
+	float					m_MaxY;
+	float					m_MinDistance;
+	float					m_CellSize;
+	int						m_Columns;
+	int						m_Rows;
+};
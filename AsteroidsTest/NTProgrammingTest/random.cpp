@@ -0,0 +1,50 @@
+//-------------------------------------------------------------------------------------------------------------
+// random.cpp
+//
+// Implementation of the random number streams.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "random.h"
+
+//--------------------------------------------------------------------------------------------------------------
+// SplitMix64
+// Advance the state by the golden ratio and scramble it. Consecutive states give unrelated outputs, which is
+// what makes it suitable for turning similar identities into dissimilar generator states.
+//--------------------------------------------------------------------------------------------------------------
+static unsigned long long SplitMix64(unsigned long long& state)
+{
+	state += 0x9e3779b97f4a7c15ull;
+	unsigned long long mixed = state;
+	mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ull;
+	mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebull;
+	return mixed ^ (mixed >> 31);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Seed
+// Each part of the identity is mixed in separately, so that, say, stream 1 substream 0 and stream 0
+// substream 1 don't end up with the same state.
+//--------------------------------------------------------------------------------------------------------------
+void RandomStream::Seed(unsigned long long seed, unsigned int stream, unsigned long long substream)
+{
+	unsigned long long key = seed;
+	key = SplitMix64(key) + stream;
+	key = SplitMix64(key) + substream;
+
+	unsigned long long low = SplitMix64(key);
+	unsigned long long high = SplitMix64(key);
+	m_State[0] = (unsigned int)low;
+	m_State[1] = (unsigned int)(low >> 32);
+	m_State[2] = (unsigned int)high;
+	m_State[3] = (unsigned int)(high >> 32);
+
+	// xoshiro's only bad state; vanishingly unlikely, but cheap to rule out.
+	if ((m_State[0] | m_State[1] | m_State[2] | m_State[3]) == 0)
+	{
+		m_State[0] = 1;
+	}
+}
@@ -0,0 +1,99 @@
+//-------------------------------------------------------------------------------------------------------------
+// random.h
+//
+// Seedable random number streams. Each stream is identified by a seed, a stream number and a substream number,
+// and streams with different identities are independent of each other. Code that needs random numbers makes
+// its own stream from its own identity rather than sharing one generator, so the numbers it gets don't depend
+// on what else drew numbers first or on which thread it runs on, and are the same on every platform.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// RandomStream
+// xoshiro128**, seeded through SplitMix64 from the stream's identity. Small enough to make one per entity,
+// and a stream can be copied to save its position.
+//-------------------------------------------------------------------------------------------------------------
+class RandomStream
+{
+public:
+	RandomStream() { Seed(0, 0); }
+	RandomStream(unsigned long long seed, unsigned int stream, unsigned long long substream = 0) { Seed(seed, stream, substream); }
+
+	void Seed(unsigned long long seed, unsigned int stream, unsigned long long substream = 0);
+
+	unsigned int NextUInt()
+	{
+		unsigned int result = RotateLeft(m_State[1] * 5, 7) * 9;
+		unsigned int shifted = m_State[1] << 9;
+
+		m_State[2] ^= m_State[0];
+		m_State[3] ^= m_State[1];
+		m_State[1] ^= m_State[2];
+		m_State[0] ^= m_State[3];
+		m_State[2] ^= shifted;
+		m_State[3] = RotateLeft(m_State[3], 11);
+
+		return result;
+	}
+
+	// Uniform in [0, 1), from the top 24 bits so that every value is exact as a float.
+	float NextUnit()
+	{
+		return (float)(NextUInt() >> 8) * (1.f / 16777216.f);
+	}
+
+	// Uniform in [min, max).
+	float NextRange(float min, float max)
+	{
+		return min + NextUnit() * (max - min);
+	}
+
+	// Uniform in [min, max), or min if the range is empty.
+	int NextRange(int min, int max)
+	{
+		if (max <= min)
+		{
+			return min;
+		}
+		return min + (int)(((unsigned long long)NextUInt() * (unsigned int)(max - min)) >> 32);
+	}
+
+private:
+	static unsigned int RotateLeft(unsigned int value, int shift)
+	{
+		return (value << shift) | (value >> (32 - shift));
+	}
+
+	unsigned int	m_State[4];
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// RandomStreamId
+// The random streams the game draws from, one for each thing that needs random numbers. Within a stream, the
+// substream picks out the object the numbers are for.
+//-------------------------------------------------------------------------------------------------------------
+enum RandomStreamId
+{
+	// How many of each object the field has, or a streamed chunk has, with the chunk as the substream.
+	RANDOM_STREAM_WORLD,
+
+	// Where the suns and asteroids are placed, likewise.
+	RANDOM_STREAM_SUNS,
+	RANDOM_STREAM_ASTEROIDS,
+
+	// Where a ship reappears, keyed on the tick and the ship's slot.
+	RANDOM_STREAM_RESPAWN,
+
+	// For tools and tests driving the game, so that they don't disturb the game's own streams.
+	RANDOM_STREAM_TOOLS,
+
+	// Where each bot ship starts, with the bot's number as the substream.
+	RANDOM_STREAM_BOTS,
+
+	// On a server, where each client's ship starts, with the connection's number as the substream. On a
+	// client, which packets a simulated lossy link drops, from a seed of the client's own.
+	RANDOM_STREAM_NETWORK
+};
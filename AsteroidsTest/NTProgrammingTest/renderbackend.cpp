@@ -0,0 +1,129 @@
+//-------------------------------------------------------------------------------------------------------------
+// renderbackend.cpp
+//
+// Implementation of the render backends.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "renderbackend.h"
+
+//--------------------------------------------------------------------------------------------------------------
+// FramebufferRenderBackend
+//--------------------------------------------------------------------------------------------------------------
+FramebufferRenderBackend::FramebufferRenderBackend(Framebuffer& target)
+: m_Target(target)
+, m_Background(MakeColour(255, 255, 255))
+{
+	for (int pen = 0; pen < PEN_COUNT; pen++)
+	{
+		m_PenColours[pen] = GetPenColour((RenderPen)pen);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Submit
+//--------------------------------------------------------------------------------------------------------------
+void FramebufferRenderBackend::Submit(const RenderCommandBuffer& commands)
+{
+	m_Target.Clear(m_Background);
+
+	const std::vector<RenderBatch>& batches = commands.GetBatches();
+	for (size_t batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+	{
+		const RenderBatch& batch = batches[batchIndex];
+		Colour colour = m_PenColours[batch.m_Pen];
+
+		if (batch.m_Shape == SHAPE_CIRCLE)
+		{
+			for (size_t index = batch.m_Begin; index < batch.m_End; index++)
+			{
+				const RenderCommand& command = commands.GetCommand(index);
+				m_Target.DrawCircle((int)command.m_X, (int)command.m_Y, command.m_Radius, colour, m_Background);
+			}
+		}
+		else
+		{
+			for (size_t index = batch.m_Begin; index < batch.m_End; index++)
+			{
+				int points[4][2];
+				GetShipOutline(commands.GetCommand(index), points);
+				m_Target.DrawPolygon(&points[0][0], 4, colour);
+			}
+		}
+	}
+}
+
+#ifdef _WIN32
+//--------------------------------------------------------------------------------------------------------------
+// GdiRenderBackend
+//--------------------------------------------------------------------------------------------------------------
+GdiRenderBackend::GdiRenderBackend()
+: m_DeviceContext(NULL)
+{
+	for (int pen = 0; pen < PEN_COUNT; pen++)
+	{
+		Colour colour = GetPenColour((RenderPen)pen);
+		m_Pens[pen] = CreatePen(PS_SOLID, 1, RGB(GetRed(colour), GetGreen(colour), GetBlue(colour)));
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~GdiRenderBackend
+//--------------------------------------------------------------------------------------------------------------
+GdiRenderBackend::~GdiRenderBackend()
+{
+	for (int pen = 0; pen < PEN_COUNT; pen++)
+	{
+		DeleteObject(m_Pens[pen]);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Submit
+// Puts the device context's own pen back afterwards.
+//--------------------------------------------------------------------------------------------------------------
+void GdiRenderBackend::Submit(const RenderCommandBuffer& commands)
+{
+	assert(m_DeviceContext != NULL);
+
+	HGDIOBJ originalPen = GetCurrentObject(m_DeviceContext, OBJ_PEN);
+
+	const std::vector<RenderBatch>& batches = commands.GetBatches();
+	for (size_t batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+	{
+		const RenderBatch& batch = batches[batchIndex];
+		SelectObject(m_DeviceContext, m_Pens[batch.m_Pen]);
+
+		if (batch.m_Shape == SHAPE_CIRCLE)
+		{
+			for (size_t index = batch.m_Begin; index < batch.m_End; index++)
+			{
+				const RenderCommand& command = commands.GetCommand(index);
+				int x = (int)command.m_X;
+				int y = (int)command.m_Y;
+				int radius = command.m_Radius;
+				Ellipse(m_DeviceContext, x - radius, y - radius, x + radius, y + radius);
+			}
+		}
+		else
+		{
+			for (size_t index = batch.m_Begin; index < batch.m_End; index++)
+			{
+				int aiPoints[4][2];
+				GetShipOutline(commands.GetCommand(index), aiPoints);
+
+				MoveToEx(m_DeviceContext, aiPoints[0][0], aiPoints[0][1], 0);
+				LineTo(m_DeviceContext, aiPoints[1][0], aiPoints[1][1]);
+				LineTo(m_DeviceContext, aiPoints[2][0], aiPoints[2][1]);
+				LineTo(m_DeviceContext, aiPoints[3][0], aiPoints[3][1]);
+				LineTo(m_DeviceContext, aiPoints[0][0], aiPoints[0][1]);
+			}
+		}
+	}
+
+	SelectObject(m_DeviceContext, originalPen);
+}
+#endif // _WIN32
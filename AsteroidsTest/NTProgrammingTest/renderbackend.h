@@ -0,0 +1,55 @@
+//-------------------------------------------------------------------------------------------------------------
+// renderbackend.h
+//
+// The backends that draw render command buffers: into a software framebuffer, or through GDI on Windows.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include "framebuffer.h"
+#include "rendercommands.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// FramebufferRenderBackend
+// Clears the framebuffer to white and rasterises the commands into it. Circles are filled white, as GDI's
+// default brush fills them in the window.
+//-------------------------------------------------------------------------------------------------------------
+class FramebufferRenderBackend : public RenderBackend
+{
+public:
+	explicit FramebufferRenderBackend(Framebuffer& target);
+
+	virtual void Submit(const RenderCommandBuffer& commands);
+
+private:
+	Framebuffer&	m_Target;
+	Colour			m_Background;
+	Colour			m_PenColours[PEN_COUNT];
+};
+
+#ifdef _WIN32
+//-------------------------------------------------------------------------------------------------------------
+// GdiRenderBackend
+// Draws into a device context. The pens are created once and kept, and each batch selects its pen once.
+// The background is whatever the window erased to.
+//-------------------------------------------------------------------------------------------------------------
+class GdiRenderBackend : public RenderBackend
+{
+public:
+	GdiRenderBackend();
+	virtual ~GdiRenderBackend();
+
+	void SetDeviceContext(HDC hdc) { m_DeviceContext = hdc; }
+
+	virtual void Submit(const RenderCommandBuffer& commands);
+
+private:
+	HDC		m_DeviceContext;
+	HPEN	m_Pens[PEN_COUNT];
+};
+#endif // _WIN32
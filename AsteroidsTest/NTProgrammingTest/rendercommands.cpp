@@ -0,0 +1,287 @@
+//-------------------------------------------------------------------------------------------------------------
+// rendercommands.cpp
+//
+// Implementation of the render command buffer.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "rendercommands.h"
+#include <math.h>
+#include <string.h>
+
+// Capture files start with this, followed by the format version.
+static const char CAPTURE_MAGIC[4] = { 'N', 'T', 'R', 'C' };
+static const unsigned int CAPTURE_VERSION = 1;
+
+// Each command is written as shape, pen, radius, x, y and angle, in little-endian order.
+static const size_t SAVED_COMMAND_SIZE = 16;
+
+//--------------------------------------------------------------------------------------------------------------
+// GetPenColour
+//--------------------------------------------------------------------------------------------------------------
+Colour GetPenColour(RenderPen pen)
+{
+	switch (pen)
+	{
+	case PEN_RED:	return MakeColour(255, 0, 0);
+	case PEN_GREEN:	return MakeColour(0, 255, 0);
+	case PEN_BLUE:	return MakeColour(0, 0, 255);
+	default:		return MakeColour(0, 0, 0);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetShipOutline
+// A dart from the ship's position, pointing along its heading.
+//--------------------------------------------------------------------------------------------------------------
+void GetShipOutline(const RenderCommand& command, int outPoints[4][2])
+{
+	const int iLong = 12;
+	const int iShort = 4;
+
+	float x = command.m_X;
+	float y = command.m_Y;
+	float angle = command.m_Angle;
+
+	outPoints[0][0] = (int)(x);
+	outPoints[0][1] = (int)(y);
+	outPoints[1][0] = (int)(x+sinf(angle-3.14f/2.f)*iShort);
+	outPoints[1][1] = (int)(y+cosf(angle-3.14f/2.f)*iShort);
+	outPoints[2][0] = (int)(x+sinf(angle)*iLong);
+	outPoints[2][1] = (int)(y+cosf(angle)*iLong);
+	outPoints[3][0] = (int)(x+sinf(angle+3.14f/2.f)*iShort);
+	outPoints[3][1] = (int)(y+cosf(angle+3.14f/2.f)*iShort);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+//--------------------------------------------------------------------------------------------------------------
+void RenderCommandBuffer::Clear()
+{
+	m_Commands.clear();
+	m_Batches.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AddCircle
+//--------------------------------------------------------------------------------------------------------------
+void RenderCommandBuffer::AddCircle(RenderPen pen, float x, float y, int radius)
+{
+	RenderCommand command;
+	command.m_Shape = (unsigned char)SHAPE_CIRCLE;
+	command.m_Pen = (unsigned char)pen;
+	command.m_Radius = (unsigned short)radius;
+	command.m_X = x;
+	command.m_Y = y;
+	command.m_Angle = 0.f;
+	m_Commands.push_back(command);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// AddShip
+//--------------------------------------------------------------------------------------------------------------
+void RenderCommandBuffer::AddShip(RenderPen pen, float x, float y, float angle)
+{
+	RenderCommand command;
+	command.m_Shape = (unsigned char)SHAPE_SHIP;
+	command.m_Pen = (unsigned char)pen;
+	command.m_Radius = 0;
+	command.m_X = x;
+	command.m_Y = y;
+	command.m_Angle = angle;
+	m_Commands.push_back(command);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SortByState
+// A counting sort on pen then shape, so the whole sort is two linear passes.
+//--------------------------------------------------------------------------------------------------------------
+void RenderCommandBuffer::SortByState()
+{
+	const int keyCount = PEN_COUNT * SHAPE_COUNT;
+	size_t start[keyCount + 1] = { 0 };
+
+	for (size_t index = 0; index < m_Commands.size(); index++)
+	{
+		const RenderCommand& command = m_Commands[index];
+		start[command.m_Pen * SHAPE_COUNT + command.m_Shape + 1]++;
+	}
+	for (int key = 0; key < keyCount; key++)
+	{
+		start[key + 1] += start[key];
+	}
+
+	m_Batches.clear();
+	for (int key = 0; key < keyCount; key++)
+	{
+		if (start[key] != start[key + 1])
+		{
+			RenderBatch batch;
+			batch.m_Pen = (RenderPen)(key / SHAPE_COUNT);
+			batch.m_Shape = (RenderShape)(key % SHAPE_COUNT);
+			batch.m_Begin = start[key];
+			batch.m_End = start[key + 1];
+			m_Batches.push_back(batch);
+		}
+	}
+
+	m_Sorted.resize(m_Commands.size());
+	for (size_t index = 0; index < m_Commands.size(); index++)
+	{
+		const RenderCommand& command = m_Commands[index];
+		m_Sorted[start[command.m_Pen * SHAPE_COUNT + command.m_Shape]++] = command;
+	}
+	m_Commands.swap(m_Sorted);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Serialisation helpers
+//--------------------------------------------------------------------------------------------------------------
+static void PutUnsigned(unsigned char* out, unsigned int value)
+{
+	out[0] = (unsigned char)value;
+	out[1] = (unsigned char)(value >> 8);
+	out[2] = (unsigned char)(value >> 16);
+	out[3] = (unsigned char)(value >> 24);
+}
+
+static unsigned int GetUnsigned(const unsigned char* in)
+{
+	return in[0] | (in[1] << 8) | (in[2] << 16) | ((unsigned int)in[3] << 24);
+}
+
+// Returns false if the file can't report its size, as a pipe can't.
+static bool GetBytesRemaining(FILE* file, size_t& outBytes)
+{
+	long position = ftell(file);
+	if (position < 0 || fseek(file, 0, SEEK_END) != 0)
+	{
+		return false;
+	}
+
+	long end = ftell(file);
+	if (fseek(file, position, SEEK_SET) != 0 || end < position)
+	{
+		return false;
+	}
+
+	outBytes = (size_t)(end - position);
+	return true;
+}
+
+static void PutFloat(unsigned char* out, float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	PutUnsigned(out, bits);
+}
+
+static float GetFloat(const unsigned char* in)
+{
+	unsigned int bits = GetUnsigned(in);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteCaptureHeader
+//--------------------------------------------------------------------------------------------------------------
+bool RenderCommandBuffer::WriteCaptureHeader(FILE* file)
+{
+	unsigned char header[8];
+	memcpy(header, CAPTURE_MAGIC, 4);
+	PutUnsigned(header + 4, CAPTURE_VERSION);
+	return fwrite(header, 1, sizeof(header), file) == sizeof(header);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ReadCaptureHeader
+// Returns false if the file isn't a capture this version can read.
+//--------------------------------------------------------------------------------------------------------------
+bool RenderCommandBuffer::ReadCaptureHeader(FILE* file)
+{
+	unsigned char header[8];
+	if (fread(header, 1, sizeof(header), file) != sizeof(header))
+	{
+		return false;
+	}
+	return memcmp(header, CAPTURE_MAGIC, 4) == 0 && GetUnsigned(header + 4) == CAPTURE_VERSION;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Save
+//--------------------------------------------------------------------------------------------------------------
+bool RenderCommandBuffer::Save(FILE* file) const
+{
+	std::vector<unsigned char> data(4 + m_Commands.size() * SAVED_COMMAND_SIZE);
+	PutUnsigned(&data[0], (unsigned int)m_Commands.size());
+
+	unsigned char* out = &data[4];
+	for (size_t index = 0; index < m_Commands.size(); index++, out += SAVED_COMMAND_SIZE)
+	{
+		const RenderCommand& command = m_Commands[index];
+		out[0] = command.m_Shape;
+		out[1] = command.m_Pen;
+		out[2] = (unsigned char)command.m_Radius;
+		out[3] = (unsigned char)(command.m_Radius >> 8);
+		PutFloat(out + 4, command.m_X);
+		PutFloat(out + 8, command.m_Y);
+		PutFloat(out + 12, command.m_Angle);
+	}
+
+	return fwrite(&data[0], 1, data.size(), file) == data.size();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Load
+// Replaces the buffer's contents. Call SortByState before submitting.
+//--------------------------------------------------------------------------------------------------------------
+bool RenderCommandBuffer::Load(FILE* file)
+{
+	Clear();
+
+	unsigned char countData[4];
+	if (fread(countData, 1, sizeof(countData), file) != sizeof(countData))
+	{
+		return false;
+	}
+
+	// A corrupt count mustn't allocate more than the file could hold.
+	unsigned int count = GetUnsigned(countData);
+	size_t bytesRemaining;
+	if (!GetBytesRemaining(file, bytesRemaining) || count > bytesRemaining / SAVED_COMMAND_SIZE)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> data(count * SAVED_COMMAND_SIZE);
+	if (count > 0 && fread(&data[0], 1, data.size(), file) != data.size())
+	{
+		return false;
+	}
+
+	m_Commands.resize(count);
+	const unsigned char* in = data.empty() ? NULL : &data[0];
+	for (unsigned int index = 0; index < count; index++, in += SAVED_COMMAND_SIZE)
+	{
+		if (in[0] >= SHAPE_COUNT || in[1] >= PEN_COUNT)
+		{
+			Clear();
+			return false;
+		}
+
+		RenderCommand& command = m_Commands[index];
+		command.m_Shape = in[0];
+		command.m_Pen = in[1];
+		command.m_Radius = (unsigned short)(in[2] | (in[3] << 8));
+		command.m_X = GetFloat(in + 4);
+		command.m_Y = GetFloat(in + 8);
+		command.m_Angle = GetFloat(in + 12);
+	}
+
+	return true;
+}
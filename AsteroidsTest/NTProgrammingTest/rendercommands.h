@@ -0,0 +1,124 @@
+//-------------------------------------------------------------------------------------------------------------
+// rendercommands.h
+//
+// A frame's drawing, recorded as a list of small commands instead of being drawn straight away, so that it can
+// be batched by pen, saved, and replayed into any backend.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <vector>
+#include "framebuffer.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderPen
+// The pens the game draws with. Backends create the matching state once and keep it.
+//-------------------------------------------------------------------------------------------------------------
+enum RenderPen
+{
+	PEN_RED,
+	PEN_GREEN,
+	PEN_BLUE,
+
+	PEN_COUNT
+};
+
+Colour GetPenColour(RenderPen pen);
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderShape
+//-------------------------------------------------------------------------------------------------------------
+enum RenderShape
+{
+	// An outlined circle of m_Radius.
+	SHAPE_CIRCLE,
+
+	// A ship's dart outline, pointing along m_Angle.
+	SHAPE_SHIP,
+
+	SHAPE_COUNT
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderCommand
+// One shape to draw.
+//-------------------------------------------------------------------------------------------------------------
+struct RenderCommand
+{
+	unsigned char	m_Shape;
+	unsigned char	m_Pen;
+	unsigned short	m_Radius;
+	float			m_X;
+	float			m_Y;
+	float			m_Angle;
+};
+
+// The corners of a SHAPE_SHIP command's outline.
+void GetShipOutline(const RenderCommand& command, int outPoints[4][2]);
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderBatch
+// A run of commands sharing a pen and shape, which a backend can draw with one state change.
+//-------------------------------------------------------------------------------------------------------------
+struct RenderBatch
+{
+	RenderPen	m_Pen;
+	RenderShape	m_Shape;
+	size_t		m_Begin;
+	size_t		m_End;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderCommandBuffer
+// Cleared and refilled every frame; the storage is kept, so a steady frame doesn't allocate.
+//-------------------------------------------------------------------------------------------------------------
+class RenderCommandBuffer
+{
+public:
+	void Clear();
+	void Reserve(size_t count) { m_Commands.reserve(count); }
+
+	void AddCircle(RenderPen pen, float x, float y, int radius);
+	void AddShip(RenderPen pen, float x, float y, float angle);
+
+	// Reorder the commands so that each pen and shape is contiguous, and work out the batches. Stable, so
+	// commands sharing a pen keep the order they were added in.
+	void SortByState();
+
+	size_t Size() const { return m_Commands.size(); }
+	const RenderCommand& GetCommand(size_t index) const { return m_Commands[index]; }
+
+	// Valid after SortByState, until the buffer is next changed.
+	const std::vector<RenderBatch>& GetBatches() const { return m_Batches; }
+
+	// Append the frame to a capture file, or read the next frame from one. Load returns false at the end of
+	// the file or on a malformed frame.
+	bool Save(FILE* file) const;
+	bool Load(FILE* file);
+
+	static bool WriteCaptureHeader(FILE* file);
+	static bool ReadCaptureHeader(FILE* file);
+
+private:
+	std::vector<RenderCommand>	m_Commands;
+	std::vector<RenderCommand>	m_Sorted;
+	std::vector<RenderBatch>	m_Batches;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderBackend
+// Draws a sorted command buffer as one whole frame, on a cleared background.
+//-------------------------------------------------------------------------------------------------------------
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	virtual void Submit(const RenderCommandBuffer& commands) = 0;
+};
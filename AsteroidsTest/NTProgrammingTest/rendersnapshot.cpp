@@ -0,0 +1,110 @@
+//-------------------------------------------------------------------------------------------------------------
+// rendersnapshot.cpp
+//
+// Implementation of render snapshots and the buffer between the simulation and render threads.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "rendersnapshot.h"
+#include "objects.h"
+#include "trace.h"
+
+//--------------------------------------------------------------------------------------------------------------
+// Capture
+//--------------------------------------------------------------------------------------------------------------
+void RenderSnapshotLayer::Capture(const EntityArray& entities, bool withPrevious)
+{
+	m_X.assign(entities.m_PositionX.begin(), entities.m_PositionX.end());
+	m_Y.assign(entities.m_PositionY.begin(), entities.m_PositionY.end());
+	if (withPrevious)
+	{
+		m_PreviousX.assign(entities.m_PreviousX.begin(), entities.m_PreviousX.end());
+		m_PreviousY.assign(entities.m_PreviousY.begin(), entities.m_PreviousY.end());
+	}
+	else
+	{
+		m_PreviousX.clear();
+		m_PreviousY.clear();
+	}
+	m_Angle.clear();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetInterpolatedPosition
+// As EntityArray::GetInterpolatedPosition.
+//--------------------------------------------------------------------------------------------------------------
+NTPoint RenderSnapshotLayer::GetInterpolatedPosition(size_t index, float interpolation) const
+{
+	return NTPoint(m_PreviousX[index] + (m_X[index] - m_PreviousX[index]) * interpolation,
+		m_PreviousY[index] + (m_Y[index] - m_PreviousY[index]) * interpolation);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetInterpolationAt
+//--------------------------------------------------------------------------------------------------------------
+float RenderSnapshot::GetInterpolationAt(Clock::time_point time) const
+{
+	if (m_TickDelta <= 0.f || time <= m_CaptureTime)
+	{
+		return m_Interpolation;
+	}
+
+	float interpolation = m_Interpolation + std::chrono::duration<float>(time - m_CaptureTime).count() / m_TickDelta;
+	return interpolation < 1.f ? interpolation : 1.f;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// BuildRenderCommands
+//--------------------------------------------------------------------------------------------------------------
+void RenderSnapshot::BuildRenderCommands(RenderCommandBuffer& commands, float interpolation) const
+{
+	NT_TRACE_SCOPE_COUNT("build render commands", m_Suns.Size() + m_Missiles.Size() + m_Ships.Size() + m_Asteroids.Size());
+	commands.Clear();
+	commands.Reserve(m_Suns.Size() + m_Missiles.Size() + m_Ships.Size() + m_Asteroids.Size());
+
+	Sun::Draw(commands, m_Suns);
+	Missile::Draw(commands, m_Missiles, interpolation);
+	Ship::Draw(commands, m_Ships, interpolation);
+	Asteroids::Draw(commands, m_Asteroids);
+
+	commands.SortByState();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// RenderSnapshotBuffer
+// The writer starts with snapshot 0, the reader with 1, and 2 is the latest, though nothing is in it yet.
+//--------------------------------------------------------------------------------------------------------------
+RenderSnapshotBuffer::RenderSnapshotBuffer()
+: m_Latest(2)
+, m_WriteIndex(0)
+, m_ReadIndex(1)
+, m_HasRead(false)
+, m_PublishedCount(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Publish
+// Release ordering makes the writes to the snapshot visible to a reader that acquires it.
+//--------------------------------------------------------------------------------------------------------------
+void RenderSnapshotBuffer::Publish()
+{
+	m_WriteIndex = m_Latest.exchange(m_WriteIndex | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	m_PublishedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Acquire
+//--------------------------------------------------------------------------------------------------------------
+const RenderSnapshot* RenderSnapshotBuffer::Acquire()
+{
+	if ((m_Latest.load(std::memory_order_relaxed) & FRESH) != 0)
+	{
+		m_ReadIndex = m_Latest.exchange(m_ReadIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		m_HasRead = true;
+	}
+	return m_HasRead ? &m_Snapshots[m_ReadIndex] : NULL;
+}
@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------------------------------------------------
+// rendersnapshot.h
+//
+// A copy of everything drawing needs from one tick, so that a frame can be drawn while the simulation carries
+// on, and the buffer that passes snapshots from the simulation thread to the render thread.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include "entitystore.h"
+#include "ntpoint.h"
+#include "rendercommands.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderSnapshotLayer
+// One kind of object, as drawing sees it. Objects that move keep their previous position, to be drawn part
+// way between the two, and ships keep their heading; the arrays for what a kind doesn't have stay empty.
+//-------------------------------------------------------------------------------------------------------------
+struct RenderSnapshotLayer
+{
+	// Copy the positions, and the previous positions if withPrevious. The storage is reused.
+	void Capture(const EntityArray& entities, bool withPrevious);
+
+	size_t Size() const { return m_X.size(); }
+	NTPoint GetPosition(size_t index) const { return NTPoint(m_X[index], m_Y[index]); }
+	NTPoint GetInterpolatedPosition(size_t index, float interpolation) const;
+
+	std::vector<float>	m_X;
+	std::vector<float>	m_Y;
+	std::vector<float>	m_PreviousX;
+	std::vector<float>	m_PreviousY;
+	std::vector<float>	m_Angle;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderSnapshot
+// Filled in by Game::CaptureSnapshot. Nothing in it refers back to the game, so it can be drawn from any
+// thread once captured.
+//-------------------------------------------------------------------------------------------------------------
+struct RenderSnapshot
+{
+	typedef std::chrono::steady_clock Clock;
+
+	RenderSnapshot()
+	: m_Tick(0)
+	, m_TickDelta(0.f)
+	, m_Interpolation(0.f)
+	{
+	}
+
+	// How far past the previous tick the snapshot is, at a given time: its own interpolation plus the time
+	// since it was captured, so that a frame drawn from an older snapshot still moves smoothly. At most 1.
+	float GetInterpolationAt(Clock::time_point time) const;
+
+	// Record the drawing, sorted and ready to submit.
+	void BuildRenderCommands(RenderCommandBuffer& commands, float interpolation) const;
+
+	unsigned long long	m_Tick;
+	float				m_TickDelta;
+	float				m_Interpolation;
+	Clock::time_point	m_CaptureTime;
+
+	RenderSnapshotLayer	m_Suns;
+	RenderSnapshotLayer	m_Asteroids;
+	RenderSnapshotLayer	m_Missiles;
+	RenderSnapshotLayer	m_Ships;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// RenderSnapshotBuffer
+// A triple buffer. The writer fills one snapshot while the reader draws from another, and the third holds
+// the latest finished one. Publishing swaps the writer's snapshot with that one, and acquiring swaps the
+// reader's with it if a newer one is there, each with a single atomic exchange: neither side ever waits for
+// the other, and the writer can publish any number of times while the reader is still drawing.
+//
+// One thread may write and one other may read.
+//-------------------------------------------------------------------------------------------------------------
+class RenderSnapshotBuffer
+{
+public:
+	RenderSnapshotBuffer();
+
+	// The snapshot to fill in next. Only the writer may touch it, until it calls Publish.
+	RenderSnapshot& GetWriteSnapshot() { return m_Snapshots[m_WriteIndex]; }
+	void Publish();
+
+	// The latest published snapshot, or the one acquired before if nothing newer has been published. It stays
+	// valid, and unchanged, until the reader's next call. Returns NULL if nothing has been published yet.
+	const RenderSnapshot* Acquire();
+
+	unsigned long long GetPublishedCount() const { return m_PublishedCount.load(std::memory_order_relaxed); }
+
+private:
+	// The index of the latest snapshot, with this bit set if the reader hasn't taken it yet.
+	static const unsigned int FRESH = 4;
+	static const unsigned int INDEX_MASK = 3;
+
+	RenderSnapshot					m_Snapshots[3];
+	std::atomic<unsigned int>		m_Latest;
+	unsigned int					m_WriteIndex;
+	unsigned int					m_ReadIndex;
+	bool							m_HasRead;
+	std::atomic<unsigned long long>	m_PublishedCount;
+};
@@ -0,0 +1,610 @@
+//-------------------------------------------------------------------------------------------------------------
+// replay.cpp
+//
+// Implementation of session recording and playback.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "replay.h"
+
+static const char RECORDING_MAGIC[4] = { 'N', 'T', 'I', 'R' };
+static const unsigned int RECORDING_VERSION = 7;
+
+// Magic, version, byte order, seed, tick rate, the sun gravity and integrator settings, the gravity field
+// settings, the sun and asteroid counts, the world streaming settings, the bot count and the keyframe interval.
+static const size_t HEADER_SIZE = 92;
+
+static const unsigned char BLOCK_KEYFRAME = 'K';
+static const unsigned char BLOCK_INPUT = 'I';
+
+// The sizes of the block headers that follow the type byte.
+static const size_t KEYFRAME_HEADER_SIZE = 12;
+static const size_t INPUT_HEADER_SIZE = 16;
+
+// The low bits of each tick's first byte are the keys; this bit says that shots follow.
+static const unsigned char TICK_HAS_FIRES = 0x80;
+static_assert(KEY_COUNT <= 7, "The keys no longer fit alongside TICK_HAS_FIRES");
+
+// Input is written out at least this often, even between keyframes, so that the buffer stays small.
+static const size_t MAX_BUFFERED_INPUT = 64 * 1024;
+
+//--------------------------------------------------------------------------------------------------------------
+// InputRecorder
+//--------------------------------------------------------------------------------------------------------------
+InputRecorder::InputRecorder()
+: m_File(NULL)
+, m_KeyframeInterval(DEFAULT_KEYFRAME_INTERVAL)
+, m_TicksRecorded(0)
+, m_TicksSinceKeyframe(0)
+, m_KeyframesRecorded(0)
+, m_Failed(false)
+, m_InputFirstTick(0)
+, m_InputTicks(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~InputRecorder
+//--------------------------------------------------------------------------------------------------------------
+InputRecorder::~InputRecorder()
+{
+	Close();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Open
+//--------------------------------------------------------------------------------------------------------------
+bool InputRecorder::Open(const char* path, const Game& game, unsigned int keyframeInterval)
+{
+	assert(keyframeInterval > 0);
+
+	Close();
+
+	m_File = fopen(path, "wb");
+	if (m_File == NULL)
+	{
+		return false;
+	}
+
+	m_KeyframeInterval = keyframeInterval;
+	m_TicksRecorded = 0;
+	m_TicksSinceKeyframe = 0;
+	m_KeyframesRecorded = 0;
+	m_Failed = false;
+	m_Input.clear();
+	m_InputTicks = 0;
+
+	const GameSettings& settings = game.m_Settings;
+	std::vector<unsigned char> header;
+	StateWriter writer(header);
+	writer.Write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+	writer.WriteValue(RECORDING_VERSION);
+	writer.WriteValue(STATE_BYTE_ORDER_MARK);
+	writer.WriteValue(game.GetSeed());
+	writer.WriteValue(settings.m_TickRate);
+	writer.WriteValue(settings.m_SunGravity);
+	writer.WriteValue(settings.m_Integrator.m_Accuracy);
+	writer.WriteValue(settings.m_Integrator.m_LengthScale);
+	writer.WriteValue(settings.m_Integrator.m_MaxSubsteps);
+	writer.WriteValue((unsigned int)settings.m_UseGravityField);
+	writer.WriteValue(settings.m_GravityField.m_CellSize);
+	writer.WriteValue(settings.m_GravityField.m_MaxError);
+	writer.WriteValue(settings.m_GravityField.m_ExactRadius);
+	writer.WriteValue(settings.m_GravityField.m_Margin);
+	writer.WriteValue(settings.m_GravityField.m_MaxNodes);
+	writer.WriteValue((unsigned int)settings.m_SunCount);
+	writer.WriteValue((unsigned int)settings.m_AsteroidCount);
+	writer.WriteValue((unsigned int)settings.m_StreamWorld);
+	writer.WriteValue(settings.m_WorldStream.m_ChunkSize);
+	writer.WriteValue(settings.m_WorldStream.m_LoadRadius);
+	writer.WriteValue(settings.m_WorldStream.m_EvictRadius);
+	writer.WriteValue((unsigned int)settings.m_BotCount);
+	writer.WriteValue(keyframeInterval);
+	assert(header.size() == HEADER_SIZE);
+
+	if (fwrite(&header[0], 1, header.size(), m_File) != header.size())
+	{
+		m_Failed = true;
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Close
+//--------------------------------------------------------------------------------------------------------------
+bool InputRecorder::Close()
+{
+	if (m_File == NULL)
+	{
+		return true;
+	}
+
+	FlushInput();
+	if (fclose(m_File) != 0)
+	{
+		m_Failed = true;
+	}
+	m_File = NULL;
+
+	return !m_Failed;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// RecordTick
+// Called with the state as it is at the start of the tick, before the input is acted on.
+//--------------------------------------------------------------------------------------------------------------
+void InputRecorder::RecordTick(const Game& game, const TickInput& input)
+{
+	if (m_File == NULL)
+	{
+		return;
+	}
+
+	unsigned long long tick = game.GetTickCount();
+	assert(m_InputTicks == 0 || tick == m_InputFirstTick + m_InputTicks);
+
+	if (m_KeyframesRecorded == 0 || m_TicksSinceKeyframe >= m_KeyframeInterval)
+	{
+		FlushInput();
+		WriteKeyframe(game);
+		m_TicksSinceKeyframe = 0;
+	}
+	else if (m_Input.size() >= MAX_BUFFERED_INPUT)
+	{
+		FlushInput();
+	}
+
+	if (m_InputTicks == 0)
+	{
+		m_InputFirstTick = tick;
+	}
+
+	StateWriter writer(m_Input);
+	// Written in full, as the game fires every shot it is given.
+	size_t fireCount = input.m_Fires.size();
+	assert(fireCount <= 0xffffffffu);
+	writer.WriteValue((unsigned char)(input.m_Keys | (fireCount > 0 ? TICK_HAS_FIRES : 0)));
+	if (fireCount > 0)
+	{
+		writer.WriteValue((unsigned int)fireCount);
+		for (size_t fire = 0; fire < fireCount; fire++)
+		{
+			writer.WriteValue(input.m_Fires[fire].m_X);
+			writer.WriteValue(input.m_Fires[fire].m_Y);
+		}
+	}
+
+	m_InputTicks++;
+	m_TicksRecorded++;
+	m_TicksSinceKeyframe++;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteKeyframe
+// Flushed straight away, so that everything up to the keyframe survives if the process dies.
+//--------------------------------------------------------------------------------------------------------------
+void InputRecorder::WriteKeyframe(const Game& game)
+{
+	m_State.clear();
+	StateWriter stateWriter(m_State);
+	game.SaveState(stateWriter);
+
+	std::vector<unsigned char> header;
+	StateWriter writer(header);
+	writer.WriteValue(BLOCK_KEYFRAME);
+	writer.WriteValue(game.GetTickCount());
+	writer.WriteValue((unsigned int)m_State.size());
+
+	if (fwrite(&header[0], 1, header.size(), m_File) != header.size()
+		|| fwrite(&m_State[0], 1, m_State.size(), m_File) != m_State.size()
+		|| fflush(m_File) != 0)
+	{
+		m_Failed = true;
+	}
+	m_KeyframesRecorded++;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FlushInput
+//--------------------------------------------------------------------------------------------------------------
+void InputRecorder::FlushInput()
+{
+	if (m_InputTicks == 0)
+	{
+		return;
+	}
+
+	std::vector<unsigned char> header;
+	StateWriter writer(header);
+	writer.WriteValue(BLOCK_INPUT);
+	writer.WriteValue(m_InputFirstTick);
+	writer.WriteValue(m_InputTicks);
+	writer.WriteValue((unsigned int)m_Input.size());
+
+	if (fwrite(&header[0], 1, header.size(), m_File) != header.size()
+		|| fwrite(&m_Input[0], 1, m_Input.size(), m_File) != m_Input.size())
+	{
+		m_Failed = true;
+	}
+
+	m_Input.clear();
+	m_InputTicks = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// InputPlayer
+//--------------------------------------------------------------------------------------------------------------
+InputPlayer::InputPlayer()
+: m_File(NULL)
+, m_Seed(0)
+, m_TickRate(60.f)
+, m_SunGravity(0.f)
+, m_UseGravityField(false)
+, m_SunCount(0)
+, m_AsteroidCount(0)
+, m_StreamWorld(false)
+, m_BotCount(0)
+, m_NextTick(0)
+, m_EndTick(0)
+, m_InputOffset(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~InputPlayer
+//--------------------------------------------------------------------------------------------------------------
+InputPlayer::~InputPlayer()
+{
+	Close();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Open
+// Walk the blocks, reading the input and noting where each keyframe is. Reading stops at the first block
+// that is incomplete or doesn't carry on from the tick before it.
+//--------------------------------------------------------------------------------------------------------------
+bool InputPlayer::Open(const char* path)
+{
+	Close();
+
+	m_File = fopen(path, "rb");
+	if (m_File == NULL)
+	{
+		return false;
+	}
+
+	fseek(m_File, 0, SEEK_END);
+	long fileSize = ftell(m_File);
+	fseek(m_File, 0, SEEK_SET);
+
+	unsigned char header[HEADER_SIZE];
+	if (fread(header, 1, sizeof(header), m_File) != sizeof(header))
+	{
+		Close();
+		return false;
+	}
+
+	StateReader reader(header, sizeof(header));
+	char magic[4];
+	unsigned int version = 0;
+	unsigned int byteOrder = 0;
+	unsigned int useGravityField = 0;
+	unsigned int sunCount = 0;
+	unsigned int asteroidCount = 0;
+	unsigned int streamWorld = 0;
+	unsigned int botCount = 0;
+	unsigned int keyframeInterval = 0;
+	reader.Read(magic, sizeof(magic));
+	reader.ReadValue(version);
+	reader.ReadValue(byteOrder);
+	reader.ReadValue(m_Seed);
+	reader.ReadValue(m_TickRate);
+	reader.ReadValue(m_SunGravity);
+	reader.ReadValue(m_Integrator.m_Accuracy);
+	reader.ReadValue(m_Integrator.m_LengthScale);
+	reader.ReadValue(m_Integrator.m_MaxSubsteps);
+	reader.ReadValue(useGravityField);
+	reader.ReadValue(m_GravityField.m_CellSize);
+	reader.ReadValue(m_GravityField.m_MaxError);
+	reader.ReadValue(m_GravityField.m_ExactRadius);
+	reader.ReadValue(m_GravityField.m_Margin);
+	reader.ReadValue(m_GravityField.m_MaxNodes);
+	reader.ReadValue(sunCount);
+	reader.ReadValue(asteroidCount);
+	reader.ReadValue(streamWorld);
+	reader.ReadValue(m_WorldStream.m_ChunkSize);
+	reader.ReadValue(m_WorldStream.m_LoadRadius);
+	reader.ReadValue(m_WorldStream.m_EvictRadius);
+	reader.ReadValue(botCount);
+	reader.ReadValue(keyframeInterval);
+	m_UseGravityField = useGravityField != 0;
+	m_SunCount = sunCount;
+	m_AsteroidCount = asteroidCount;
+	m_StreamWorld = streamWorld != 0;
+	m_BotCount = botCount;
+
+	if (reader.HasFailed() || memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0 || version != RECORDING_VERSION
+		|| byteOrder != STATE_BYTE_ORDER_MARK || !(m_TickRate > 0.f) || !(m_Integrator.m_Accuracy > 0.f)
+		|| !(m_Integrator.m_LengthScale > 0.f) || m_Integrator.m_MaxSubsteps < 1 || !(m_WorldStream.m_ChunkSize > 0.f)
+		|| m_WorldStream.m_LoadRadius < 0 || m_WorldStream.m_EvictRadius < m_WorldStream.m_LoadRadius)
+	{
+		Close();
+		return false;
+	}
+
+	unsigned long long inputEnd = 0;
+	for (;;)
+	{
+		int type = fgetc(m_File);
+		if (type == BLOCK_KEYFRAME)
+		{
+			unsigned char blockHeader[KEYFRAME_HEADER_SIZE];
+			if (fread(blockHeader, 1, sizeof(blockHeader), m_File) != sizeof(blockHeader))
+			{
+				break;
+			}
+
+			Keyframe keyframe;
+			StateReader blockReader(blockHeader, sizeof(blockHeader));
+			blockReader.ReadValue(keyframe.m_Tick);
+			blockReader.ReadValue(keyframe.m_Size);
+			keyframe.m_FileOffset = ftell(m_File);
+
+			if (keyframe.m_Size > (unsigned long)(fileSize - keyframe.m_FileOffset)
+				|| (!m_Keyframes.empty() && keyframe.m_Tick != inputEnd))
+			{
+				break;
+			}
+
+			m_Keyframes.push_back(keyframe);
+			inputEnd = keyframe.m_Tick;
+			fseek(m_File, (long)keyframe.m_Size, SEEK_CUR);
+		}
+		else if (type == BLOCK_INPUT && !m_Keyframes.empty())
+		{
+			unsigned char blockHeader[INPUT_HEADER_SIZE];
+			if (fread(blockHeader, 1, sizeof(blockHeader), m_File) != sizeof(blockHeader))
+			{
+				break;
+			}
+
+			InputBlock block;
+			unsigned int size = 0;
+			StateReader blockReader(blockHeader, sizeof(blockHeader));
+			blockReader.ReadValue(block.m_FirstTick);
+			blockReader.ReadValue(block.m_TickCount);
+			blockReader.ReadValue(size);
+			block.m_Offset = m_Input.size();
+
+			if (block.m_FirstTick != inputEnd || size > (unsigned long)(fileSize - ftell(m_File)))
+			{
+				break;
+			}
+
+			m_Input.resize(block.m_Offset + size);
+			if (size > 0 && fread(&m_Input[block.m_Offset], 1, size, m_File) != size)
+			{
+				m_Input.resize(block.m_Offset);
+				break;
+			}
+
+			m_InputBlocks.push_back(block);
+			inputEnd = block.m_FirstTick + block.m_TickCount;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (m_Keyframes.empty())
+	{
+		Close();
+		return false;
+	}
+
+	m_EndTick = inputEnd;
+	m_NextTick = m_Keyframes[0].m_Tick;
+	m_InputOffset = 0;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Close
+//--------------------------------------------------------------------------------------------------------------
+void InputPlayer::Close()
+{
+	if (m_File != NULL)
+	{
+		fclose(m_File);
+		m_File = NULL;
+	}
+
+	m_Keyframes.clear();
+	m_InputBlocks.clear();
+	m_Input.clear();
+	m_NextTick = 0;
+	m_EndTick = 0;
+	m_InputOffset = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Start
+//--------------------------------------------------------------------------------------------------------------
+bool InputPlayer::Start(Game& game)
+{
+	if (m_Keyframes.empty())
+	{
+		return false;
+	}
+
+	game.m_Settings.m_TickRate = m_TickRate;
+	game.m_Settings.m_SunGravity = m_SunGravity;
+	game.m_Settings.m_Integrator = m_Integrator;
+	game.m_Settings.m_UseGravityField = m_UseGravityField;
+	game.m_Settings.m_GravityField = m_GravityField;
+	game.m_Settings.m_SunCount = m_SunCount;
+	game.m_Settings.m_AsteroidCount = m_AsteroidCount;
+	game.m_Settings.m_StreamWorld = m_StreamWorld;
+	game.m_Settings.m_WorldStream = m_WorldStream;
+	game.m_Settings.m_BotCount = m_BotCount;
+
+	return game.Initialise(m_Seed) && LoadKeyframe(game, m_Keyframes[0]) && FindInput(m_Keyframes[0].m_Tick);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Seek
+//--------------------------------------------------------------------------------------------------------------
+bool InputPlayer::Seek(Game& game, unsigned long long tick)
+{
+	if (m_Keyframes.empty() || tick < GetFirstTick() || tick > m_EndTick)
+	{
+		return false;
+	}
+
+	// The last keyframe at or before the tick.
+	size_t keyframeIndex = m_Keyframes.size() - 1;
+	while (m_Keyframes[keyframeIndex].m_Tick > tick)
+	{
+		keyframeIndex--;
+	}
+	const Keyframe& keyframe = m_Keyframes[keyframeIndex];
+
+	// Going back, or forward past a keyframe, is quicker from the keyframe than from here.
+	if (tick < m_NextTick || keyframe.m_Tick > m_NextTick)
+	{
+		if (!LoadKeyframe(game, keyframe) || !FindInput(keyframe.m_Tick))
+		{
+			return false;
+		}
+	}
+
+	while (m_NextTick < tick)
+	{
+		if (!Step(game))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Step
+//--------------------------------------------------------------------------------------------------------------
+bool InputPlayer::Step(Game& game)
+{
+	if (IsFinished() || !DecodeTick(m_TickInput))
+	{
+		return false;
+	}
+
+	assert(game.GetTickCount() == m_NextTick);
+	game.Tick(game.GetTickDelta(), m_TickInput);
+	m_NextTick++;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// LoadKeyframe
+//--------------------------------------------------------------------------------------------------------------
+bool InputPlayer::LoadKeyframe(Game& game, const Keyframe& keyframe)
+{
+	m_State.resize(keyframe.m_Size);
+	if (fseek(m_File, keyframe.m_FileOffset, SEEK_SET) != 0
+		|| (keyframe.m_Size > 0 && fread(&m_State[0], 1, keyframe.m_Size, m_File) != keyframe.m_Size))
+	{
+		return false;
+	}
+
+	StateReader reader(m_State.empty() ? NULL : &m_State[0], m_State.size());
+	if (!game.LoadState(reader) || !reader.IsAtEnd() || game.GetTickCount() != keyframe.m_Tick)
+	{
+		return false;
+	}
+
+	m_NextTick = keyframe.m_Tick;
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// FindInput
+// Point playback at the input for the given tick. Input blocks start at keyframes, so this is normally the
+// start of a block, but shorter blocks written between keyframes are skipped through tick by tick.
+//--------------------------------------------------------------------------------------------------------------
+bool InputPlayer::FindInput(unsigned long long tick)
+{
+	if (tick == m_EndTick)
+	{
+		m_InputOffset = m_Input.size();
+		return true;
+	}
+
+	size_t blockIndex = m_InputBlocks.size();
+	while (blockIndex > 0 && m_InputBlocks[blockIndex - 1].m_FirstTick > tick)
+	{
+		blockIndex--;
+	}
+	if (blockIndex == 0)
+	{
+		return false;
+	}
+
+	const InputBlock& block = m_InputBlocks[blockIndex - 1];
+	m_InputOffset = block.m_Offset;
+	for (unsigned long long skip = block.m_FirstTick; skip < tick; skip++)
+	{
+		if (!DecodeTick(m_TickInput))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// DecodeTick
+// Read the input at the playback offset and move past it.
+//--------------------------------------------------------------------------------------------------------------
+bool InputPlayer::DecodeTick(TickInput& outInput)
+{
+	size_t remaining = m_Input.size() - m_InputOffset;
+	StateReader reader(remaining > 0 ? &m_Input[m_InputOffset] : NULL, remaining);
+
+	unsigned char flags = 0;
+	if (!reader.ReadValue(flags))
+	{
+		return false;
+	}
+
+	outInput.m_Keys = flags & ~TICK_HAS_FIRES;
+	outInput.m_Fires.clear();
+	size_t size = 1;
+
+	if (flags & TICK_HAS_FIRES)
+	{
+		// The count is checked against what is left before anything is made for it.
+		unsigned int fireCount = 0;
+		if (!reader.ReadValue(fireCount) || fireCount > (remaining - size - sizeof(fireCount)) / (2 * sizeof(int)))
+		{
+			return false;
+		}
+		outInput.m_Fires.resize(fireCount);
+		for (unsigned int fire = 0; fire < fireCount; fire++)
+		{
+			reader.ReadValue(outInput.m_Fires[fire].m_X);
+			reader.ReadValue(outInput.m_Fires[fire].m_Y);
+		}
+		if (reader.HasFailed())
+		{
+			return false;
+		}
+		size += sizeof(fireCount) + fireCount * 2 * sizeof(int);
+	}
+
+	m_InputOffset += size;
+	return true;
+}
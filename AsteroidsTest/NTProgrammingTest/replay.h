@@ -0,0 +1,148 @@
+//-------------------------------------------------------------------------------------------------------------
+// replay.h
+//
+// Recording a session as its seed and the input of every tick, and playing it back. Recordings also carry a
+// keyframe of the whole game state every so many ticks, so that playback can jump to any tick by loading the
+// keyframe before it and simulating only the ticks in between.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <vector>
+#include "game.h"
+
+// Ten seconds at the default tick rate.
+static const unsigned int DEFAULT_KEYFRAME_INTERVAL = 600;
+
+//-------------------------------------------------------------------------------------------------------------
+// InputRecorder
+// Attach to a game with Game::SetInputRecorder. The first tick recorded is always a keyframe, so anything set
+// up before recording starts is captured too.
+//
+// The file is a header followed by blocks. A keyframe block holds a tick number and the game state at the
+// start of that tick; an input block holds a run of consecutive ticks' input, one byte of keys per tick plus
+// any shots. Input is buffered and written out as a block at each keyframe, so a recording cut off by a crash
+// still plays up to its last keyframe.
+//-------------------------------------------------------------------------------------------------------------
+class InputRecorder
+{
+public:
+	InputRecorder();
+	~InputRecorder();
+
+	// Returns false if the file couldn't be created. Ticks must then be recorded in order, one after another.
+	bool Open(const char* path, const Game& game, unsigned int keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+
+	// Writes out the buffered input. Returns false if anything failed to write.
+	bool Close();
+
+	bool IsOpen() const { return m_File != NULL; }
+
+	void RecordTick(const Game& game, const TickInput& input);
+
+	unsigned long long GetTicksRecorded() const { return m_TicksRecorded; }
+	size_t GetKeyframesRecorded() const { return m_KeyframesRecorded; }
+
+private:
+	void WriteKeyframe(const Game& game);
+	void FlushInput();
+
+	FILE*						m_File;
+	unsigned int				m_KeyframeInterval;
+	unsigned long long			m_TicksRecorded;
+	unsigned int				m_TicksSinceKeyframe;
+	size_t						m_KeyframesRecorded;
+	bool						m_Failed;
+
+	// The ticks not yet written out, and the tick the first of them was.
+	std::vector<unsigned char>	m_Input;
+	unsigned long long			m_InputFirstTick;
+	unsigned int				m_InputTicks;
+
+	std::vector<unsigned char>	m_State;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// InputPlayer
+// Plays a recording back into a game, as fast as the game can tick.
+//-------------------------------------------------------------------------------------------------------------
+class InputPlayer
+{
+public:
+	InputPlayer();
+	~InputPlayer();
+
+	// Read the header, the input and the index of keyframes. The keyframes themselves are read as they are
+	// needed. A recording that was cut off plays up to the last tick that was completely written. Returns false
+	// if the file isn't a recording this build can play.
+	bool Open(const char* path);
+	void Close();
+
+	// Apply the recorded settings, initialise the game with the recorded seed, and load the first keyframe.
+	// Settings that don't change the results, such as the thread count, are left as they are.
+	bool Start(Game& game);
+
+	// After Start, bring the game to the start of the given tick, from the nearest keyframe at or before it unless the
+	// game is already closer. Returns false if the tick is outside the recording or a keyframe is unreadable.
+	bool Seek(Game& game, unsigned long long tick);
+
+	// Run the next recorded tick. Returns false once the recording has finished.
+	bool Step(Game& game);
+
+	bool IsFinished() const { return m_NextTick >= m_EndTick; }
+	unsigned long long GetNextTick() const { return m_NextTick; }
+
+	unsigned int GetSeed() const { return m_Seed; }
+	unsigned long long GetFirstTick() const { return m_Keyframes.empty() ? 0 : m_Keyframes[0].m_Tick; }
+	unsigned long long GetEndTick() const { return m_EndTick; }
+	size_t GetKeyframeCount() const { return m_Keyframes.size(); }
+
+private:
+	struct Keyframe
+	{
+		unsigned long long	m_Tick;
+		long				m_FileOffset;
+		unsigned int		m_Size;
+	};
+
+	struct InputBlock
+	{
+		unsigned long long	m_FirstTick;
+		unsigned int		m_TickCount;
+		size_t				m_Offset;
+	};
+
+	bool LoadKeyframe(Game& game, const Keyframe& keyframe);
+	bool FindInput(unsigned long long tick);
+	bool DecodeTick(TickInput& outInput);
+
+	FILE*						m_File;
+	unsigned int				m_Seed;
+	float						m_TickRate;
+	float						m_SunGravity;
+	IntegratorSettings			m_Integrator;
+	bool						m_UseGravityField;
+	GravityFieldSettings		m_GravityField;
+	size_t						m_SunCount;
+	size_t						m_AsteroidCount;
+	bool						m_StreamWorld;
+	WorldStreamSettings			m_WorldStream;
+	size_t						m_BotCount;
+
+	std::vector<Keyframe>		m_Keyframes;
+	std::vector<InputBlock>		m_InputBlocks;
+	std::vector<unsigned char>	m_Input;
+	std::vector<unsigned char>	m_State;
+	TickInput					m_TickInput;
+
+	// Where playback has got to: the tick Step runs next, and the offset of its input.
+	unsigned long long			m_NextTick;
+	unsigned long long			m_EndTick;
+	size_t						m_InputOffset;
+};
@@ -0,0 +1,131 @@
+//-------------------------------------------------------------------------------------------------------------
+// simthread.cpp
+//
+// Implementation of the simulation thread.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "simthread.h"
+#include "trace.h"
+
+//--------------------------------------------------------------------------------------------------------------
+// SimulationThread
+//--------------------------------------------------------------------------------------------------------------
+SimulationThread::SimulationThread()
+: m_Game(NULL)
+, m_Stopping(false)
+, m_Finished(true)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~SimulationThread
+//--------------------------------------------------------------------------------------------------------------
+SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Start
+// The first snapshot is published before the thread starts, so there is something to draw straight away.
+//--------------------------------------------------------------------------------------------------------------
+void SimulationThread::Start(Game& game, const SimulationThreadSettings& settings)
+{
+	assert(!m_Thread.joinable());
+
+	m_Game = &game;
+	m_Settings = settings;
+	m_Pacer.SetSettings(settings.m_Pacing);
+	m_Stopping.store(false);
+	m_Finished.store(false);
+
+	game.CaptureSnapshot(m_Snapshots.GetWriteSnapshot());
+	m_Snapshots.Publish();
+
+	m_Thread = std::thread(&SimulationThread::ThreadMain, this);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Stop
+//--------------------------------------------------------------------------------------------------------------
+void SimulationThread::Stop()
+{
+	if (m_Thread.joinable())
+	{
+		m_Stopping.store(true);
+		m_Thread.join();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Fire
+//--------------------------------------------------------------------------------------------------------------
+void SimulationThread::Fire(int x, int y)
+{
+	FireCommand fire;
+	fire.m_X = x;
+	fire.m_Y = y;
+
+	std::lock_guard<std::mutex> lock(m_FireMutex);
+	m_QueuedFires.push_back(fire);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ThreadMain
+// Only the queued shots are taken under the lock, and the lock is never held while the game runs.
+//--------------------------------------------------------------------------------------------------------------
+void SimulationThread::ThreadMain()
+{
+	NT_TRACE_THREAD_NAME("simulation");
+
+	Game& game = *m_Game;
+	m_Pacer.Reset();
+
+	while (!m_Stopping.load(std::memory_order_relaxed))
+	{
+		if (m_Settings.m_StopAtTick > 0 && game.GetTickCount() >= m_Settings.m_StopAtTick)
+		{
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_FireMutex);
+			m_Fires.swap(m_QueuedFires);
+		}
+		for (size_t fire = 0; fire < m_Fires.size(); fire++)
+		{
+			game.Fire(m_Fires[fire].m_X, m_Fires[fire].m_Y);
+		}
+		m_Fires.clear();
+
+		if (m_Settings.m_BeforeUpdate)
+		{
+			m_Settings.m_BeforeUpdate(game);
+		}
+
+		unsigned long long ticksBefore = game.GetTickCount();
+		bool needRedraw;
+		game.Update(needRedraw);
+
+		if (needRedraw || game.GetTickCount() != ticksBefore)
+		{
+			game.CaptureSnapshot(m_Snapshots.GetWriteSnapshot());
+			m_Snapshots.Publish();
+		}
+		if (needRedraw && m_Settings.m_Redraw)
+		{
+			m_Settings.m_Redraw();
+		}
+
+		if (m_Settings.m_Pace)
+		{
+			m_Pacer.WaitForNextFrame(game.GetTimeUntilUpdate());
+		}
+	}
+
+	m_Finished.store(true, std::memory_order_release);
+}
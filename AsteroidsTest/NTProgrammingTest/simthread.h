@@ -0,0 +1,95 @@
+//-------------------------------------------------------------------------------------------------------------
+// simthread.h
+//
+// Runs a game on a thread of its own, publishing a render snapshot as it goes, so that drawing on another
+// thread and updating never hold each other up.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "framepacer.h"
+#include "game.h"
+#include "rendersnapshot.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// SimulationThreadSettings
+//-------------------------------------------------------------------------------------------------------------
+struct SimulationThreadSettings
+{
+	SimulationThreadSettings()
+	: m_Pace(true)
+	, m_StopAtTick(0)
+	{
+	}
+
+	// Sleep between updates with a FramePacer. Turn off to run flat out, as when the game's timer is fixed.
+	bool				m_Pace;
+	FramePacerSettings	m_Pacing;
+
+	// Stop once the game has run this many ticks, or never if 0.
+	unsigned long long	m_StopAtTick;
+
+	// Called on the simulation thread before each update, for drivers that feed the game input.
+	std::function<void(Game& game)>	m_BeforeUpdate;
+
+	// Called on the simulation thread when the game asks for a redraw, after the snapshot is published.
+	std::function<void()>	m_Redraw;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// SimulationThread
+// Once started, the game belongs to the simulation thread: nothing else may touch it until Stop returns. Other
+// threads talk to it through Fire, and see it through the snapshots. A snapshot is published after every
+// update that ran a tick or asked for a redraw.
+//-------------------------------------------------------------------------------------------------------------
+class SimulationThread
+{
+public:
+	SimulationThread();
+	~SimulationThread();
+
+	void Start(Game& game, const SimulationThreadSettings& settings);
+
+	// Ask the thread to finish, and wait for it.
+	void Stop();
+
+	// Whether the thread has finished, by reaching m_StopAtTick or by being stopped.
+	bool IsFinished() const { return m_Finished.load(std::memory_order_acquire); }
+
+	// Queue a shot for the game's next tick. Safe from any thread.
+	void Fire(int x, int y);
+
+	// The latest snapshot, for the one thread that draws. See RenderSnapshotBuffer::Acquire.
+	const RenderSnapshot* AcquireSnapshot() { return m_Snapshots.Acquire(); }
+	unsigned long long GetPublishedCount() const { return m_Snapshots.GetPublishedCount(); }
+
+	// Valid once the thread has finished.
+	const FramePacerStats& GetPacerStats() const { return m_Pacer.GetStats(); }
+
+private:
+	void ThreadMain();
+
+	Game*						m_Game;
+	SimulationThreadSettings	m_Settings;
+	FramePacer					m_Pacer;
+	RenderSnapshotBuffer		m_Snapshots;
+
+	std::thread					m_Thread;
+	std::atomic<bool>			m_Stopping;
+	std::atomic<bool>			m_Finished;
+
+	// Shots queued by other threads, and the thread's own list to take them into.
+	std::mutex					m_FireMutex;
+	std::vector<FireCommand>	m_QueuedFires;
+	std::vector<FireCommand>	m_Fires;
+};
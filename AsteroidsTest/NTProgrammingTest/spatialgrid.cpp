@@ -0,0 +1,156 @@
+//-------------------------------------------------------------------------------------------------------------
+// spatialgrid.cpp
+//
+// Implementation of the uniform grid broadphase.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "spatialgrid.h"
+#include <cmath>
+
+// Entities further out than this are clamped to the outermost cell, so cell coordinates can't overflow.
+static const float MAX_CELL_COORDINATE = 1e8f;
+
+//--------------------------------------------------------------------------------------------------------------
+// SpatialGrid
+//--------------------------------------------------------------------------------------------------------------
+SpatialGrid::SpatialGrid()
+: m_CellSize(1.f)
+, m_InvCellSize(1.f)
+, m_TableMask(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// CellCoordinate
+//--------------------------------------------------------------------------------------------------------------
+int SpatialGrid::CellCoordinate(float value) const
+{
+	float cell = floorf(value * m_InvCellSize);
+
+	// Written so that NaN lands in a cell too.
+	if (!(cell > -MAX_CELL_COORDINATE))
+	{
+		cell = -MAX_CELL_COORDINATE;
+	}
+	else if (cell > MAX_CELL_COORDINATE)
+	{
+		cell = MAX_CELL_COORDINATE;
+	}
+
+	return (int)cell;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// HashCell
+//--------------------------------------------------------------------------------------------------------------
+unsigned int SpatialGrid::HashCell(int cellX, int cellY) const
+{
+	return (((unsigned int)cellX * 73856093u) ^ ((unsigned int)cellY * 19349663u)) & m_TableMask;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Build
+// Counting sort of the entities by bucket, so the whole build is two linear passes.
+//--------------------------------------------------------------------------------------------------------------
+void SpatialGrid::Build(const EntityArray& entities, float cellSize)
+{
+	assert(cellSize > 0.f);
+
+	m_CellSize = cellSize;
+	m_InvCellSize = 1.f / cellSize;
+
+	size_t count = entities.Size();
+
+	// Keep the table at least twice the entity count so buckets stay short.
+	unsigned int tableSize = 64;
+	while (tableSize < count * 2)
+	{
+		tableSize *= 2;
+	}
+	m_TableMask = tableSize - 1;
+
+	m_BucketStart.assign(tableSize + 1, 0);
+
+	m_CellsX.resize(count);
+	m_CellsY.resize(count);
+	m_Buckets.resize(count);
+	for (size_t index = 0; index < count; index++)
+	{
+		m_CellsX[index] = CellCoordinate(entities.m_PositionX[index]);
+		m_CellsY[index] = CellCoordinate(entities.m_PositionY[index]);
+		m_Buckets[index] = HashCell(m_CellsX[index], m_CellsY[index]);
+		m_BucketStart[m_Buckets[index] + 1]++;
+	}
+
+	for (unsigned int bucket = 0; bucket < tableSize; bucket++)
+	{
+		m_BucketStart[bucket + 1] += m_BucketStart[bucket];
+	}
+
+	m_Next.assign(m_BucketStart.begin(), m_BucketStart.end() - 1);
+	m_Entries.resize(count);
+	m_EntryCellX.resize(count);
+	m_EntryCellY.resize(count);
+	for (size_t index = 0; index < count; index++)
+	{
+		unsigned int slot = m_Next[m_Buckets[index]]++;
+		m_Entries[slot] = (unsigned int)index;
+		m_EntryCellX[slot] = m_CellsX[index];
+		m_EntryCellY[slot] = m_CellsY[index];
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Clear
+//--------------------------------------------------------------------------------------------------------------
+void SpatialGrid::Clear()
+{
+	m_BucketStart.clear();
+	m_Entries.clear();
+	m_EntryCellX.clear();
+	m_EntryCellY.clear();
+	m_TableMask = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Query
+//--------------------------------------------------------------------------------------------------------------
+void SpatialGrid::Query(float x, float y, float radius, std::vector<unsigned int>& outCandidates) const
+{
+	if (m_Entries.empty())
+	{
+		return;
+	}
+
+	int minCellX = CellCoordinate(x - radius);
+	int maxCellX = CellCoordinate(x + radius);
+	int minCellY = CellCoordinate(y - radius);
+	int maxCellY = CellCoordinate(y + radius);
+
+	// A circle covering more cells than there are entities is cheaper to answer by returning everything.
+	double cellCount = ((double)maxCellX - minCellX + 1.) * ((double)maxCellY - minCellY + 1.);
+	if (cellCount > (double)m_Entries.size())
+	{
+		outCandidates.insert(outCandidates.end(), m_Entries.begin(), m_Entries.end());
+		return;
+	}
+
+	for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+	{
+		for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+		{
+			unsigned int bucket = HashCell(cellX, cellY);
+			for (unsigned int slot = m_BucketStart[bucket]; slot < m_BucketStart[bucket + 1]; slot++)
+			{
+				if (m_EntryCellX[slot] == cellX && m_EntryCellY[slot] == cellY)
+				{
+					outCandidates.push_back(m_Entries[slot]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,83 @@
+//-------------------------------------------------------------------------------------------------------------
+// spatialgrid.h
+//
+// A uniform grid broadphase. Entities are bucketed by the cell they sit in, hashed into a fixed size table so
+// that the grid covers unbounded space, and queries only visit the cells a search circle overlaps.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <vector>
+#include "entitystore.h"
+
+//-------------------------------------------------------------------------------------------------------------
+// CollisionStats
+// How many pairs the broadphase passed on to be tested, and how many of those actually collided.
+//-------------------------------------------------------------------------------------------------------------
+struct CollisionStats
+{
+	CollisionStats() { Reset(); }
+
+	void Reset()
+	{
+		m_CandidatePairs = 0;
+		m_Hits = 0;
+	}
+
+	void Add(const CollisionStats& other)
+	{
+		m_CandidatePairs += other.m_CandidatePairs;
+		m_Hits += other.m_Hits;
+	}
+
+	unsigned long long	m_CandidatePairs;
+	unsigned long long	m_Hits;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// SpatialGrid
+// Built from the positions in an EntityArray. Queries return entity indices, which stay valid until the
+// array is next changed, so the grid must be rebuilt after entities are added or removed.
+//-------------------------------------------------------------------------------------------------------------
+class SpatialGrid
+{
+public:
+	SpatialGrid();
+
+	void Build(const EntityArray& entities, float cellSize);
+	void Clear();
+
+	// Number of entities in the grid.
+	size_t Size() const { return m_Entries.size(); }
+
+	// Append the index of every entity in the cells overlapped by the circle. Each entity is returned at most
+	// once, but may be further away than radius; the caller does the exact test.
+	void Query(float x, float y, float radius, std::vector<unsigned int>& outCandidates) const;
+
+private:
+	int CellCoordinate(float value) const;
+	unsigned int HashCell(int cellX, int cellY) const;
+
+	float						m_CellSize;
+	float						m_InvCellSize;
+	unsigned int				m_TableMask;
+
+	// Entity indices sorted by bucket; bucket b holds m_Entries[m_BucketStart[b] .. m_BucketStart[b + 1]).
+	std::vector<unsigned int>	m_BucketStart;
+	std::vector<unsigned int>	m_Entries;
+
+	// The cell each entry is in, to tell apart the different cells that share a bucket.
+	std::vector<int>			m_EntryCellX;
+	std::vector<int>			m_EntryCellY;
+
+	// Scratch for Build, kept so that rebuilding a grid of a steady size doesn't allocate.
+	std::vector<int>			m_CellsX;
+	std::vector<int>			m_CellsY;
+	std::vector<unsigned int>	m_Buckets;
+	std::vector<unsigned int>	m_Next;
+};
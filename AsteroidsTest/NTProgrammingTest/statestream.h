@@ -0,0 +1,112 @@
+//-------------------------------------------------------------------------------------------------------------
+// statestream.h
+//
+// Writing simulation state into a byte buffer and reading it back, for keyframes and saved sessions. Values are
+// copied in the machine's own byte order; files that store them record the order so a reader can reject a
+// mismatch.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <string.h>
+#include <vector>
+
+// Written by the machine that saved the state, and compared by the one that loads it.
+static const unsigned int STATE_BYTE_ORDER_MARK = 0x01020304;
+
+//-------------------------------------------------------------------------------------------------------------
+// StateWriter
+// Appends to a buffer owned by the caller, so the buffer's storage can be reused from one save to the next.
+//-------------------------------------------------------------------------------------------------------------
+class StateWriter
+{
+public:
+	explicit StateWriter(std::vector<unsigned char>& data) : m_Data(data) {}
+
+	void Write(const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		m_Data.insert(m_Data.end(), bytes, bytes + size);
+	}
+
+	template <typename T>
+	void WriteValue(const T& value)
+	{
+		Write(&value, sizeof(T));
+	}
+
+	// The element count, then the elements.
+	template <typename T>
+	void WriteVector(const std::vector<T>& values)
+	{
+		WriteValue((unsigned int)values.size());
+		if (!values.empty())
+		{
+			Write(&values[0], values.size() * sizeof(T));
+		}
+	}
+
+	// Bytes in the buffer, including any that were there before the writer was made.
+	size_t GetSize() const { return m_Data.size(); }
+
+private:
+	std::vector<unsigned char>&	m_Data;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// StateReader
+// Reads from a buffer it doesn't own. A read past the end fails, and so does every read after it, so a caller
+// can read everything and check once at the end.
+//-------------------------------------------------------------------------------------------------------------
+class StateReader
+{
+public:
+	StateReader(const unsigned char* data, size_t size) : m_Data(data), m_Size(size), m_Offset(0), m_Failed(false) {}
+
+	bool Read(void* data, size_t size)
+	{
+		if (m_Failed || size > m_Size - m_Offset)
+		{
+			m_Failed = true;
+			return false;
+		}
+		memcpy(data, m_Data + m_Offset, size);
+		m_Offset += size;
+		return true;
+	}
+
+	template <typename T>
+	bool ReadValue(T& outValue)
+	{
+		return Read(&outValue, sizeof(T));
+	}
+
+	// The count is checked against what is left before anything is allocated, so a corrupt count fails rather
+	// than asking for gigabytes.
+	template <typename T>
+	bool ReadVector(std::vector<T>& outValues)
+	{
+		unsigned int count;
+		if (!ReadValue(count) || count > (m_Size - m_Offset) / sizeof(T))
+		{
+			m_Failed = true;
+			return false;
+		}
+		outValues.resize(count);
+		return count == 0 || Read(&outValues[0], count * sizeof(T));
+	}
+
+	bool HasFailed() const { return m_Failed; }
+	bool IsAtEnd() const { return m_Offset == m_Size; }
+
+private:
+	const unsigned char*	m_Data;
+	size_t					m_Size;
+	size_t					m_Offset;
+	bool					m_Failed;
+};
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
@@ -12,9 +14,12 @@
 #include <windows.h>
 
 // C RunTime Header Files
-#include <stdlib.h>
 #include <malloc.h>
-#include <memory.h>
 #include <tchar.h>
 
+#endif // _WIN32
+
+#include <stdlib.h>
+#include <memory.h>
+
 #include "assert.h"
@@ -0,0 +1,59 @@
+//-------------------------------------------------------------------------------------------------------------
+// sweep.cpp
+//
+// Implementation of the continuous collision tests.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "sweep.h"
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------------------
+// SweepCircle
+// The moving centre is from + t * path, and the circles touch where its distance from centre is radius. With
+// offset = from - centre that is the quadratic |path|^2 t^2 + 2 (offset . path) t + |offset|^2 - radius^2 = 0,
+// whose smaller root is where they first touch.
+//--------------------------------------------------------------------------------------------------------------
+bool SweepCircle(const NTPoint& from, const NTPoint& to, const NTPoint& centre, float radius, float& outTime)
+{
+	NTPoint path = to - from;
+	NTPoint offset = from - centre;
+
+	float a = path.LengthSquared();
+	float halfB = offset.Dot(path);
+	float c = offset.LengthSquared() - radius * radius;
+
+	if (c < 0.f)
+	{
+		if (halfB < 0.f)
+		{
+			outTime = 0.f;
+			return true;
+		}
+		return false;
+	}
+
+	// Moving away, or not at all, from outside.
+	if (halfB >= 0.f || a == 0.f)
+	{
+		return false;
+	}
+
+	float discriminant = halfB * halfB - a * c;
+	if (discriminant < 0.f)
+	{
+		return false;
+	}
+
+	float time = (-halfB - sqrtf(discriminant)) / a;
+	if (time > 1.f)
+	{
+		return false;
+	}
+
+	outTime = time;
+	return true;
+}
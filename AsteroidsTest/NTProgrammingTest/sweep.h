@@ -0,0 +1,21 @@
+//-------------------------------------------------------------------------------------------------------------
+// sweep.h
+//
+// Continuous collision tests. A fast body can cross a small one completely within a tick, so testing where
+// it ends up misses the hit; testing the path it took between ticks doesn't.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include "ntpoint.h"
+
+// Whether a circle moving in a straight line from "from" to "to" touches a still circle at centre, where
+// radius is the two radii added together. If it does, outTime is how far along the path they first touch,
+// from 0 to 1. A circle that starts overlapping only hits if it is moving further in, so that a body isn't
+// hit by something leaving it, such as a missile fired from inside a ship.
+bool SweepCircle(const NTPoint& from, const NTPoint& to, const NTPoint& centre, float radius, float& outTime);
@@ -2,13 +2,10 @@
 #include "stdafx.h"
 #include "timer.h"
 
-#include <time.h>
-#include <stdio.h>
-
 Timer::Timer()
 : m_TimeDelta(0.f)
+, m_FixedTimeDelta(0.f)
 , m_Time(0.)
-, m_Ticks(0)
 {
 	Reset();
 }
@@ -17,19 +14,22 @@ void Timer::Reset()
 {
 	m_Time = 0.;
 	m_TimeDelta = 0.f;
-	m_Ticks = clock();
+	m_LastUpdate = Clock::now();
 }
 
 void Timer::Update()
 {
-	long ticks = clock();
-
-	m_TimeDelta = float((double)(ticks - m_Ticks) / CLOCKS_PER_SEC);
-	if (m_TimeDelta > 0.2f)
+	if (m_FixedTimeDelta > 0.f)
 	{
-		m_TimeDelta = 0.2f;
+		m_TimeDelta = m_FixedTimeDelta;
+		m_Time = m_Time + m_TimeDelta;
+		return;
 	}
 
+	// No clamp here: the game limits how many ticks it will run to catch up on a long frame.
+	Clock::time_point now = Clock::now();
+
+	m_TimeDelta = std::chrono::duration<float>(now - m_LastUpdate).count();
 	m_Time = m_Time + m_TimeDelta;
-	m_Ticks = ticks;
+	m_LastUpdate = now;
 }
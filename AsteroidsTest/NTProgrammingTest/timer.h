@@ -10,6 +10,13 @@
 
 #pragma once
 
+#include <chrono>
+
+//-------------------------------------------------------------------------------------------------------------
+// Timer
+// Measures wall time between calls to Update() with a monotonic clock, so that the result isn't affected by
+// CPU load or changes to the system time.
+//-------------------------------------------------------------------------------------------------------------
 class Timer
 {
 public:
@@ -18,11 +25,18 @@ public:
 	void Reset();
 	void Update();
 
+	// When non-zero, Update() advances by exactly this much instead of reading the clock. Used to
+	// fast-forward the simulation in headless runs.
+	void SetFixedTimeDelta(float timeDelta) { m_FixedTimeDelta = timeDelta; }
+
 	float GetTimeDelta() { return m_TimeDelta; }
 	double GetTime()     { return m_Time; }
 
 private:
-	float           m_TimeDelta;
-	double          m_Time;
-	unsigned long   m_Ticks;
+	typedef std::chrono::steady_clock Clock;
+
+	float               m_TimeDelta;
+	float               m_FixedTimeDelta;
+	double              m_Time;
+	Clock::time_point   m_LastUpdate;
 };
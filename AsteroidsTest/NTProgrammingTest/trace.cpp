@@ -0,0 +1,311 @@
+//-------------------------------------------------------------------------------------------------------------
+// trace.cpp
+//
+// Implementation of the scoped trace markers.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+Tracer g_Tracer;
+
+thread_local Tracer::Buffer* Tracer::s_ThreadBuffer = NULL;
+thread_local const Tracer* Tracer::s_ThreadTracer = NULL;
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteJsonString
+// Quoted, with anything JSON won't take in a string escaped.
+//--------------------------------------------------------------------------------------------------------------
+static void WriteJsonString(FILE* file, const char* text)
+{
+	fputc('"', file);
+	for (const char* character = text; *character != '\0'; character++)
+	{
+		unsigned char value = (unsigned char)*character;
+		if (value == '"' || value == '\\')
+		{
+			fputc('\\', file);
+			fputc(value, file);
+		}
+		else if (value < 0x20)
+		{
+			fprintf(file, "\\u%04x", value);
+		}
+		else
+		{
+			fputc(value, file);
+		}
+	}
+	fputc('"', file);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Tracer
+//--------------------------------------------------------------------------------------------------------------
+Tracer::Tracer()
+: m_Enabled(false)
+, m_EventsPerThread(0)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ~Tracer
+//--------------------------------------------------------------------------------------------------------------
+Tracer::~Tracer()
+{
+	for (size_t buffer = 0; buffer < m_Buffers.size(); buffer++)
+	{
+		delete m_Buffers[buffer];
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Start
+//--------------------------------------------------------------------------------------------------------------
+void Tracer::Start(size_t eventsPerThread)
+{
+	size_t capacity = 1;
+	while (capacity < eventsPerThread)
+	{
+		capacity <<= 1;
+	}
+
+	std::lock_guard<std::mutex> lock(m_BuffersMutex);
+	m_EventsPerThread = capacity;
+	for (size_t buffer = 0; buffer < m_Buffers.size(); buffer++)
+	{
+		ResetBuffer(*m_Buffers[buffer]);
+	}
+	m_Enabled.store(true);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Stop
+// The buffers keep what they hold, to be read.
+//--------------------------------------------------------------------------------------------------------------
+void Tracer::Stop()
+{
+	m_Enabled.store(false);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Record
+// Only the owning thread writes to a buffer, so the slot is filled and then published by moving the count on,
+// with no lock and nothing to wait for.
+//--------------------------------------------------------------------------------------------------------------
+void Tracer::Record(const char* name, unsigned long long start, unsigned long long end, size_t count)
+{
+	Buffer* buffer = GetThreadBuffer();
+	if (buffer->m_Events.empty())
+	{
+		return;
+	}
+
+	unsigned long long written = buffer->m_Written.load(std::memory_order_relaxed);
+	TraceEvent& event = buffer->m_Events[(size_t)written & (buffer->m_Events.size() - 1)];
+	event.m_Name = name;
+	event.m_Start = start;
+	event.m_End = end;
+	event.m_Count = count;
+	buffer->m_Written.store(written + 1, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SetThreadName
+//--------------------------------------------------------------------------------------------------------------
+void Tracer::SetThreadName(const char* name)
+{
+	Buffer* buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(m_BuffersMutex);
+	strncpy(buffer->m_Name, name, sizeof(buffer->m_Name) - 1);
+	buffer->m_Name[sizeof(buffer->m_Name) - 1] = '\0';
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetEvents
+//--------------------------------------------------------------------------------------------------------------
+void Tracer::GetEvents(std::vector<TraceEvent>& outEvents, std::vector<unsigned int>& outThreads) const
+{
+	outEvents.clear();
+	outThreads.clear();
+
+	std::lock_guard<std::mutex> lock(m_BuffersMutex);
+	for (size_t bufferIndex = 0; bufferIndex < m_Buffers.size(); bufferIndex++)
+	{
+		const Buffer& buffer = *m_Buffers[bufferIndex];
+		unsigned long long written = buffer.m_Written.load(std::memory_order_acquire);
+		unsigned long long capacity = buffer.m_Events.size();
+		unsigned long long first = written > capacity ? written - capacity : 0;
+		for (unsigned long long index = first; index < written; index++)
+		{
+			outEvents.push_back(buffer.m_Events[(size_t)index & (size_t)(capacity - 1)]);
+			outThreads.push_back((unsigned int)bufferIndex);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Summarise
+// Names are compared as strings, since the same literal in two files needn't be at the same address.
+//--------------------------------------------------------------------------------------------------------------
+void Tracer::Summarise(std::vector<TraceSummary>& outSummaries) const
+{
+	outSummaries.clear();
+
+	std::vector<TraceEvent> events;
+	std::vector<unsigned int> threads;
+	GetEvents(events, threads);
+
+	for (size_t eventIndex = 0; eventIndex < events.size(); eventIndex++)
+	{
+		const TraceEvent& event = events[eventIndex];
+		size_t summaryIndex = 0;
+		while (summaryIndex < outSummaries.size() && strcmp(outSummaries[summaryIndex].m_Name, event.m_Name) != 0)
+		{
+			summaryIndex++;
+		}
+		if (summaryIndex == outSummaries.size())
+		{
+			TraceSummary summary;
+			summary.m_Name = event.m_Name;
+			summary.m_Events = 0;
+			summary.m_TotalTime = 0.;
+			summary.m_WorstTime = 0.;
+			summary.m_WorstCount = 0;
+			summary.m_MostCount = 0;
+			outSummaries.push_back(summary);
+		}
+
+		TraceSummary& summary = outSummaries[summaryIndex];
+		double time = (event.m_End - event.m_Start) * 1e-9;
+		summary.m_Events++;
+		summary.m_TotalTime += time;
+		if (time >= summary.m_WorstTime)
+		{
+			summary.m_WorstTime = time;
+			summary.m_WorstCount = event.m_Count;
+		}
+		summary.m_MostCount = event.m_Count > summary.m_MostCount ? event.m_Count : summary.m_MostCount;
+	}
+
+	std::sort(outSummaries.begin(), outSummaries.end(), [](const TraceSummary& a, const TraceSummary& b)
+	{
+		return a.m_TotalTime > b.m_TotalTime;
+	});
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WriteChromeTrace
+// Complete events, in microseconds from the first event held, with each one's count as an argument, and a
+// name for each thread.
+//--------------------------------------------------------------------------------------------------------------
+bool Tracer::WriteChromeTrace(const char* path) const
+{
+	std::vector<TraceEvent> events;
+	std::vector<unsigned int> threads;
+	GetEvents(events, threads);
+
+	unsigned long long origin = ~0ull;
+	for (size_t event = 0; event < events.size(); event++)
+	{
+		origin = events[event].m_Start < origin ? events[event].m_Start : origin;
+	}
+
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(m_BuffersMutex);
+		for (size_t buffer = 0; buffer < m_Buffers.size(); buffer++)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n",
+				(unsigned int)buffer + 1);
+			WriteJsonString(file, m_Buffers[buffer]->m_Name);
+			fprintf(file, "}}");
+			first = false;
+		}
+	}
+
+	for (size_t eventIndex = 0; eventIndex < events.size(); eventIndex++)
+	{
+		const TraceEvent& event = events[eventIndex];
+		fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+		WriteJsonString(file, event.m_Name);
+		fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"count\":%llu}}", threads[eventIndex] + 1,
+			(event.m_Start - origin) * 1e-3, (event.m_End - event.m_Start) * 1e-3, (unsigned long long)event.m_Count);
+		first = false;
+	}
+	fprintf(file, "\n]}\n");
+
+	bool written = !ferror(file);
+	return fclose(file) == 0 && written;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetOverwrittenCount
+//--------------------------------------------------------------------------------------------------------------
+unsigned long long Tracer::GetOverwrittenCount() const
+{
+	std::lock_guard<std::mutex> lock(m_BuffersMutex);
+	unsigned long long overwritten = 0;
+	for (size_t buffer = 0; buffer < m_Buffers.size(); buffer++)
+	{
+		unsigned long long written = m_Buffers[buffer]->m_Written.load(std::memory_order_acquire);
+		unsigned long long capacity = m_Buffers[buffer]->m_Events.size();
+		overwritten += written > capacity ? written - capacity : 0;
+	}
+	return overwritten;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Now
+//--------------------------------------------------------------------------------------------------------------
+unsigned long long Tracer::Now()
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetThreadBuffer
+// Made on the thread's first use and kept for the life of the tracer, so that a thread's events can still be
+// read after it has gone.
+//--------------------------------------------------------------------------------------------------------------
+Tracer::Buffer* Tracer::GetThreadBuffer()
+{
+	if (s_ThreadTracer == this)
+	{
+		return s_ThreadBuffer;
+	}
+
+	std::lock_guard<std::mutex> lock(m_BuffersMutex);
+	Buffer* buffer = new Buffer;
+	snprintf(buffer->m_Name, sizeof(buffer->m_Name), "thread %u", (unsigned int)m_Buffers.size() + 1);
+	ResetBuffer(*buffer);
+	m_Buffers.push_back(buffer);
+
+	s_ThreadBuffer = buffer;
+	s_ThreadTracer = this;
+	return buffer;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ResetBuffer
+//--------------------------------------------------------------------------------------------------------------
+void Tracer::ResetBuffer(Buffer& buffer)
+{
+	buffer.m_Events.resize(m_EventsPerThread);
+	buffer.m_Written.store(0);
+}
@@ -0,0 +1,175 @@
+//-------------------------------------------------------------------------------------------------------------
+// trace.h
+//
+// Scoped timing markers for the hot paths, kept in a ring buffer per thread and written out as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev). Building with NT_TRACE set to 0 compiles every marker away.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// On unless the build turns it off. Even compiled in, markers cost a single load until tracing is started.
+#ifndef NT_TRACE
+#define NT_TRACE 1
+#endif
+
+//-------------------------------------------------------------------------------------------------------------
+// TraceEvent
+// One marked scope: what it was, when it ran, in nanoseconds on the steady clock, and how many objects it
+// dealt with, if it said.
+//-------------------------------------------------------------------------------------------------------------
+struct TraceEvent
+{
+	const char*			m_Name;
+	unsigned long long	m_Start;
+	unsigned long long	m_End;
+	size_t				m_Count;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// TraceSummary
+// Every event with one name in what the buffers hold. The count given is the one from the slowest event, to
+// say how much it was dealing with when it spiked.
+//-------------------------------------------------------------------------------------------------------------
+struct TraceSummary
+{
+	const char*			m_Name;
+	unsigned long long	m_Events;
+	double				m_TotalTime;
+	double				m_WorstTime;
+	size_t				m_WorstCount;
+	size_t				m_MostCount;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// Tracer
+// Each thread writes only to its own buffer, made the first time it records, so recording takes no lock. A
+// buffer holds the latest events its thread recorded, overwriting the oldest once full, so the moments
+// before a stutter are still there when it is noticed.
+//
+// Start and Stop can be called at any time, but Start clears the buffers and so must not be called while
+// another thread might be recording; the same goes for reading the events, which should be done once tracing
+// has stopped, or while the traced threads are idle.
+//-------------------------------------------------------------------------------------------------------------
+class Tracer
+{
+public:
+	static const size_t DEFAULT_EVENTS_PER_THREAD = 65536;
+
+	Tracer();
+	~Tracer();
+
+	// Start recording, with room for eventsPerThread events on each thread, rounded up to a power of two.
+	void Start(size_t eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+	void Stop();
+	bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+	void Record(const char* name, unsigned long long start, unsigned long long end, size_t count);
+
+	// Name the calling thread in the trace. The name is copied.
+	void SetThreadName(const char* name);
+
+	// Every event held, oldest first on each thread, and each event's thread number.
+	void GetEvents(std::vector<TraceEvent>& outEvents, std::vector<unsigned int>& outThreads) const;
+
+	// One summary for each name, slowest in total first.
+	void Summarise(std::vector<TraceSummary>& outSummaries) const;
+
+	// Write every event held as Chrome's JSON trace format. Returns false if the file couldn't be written.
+	bool WriteChromeTrace(const char* path) const;
+
+	// Events overwritten before they could be read, over every thread.
+	unsigned long long GetOverwrittenCount() const;
+
+	// The steady clock, in nanoseconds.
+	static unsigned long long Now();
+
+private:
+	// Not copyable.
+	Tracer(const Tracer&);
+	Tracer& operator=(const Tracer&);
+
+	struct Buffer
+	{
+		char								m_Name[32];
+		std::vector<TraceEvent>				m_Events;
+		std::atomic<unsigned long long>		m_Written;
+	};
+
+	Buffer* GetThreadBuffer();
+	void ResetBuffer(Buffer& buffer);
+
+	// The calling thread's buffer, and the tracer it belongs to.
+	static thread_local Buffer*			s_ThreadBuffer;
+	static thread_local const Tracer*	s_ThreadTracer;
+
+	std::atomic<bool>		m_Enabled;
+	size_t					m_EventsPerThread;
+
+	// Guards the list of buffers, not what is in them.
+	mutable std::mutex		m_BuffersMutex;
+	std::vector<Buffer*>	m_Buffers;
+};
+
+extern Tracer g_Tracer;
+
+//-------------------------------------------------------------------------------------------------------------
+// TraceScope
+// Records the time from its construction to its destruction, if tracing was on when it began. Use it through
+// the macros below, so that it can be compiled away.
+//-------------------------------------------------------------------------------------------------------------
+class TraceScope
+{
+public:
+	explicit TraceScope(const char* name, size_t count = 0)
+	: m_Name(name)
+	, m_Count(count)
+	, m_Active(g_Tracer.IsEnabled())
+	, m_Start(m_Active ? Tracer::Now() : 0)
+	{
+	}
+
+	~TraceScope()
+	{
+		if (m_Active)
+		{
+			g_Tracer.Record(m_Name, m_Start, Tracer::Now(), m_Count);
+		}
+	}
+
+private:
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+
+	const char*			m_Name;
+	size_t				m_Count;
+	bool				m_Active;
+	unsigned long long	m_Start;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// Markers
+// NT_TRACE_SCOPE times the rest of the enclosing scope under a name, which must be a string that outlives the
+// trace, such as a literal. NT_TRACE_SCOPE_COUNT also records how many objects the scope deals with; the count
+// isn't evaluated when tracing is compiled out.
+//-------------------------------------------------------------------------------------------------------------
+#define NT_TRACE_JOIN_INNER(a, b) a##b
+#define NT_TRACE_JOIN(a, b) NT_TRACE_JOIN_INNER(a, b)
+
+#if NT_TRACE
+#define NT_TRACE_SCOPE(name) TraceScope NT_TRACE_JOIN(traceScope, __LINE__)(name)
+#define NT_TRACE_SCOPE_COUNT(name, count) TraceScope NT_TRACE_JOIN(traceScope, __LINE__)(name, count)
+#define NT_TRACE_THREAD_NAME(name) g_Tracer.SetThreadName(name)
+#else
+#define NT_TRACE_SCOPE(name)
+#define NT_TRACE_SCOPE_COUNT(name, count)
+#define NT_TRACE_THREAD_NAME(name)
+#endif
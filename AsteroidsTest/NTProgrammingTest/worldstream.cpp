@@ -0,0 +1,354 @@
+//-------------------------------------------------------------------------------------------------------------
+// worldstream.cpp
+//
+// Implementation of the streamed playing field.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#include "stdafx.h"
+
+#include "worldstream.h"
+#include "objects.h"
+#include <algorithm>
+#include <cmath>
+
+// Positions are rounded down to whole units when spawned, which can bring two objects closer by up to the
+// diagonal of a unit square, so they are sampled that much further apart to start with.
+static const float PLACEMENT_SNAP_MARGIN = 1.5f;
+
+// How many of each object a chunk generates, before any are lost to the spacing.
+static const int MIN_SUNS_PER_CHUNK = 4;
+static const int MAX_SUNS_PER_CHUNK = 10;
+static const int MIN_ASTEROIDS_PER_CHUNK = 3;
+static const int MAX_ASTEROIDS_PER_CHUNK = 8;
+
+// Ships further out than this many chunks are treated as being at the edge, so chunk coordinates can't
+// overflow.
+static const float MAX_CHUNK_COORDINATE = 1e8f;
+
+//--------------------------------------------------------------------------------------------------------------
+// ScatterObjects
+// omit, if given, has a bit for each point generated; the points whose bits are set are skipped, with null
+// handles in their place.
+//--------------------------------------------------------------------------------------------------------------
+static size_t ScatterObjects(PoissonDiskSampler& sampler, RandomStream& random, float minX, float minY, float maxX,
+	float maxY, float spacing, size_t count, EntityArray& objects, ObjectSpawnFunction spawn,
+	const std::vector<unsigned int>* omit, std::vector<EntityHandle>* outHandles)
+{
+	std::vector<NTPoint> positions;
+	sampler.Generate(random, minX, minY, maxX, maxY, spacing + PLACEMENT_SNAP_MARGIN, count, positions);
+
+	objects.Reserve(objects.Size() + positions.size());
+	size_t spawned = 0;
+	for (size_t index = 0; index < positions.size(); index++)
+	{
+		EntityHandle handle;
+		if (omit == NULL || index / 32 >= omit->size() || ((*omit)[index / 32] & (1u << (index % 32))) == 0)
+		{
+			handle = spawn(objects, (int)floorf(positions[index].x), (int)floorf(positions[index].y));
+			spawned++;
+		}
+
+		if (outHandles != NULL)
+		{
+			outHandles->push_back(handle);
+		}
+	}
+	return spawned;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// ScatterObjects
+//--------------------------------------------------------------------------------------------------------------
+size_t ScatterObjects(PoissonDiskSampler& sampler, RandomStream& random, float minX, float minY, float maxX, float maxY,
+	float spacing, size_t count, EntityArray& objects, ObjectSpawnFunction spawn, std::vector<EntityHandle>* outHandles)
+{
+	return ScatterObjects(sampler, random, minX, minY, maxX, maxY, spacing, count, objects, spawn, NULL, outHandles);
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// WorldStreamer
+//--------------------------------------------------------------------------------------------------------------
+WorldStreamer::WorldStreamer()
+: m_Seed(0)
+, m_ForceUpdate(true)
+{
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Reset
+//--------------------------------------------------------------------------------------------------------------
+void WorldStreamer::Reset(unsigned int seed, const WorldStreamSettings& settings)
+{
+	assert(settings.m_ChunkSize > 0.f && settings.m_LoadRadius >= 0 && settings.m_EvictRadius >= settings.m_LoadRadius);
+
+	m_Seed = seed;
+	m_Settings = settings;
+	m_Stats = WorldStreamStats();
+	m_Chunks.clear();
+	m_ChunkIndex.clear();
+	m_DestroyedAsteroids.clear();
+	m_ShipChunks.clear();
+	m_PreviousShipChunks.clear();
+	m_ForceUpdate = true;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// GetChunkCoordinate
+// Written so that NaN lands in a chunk too.
+//--------------------------------------------------------------------------------------------------------------
+int WorldStreamer::GetChunkCoordinate(float value) const
+{
+	float chunk = floorf(value / m_Settings.m_ChunkSize);
+	if (!(chunk > -MAX_CHUNK_COORDINATE))
+	{
+		chunk = -MAX_CHUNK_COORDINATE;
+	}
+	else if (chunk > MAX_CHUNK_COORDINATE)
+	{
+		chunk = MAX_CHUNK_COORDINATE;
+	}
+	return (int)chunk;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// Update
+// Nothing is evicted that is near a ship, and everything near a ship is loaded, so when no ship has changed
+// chunk since the last update there is nothing to do. Otherwise chunks are evicted before any are loaded, so
+// a ship jumping a long way doesn't briefly hold both neighbourhoods at once.
+//--------------------------------------------------------------------------------------------------------------
+bool WorldStreamer::Update(EntityArray& suns, EntityArray& asteroids, const EntityArray& ships)
+{
+	m_ShipChunks.clear();
+	for (size_t index = 0; index < ships.Size(); index++)
+	{
+		m_ShipChunks.push_back(GetChunkKey(GetChunkCoordinate(ships.m_PositionX[index]), GetChunkCoordinate(ships.m_PositionY[index])));
+	}
+	std::sort(m_ShipChunks.begin(), m_ShipChunks.end());
+	m_ShipChunks.erase(std::unique(m_ShipChunks.begin(), m_ShipChunks.end()), m_ShipChunks.end());
+
+	if (!m_ForceUpdate && m_ShipChunks == m_PreviousShipChunks)
+	{
+		return false;
+	}
+	m_ForceUpdate = false;
+	m_PreviousShipChunks.swap(m_ShipChunks);
+	const std::vector<unsigned long long>& shipChunks = m_PreviousShipChunks;
+
+	for (size_t chunkIndex = 0; chunkIndex < m_Chunks.size(); chunkIndex++)
+	{
+		m_Chunks[chunkIndex].m_Kept = false;
+	}
+
+	const int evictRadius = m_Settings.m_EvictRadius;
+	for (size_t shipChunk = 0; shipChunk < shipChunks.size(); shipChunk++)
+	{
+		int shipX = (int)(shipChunks[shipChunk] >> 32);
+		int shipY = (int)(unsigned int)shipChunks[shipChunk];
+		for (int y = shipY - evictRadius; y <= shipY + evictRadius; y++)
+		{
+			for (int x = shipX - evictRadius; x <= shipX + evictRadius; x++)
+			{
+				std::unordered_map<unsigned long long, size_t>::const_iterator found = m_ChunkIndex.find(GetChunkKey(x, y));
+				if (found != m_ChunkIndex.end())
+				{
+					m_Chunks[found->second].m_Kept = true;
+				}
+			}
+		}
+	}
+
+	// Highest index first, so that the chunk moved into each hole has already been looked at.
+	bool changed = false;
+	for (size_t chunkIndex = m_Chunks.size(); chunkIndex-- > 0; )
+	{
+		if (!m_Chunks[chunkIndex].m_Kept)
+		{
+			EvictChunk(chunkIndex, suns, asteroids);
+			changed = true;
+		}
+	}
+
+	const int loadRadius = m_Settings.m_LoadRadius;
+	for (size_t shipChunk = 0; shipChunk < shipChunks.size(); shipChunk++)
+	{
+		int shipX = (int)(shipChunks[shipChunk] >> 32);
+		int shipY = (int)(unsigned int)shipChunks[shipChunk];
+		for (int y = shipY - loadRadius; y <= shipY + loadRadius; y++)
+		{
+			for (int x = shipX - loadRadius; x <= shipX + loadRadius; x++)
+			{
+				if (m_ChunkIndex.find(GetChunkKey(x, y)) == m_ChunkIndex.end())
+				{
+					LoadChunk(x, y, suns, asteroids);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	m_Stats.m_ResidentChunks = m_Chunks.size();
+	m_Stats.m_ModifiedChunks = m_DestroyedAsteroids.size();
+	return changed;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// LoadChunk
+// Each kind of object is kept half its spacing in from the chunk's edges, so that objects in neighbouring
+// chunks are properly spaced from each other too.
+//--------------------------------------------------------------------------------------------------------------
+void WorldStreamer::LoadChunk(int x, int y, EntityArray& suns, EntityArray& asteroids)
+{
+	unsigned long long key = GetChunkKey(x, y);
+
+	m_ChunkIndex[key] = m_Chunks.size();
+	m_Chunks.push_back(Chunk());
+	Chunk& chunk = m_Chunks.back();
+	chunk.m_X = x;
+	chunk.m_Y = y;
+	chunk.m_Kept = true;
+
+	float size = m_Settings.m_ChunkSize;
+	float minX = (float)x * size;
+	float minY = (float)y * size;
+	float maxX = minX + size;
+	float maxY = minY + size;
+
+	RandomStream countRandom(m_Seed, RANDOM_STREAM_WORLD, key);
+	size_t sunCount = (size_t)countRandom.NextRange(MIN_SUNS_PER_CHUNK, MAX_SUNS_PER_CHUNK + 1);
+	size_t asteroidCount = (size_t)countRandom.NextRange(MIN_ASTEROIDS_PER_CHUNK, MAX_ASTEROIDS_PER_CHUNK + 1);
+
+	RandomStream sunRandom(m_Seed, RANDOM_STREAM_SUNS, key);
+	float sunInset = Sun::MINIMUM_SPACING * 0.5f + PLACEMENT_SNAP_MARGIN;
+	ScatterObjects(m_Sampler, sunRandom, minX + sunInset, minY + sunInset, maxX - sunInset, maxY - sunInset,
+		Sun::MINIMUM_SPACING, sunCount, suns, Sun::Spawn, NULL, &chunk.m_Suns);
+
+	std::map<unsigned long long, std::vector<unsigned int> >::const_iterator destroyed = m_DestroyedAsteroids.find(key);
+	RandomStream asteroidRandom(m_Seed, RANDOM_STREAM_ASTEROIDS, key);
+	float asteroidInset = Asteroids::MINIMUM_SPACING * 0.5f + PLACEMENT_SNAP_MARGIN;
+	ScatterObjects(m_Sampler, asteroidRandom, minX + asteroidInset, minY + asteroidInset, maxX - asteroidInset,
+		maxY - asteroidInset, Asteroids::MINIMUM_SPACING, asteroidCount, asteroids, Asteroids::Spawn,
+		destroyed != m_DestroyedAsteroids.end() ? &destroyed->second : NULL, &chunk.m_Asteroids);
+
+	m_Stats.m_ChunksLoaded++;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// EvictChunk
+// Take the chunk's objects out of the arrays, noting which of its asteroids were destroyed, and move the last
+// chunk into its place.
+//--------------------------------------------------------------------------------------------------------------
+void WorldStreamer::EvictChunk(size_t chunkIndex, EntityArray& suns, EntityArray& asteroids)
+{
+	Chunk& chunk = m_Chunks[chunkIndex];
+	unsigned long long key = GetChunkKey(chunk.m_X, chunk.m_Y);
+
+	for (size_t index = 0; index < chunk.m_Suns.size(); index++)
+	{
+		suns.Remove(chunk.m_Suns[index]);
+	}
+
+	std::vector<unsigned int> destroyed((chunk.m_Asteroids.size() + 31) / 32, 0);
+	bool anyDestroyed = false;
+	for (size_t index = 0; index < chunk.m_Asteroids.size(); index++)
+	{
+		if (asteroids.Contains(chunk.m_Asteroids[index]))
+		{
+			asteroids.Remove(chunk.m_Asteroids[index]);
+		}
+		else
+		{
+			destroyed[index / 32] |= 1u << (index % 32);
+			anyDestroyed = true;
+		}
+	}
+	if (anyDestroyed)
+	{
+		m_DestroyedAsteroids[key].swap(destroyed);
+	}
+
+	m_ChunkIndex.erase(key);
+	if (chunkIndex + 1 < m_Chunks.size())
+	{
+		chunk = std::move(m_Chunks.back());
+		m_ChunkIndex[GetChunkKey(chunk.m_X, chunk.m_Y)] = chunkIndex;
+	}
+	m_Chunks.pop_back();
+
+	m_Stats.m_ChunksEvicted++;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// SaveState
+//--------------------------------------------------------------------------------------------------------------
+void WorldStreamer::SaveState(StateWriter& writer) const
+{
+	writer.WriteValue(m_Stats.m_ChunksLoaded);
+	writer.WriteValue(m_Stats.m_ChunksEvicted);
+
+	writer.WriteValue((unsigned int)m_Chunks.size());
+	for (size_t chunkIndex = 0; chunkIndex < m_Chunks.size(); chunkIndex++)
+	{
+		const Chunk& chunk = m_Chunks[chunkIndex];
+		writer.WriteValue(chunk.m_X);
+		writer.WriteValue(chunk.m_Y);
+		writer.WriteVector(chunk.m_Suns);
+		writer.WriteVector(chunk.m_Asteroids);
+	}
+
+	writer.WriteValue((unsigned int)m_DestroyedAsteroids.size());
+	for (std::map<unsigned long long, std::vector<unsigned int> >::const_iterator destroyed = m_DestroyedAsteroids.begin();
+		destroyed != m_DestroyedAsteroids.end(); ++destroyed)
+	{
+		writer.WriteValue(destroyed->first);
+		writer.WriteVector(destroyed->second);
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+// LoadState
+// Which chunks the ships were in isn't saved; the next update works it out again and, since the loaded
+// chunks already fit the ships, finds nothing to change.
+//--------------------------------------------------------------------------------------------------------------
+bool WorldStreamer::LoadState(StateReader& reader)
+{
+	m_Chunks.clear();
+	m_ChunkIndex.clear();
+	m_DestroyedAsteroids.clear();
+	m_PreviousShipChunks.clear();
+	m_ForceUpdate = true;
+
+	unsigned int chunkCount = 0;
+	reader.ReadValue(m_Stats.m_ChunksLoaded);
+	reader.ReadValue(m_Stats.m_ChunksEvicted);
+	reader.ReadValue(chunkCount);
+	for (unsigned int chunkIndex = 0; chunkIndex < chunkCount && !reader.HasFailed(); chunkIndex++)
+	{
+		Chunk chunk;
+		chunk.m_Kept = true;
+		reader.ReadValue(chunk.m_X);
+		reader.ReadValue(chunk.m_Y);
+		reader.ReadVector(chunk.m_Suns);
+		reader.ReadVector(chunk.m_Asteroids);
+
+		if (!m_ChunkIndex.insert(std::make_pair(GetChunkKey(chunk.m_X, chunk.m_Y), m_Chunks.size())).second)
+		{
+			return false;
+		}
+		m_Chunks.push_back(std::move(chunk));
+	}
+
+	unsigned int destroyedCount = 0;
+	reader.ReadValue(destroyedCount);
+	for (unsigned int destroyedIndex = 0; destroyedIndex < destroyedCount && !reader.HasFailed(); destroyedIndex++)
+	{
+		unsigned long long key = 0;
+		reader.ReadValue(key);
+		reader.ReadVector(m_DestroyedAsteroids[key]);
+	}
+
+	m_Stats.m_ResidentChunks = m_Chunks.size();
+	m_Stats.m_ModifiedChunks = m_DestroyedAsteroids.size();
+	return !reader.HasFailed();
+}
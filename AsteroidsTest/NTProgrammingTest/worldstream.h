@@ -0,0 +1,140 @@
+//-------------------------------------------------------------------------------------------------------------
+// worldstream.h
+//
+// An unbounded playing field, divided into square chunks whose suns and asteroids are generated from the seed
+// and the chunk's coordinates when a ship comes near, and removed again when every ship has left. Only the
+// chunks around ships exist at any time, so memory and the cost of a tick depend on how many ships there are
+// rather than on how big the world is.
+//
+// Copyright(c) Ninja Theory 2010. All Rights Reserved.
+//-------------------------------------------------------------------------------------------------------------
+
+#pragma once
+
+//-------------------------------------------------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------------------------------------------------
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "entitystore.h"
+#include "poissondisk.h"
+#include "random.h"
+#include "statestream.h"
+
+typedef EntityHandle (*ObjectSpawnFunction)(EntityArray& objects, int x, int y);
+
+// Spawn up to count objects scattered over the rectangle, each at least spacing from the others, and append
+// their handles to outHandles if it is given. Returns the number spawned.
+size_t ScatterObjects(PoissonDiskSampler& sampler, RandomStream& random, float minX, float minY, float maxX, float maxY,
+	float spacing, size_t count, EntityArray& objects, ObjectSpawnFunction spawn, std::vector<EntityHandle>* outHandles);
+
+//-------------------------------------------------------------------------------------------------------------
+// WorldStreamSettings
+//-------------------------------------------------------------------------------------------------------------
+struct WorldStreamSettings
+{
+	WorldStreamSettings()
+	: m_ChunkSize(1024.f)
+	, m_LoadRadius(1)
+	, m_EvictRadius(2)
+	{
+	}
+
+	float	m_ChunkSize;
+
+	// Chunks up to m_LoadRadius chunks away from a ship's are loaded, and chunks more than m_EvictRadius away
+	// from every ship's are evicted. The gap between the two stops a ship weaving across a chunk border from
+	// loading and evicting the same chunks over and over.
+	int		m_LoadRadius;
+	int		m_EvictRadius;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// WorldStreamStats
+//-------------------------------------------------------------------------------------------------------------
+struct WorldStreamStats
+{
+	WorldStreamStats()
+	: m_ResidentChunks(0)
+	, m_ModifiedChunks(0)
+	, m_ChunksLoaded(0)
+	, m_ChunksEvicted(0)
+	{
+	}
+
+	size_t				m_ResidentChunks;
+
+	// Chunks that have been changed by play and then evicted, whose changes are kept to be put back when they
+	// are loaded again.
+	size_t				m_ModifiedChunks;
+
+	unsigned long long	m_ChunksLoaded;
+	unsigned long long	m_ChunksEvicted;
+};
+
+//-------------------------------------------------------------------------------------------------------------
+// WorldStreamer
+// Owns no entities itself; it adds the suns and asteroids of the chunks it loads to the game's arrays and
+// remembers their handles so it can take them out again. Suns never change, so an evicted chunk's suns are
+// simply generated again. Asteroids can be destroyed, so on eviction the chunk records which of its
+// asteroids are gone, as one bit per asteroid it generated, and those are left out when it is next loaded.
+//-------------------------------------------------------------------------------------------------------------
+class WorldStreamer
+{
+public:
+	WorldStreamer();
+
+	// Forget every chunk and every change, without touching the arrays.
+	void Reset(unsigned int seed, const WorldStreamSettings& settings);
+
+	// Load the chunks the ships are near and evict the ones they have all left. Returns true if suns or
+	// asteroids were added or removed, in which case indices into those arrays have changed.
+	bool Update(EntityArray& suns, EntityArray& asteroids, const EntityArray& ships);
+
+	const WorldStreamStats& GetStats() const { return m_Stats; }
+
+	// The chunks' handles are saved rather than their objects, so state must be loaded after the arrays the
+	// handles refer to.
+	void SaveState(StateWriter& writer) const;
+	bool LoadState(StateReader& reader);
+
+private:
+	struct Chunk
+	{
+		int							m_X;
+		int							m_Y;
+		std::vector<EntityHandle>	m_Suns;
+
+		// One entry for every asteroid the chunk generates, in the order generated, with a null handle for
+		// any destroyed before the chunk was loaded.
+		std::vector<EntityHandle>	m_Asteroids;
+
+		bool						m_Kept;
+	};
+
+	static unsigned long long GetChunkKey(int x, int y) { return ((unsigned long long)(unsigned int)x << 32) | (unsigned int)y; }
+	int GetChunkCoordinate(float value) const;
+
+	void LoadChunk(int x, int y, EntityArray& suns, EntityArray& asteroids);
+	void EvictChunk(size_t chunkIndex, EntityArray& suns, EntityArray& asteroids);
+
+	unsigned int				m_Seed;
+	WorldStreamSettings			m_Settings;
+	WorldStreamStats			m_Stats;
+
+	std::vector<Chunk>			m_Chunks;
+	std::unordered_map<unsigned long long, size_t>	m_ChunkIndex;
+
+	// Which asteroids are destroyed in each evicted chunk that had any destroyed, 32 to a word. Ordered, so
+	// that saved state is the same however the chunks were visited.
+	std::map<unsigned long long, std::vector<unsigned int> >	m_DestroyedAsteroids;
+
+	// The distinct chunks that had ships in them at the last update. If they haven't changed, neither has
+	// anything the update would do.
+	std::vector<unsigned long long>	m_ShipChunks;
+	std::vector<unsigned long long>	m_PreviousShipChunks;
+	bool						m_ForceUpdate;
+
+	PoissonDiskSampler			m_Sampler;
+};